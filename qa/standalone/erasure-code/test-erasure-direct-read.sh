@@ -0,0 +1,280 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+#
+# Client reads that fall within one data chunk are served by the shard
+# holding that chunk (osd_ec_direct_reads).  Check that they return the
+# right data, that reads spanning chunks or stripes still decode, and that
+# a shard which is down, missing the object or failing the read sends the
+# read back to the decoding path.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7148" # git grep '\<7148\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+    CEPH_ARGS+="--osd-objectstore=filestore "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        run_mon $dir a || return 1
+        run_mgr $dir x || return 1
+        for id in 0 1 2 3 ; do
+            run_osd $dir $id || return 1
+        done
+        create_erasure_coded_pool $poolname || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+poolname=pool-jerasure
+# one stripe of k=2 chunks of 4K
+chunk_size=4096
+stripe_width=8192
+
+function create_erasure_coded_pool() {
+    local poolname=$1
+
+    ceph osd erasure-code-profile set myprofile \
+        plugin=jerasure \
+        k=2 m=2 \
+        stripe_unit=$chunk_size \
+        crush-failure-domain=osd || return 1
+    create_pool $poolname 1 1 erasure myprofile || return 1
+    wait_for_clean || return 1
+}
+
+function make_data() {
+    local file=$1
+    local bytes=$2
+
+    dd if=/dev/urandom of=$file bs=$bytes count=1 2>/dev/null || return 1
+}
+
+##
+# Print how many direct reads of **objname** the primary sent to the
+# shard **shard** of the object, or to any shard if **shard** is empty.
+#
+function count_direct_reads() {
+    local dir=$1
+    local objname=$2
+    local shard=$3
+
+    local primary=$(get_primary $poolname $objname)
+    CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$primary) \
+        log flush >&2 || return 1
+    grep -c "objects_read_direct: .*:::$objname:head.* from [0-9]*(${shard:-[0-9]*})" \
+        $dir/osd.$primary.log
+}
+
+##
+# Print how many direct reads of **objname** fell back to decoding.
+#
+function count_fallbacks() {
+    local dir=$1
+    local objname=$2
+
+    local primary=$(get_primary $poolname $objname)
+    CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$primary) \
+        log flush >&2 || return 1
+    grep -c "handle_direct_read: .*:::$objname:head" $dir/osd.$primary.log
+}
+
+##
+# Read **objname** in pieces of **block** bytes and compare it with
+# **expected**.
+#
+function get_and_compare() {
+    local dir=$1
+    local objname=$2
+    local block=$3
+    local expected=$4
+
+    rados --pool $poolname -b $block get $objname $dir/COPY || return 1
+    cmp $expected $dir/COPY || return 1
+    rm $dir/COPY
+}
+
+function TEST_direct_read_chunk() {
+    local dir=$1
+    local objname=obj-chunk
+
+    make_data $dir/ORIGINAL $stripe_width || return 1
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+
+    # every 1K piece lies within chunk 0 or chunk 1
+    get_and_compare $dir $objname 1024 $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname 0) = 4 || return 1
+    test $(count_direct_reads $dir $objname 1) = 4 || return 1
+    test $(count_fallbacks $dir $objname) = 0 || return 1
+
+    # a whole chunk at once
+    get_and_compare $dir $objname $chunk_size $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname 0) = 5 || return 1
+    test $(count_direct_reads $dir $objname 1) = 5 || return 1
+    test $(count_fallbacks $dir $objname) = 0 || return 1
+
+    # the tail of an object that ends within a chunk
+    make_data $dir/SHORT 5000 || return 1
+    rados --pool $poolname put $objname $dir/SHORT || return 1
+    get_and_compare $dir $objname $chunk_size $dir/SHORT || return 1
+    test $(count_direct_reads $dir $objname 1) = 6 || return 1
+    test $(count_fallbacks $dir $objname) = 0 || return 1
+}
+
+function TEST_direct_read_span() {
+    local dir=$1
+    local objname=obj-span
+
+    # 6000 bytes pieces of 24000: each one crosses a chunk or a stripe
+    # boundary, so none of them is a direct read
+    make_data $dir/ORIGINAL 24000 || return 1
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+    get_and_compare $dir $objname 6000 $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname) = 0 || return 1
+
+    # the whole object in one read
+    get_and_compare $dir $objname 65536 $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname) = 0 || return 1
+
+    # 3000 bytes pieces: some fit in a chunk, the others decode
+    get_and_compare $dir $objname 3000 $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname) -gt 0 || return 1
+    test $(count_fallbacks $dir $objname) = 0 || return 1
+}
+
+function TEST_direct_read_shard_down() {
+    local dir=$1
+    local objname=obj-down
+
+    make_data $dir/ORIGINAL $stripe_width || return 1
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+    local -a osds=($(get_osds $poolname $objname))
+
+    ceph osd set noout || return 1
+    kill_daemons $dir TERM osd.${osds[1]} >&2 < /dev/null || return 1
+    ceph osd down osd.${osds[1]} || return 1
+
+    # chunk 1 has no acting shard left: its pieces decode
+    get_and_compare $dir $objname 1024 $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname 1) = 0 || return 1
+    test $(count_direct_reads $dir $objname 0) = 4 || return 1
+
+    activate_osd $dir ${osds[1]} || return 1
+    ceph osd unset noout || return 1
+    wait_for_clean || return 1
+}
+
+function TEST_direct_read_shard_missing() {
+    local dir=$1
+    local objname=obj-missing
+
+    make_data $dir/ORIGINAL $stripe_width || return 1
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+    local -a osds=($(get_osds $poolname $objname))
+
+    # rewrite the object while the shard of chunk 1 is down, and keep it
+    # from being recovered once the shard is back
+    ceph osd set noout || return 1
+    kill_daemons $dir TERM osd.${osds[1]} >&2 < /dev/null || return 1
+    ceph osd down osd.${osds[1]} || return 1
+    make_data $dir/NEW $stripe_width || return 1
+    rados --pool $poolname put $objname $dir/NEW || return 1
+    ceph osd set norecover || return 1
+    ceph osd set nobackfill || return 1
+    activate_osd $dir ${osds[1]} || return 1
+    wait_for_osd up ${osds[1]} || return 1
+
+    # the shard is acting again but still misses the object
+    get_and_compare $dir $objname 1024 $dir/NEW || return 1
+    test $(count_direct_reads $dir $objname 1) = 0 || return 1
+    test $(count_direct_reads $dir $objname 0) = 4 || return 1
+
+    ceph osd unset norecover || return 1
+    ceph osd unset nobackfill || return 1
+    ceph osd unset noout || return 1
+    wait_for_clean || return 1
+
+    # recovered: direct reads are back
+    get_and_compare $dir $objname 1024 $dir/NEW || return 1
+    test $(count_direct_reads $dir $objname 1) = 4 || return 1
+}
+
+function TEST_direct_read_shard_error() {
+    local dir=$1
+    local objname=obj-error
+
+    make_data $dir/ORIGINAL $stripe_width || return 1
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+
+    # the shard of chunk 1 fails the read: it is decoded from the others
+    inject_eio ec data $poolname $objname $dir 1 || return 1
+    get_and_compare $dir $objname $chunk_size $dir/ORIGINAL || return 1
+    test $(count_direct_reads $dir $objname 1) = 1 || return 1
+    test $(count_fallbacks $dir $objname) = 1 || return 1
+
+    # the shard lost its copy altogether
+    local -a osds=($(get_osds $poolname $objname))
+    objectstore_tool $dir ${osds[1]} $objname remove || return 1
+    get_and_compare $dir $objname $chunk_size $dir/ORIGINAL || return 1
+    test $(count_fallbacks $dir $objname) = 2 || return 1
+}
+
+function TEST_direct_read_pending_writes() {
+    local dir=$1
+    local objname=obj-writes
+
+    make_data $dir/V0 $stripe_width || return 1
+    make_data $dir/V1 $stripe_width || return 1
+    rados --pool $poolname put $objname $dir/V0 || return 1
+
+    # overwrite the object back and forth while it is being read
+    (
+        for i in $(seq 1 40) ; do
+            rados --pool $poolname put $objname $dir/V$((i % 2)) || exit 1
+        done
+    ) &
+    local writer=$!
+
+    for i in $(seq 1 20) ; do
+        rados --pool $poolname -b 1024 get $objname $dir/COPY || return 1
+        # each piece is a single read, it must come from one version
+        for piece in $(seq 0 7) ; do
+            local skip=$((piece * 1024))
+            if ! cmp -s -n 1024 -i $skip:$skip $dir/V0 $dir/COPY &&
+               ! cmp -s -n 1024 -i $skip:$skip $dir/V1 $dir/COPY ; then
+                echo "piece $piece of read $i matches no version"
+                return 1
+            fi
+        done
+    done
+    wait $writer || return 1
+
+    # the 40th write put V0 back
+    get_and_compare $dir $objname 1024 $dir/V0 || return 1
+    test $(count_direct_reads $dir $objname) -gt 0 || return 1
+}
+
+main test-erasure-direct-read "$@"
+
+# Local Variables:
+# compile-command: "cd ../../../build ; make -j4 && ../qa/run-standalone.sh test-erasure-direct-read.sh"
+# End:
@@ -73,6 +73,14 @@ static ceph::spinlock debug_lock;
     return buffer_missed_crc;
   }
 
+  // per thread, so that callers can attribute copies to the work they do
+  // without contending on a shared counter
+  static thread_local uint64_t buffer_thread_memcopy = 0;
+
+  uint64_t buffer::get_thread_memcopy_count() {
+    return buffer_thread_memcopy;
+  }
+
   const char * buffer::error::what() const throw () {
     return "buffer::exception";
   }
@@ -1232,6 +1240,7 @@ static ceph::spinlock debug_lock;
       pos += node.length();
     }
     _memcopy_count += pos;
+    buffer_thread_memcopy += pos;
     _carriage = &always_empty_bptr;
     _buffers.clear_and_dispose();
     if (likely(nb->length())) {
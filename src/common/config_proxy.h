@@ -118,6 +118,12 @@ public:
   ConfigValues* operator->() noexcept {
     return &values;
   }
+  // for seeding a context with the settings of another one, crimson's for
+  // instance
+  void set_config_values(const ConfigValues& val) {
+    std::lock_guard l{lock};
+    values = val;
+  }
   int get_val(const std::string& key, char** buf, int len) const {
     std::lock_guard l{lock};
     return config.get_val(values, key, buf, len);
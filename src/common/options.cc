@@ -1061,6 +1061,16 @@ std::vector<Option> get_global_options() {
     .set_description("Maximum threadpool size of AsyncMessenger")
     .add_see_also("ms_async_op_threads"),
 
+    Option("ms_async_send_batch_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(128_K)
+    .set_description("Coalesce queued messages of a connection into one socket send up to this many bytes")
+    .set_long_description("When more messages are queued behind the one being written, the msgr2 protocol appends them to the same outgoing buffer and hands them to the kernel in a single gathered sendmsg, as long as the buffer stays below this size and IOV_MAX segments. 0 sends every message on its own."),
+
+    Option("ms_async_zerocopy_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Send with MSG_ZEROCOPY when a sendmsg carries at least this many bytes (0 disables)")
+    .set_long_description("Linux only. The kernel pins the pages instead of copying them into the socket; the sender keeps the buffers referenced until the completion is read back from the socket error queue. Pinning costs more than copying for small sends, so values below 10K or so are counterproductive. Only applies to connections created after the change."),
+
     Option("ms_async_rdma_device_name", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
     .set_description(""),
@@ -2710,6 +2720,14 @@ std::vector<Option> get_global_options() {
     .set_long_description("the threshold between high priority ops that use strict priority ordering and low priority ops that use a fairness algorithm that may or may not incorporate priority")
     .add_see_also("osd_op_queue"),
 
+    Option("osd_op_batch_max", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("Maximum number of client ops and replicated writes for the same PG run under one hold of the PG lock")
+    .set_long_description("Once a worker thread holds the lock of a PG, it also runs the ops for that PG which other worker threads of its shard already took from the op queue and which wait for the PG lock, up to this many ops in all, and it submits their transactions to the object store together.  The op queue is not consulted for them, so its scheduling is unchanged, and batching only happens with more than one thread per shard.  Only ops of replicated pools are batched.  1 disables batching.")
+    .add_see_also("osd_op_queue")
+    .add_see_also("osd_op_num_threads_per_shard"),
+
     Option("osd_op_queue_mclock_client_op_res", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(1000.0)
     .set_description("mclock reservation of client operator requests")
@@ -3174,6 +3192,16 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_ec_parity_delta_writes", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Update coding chunks from the data delta for small erasure coded overwrites")
+    .set_long_description("When a write to a pool with allow_ec_overwrites falls within a single data chunk of a stripe, and the erasure code plugin supports it, read only that range from the data shard and the coding shards and fold the delta into the coding chunks, instead of reading and re-encoding the whole stripe."),
+
+    Option("osd_ec_direct_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Serve erasure coded reads that fall within a single data chunk from that shard alone")
+    .set_long_description("When every extent of a client read lies within the same data chunk of its stripe and the shard holding that chunk is up and has the object, read only that range from the shard instead of reading and decoding whole stripes from k shards.  If the shard cannot serve the read, fall back to the decoding read."),
+
     Option("osd_recover_clone_overlap_limit", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description(""),
@@ -3313,6 +3341,39 @@ std::vector<Option> get_global_options() {
     .set_default(3)
     .set_description(""),
 
+    Option("osd_recovery_adaptive", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Pace recovery and backfill by client op latency")
+    .set_long_description("Instead of the fixed osd_recovery_sleep* and osd_recovery_max_active, continuously adjust the number of concurrent recovery ops, the sleep between them and the number of backfill reservations (up to osd_max_backfills) to hold client op p99 latency at osd_recovery_adaptive_target_p99.")
+    .add_see_also("osd_recovery_adaptive_target_p99")
+    .add_see_also("osd_recovery_adaptive_max_active")
+    .add_see_also("osd_recovery_adaptive_max_sleep")
+    .add_see_also("osd_recovery_adaptive_max_queue_util"),
+
+    Option("osd_recovery_adaptive_target_p99", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.1)
+    .set_min(0.0001)
+    .set_description("Client op p99 latency (seconds) the adaptive recovery throttle aims for")
+    .add_see_also("osd_recovery_adaptive"),
+
+    Option("osd_recovery_adaptive_max_queue_util", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.8)
+    .set_min_max(0.0, 1.0)
+    .set_description("Object store queue utilization above which the adaptive recovery throttle backs off")
+    .add_see_also("osd_recovery_adaptive"),
+
+    Option("osd_recovery_adaptive_max_active", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(16)
+    .set_min(1)
+    .set_description("Upper bound for concurrent recovery ops under the adaptive recovery throttle")
+    .add_see_also("osd_recovery_adaptive"),
+
+    Option("osd_recovery_adaptive_max_sleep", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.5)
+    .set_min(0.0)
+    .set_description("Upper bound for the sleep (seconds) between recovery ops under the adaptive recovery throttle")
+    .add_see_also("osd_recovery_adaptive"),
+
     Option("osd_recovery_max_single_start", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description(""),
@@ -3436,6 +3497,17 @@ std::vector<Option> get_global_options() {
     .set_default(512_K)
     .set_description("Number of bytes to read from an object at a time during deep scrub"),
 
+    Option("osd_deep_scrub_store_digest", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Let the object store verify and digest object data during deep scrub")
+    .set_long_description("When the object store supports it, deep scrub asks it for a crc32c digest of the object data instead of reading the data into the OSD.  BlueStore verifies its blob checksums and derives the digest from them.")
+    .add_see_also("osd_deep_scrub_digest_stride"),
+
+    Option("osd_deep_scrub_digest_stride", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(4_M)
+    .set_description("Number of bytes of an object to digest at a time during deep scrub, when the object store digests the data itself")
+    .add_see_also("osd_deep_scrub_store_digest"),
+
     Option("osd_deep_scrub_keys", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("Number of keys to read from an object at a time during deep scrub"),
@@ -3983,6 +4055,28 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("crimson_osd_objectstore", Option::TYPE_STR, Option::LEVEL_DEV)
+    .set_default("cyanstore")
+    .set_enum_allowed({"cyanstore", "alienstore"})
+    .set_flag(Option::FLAG_CREATE)
+    .set_description("backend type for a crimson OSD")
+    .set_long_description("alienstore runs the classic store selected by "
+                          "osd_objectstore in a pool of non-seastar threads.")
+    .add_see_also({"osd_objectstore", "crimson_alien_op_num_threads"}),
+
+    Option("crimson_alien_op_num_threads", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(6)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("number of threads calling into the classic store of alienstore"),
+
+    Option("crimson_alien_thread_cpu", Option::TYPE_INT, Option::LEVEL_DEV)
+    .set_default(-1)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("CPU core the alienstore threads are pinned to")
+    .set_long_description("-1 picks the first core after the ones seastar "
+                          "runs its reactors on, or the last core if there "
+                          "is none left."),
+
     Option("osd_bench_small_size_max_iops", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(100)
     .set_description(""),
@@ -4084,6 +4178,21 @@ std::vector<Option> get_global_options() {
     .set_default(16)
     .set_description(""),
 
+    Option("bdev_ioring", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Enables Linux io_uring API instead of libaio")
+    .set_long_description("Falls back to libaio if the OSD was built without liburing or the running kernel does not support io_uring."),
+
+    Option("bdev_ioring_hipri", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use polled IO completions with io_uring")
+    .add_see_also("bdev_ioring"),
+
+    Option("bdev_ioring_sqthread_poll", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Offload io_uring submission queue polling to a kernel thread")
+    .add_see_also("bdev_ioring"),
+
     Option("bdev_block_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(4_K)
     .set_description(""),
@@ -4260,6 +4369,57 @@ std::vector<Option> get_global_options() {
     .add_see_also("bluestore_block_db_path")
     .add_see_also("bluestore_block_db_size"),
 
+    Option("bluestore_fast_tier_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_CREATE)
+    .set_description("Space at the end of block.db set aside for object data")
+    .set_long_description("If non-zero and a separate block.db device is used, mkfs carves this much (capped at half of the device) out of the end of block.db and uses it as a fast tier for small and frequently read object data.  BlueFS gets the rest of the device.")
+    .add_see_also("bluestore_block_db_path"),
+
+    Option("bluestore_fast_tier_max_write", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Allocations up to this size are placed on the fast tier")
+    .set_long_description("Larger allocations only go to the fast tier if the object is hot.")
+    .add_see_also("bluestore_fast_tier_hot_reads"),
+
+    Option("bluestore_fast_tier_hot_reads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Read heat at which an object is considered hot")
+    .set_long_description("Each read of an object adds one to its heat, which halves every bluestore_fast_tier_heat_half_life seconds.  Writes to hot objects are placed on the fast tier regardless of size and hot objects are never demoted.")
+    .add_see_also("bluestore_fast_tier_heat_half_life"),
+
+    Option("bluestore_fast_tier_heat_half_life", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(300)
+    .set_min(1)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Seconds after which an object's read heat is halved"),
+
+    Option("bluestore_fast_tier_demote_age", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(600)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Seconds an object must go untouched before its data is demoted from the fast tier")
+    .set_long_description("Ignored while the fast tier has less than bluestore_fast_tier_min_free_ratio free.")
+    .add_see_also("bluestore_fast_tier_min_free_ratio"),
+
+    Option("bluestore_fast_tier_min_free_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_min_max(0.0, 1.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Fast tier free space below which nothing new is placed on it and all data but hot objects' is demoted"),
+
+    Option("bluestore_fast_tier_demote_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(30)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("How often (in seconds) fast tier residents are checked for demotion"),
+
+    Option("bluestore_fast_tier_demote_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(4_M)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Max object data a single transaction rewrites to demote it from the fast tier")
+    .set_long_description("Demotions are carried out by the next transaction submitted to the object's collection, so that they are ordered with client writes."),
+
     Option("bluestore_block_wal_path", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("")
     .set_flag(Option::FLAG_CREATE)
@@ -4419,6 +4579,12 @@ std::vector<Option> get_global_options() {
     .set_description("")
     .add_see_also("bluestore_max_blob_size"),
 
+    Option("bluestore_inline_data_max", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Store data of objects up to this size inside the onode")
+    .set_long_description("Objects whose data never grows past this size are kept in the onode key in the kv store instead of allocating min_alloc_size on disk, so a read needs no device I/O after the onode is loaded.  An object that grows past the limit is moved to regular blobs.  Onodes carrying inline data cannot be decoded by releases that do not know about it.  0 disables."),
+
     Option("bluestore_compression_required_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(.875)
     .set_flag(Option::FLAG_RUNTIME)
@@ -4453,6 +4619,55 @@ std::vector<Option> get_global_options() {
     .set_default(64)
     .set_description("Max pinned cache entries we consider before giving up"),
 
+    Option("bluestore_cache_trim_max_onode_batch", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(256)
+    .set_description("Max onodes trimmed from a cache shard before dropping its lock")
+    .set_long_description("0 means trim everything in one go"),
+
+    Option("bluestore_cache_trim_max_buffer_batch", Option::TYPE_SIZE, Option::LEVEL_DEV)
+    .set_default(4_M)
+    .set_description("Max buffer bytes trimmed from a cache shard before dropping its lock")
+    .set_long_description("0 means trim everything in one go"),
+
+    Option("bluestore_cache_collection_shards", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Number of cache shards a single collection's onodes and buffers are spread over")
+    .set_long_description("Objects are hashed over this many cache shards (capped to the total shard count) so that a hot collection does not serialize on a single shard lock."),
+
+    Option("bluestore_onode_warmup", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Record the hottest onodes and prefetch them after a restart")
+    .set_long_description("The keys of the most recently used onodes are periodically written to a small BlueFS file and, on mount, loaded back into the cache by a background thread."),
+
+    Option("bluestore_onode_warmup_max_onodes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(100000)
+    .set_description("Max onodes recorded for and prefetched on warm-up")
+    .add_see_also("bluestore_onode_warmup"),
+
+    Option("bluestore_onode_warmup_checkpoint_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(600)
+    .set_description("How often (in seconds) the hot onode list is recorded")
+    .set_long_description("The list is also recorded on a clean umount.  0 means only on umount.")
+    .add_see_also("bluestore_onode_warmup"),
+
+    Option("bluestore_onode_warmup_buffers", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Also record cached data ranges and read them back on warm-up")
+    .add_see_also("bluestore_onode_warmup_max_bytes"),
+
+    Option("bluestore_onode_warmup_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(256_M)
+    .set_description("Max object data read back into the buffer cache on warm-up")
+    .add_see_also("bluestore_onode_warmup_buffers"),
+
+    Option("bluestore_onode_warmup_max_ops_per_sec", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1000)
+    .set_description("Max onode loads and data reads per second issued by warm-up")
+    .set_long_description("0 means unthrottled.")
+    .add_see_also("bluestore_onode_warmup"),
+
     Option("bluestore_cache_type", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("2q")
     .set_enum_allowed({"2q", "lru"})
@@ -4509,10 +4724,26 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_allocator", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("bitmap")
-    .set_enum_allowed({"bitmap", "stupid"})
+    .set_enum_allowed({"bitmap", "stupid", "avl", "hybrid"})
     .set_description("Allocator policy")
     .set_long_description("Allocator to use for bluestore.  Stupid should only be used for testing."),
 
+    Option("bluestore_avl_alloc_bf_threshold", Option::TYPE_SIZE, Option::LEVEL_DEV)
+    .set_default(128_K)
+    .set_description("Sets threshold at which avl allocator switches to best-fit mode")
+    .set_long_description("Requests of at least this size are always served best-fit.  "
+			  "Smaller requests are served first-fit unless the largest "
+			  "contiguous free extent is shorter than this threshold."),
+
+    Option("bluestore_avl_alloc_bf_free_pct", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(4)
+    .set_description("Sets free space percentage below which avl allocator switches to best-fit mode")
+    .add_see_also("bluestore_avl_alloc_bf_threshold"),
+
+    Option("bluestore_hybrid_alloc_mem_cap", Option::TYPE_SIZE, Option::LEVEL_DEV)
+    .set_default(64_M)
+    .set_description("Maximum RAM hybrid allocator should use before enabling bitmap supplement"),
+
     Option("bluestore_freelist_blocks_per_key", Option::TYPE_SIZE, Option::LEVEL_DEV)
     .set_default(128)
     .set_description("Block (and bits) per database key"),
@@ -4539,7 +4770,8 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_rocksdb_cfs", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("M= P= L=")
-    .set_description("List of whitespace-separate key/value pairs where key is CF name and value is CF options"),
+    .set_description("List of whitespace-separate key/value pairs where key is CF name and value is CF options")
+    .set_long_description("A key of the form name(N) hashes the keys of prefix 'name' over N column families name-0 .. name-(N-1); name(N,l-h) feeds only key bytes [l, h) to the hash.  The layout is fixed when the store is created; use 'ceph-bluestore-tool reshard' to change it."),
 
     Option("bluestore_fsck_on_mount", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
@@ -4574,6 +4806,13 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_RUNTIME)
     .set_description("Maximum bytes read at once by deep fsck"),
 
+    Option("bluestore_fsck_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Number of threads fsck walks the object keyspace with")
+    .set_long_description("The object keyspace is split at collection boundaries and the pieces are checked in parallel."),
+
     Option("bluestore_throttle_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(64_M)
     .set_flag(Option::FLAG_RUNTIME)
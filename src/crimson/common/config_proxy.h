@@ -88,6 +88,9 @@ public:
   ConfigValues* operator->() noexcept {
     return values.get();
   }
+  const ConfigValues& get_config_values() const {
+    return *values.get();
+  }
 
   // required by sharded<>
   seastar::future<> start();
@@ -100,11 +100,16 @@ class Messenger {
 
   virtual void set_policy_throttler(entity_type_t peer_type, Throttle* throttle) = 0;
 
+  /// master_sid of create() is either a shard holding all connections, or
+  /// one of these to spread them over all shards
+  static constexpr int SHARD_BY_IP = -1;     ///< by peer ip
+  static constexpr int SHARD_BALANCED = -2;  ///< by peer ip, port and nonce
+
   static seastar::future<Messenger*>
   create(const entity_name_t& name,
          const std::string& lname,
          const uint64_t nonce,
-         const int master_sid=-1);
+         const int master_sid=SHARD_BY_IP);
 };
 
 inline ostream& operator<<(ostream& out, const Messenger& msgr) {
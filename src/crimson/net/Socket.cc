@@ -56,6 +56,13 @@ seastar::future<bufferlist> Socket::read(size_t bytes)
   if (bytes == 0) {
     return seastar::make_ready_future<bufferlist>();
   }
+  if (seastar::engine().cpu_id() != sid) {
+    // the buffers are wrapped with create_foreign(), so they go back to
+    // this core when the caller frees them
+    return seastar::smp::submit_to(sid, [this, bytes] {
+        return read(bytes);
+      });
+  }
   r.buffer.clear();
   r.remaining = bytes;
   return in.consume(bufferlist_consumer{r.buffer, r.remaining})
@@ -69,6 +76,15 @@ seastar::future<bufferlist> Socket::read(size_t bytes)
 
 seastar::future<seastar::temporary_buffer<char>>
 Socket::read_exactly(size_t bytes) {
+  if (seastar::engine().cpu_id() != sid) {
+    // the buffer may share its deleter with what is left in the stream;
+    // hand out a copy of our own instead
+    return seastar::smp::submit_to(sid, [this, bytes] {
+        return read_exactly(bytes).then([] (tmp_buf buf) {
+            return tmp_buf(buf.get(), buf.size());
+          });
+      });
+  }
   return in.read_exactly(bytes)
     .then([this](auto buf) {
       if (buf.empty()) {
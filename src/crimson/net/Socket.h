@@ -10,6 +10,9 @@
 
 namespace ceph::net {
 
+/// A connected socket and its streams. They belong to the reactor of the
+/// core that created the socket; calls from a Connection on another core
+/// are forwarded there.
 class Socket
 {
   const seastar::shard_id sid;
@@ -38,13 +41,19 @@ class Socket
   seastar::future<tmp_buf> read_exactly(size_t bytes);
 
   seastar::future<> write(packet&& buf) {
-    return out.write(std::move(buf));
+    return seastar::smp::submit_to(sid, [this, buf = std::move(buf)] () mutable {
+        return out.write(std::move(buf));
+      });
   }
   seastar::future<> flush() {
-    return out.flush();
+    return seastar::smp::submit_to(sid, [this] {
+        return out.flush();
+      });
   }
   seastar::future<> write_flush(packet&& buf) {
-    return out.write(std::move(buf)).then([this] { return out.flush(); });
+    return seastar::smp::submit_to(sid, [this, buf = std::move(buf)] () mutable {
+        return out.write(std::move(buf)).then([this] { return out.flush(); });
+      });
   }
 
   /// Socket can only be closed once.
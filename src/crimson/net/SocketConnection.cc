@@ -347,7 +347,8 @@ seastar::future<> SocketConnection::do_close()
         return pending_dispatch.close();
       }).finally(std::move(cleanup));
   } else {
-    ceph_assert(state == state_t::connecting);
+    // not connected yet, or the socket was handed over to another shard
+    ceph_assert(state == state_t::connecting || state == state_t::accepting);
     close_ready = pending_dispatch.close().finally(std::move(cleanup));
   }
   logger().debug("{} trigger closing, was {}", *this, static_cast<int>(state));
@@ -885,25 +886,79 @@ SocketConnection::start_accept(seastar::foreign_ptr<std::unique_ptr<Socket>>&& s
           peer_addr.set_type(addr.get_type());
           peer_addr.set_port(addr.get_port());
           peer_addr.set_nonce(addr.get_nonce());
-          return seastar::repeat([this] {
-            return repeat_handle_connect();
-          });
-        }).then([this] {
-          // notify the dispatcher and allow them to reject the connection
-          return dispatcher.ms_handle_accept(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
-        }).then([this] {
-          messenger.register_conn(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
-          messenger.unaccept_conn(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
-          execute_open();
+          if (auto owner = messenger.locate_shard(peer_addr);
+              owner != messenger.shard_id()) {
+            return hand_over_accept(owner);
+          }
+          return accept_handshake();
         }).handle_exception([this] (std::exception_ptr eptr) {
-          // TODO: handle fault in the accepting state
-          logger().warn("{} accepting fault: {}", *this, eptr);
-          h.promise.set_value();
-          close();
+          accept_fault(eptr);
         });
     });
 }
 
+void
+SocketConnection::resume_accept(seastar::foreign_ptr<std::unique_ptr<Socket>>&& sock,
+                                const entity_addr_t& _peer_addr,
+                                uint16_t _socket_port)
+{
+  ceph_assert(state == state_t::none);
+  ceph_assert(!socket);
+  peer_addr = _peer_addr;
+  side = side_t::acceptor;
+  socket_port = _socket_port;
+  socket = std::move(sock);
+  messenger.accept_conn(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
+  logger().debug("{} trigger accepting (handed over), was {}", *this, static_cast<int>(state));
+  state = state_t::accepting;
+  seastar::with_gate(pending_dispatch, [this] {
+      return accept_handshake()
+        .handle_exception([this] (std::exception_ptr eptr) {
+          accept_fault(eptr);
+        });
+    });
+}
+
+seastar::future<>
+SocketConnection::accept_handshake()
+{
+  return seastar::repeat([this] {
+      return repeat_handle_connect();
+    }).then([this] {
+      // notify the dispatcher and allow them to reject the connection
+      return dispatcher.ms_handle_accept(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
+    }).then([this] {
+      messenger.register_conn(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
+      messenger.unaccept_conn(seastar::static_pointer_cast<SocketConnection>(shared_from_this()));
+      execute_open();
+    });
+}
+
+seastar::future<>
+SocketConnection::hand_over_accept(seastar::shard_id owner)
+{
+  // the peer's port and nonce place it on another shard, whose messenger
+  // must see all of its connections
+  logger().debug("{} handing over to shard {}", *this, owner);
+  return messenger.container().invoke_on(owner,
+      [sock = std::move(socket), peer_addr = peer_addr,
+       socket_port = socket_port] (auto& msgr) mutable {
+        msgr.adopt_accepted(std::move(sock), peer_addr, socket_port);
+      }).then([this] {
+        h.promise.set_value();
+        close();
+      });
+}
+
+void
+SocketConnection::accept_fault(std::exception_ptr eptr)
+{
+  // TODO: handle fault in the accepting state
+  logger().warn("{} accepting fault: {}", *this, eptr);
+  h.promise.set_value();
+  close();
+}
+
 void
 SocketConnection::execute_open()
 {
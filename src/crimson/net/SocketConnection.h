@@ -78,6 +78,9 @@ class SocketConnection : public Connection {
   } h;
 
   /// server side of handshake negotiation
+  seastar::future<> accept_handshake();
+  seastar::future<> hand_over_accept(seastar::shard_id owner);
+  void accept_fault(std::exception_ptr eptr);
   seastar::future<stop_t> repeat_handle_connect();
   seastar::future<stop_t> handle_connect_with_existing(SocketConnectionRef existing,
                                                         bufferlist&& authorizer_reply);
@@ -197,6 +200,11 @@ class SocketConnection : public Connection {
   /// only call when SocketConnection first construct
   void start_accept(seastar::foreign_ptr<std::unique_ptr<Socket>>&& socket,
                     const entity_addr_t& peer_addr);
+  /// continue the server's handshake of a connection handed over by
+  /// another shard after the banner exchange
+  void resume_accept(seastar::foreign_ptr<std::unique_ptr<Socket>>&& socket,
+                     const entity_addr_t& peer_addr,
+                     uint16_t socket_port);
 
   /// the number of connections initiated in this session, increment when a
   /// new connection is established
@@ -147,9 +147,11 @@ seastar::future<> SocketMessenger::do_start(Dispatcher *disp)
             // allocate the connection
             entity_addr_t peer_addr;
             peer_addr.set_sockaddr(&paddr.as_posix_sockaddr());
-            auto shard = locate_shard(peer_addr);
-#warning fixme
-            // we currently do dangerous i/o from a Connection core, different from the Socket core.
+            // the port and nonce balanced sharding needs come with the
+            // banner; start here and let the connection move
+            auto shard = master_sid == SHARD_BALANCED ? sid : locate_shard(peer_addr);
+            // the Socket stays on this core, and does its i/o here for a
+            // Connection on another core
             auto sock = seastar::make_foreign(std::make_unique<Socket>(std::move(socket)));
             // don't wait before accepting another
             container().invoke_on(shard, [sock = std::move(sock), peer_addr, this](auto& msgr) mutable {
@@ -238,8 +240,10 @@ seastar::shard_id SocketMessenger::locate_shard(const entity_addr_t& addr)
   }
   std::size_t seed = 0;
   boost::hash_combine(seed, addr.u.sin.sin_addr.s_addr);
-  //boost::hash_combine(seed, addr.u.sin.sin_port);
-  //boost::hash_combine(seed, addr.nonce);
+  if (master_sid == SHARD_BALANCED) {
+    boost::hash_combine(seed, addr.u.sin.sin_port);
+    boost::hash_combine(seed, addr.nonce);
+  }
   return seed % seastar::smp::count;
 }
 
@@ -267,6 +271,10 @@ void SocketMessenger::register_conn(SocketConnectionRef conn)
 {
   if (master_sid >= 0) {
     ceph_assert(static_cast<int>(sid) == master_sid);
+  } else {
+    // reconnects and connection races are resolved by lookup_conn() on
+    // the shard of the peer's address
+    ceph_assert(locate_shard(conn->get_peer_addr()) == sid);
   }
   auto [i, added] = connections.emplace(conn->get_peer_addr(), conn);
   std::ignore = i;
@@ -281,3 +289,11 @@ void SocketMessenger::unregister_conn(SocketConnectionRef conn)
   ceph_assert(found->second == conn);
   connections.erase(found);
 }
+
+void SocketMessenger::adopt_accepted(seastar::foreign_ptr<std::unique_ptr<Socket>>&& socket,
+                                     const entity_addr_t& peer_addr,
+                                     uint16_t socket_port)
+{
+  SocketConnectionRef conn = seastar::make_shared<SocketConnection>(*this, *dispatcher);
+  conn->resume_accept(std::move(socket), peer_addr, socket_port);
+}
@@ -50,9 +50,12 @@ class SocketMessenger final : public Messenger, public seastar::peering_sharded_
   seastar::future<> do_shutdown();
   // conn sharding options:
   // 0. Compatible (master_sid >= 0): place all connections to one master shard
-  // 1. Simplest (master_sid < 0): sharded by ip only
-  // 2. Balanced (not implemented): sharded by ip + port + nonce,
-  //        but, need to move SocketConnection between cores.
+  // 1. Simplest (SHARD_BY_IP): sharded by ip only
+  // 2. Balanced (SHARD_BALANCED): sharded by ip + port + nonce, so that the
+  //        processes of one client host spread over all cores. An accepted
+  //        connection only learns the peer's port and nonce from its banner,
+  //        so it starts on the accepting core and is then handed over, see
+  //        adopt_accepted().
   seastar::shard_id locate_shard(const entity_addr_t& addr);
 
  public:
@@ -105,6 +108,11 @@ class SocketMessenger final : public Messenger, public seastar::peering_sharded_
   void unaccept_conn(SocketConnectionRef);
   void register_conn(SocketConnectionRef);
   void unregister_conn(SocketConnectionRef);
+  /// continue accepting a connection that belongs to this shard, whose
+  /// socket and banner exchange are done on another one
+  void adopt_accepted(seastar::foreign_ptr<std::unique_ptr<Socket>>&& socket,
+                      const entity_addr_t& peer_addr,
+                      uint16_t socket_port);
 
   // required by sharded<>
   seastar::future<> stop() {
@@ -612,7 +612,7 @@ public:
   int get_data_alignment() {
     if (!data.largest_data_len)
       return 0;
-    return (0 - get_data_offset()) & ~CEPH_PAGE_MASK;
+    return (data.largest_data_off - get_data_offset()) & ~CEPH_PAGE_MASK;
   }
   /// Is the Transaction empty (no operations)
   bool empty() {
@@ -0,0 +1,141 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// NOTE: this file is built without WITH_SEASTAR, as it talks to the classic
+// ObjectStore in the classic CephContext.
+
+#include "alien_backend.h"
+
+#include "common/ceph_context.h"
+#include "global/global_context.h"
+#include "include/Context.h"
+#include "os/ObjectStore.h"
+
+namespace {
+
+struct ClassicCollection final : public ceph::os::alien::Collection {
+  ObjectStore::CollectionHandle ch;
+  explicit ClassicCollection(ObjectStore::CollectionHandle&& ch)
+    : ch{std::move(ch)}
+  {}
+};
+
+ObjectStore::CollectionHandle&
+handle_of(const ceph::os::alien::CollectionRef& c)
+{
+  return static_cast<ClassicCollection*>(c.get())->ch;
+}
+
+class ClassicBackend final : public ceph::os::alien::Backend {
+  CephContext* cct;
+  std::unique_ptr<ObjectStore> store;
+
+public:
+  ClassicBackend(CephContext* cct, ObjectStore* store)
+    : cct{cct}, store{store}
+  {}
+  ~ClassicBackend() final {
+    store.reset();
+    if (g_ceph_context == cct) {
+      g_ceph_context = nullptr;
+    }
+    cct->put();
+  }
+
+  int mount() final {
+    return store->mount();
+  }
+  int umount() final {
+    return store->umount();
+  }
+  int mkfs(uuid_d osd_fsid) final {
+    store->set_fsid(osd_fsid);
+    return store->mkfs();
+  }
+
+  int read(const ceph::os::alien::CollectionRef& c,
+	   const ghobject_t& oid,
+	   uint64_t offset,
+	   size_t len,
+	   uint32_t op_flags,
+	   bufferlist* bl) final {
+    return store->read(handle_of(c), oid, offset, len, *bl, op_flags);
+  }
+  int omap_get_values(const ceph::os::alien::CollectionRef& c,
+		      const ghobject_t& oid,
+		      const std::set<std::string>& keys,
+		      std::map<std::string, bufferlist>* values) final {
+    return store->omap_get_values(handle_of(c), oid, keys, values);
+  }
+
+  ceph::os::alien::CollectionRef
+  create_new_collection(const coll_t& cid) final {
+    return std::make_shared<ClassicCollection>(
+      store->create_new_collection(cid));
+  }
+  ceph::os::alien::CollectionRef
+  open_collection(const coll_t& cid) final {
+    if (auto ch = store->open_collection(cid); ch) {
+      return std::make_shared<ClassicCollection>(std::move(ch));
+    } else {
+      return {};
+    }
+  }
+  std::vector<coll_t> list_collections() final {
+    std::vector<coll_t> collections;
+    store->list_collections(collections);
+    return collections;
+  }
+
+  int queue_transaction(const ceph::os::alien::CollectionRef& c,
+			const bufferlist& txn,
+			std::function<void()>&& on_commit) final {
+    // the buffers of txn were allocated by seastar, and the store may drop
+    // the last reference to them in any of its threads, so the transaction
+    // is decoded from a copy of our own
+    bufferptr copy(txn.length());
+    txn.cbegin().copy(txn.length(), copy.c_str());
+    bufferlist bl;
+    bl.append(std::move(copy));
+    ObjectStore::Transaction t;
+    auto p = bl.cbegin();
+    t.decode(p);
+    t.register_on_commit(new FunctionContext(
+      [on_commit=std::move(on_commit)](int) {
+	on_commit();
+      }));
+    return store->queue_transaction(handle_of(c), std::move(t));
+  }
+
+  int write_meta(const std::string& key,
+		 const std::string& value) final {
+    return store->write_meta(key, value);
+  }
+  int read_meta(const std::string& key, std::string* value) final {
+    return store->read_meta(key, value);
+  }
+};
+
+}
+
+namespace ceph::os::alien {
+
+std::unique_ptr<Backend> create_backend(const std::string& path,
+					const ConfigValues& values)
+{
+  auto cct = new CephContext(CEPH_ENTITY_TYPE_OSD);
+  cct->_conf.set_config_values(values);
+  // a few corners of the classic stores still read g_conf()
+  g_ceph_context = cct;
+  const auto type = cct->_conf.get_val<std::string>("osd_objectstore");
+  auto store = ObjectStore::create(cct, type, path,
+				   cct->_conf.get_val<std::string>("osd_journal"));
+  if (!store) {
+    g_ceph_context = nullptr;
+    cct->put();
+    return {};
+  }
+  return std::make_unique<ClassicBackend>(cct, store);
+}
+
+}
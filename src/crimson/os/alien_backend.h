@@ -0,0 +1,80 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "include/buffer.h"
+#include "include/uuid.h"
+#include "common/hobject.h"
+#include "osd/osd_types.h"
+
+class ConfigValues;
+
+namespace ceph::os::alien {
+
+/// a collection of the classic store, opaque to crimson
+class Collection {
+public:
+  virtual ~Collection() = default;
+};
+using CollectionRef = std::shared_ptr<Collection>;
+
+/**
+ * the classic ObjectStore behind AlienStore
+ *
+ * It lives in libcrimson-alienstore, along with the classic ceph-common, os
+ * and global, none of whose symbols are exported, so they don't collide with
+ * the ones of crimson-common. This interface is all that the two sides
+ * share: the calls are blocking, and they return a negative errno on error.
+ */
+class Backend {
+public:
+  virtual ~Backend() = default;
+
+  virtual int mount() = 0;
+  virtual int umount() = 0;
+  virtual int mkfs(uuid_d osd_fsid) = 0;
+
+  virtual int read(const CollectionRef& c,
+		   const ghobject_t& oid,
+		   uint64_t offset,
+		   size_t len,
+		   uint32_t op_flags,
+		   ceph::bufferlist* bl) = 0;
+  virtual int omap_get_values(const CollectionRef& c,
+			      const ghobject_t& oid,
+			      const std::set<std::string>& keys,
+			      std::map<std::string, ceph::bufferlist>* values) = 0;
+
+  virtual CollectionRef create_new_collection(const coll_t& cid) = 0;
+  /// @return nullptr if @c cid does not exist
+  virtual CollectionRef open_collection(const coll_t& cid) = 0;
+  virtual std::vector<coll_t> list_collections() = 0;
+
+  /**
+   * @param txn an encoded transaction. its buffers belong to the caller, so
+   *            they are copied before the transaction is queued
+   * @param on_commit called by a thread of the store once @c txn commits
+   */
+  virtual int queue_transaction(const CollectionRef& c,
+				const ceph::bufferlist& txn,
+				std::function<void()>&& on_commit) = 0;
+
+  virtual int write_meta(const std::string& key,
+			 const std::string& value) = 0;
+  virtual int read_meta(const std::string& key, std::string* value) = 0;
+};
+
+/// the store is created in a CephContext of its own, seeded with @c values
+[[gnu::visibility("default")]]
+std::unique_ptr<Backend> create_backend(const std::string& path,
+					const ConfigValues& values);
+
+}
@@ -0,0 +1,225 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "alien_store.h"
+
+#include <algorithm>
+#include <thread>
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+#include <seastar/core/alien.hh>
+#include <seastar/core/reactor.hh>
+
+#include "common/errno.h"
+#include "crimson/common/config_proxy.h"
+#include "crimson/common/log.h"
+#include "crimson/os/alien_backend.h"
+#include "crimson/os/Transaction.h"
+#include "crimson/thread/ThreadPool.h"
+
+namespace {
+  seastar::logger& logger() {
+    return ceph::get_logger(ceph_subsys_filestore);
+  }
+
+  struct AlienCollection final : public ceph::os::FuturizedCollection {
+    ceph::os::alien::CollectionRef ch;
+    AlienCollection(const coll_t& cid, ceph::os::alien::CollectionRef&& ch)
+      : FuturizedCollection{cid},
+        ch{std::move(ch)}
+    {}
+    ~AlienCollection() final = default;
+  };
+
+  ceph::os::alien::CollectionRef
+  handle_of(const ceph::os::FuturizedStore::CollectionRef& c)
+  {
+    return static_cast<AlienCollection*>(c.get())->ch;
+  }
+}
+
+namespace ceph::os {
+
+AlienStore::AlienStore(const std::string& path, const ConfigValues& values)
+  : path{path},
+    backend{alien::create_backend(path, values)}
+{
+  if (!backend) {
+    throw std::runtime_error(
+      fmt::format("bad objectstore type {}",
+                  ceph::common::local_conf().get_val<std::string>("osd_objectstore")));
+  }
+  const auto n_threads =
+    ceph::common::local_conf().get_val<uint64_t>("crimson_alien_op_num_threads");
+  auto cpu = ceph::common::local_conf().get_val<int64_t>("crimson_alien_thread_cpu");
+  if (cpu < 0) {
+    // right after the reactors, if there is a core left
+    cpu = std::min<int64_t>(seastar::smp::count,
+                            std::thread::hardware_concurrency() - 1);
+  }
+  tp = std::make_unique<ceph::thread::ThreadPool>(n_threads, 128, cpu);
+}
+
+AlienStore::~AlienStore() = default;
+
+seastar::future<> AlienStore::start()
+{
+  return tp->start();
+}
+
+seastar::future<> AlienStore::stop()
+{
+  return transaction_gate.close().then([this] {
+    return mounted ? umount() : seastar::now();
+  }).then([this] {
+    return tp->stop();
+  });
+}
+
+seastar::future<> AlienStore::mount()
+{
+  logger().info("{} {}", __func__, path);
+  return tp->submit([this] {
+    return backend->mount();
+  }).then([this] (int r) {
+    if (r < 0) {
+      throw std::runtime_error(fmt::format("mount: {}", cpp_strerror(r)));
+    }
+    mounted = true;
+  });
+}
+
+seastar::future<> AlienStore::umount()
+{
+  logger().info("{} {}", __func__, path);
+  return tp->submit([this] {
+    return backend->umount();
+  }).then([this] (int r) {
+    if (r < 0) {
+      throw std::runtime_error(fmt::format("umount: {}", cpp_strerror(r)));
+    }
+    mounted = false;
+  });
+}
+
+seastar::future<> AlienStore::mkfs(uuid_d osd_fsid)
+{
+  return tp->submit([this, osd_fsid] {
+    return backend->mkfs(osd_fsid);
+  }).then([] (int r) {
+    if (r < 0) {
+      throw std::runtime_error(fmt::format("mkfs: {}", cpp_strerror(r)));
+    }
+  });
+}
+
+seastar::future<bufferlist> AlienStore::read(CollectionRef c,
+                                             const ghobject_t& oid,
+                                             uint64_t offset,
+                                             size_t len,
+                                             uint32_t op_flags)
+{
+  logger().debug("{} {} {} {}~{}",
+                 __func__, c->cid, oid, offset, len);
+  return tp->submit([this, ch=handle_of(c), oid, offset, len, op_flags]
+                    () mutable {
+    bufferlist bl;
+    if (int r = backend->read(ch, oid, offset, len, op_flags, &bl); r < 0) {
+      throw std::runtime_error(fmt::format("read {}: {}",
+                                           oid, cpp_strerror(r)));
+    }
+    return bl;
+  });
+}
+
+seastar::future<AlienStore::omap_values_t>
+AlienStore::omap_get_values(CollectionRef c,
+                            const ghobject_t& oid,
+                            std::vector<std::string>&& keys)
+{
+  logger().debug("{} {} {}",
+                 __func__, c->cid, oid);
+  return tp->submit([this, ch=handle_of(c), oid, keys=std::move(keys)]
+                    () mutable {
+    std::set<std::string> to_get{keys.begin(), keys.end()};
+    std::map<std::string, bufferlist> values;
+    if (int r = backend->omap_get_values(ch, oid, to_get, &values); r < 0) {
+      throw std::runtime_error(fmt::format("omap_get_values {}: {}",
+                                           oid, cpp_strerror(r)));
+    }
+    return omap_values_t{std::make_move_iterator(values.begin()),
+                         std::make_move_iterator(values.end())};
+  });
+}
+
+AlienStore::CollectionRef AlienStore::create_new_collection(const coll_t& cid)
+{
+  return new AlienCollection{cid, backend->create_new_collection(cid)};
+}
+
+AlienStore::CollectionRef AlienStore::open_collection(const coll_t& cid)
+{
+  if (auto ch = backend->open_collection(cid); ch) {
+    return new AlienCollection{cid, std::move(ch)};
+  } else {
+    return {};
+  }
+}
+
+std::vector<coll_t> AlienStore::list_collections()
+{
+  return backend->list_collections();
+}
+
+seastar::future<> AlienStore::do_transaction(CollectionRef c,
+                                             Transaction&& txn)
+{
+  // the classic Transaction shares the encoding of ours. the encoding is
+  // copied by the backend before it is queued, while we keep it, so the
+  // buffers allocated by seastar are released by this reactor
+  auto bl = std::make_unique<bufferlist>();
+  txn.encode(*bl);
+  return seastar::with_gate(transaction_gate,
+                            [this, ch=handle_of(c), bl=std::move(bl)] () mutable {
+    auto committed = std::make_unique<seastar::promise<>>();
+    auto fut = committed->get_future();
+    auto on_commit = [shard=seastar::engine().cpu_id(),
+                      committed=committed.release()] {
+      // called by a thread of the classic store
+      std::ignore = seastar::alien::submit_to(shard, [committed] {
+        committed->set_value();
+        delete committed;
+        return seastar::now();
+      });
+    };
+    return seastar::with_semaphore(submit_lock, 1,
+                                   [this, ch, bl=std::move(bl), on_commit] () mutable {
+      auto encoded = bl.get();
+      return tp->submit([this, ch, encoded, on_commit] () mutable {
+        return backend->queue_transaction(ch, *encoded, std::move(on_commit));
+      }).finally([bl=std::move(bl)] {});
+    }).then([fut=std::move(fut)] (int r) mutable {
+      if (r < 0) {
+        logger().error("queue_transaction: {}", cpp_strerror(r));
+        abort();
+      }
+      return std::move(fut);
+    });
+  });
+}
+
+void AlienStore::write_meta(const std::string& key,
+                            const std::string& value)
+{
+  if (int r = backend->write_meta(key, value); r < 0) {
+    throw std::runtime_error{fmt::format("unable to write_meta({})", key)};
+  }
+}
+
+int AlienStore::read_meta(const std::string& key,
+                          std::string* value)
+{
+  return backend->read_meta(key, value);
+}
+
+}
@@ -0,0 +1,82 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <seastar/core/future.hh>
+#include <seastar/core/gate.hh>
+#include <seastar/core/semaphore.hh>
+
+#include "crimson/os/futurized_store.h"
+
+class ConfigValues;
+
+namespace ceph::os::alien {
+  class Backend;
+}
+
+namespace ceph::thread {
+  class ThreadPool;
+}
+
+namespace ceph::os {
+
+/**
+ * a classic ObjectStore, BlueStore for instance, driven by crimson
+ *
+ * The blocking calls into the store are made by a pool of alien threads,
+ * and their results are delivered to the shard which made the request. The
+ * store lives in a CephContext of its own, seeded with crimson's settings,
+ * the backend is picked by "osd_objectstore". See alien::Backend for how it
+ * is kept apart from crimson.
+ *
+ * Transactions are handed to the store in the order they are submitted, so
+ * an AlienStore is supposed to be used by a single shard.
+ */
+class AlienStore final : public FuturizedStore {
+  const std::string path;
+  std::unique_ptr<alien::Backend> backend;
+  std::unique_ptr<ceph::thread::ThreadPool> tp;
+  /// serializes the calls to queue_transaction()
+  seastar::semaphore submit_lock{1};
+  /// transactions not committed yet
+  seastar::gate transaction_gate;
+  bool mounted = false;
+
+public:
+  AlienStore(const std::string& path, const ConfigValues& values);
+  ~AlienStore() final;
+
+  seastar::future<> start() final;
+  seastar::future<> stop() final;
+  seastar::future<> mount() final;
+  seastar::future<> umount() final;
+
+  seastar::future<> mkfs(uuid_d osd_fsid) final;
+  seastar::future<bufferlist> read(CollectionRef c,
+				   const ghobject_t& oid,
+				   uint64_t offset,
+				   size_t len,
+				   uint32_t op_flags = 0) final;
+  seastar::future<omap_values_t> omap_get_values(
+    CollectionRef c,
+    const ghobject_t& oid,
+    std::vector<std::string>&& keys) final;
+  // the collection map of the classic store is in memory and guarded by a
+  // short-lived lock, so these are served in place
+  CollectionRef create_new_collection(const coll_t& cid) final;
+  CollectionRef open_collection(const coll_t& cid) final;
+  std::vector<coll_t> list_collections() final;
+
+  seastar::future<> do_transaction(CollectionRef ch,
+				   Transaction&& txn) final;
+
+  // only used by mkfs, before the OSD serves anything
+  void write_meta(const std::string& key,
+		  const std::string& value) final;
+  int read_meta(const std::string& key, std::string* value) final;
+};
+
+}
@@ -4,10 +4,10 @@
 #include <string>
 #include <unordered_map>
 #include <boost/intrusive_ptr.hpp>
-#include <boost/smart_ptr/intrusive_ref_counter.hpp>
 
 #include "include/buffer.h"
 #include "osd/osd_types.h"
+#include "crimson/os/futurized_store.h"
 
 namespace ceph::os {
 
@@ -22,12 +22,9 @@ class Object;
  * ObjectStore users my get collection handles with open_collection() (or,
  * for bootstrapping a new collection, create_new_collection()).
  */
-struct Collection : public boost::intrusive_ref_counter<
-  Collection,
-  boost::thread_unsafe_counter>
+struct Collection final : public FuturizedCollection
 {
   using ObjectRef = boost::intrusive_ptr<Object>;
-  const coll_t cid;
   int bits = 0;
   // always use bufferlist object for testing
   bool use_page_set = false;
@@ -37,7 +34,7 @@ struct Collection : public boost::intrusive_ref_counter<
   bool exists = true;
 
   Collection(const coll_t& c);
-  ~Collection();
+  ~Collection() final;
 
   ObjectRef create_object() const;
   ObjectRef get_object(ghobject_t oid);
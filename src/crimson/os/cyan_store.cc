@@ -43,7 +43,7 @@ seastar::future<> CyanStore::mount()
     if (int r = cbl.read_file(fn.c_str(), &err); r < 0) {
       throw std::runtime_error("read_file");
     }
-    CollectionRef c{new Collection{coll}};
+    CyanCollectionRef c{new Collection{coll}};
     auto p = cbl.cbegin();
     c->decode(p);
     coll_map[coll] = c;
@@ -107,6 +107,11 @@ CyanStore::CollectionRef CyanStore::create_new_collection(const coll_t& cid)
 }
 
 CyanStore::CollectionRef CyanStore::open_collection(const coll_t& cid)
+{
+  return _get_collection(cid);
+}
+
+CyanStore::CyanCollectionRef CyanStore::_get_collection(const coll_t& cid)
 {
   auto cp = coll_map.find(cid);
   if (cp == coll_map.end())
@@ -123,12 +128,13 @@ std::vector<coll_t> CyanStore::list_collections()
   return collections;
 }
 
-seastar::future<bufferlist> CyanStore::read(CollectionRef c,
+seastar::future<bufferlist> CyanStore::read(CollectionRef ch,
                                             const ghobject_t& oid,
                                             uint64_t offset,
                                             size_t len,
                                             uint32_t op_flags)
 {
+  auto c = static_cast<Collection*>(ch.get());
   logger().info("{} {} {} {}~{}",
                 __func__, c->cid, oid, offset, len);
   if (!c->exists) {
@@ -153,10 +159,11 @@ seastar::future<bufferlist> CyanStore::read(CollectionRef c,
 }
 
 seastar::future<CyanStore::omap_values_t>
-CyanStore::omap_get_values(CollectionRef c,
+CyanStore::omap_get_values(CollectionRef ch,
                            const ghobject_t& oid,
                            std::vector<std::string>&& keys)
 {
+  auto c = static_cast<Collection*>(ch.get());
   logger().info("{} {} {}",
                 __func__, c->cid, oid);
   auto o = c->get_object(oid);
@@ -219,7 +226,7 @@ int CyanStore::_write(const coll_t& cid, const ghobject_t& oid,
                 __func__, cid, oid, offset, len);
   assert(len == bl.length());
 
-  auto c = open_collection(cid);
+  auto c = _get_collection(cid);
   if (!c)
     return -ENOENT;
 
@@ -235,7 +242,7 @@ int CyanStore::_write(const coll_t& cid, const ghobject_t& oid,
 
 int CyanStore::_create_collection(const coll_t& cid, int bits)
 {
-  auto result = coll_map.insert(std::make_pair(cid, CollectionRef()));
+  auto result = coll_map.insert(std::make_pair(cid, CyanCollectionRef()));
   if (!result.second)
     return -EEXIST;
   auto p = new_coll_map.find(cid);
@@ -10,50 +10,51 @@
 #include <seastar/core/future.hh>
 #include "osd/osd_types.h"
 #include "include/uuid.h"
+#include "crimson/os/futurized_store.h"
 
 namespace ceph::os {
 
-class Collection;
+struct Collection;
 class Transaction;
 
 // a just-enough store for reading/writing the superblock
-class CyanStore {
-  using CollectionRef = boost::intrusive_ptr<Collection>;
+class CyanStore final : public FuturizedStore {
+  using CyanCollectionRef = boost::intrusive_ptr<Collection>;
   const std::string path;
-  std::unordered_map<coll_t, CollectionRef> coll_map;
-  std::map<coll_t,CollectionRef> new_coll_map;
+  std::unordered_map<coll_t, CyanCollectionRef> coll_map;
+  std::map<coll_t,CyanCollectionRef> new_coll_map;
   uint64_t used_bytes = 0;
 
 public:
   CyanStore(const std::string& path);
-  ~CyanStore();
+  ~CyanStore() final;
 
-  seastar::future<> mount();
-  seastar::future<> umount();
+  seastar::future<> mount() final;
+  seastar::future<> umount() final;
 
-  seastar::future<> mkfs(uuid_d osd_fsid);
+  seastar::future<> mkfs(uuid_d osd_fsid) final;
   seastar::future<bufferlist> read(CollectionRef c,
 				   const ghobject_t& oid,
 				   uint64_t offset,
 				   size_t len,
-				   uint32_t op_flags = 0);
-  using omap_values_t = std::map<std::string,bufferlist, std::less<>>;
+				   uint32_t op_flags = 0) final;
   seastar::future<omap_values_t> omap_get_values(
     CollectionRef c,
     const ghobject_t& oid,
-    std::vector<std::string>&& keys);
-  CollectionRef create_new_collection(const coll_t& cid);
-  CollectionRef open_collection(const coll_t& cid);
-  std::vector<coll_t> list_collections();
+    std::vector<std::string>&& keys) final;
+  CollectionRef create_new_collection(const coll_t& cid) final;
+  CollectionRef open_collection(const coll_t& cid) final;
+  std::vector<coll_t> list_collections() final;
 
   seastar::future<> do_transaction(CollectionRef ch,
-				   Transaction&& txn);
+				   Transaction&& txn) final;
 
   void write_meta(const std::string& key,
-		  const std::string& value);
-  int read_meta(const std::string& key, std::string* value);
+		  const std::string& value) final;
+  int read_meta(const std::string& key, std::string* value) final;
 
 private:
+  CyanCollectionRef _get_collection(const coll_t& cid);
   int _write(const coll_t& cid, const ghobject_t& oid,
 	     uint64_t offset, size_t len, const bufferlist& bl,
 	     uint32_t fadvise_flags);
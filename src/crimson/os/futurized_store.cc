@@ -0,0 +1,23 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "futurized_store.h"
+
+#include "crimson/os/alien_store.h"
+#include "crimson/os/cyan_store.h"
+
+namespace ceph::os {
+
+std::unique_ptr<FuturizedStore>
+FuturizedStore::create(const std::string& type,
+		       const std::string& data,
+		       const ConfigValues& values)
+{
+  if (type == "alienstore") {
+    return std::make_unique<AlienStore>(data, values);
+  } else {
+    return std::make_unique<CyanStore>(data);
+  }
+}
+
+}
@@ -0,0 +1,80 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/smart_ptr/intrusive_ref_counter.hpp>
+#include <seastar/core/future.hh>
+
+#include "include/uuid.h"
+#include "osd/osd_types.h"
+
+class ConfigValues;
+
+namespace ceph::os {
+
+class Transaction;
+
+/// a collection handle, what is behind it is up to the store
+class FuturizedCollection
+  : public boost::intrusive_ref_counter<FuturizedCollection,
+					boost::thread_unsafe_counter>
+{
+public:
+  explicit FuturizedCollection(const coll_t& cid)
+    : cid{cid}
+  {}
+  virtual ~FuturizedCollection() {}
+  const coll_t cid;
+};
+
+/// the store interface of crimson-osd
+class FuturizedStore {
+public:
+  /// @param type the value of "crimson_osd_objectstore"
+  static std::unique_ptr<FuturizedStore> create(const std::string& type,
+						const std::string& data,
+						const ConfigValues& values);
+  virtual ~FuturizedStore() {}
+
+  using CollectionRef = boost::intrusive_ptr<FuturizedCollection>;
+
+  // start/stop the machinery the store runs on, if any
+  virtual seastar::future<> start() {
+    return seastar::now();
+  }
+  virtual seastar::future<> stop() {
+    return seastar::now();
+  }
+  virtual seastar::future<> mount() = 0;
+  virtual seastar::future<> umount() = 0;
+
+  virtual seastar::future<> mkfs(uuid_d osd_fsid) = 0;
+  virtual seastar::future<bufferlist> read(CollectionRef c,
+					   const ghobject_t& oid,
+					   uint64_t offset,
+					   size_t len,
+					   uint32_t op_flags = 0) = 0;
+  using omap_values_t = std::map<std::string,bufferlist, std::less<>>;
+  virtual seastar::future<omap_values_t> omap_get_values(
+    CollectionRef c,
+    const ghobject_t& oid,
+    std::vector<std::string>&& keys) = 0;
+  virtual CollectionRef create_new_collection(const coll_t& cid) = 0;
+  virtual CollectionRef open_collection(const coll_t& cid) = 0;
+  virtual std::vector<coll_t> list_collections() = 0;
+
+  virtual seastar::future<> do_transaction(CollectionRef ch,
+					   Transaction&& txn) = 0;
+
+  virtual void write_meta(const std::string& key,
+			  const std::string& value) = 0;
+  virtual int read_meta(const std::string& key, std::string* value) = 0;
+};
+
+}
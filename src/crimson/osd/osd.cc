@@ -9,9 +9,7 @@
 #include "messages/MOSDMap.h"
 #include "crimson/net/Connection.h"
 #include "crimson/net/Messenger.h"
-#include "crimson/os/cyan_collection.h"
-#include "crimson/os/cyan_object.h"
-#include "crimson/os/cyan_store.h"
+#include "crimson/os/futurized_store.h"
 #include "crimson/os/Transaction.h"
 #include "crimson/osd/heartbeat.h"
 #include "crimson/osd/osd_meta.h"
@@ -32,7 +30,7 @@ namespace {
 }
 
 using ceph::common::local_conf;
-using ceph::os::CyanStore;
+using ceph::os::FuturizedStore;
 
 OSD::OSD(int id, uint32_t nonce)
   : whoami{id},
@@ -76,11 +74,15 @@ CompatSet get_osd_initial_compat_set()
 
 seastar::future<> OSD::mkfs(uuid_d cluster_fsid)
 {
-  const auto data_path = local_conf().get_val<std::string>("osd_data");
-  store = std::make_unique<ceph::os::CyanStore>(data_path);
+  store = FuturizedStore::create(
+    local_conf().get_val<std::string>("crimson_osd_objectstore"),
+    local_conf().get_val<std::string>("osd_data"),
+    local_conf().get_config_values());
   uuid_d osd_fsid;
   osd_fsid.generate_random();
-  return store->mkfs(osd_fsid).then([this] {
+  return store->start().then([osd_fsid, this] {
+    return store->mkfs(osd_fsid);
+  }).then([this] {
     return store->mount();
   }).then([cluster_fsid, osd_fsid, this] {
     superblock.cluster_fsid = cluster_fsid;
@@ -175,9 +177,13 @@ seastar::future<> OSD::start()
     dispatchers.push_front(this);
     dispatchers.push_front(monc.get());
 
-    const auto data_path = local_conf().get_val<std::string>("osd_data");
-    store = std::make_unique<ceph::os::CyanStore>(data_path);
-    return store->mount();
+    store = FuturizedStore::create(
+      local_conf().get_val<std::string>("crimson_osd_objectstore"),
+      local_conf().get_val<std::string>("osd_data"),
+      local_conf().get_config_values());
+    return store->start().then([this] {
+      return store->mount();
+    });
   }).then([this] {
     meta_coll = make_unique<OSDMeta>(store->open_collection(coll_t::meta()),
                                      store.get());
@@ -288,6 +294,8 @@ seastar::future<> OSD::stop()
     return public_msgr->shutdown();
   }).then([this] {
     return cluster_msgr->shutdown();
+  }).then([this] {
+    return store ? store->stop() : seastar::now();
   });
 }
 
@@ -30,8 +30,8 @@ namespace ceph::net {
 }
 
 namespace ceph::os {
-  class CyanStore;
-  struct Collection;
+  class FuturizedStore;
+  class FuturizedCollection;
   class Transaction;
 }
 
@@ -56,8 +56,7 @@ class OSD : public ceph::net::Dispatcher,
   SharedLRU<epoch_t, OSDMap> osdmaps;
   SimpleLRU<epoch_t, bufferlist, false> map_bl_cache;
   cached_map_t osdmap;
-  // TODO: use a wrapper for ObjectStore
-  std::unique_ptr<ceph::os::CyanStore> store;
+  std::unique_ptr<ceph::os::FuturizedStore> store;
   std::unique_ptr<OSDMeta> meta_coll;
 
   std::unordered_map<spg_t, Ref<PG>> pgs;
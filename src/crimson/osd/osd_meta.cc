@@ -1,7 +1,6 @@
 #include "osd_meta.h"
 
-#include "crimson/os/cyan_collection.h"
-#include "crimson/os/cyan_store.h"
+#include "crimson/os/futurized_store.h"
 #include "crimson/os/Transaction.h"
 
 void OSDMeta::create(ceph::os::Transaction& t)
@@ -9,8 +9,8 @@
 #include "osd/osd_types.h"
 
 namespace ceph::os {
-  class CyanStore;
-  class Collection;
+  class FuturizedStore;
+  class FuturizedCollection;
   class Transaction;
 }
 
@@ -19,12 +19,12 @@ namespace ceph::os {
 class OSDMeta {
   template<typename T> using Ref = boost::intrusive_ptr<T>;
 
-  ceph::os::CyanStore* store;
-  Ref<ceph::os::Collection> coll;
+  ceph::os::FuturizedStore* store;
+  Ref<ceph::os::FuturizedCollection> coll;
 
 public:
-  OSDMeta(Ref<ceph::os::Collection> coll,
-          ceph::os::CyanStore* store)
+  OSDMeta(Ref<ceph::os::FuturizedCollection> coll,
+          ceph::os::FuturizedStore* store)
     : store{store}, coll{coll}
   {}
 
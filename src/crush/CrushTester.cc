@@ -511,7 +511,8 @@ int CrushTester::test()
 
   if (output_choose_tries)
     crush.start_choose_profile();
-  
+
+  int ret = 0;
   for (int r = min_rule; r < crush.get_max_rules() && r <= max_rule; r++) {
     if (!crush.rule_exists(r)) {
       if (output_statistics)
@@ -604,6 +605,20 @@ int CrushTester::test()
         // create a vector to hold placement results temporarily 
         vector<int> temporary_per ( per.size() );
 
+        // map the whole batch through CRUSH in one go
+        vector<int> real_xs;
+        vector<vector<int>> batch_out;
+        if (use_crush) {
+          for (int x = batch_min; x <= batch_max; x++) {
+            uint32_t real_x = x;
+            if (pool_id != -1) {
+              real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+            }
+            real_xs.push_back(real_x);
+          }
+          crush.do_rule_batch(r, real_xs, batch_out, nr, weight, 0);
+        }
+
         for (int x = batch_min; x <= batch_max; x++) {
           // create a vector to hold the results of a CRUSH placement or RNG simulation
           vector<int> out;
@@ -611,11 +626,17 @@ int CrushTester::test()
           if (use_crush) {
             if (output_mappings)
 	      err << "CRUSH"; // prepend CRUSH to placement output
-            uint32_t real_x = x;
-            if (pool_id != -1) {
-              real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+            out.swap(batch_out[x - batch_min]);
+            if (verify_batch) {
+              vector<int> single;
+              crush.do_rule(r, real_xs[x - batch_min], single, nr, weight, 0);
+              if (single != out) {
+                err << "batch mapping mismatch rule " << r << " x " << x
+                    << " num_rep " << nr << " batch " << out
+                    << " single " << single << std::endl;
+                ret = -EINVAL;
+              }
             }
-            crush.do_rule(r, real_x, out, nr, weight, 0);
           } else {
             if (output_mappings)
 	      err << "RNG"; // prepend RNG to placement output to denote simulation
@@ -721,7 +742,7 @@ int CrushTester::test()
     crush.stop_choose_profile();
   }
 
-  return 0;
+  return ret;
 }
 
 int CrushTester::compare(CrushWrapper& crush2)
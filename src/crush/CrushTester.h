@@ -21,6 +21,7 @@ class CrushTester {
 
   int num_batches;
   bool use_crush;
+  bool verify_batch;
 
   float mark_down_device_ratio;
   float mark_down_bucket_ratio;
@@ -175,6 +176,7 @@ public:
       pool_id(-1),
       num_batches(1),
       use_crush(true),
+      verify_batch(false),
       mark_down_device_ratio(0.0),
       mark_down_bucket_ratio(1.0),
       output_utilization(false),
@@ -252,6 +254,14 @@ public:
     return output_choose_tries;
   }
 
+  /// check the batched mappings against mapping one x at a time
+  void set_verify_batch(bool b) {
+    verify_batch = b;
+  }
+  bool get_verify_batch() const {
+    return verify_batch;
+  }
+
   void set_batches(int b) {
     num_batches = b;
   }
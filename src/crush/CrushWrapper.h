@@ -1541,6 +1541,32 @@ public:
       out[i] = rawout[i];
   }
 
+  /**
+   * map each of xs as do_rule() would, with one workspace for all of them
+   *
+   * out[i] is the mapping of xs[i].
+   */
+  template<typename WeightVector>
+  void do_rule_batch(int rule, const vector<int>& xs,
+		     vector<vector<int>>& out, int maxout,
+		     const WeightVector& weight,
+		     uint64_t choose_args_index) const {
+    vector<int> rawout(xs.size() * maxout);
+    vector<int> lens(xs.size());
+    char work[crush_work_size(crush, maxout)];
+    crush_init_workspace(crush, work);
+    crush_choose_arg_map arg_map = choose_args_get_with_fallback(
+      choose_args_index);
+    crush_do_rule_batch(crush, rule, xs.data(), xs.size(), rawout.data(),
+			maxout, lens.data(), &weight[0], weight.size(), work,
+			arg_map.args);
+    out.resize(xs.size());
+    for (unsigned i = 0; i < xs.size(); i++) {
+      auto p = rawout.begin() + i * maxout;
+      out[i].assign(p, p + std::max(lens[i], 0));
+    }
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const vector<pair<int,int>>& stack,
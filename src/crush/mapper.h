@@ -78,6 +78,21 @@ extern int crush_do_rule(const struct crush_map *map,
 			 const __u32 *weights, int weight_max,
 			 void *cwin, const struct crush_choose_arg *choose_args);
 
+/** @ingroup API
+ *
+ * Map each of the __num__ inputs in __x__ through rule __ruleno__,
+ * exactly as crush_do_rule() would. The results for __x[i]__ are
+ * stored at __result__ + i * __result_max__ and their number in
+ * __result_len[i]__. A single __cwin__, initialized once, serves all
+ * of the inputs. A __result_len__ of 0 means an error for that input.
+ */
+extern void crush_do_rule_batch(const struct crush_map *map,
+				int ruleno, const int *x, int num,
+				int *result, int result_max, int *result_len,
+				const __u32 *weights, int weight_max,
+				void *cwin,
+				const struct crush_choose_arg *choose_args);
+
 /* Returns the exact amount of workspace that will need to be used
    for a given combination of crush_map and result_max. The caller can
    then allocate this much on its own, either on the stack, in a
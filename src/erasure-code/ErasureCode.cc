@@ -345,3 +345,34 @@ int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
   }
   return r;
 }
+
+void ErasureCode::encode_delta(const bufferptr &old_data,
+			       const bufferptr &new_data,
+			       bufferptr *delta)
+{
+  // addition in GF(2^w) is xor, whatever the word size
+  ceph_assert(old_data.length() == new_data.length());
+  unsigned len = old_data.length();
+  bufferptr out(buffer::create_aligned(len, SIMD_ALIGN));
+  const char *a = old_data.c_str();
+  const char *b = new_data.c_str();
+  char *d = out.c_str();
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    x ^= y;
+    memcpy(d + i, &x, sizeof(x));
+  }
+  for (; i < len; ++i) {
+    d[i] = a[i] ^ b[i];
+  }
+  *delta = std::move(out);
+}
+
+int ErasureCode::apply_delta(const std::map<int, bufferptr> &in,
+			     std::map<int, bufferptr> &out)
+{
+  return -EOPNOTSUPP;
+}
@@ -459,6 +459,54 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    enum {
+      /* The plugin's coding chunks are a linear function of each data
+       * chunk, so that a partial overwrite of one data chunk can update
+       * them with **encode_delta** and **apply_delta** instead of
+       * re-encoding the whole stripe. */
+      FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION = 1 << 0,
+    };
+
+    /**
+     * Return the FLAG_EC_PLUGIN_* optimizations supported by this
+     * instance, as configured by its profile.
+     *
+     * @return a bitmask of FLAG_EC_PLUGIN_* values
+     */
+    virtual uint64_t get_supported_optimizations() const = 0;
+
+    /**
+     * Compute the delta between the old and new content of a range of
+     * a data chunk. Both buffers must have the same length. The
+     * **delta** may be allocated by the method, or be **new_data**
+     * itself.
+     *
+     * Only valid if FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION is set.
+     *
+     * @param [in] old_data the range as currently stored
+     * @param [in] new_data the range as it will be written
+     * @param [out] delta the delta to pass to **apply_delta**
+     */
+    virtual void encode_delta(const bufferptr &old_data,
+			      const bufferptr &new_data,
+			      bufferptr *delta) = 0;
+
+    /**
+     * Fold the deltas of data chunks into the same range of the
+     * coding chunks. **in** maps data chunk indexes to deltas returned
+     * by **encode_delta**; **out** maps coding chunk indexes to the
+     * current content of the range, which is updated in place. All
+     * buffers must have the same length.
+     *
+     * Only valid if FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION is set.
+     *
+     * @param [in] in map data chunk indexes to deltas
+     * @param [in,out] out map coding chunk indexes to coding data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_delta(const std::map<int, bufferptr> &in,
+			    std::map<int, bufferptr> &out) = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -131,6 +131,44 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &in,
+                                   map<int, bufferptr> &out)
+{
+  for (auto &&d : in) {
+    if (d.first < 0 || d.first >= k)
+      return -EINVAL;
+    unsigned char *delta = (unsigned char*) d.second.c_str();
+    unsigned len = d.second.length();
+    for (auto &&c : out) {
+      if (c.first < k || c.first >= k + m)
+        return -EINVAL;
+      ceph_assert(c.second.length() == len);
+      unsigned char *coding = (unsigned char*) c.second.c_str();
+      if (m == 1) {
+        // single parity stripe, see isa_encode
+        unsigned aligned = 0;
+        if (is_aligned(delta, EC_ISA_VECTOR_OP_WORDSIZE) &&
+            is_aligned(coding, EC_ISA_VECTOR_OP_WORDSIZE)) {
+          aligned = len - (len % EC_ISA_VECTOR_OP_WORDSIZE);
+          vector_xor((vector_op_t*) delta, (vector_op_t*) coding,
+                     (vector_op_t*) (delta + aligned));
+        }
+        byte_xor(delta + aligned, coding + aligned, delta + len);
+      } else {
+        // the tables hold 32 bytes per coefficient, one row of k per
+        // coding chunk
+        ec_encode_data_update(len, k, 1, d.first,
+                              encode_tbls + 32 * k * (c.first - k),
+                              delta, &coding);
+      }
+    }
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
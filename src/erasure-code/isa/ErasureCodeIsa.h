@@ -145,6 +145,13 @@ public:
 
   void prepare() override;
 
+  uint64_t get_supported_optimizations() const override {
+    return FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION;
+  }
+
+  int apply_delta(const std::map<int, bufferptr> &in,
+                  std::map<int, bufferptr> &out) override;
+
  private:
   int parse(ErasureCodeProfile &profile,
                     std::ostream *ss) override;
@@ -130,6 +130,46 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeJerasure::matrix_apply_delta(int *matrix,
+					    const map<int, bufferptr> &in,
+					    map<int, bufferptr> &out)
+{
+  // each coding chunk is sum(matrix[row][i] * data[i]), so a delta to
+  // data chunk i changes coding chunk row by matrix[row][i] * delta
+  for (auto &&d : in) {
+    if (d.first < 0 || d.first >= k)
+      return -EINVAL;
+    char *delta = const_cast<char*>(d.second.c_str());
+    int len = d.second.length();
+    for (auto &&c : out) {
+      if (c.first < k || c.first >= k + m)
+	return -EINVAL;
+      ceph_assert((int)c.second.length() == len);
+      int coef = matrix[(c.first - k) * k + d.first];
+      if (coef == 0) {
+	continue;
+      } else if (coef == 1) {
+	galois_region_xor(delta, c.second.c_str(), len);
+      } else {
+	switch (w) {
+	case 8:
+	  galois_w08_region_multiply(delta, coef, len, c.second.c_str(), 1);
+	  break;
+	case 16:
+	  galois_w16_region_multiply(delta, coef, len, c.second.c_str(), 1);
+	  break;
+	case 32:
+	  galois_w32_region_multiply(delta, coef, len, c.second.c_str(), 1);
+	  break;
+	default:
+	  return -EINVAL;
+	}
+      }
+    }
+  }
+  return 0;
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
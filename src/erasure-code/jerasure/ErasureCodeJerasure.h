@@ -77,6 +77,9 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, std::ostream *ss);
+  int matrix_apply_delta(int *matrix,
+			 const std::map<int, bufferptr> &in,
+			 std::map<int, bufferptr> &out);
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -103,6 +106,13 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  uint64_t get_supported_optimizations() const override {
+    return FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION;
+  }
+  int apply_delta(const std::map<int, bufferptr> &in,
+		  std::map<int, bufferptr> &out) override {
+    return matrix_apply_delta(matrix, in, out);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -132,6 +142,13 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  uint64_t get_supported_optimizations() const override {
+    return FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION;
+  }
+  int apply_delta(const std::map<int, bufferptr> &in,
+		  std::map<int, bufferptr> &out) override {
+    return matrix_apply_delta(matrix, in, out);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -139,6 +139,8 @@ namespace buffer CEPH_BUFFER_API {
   int get_missed_crc();
   /// enable/disable tracking of cached crcs
   void track_cached_crc(bool b);
+  /// bytes memcpy'd by list::rebuild() and friends on the calling thread
+  uint64_t get_thread_memcopy_count();
 
   /*
    * an abstract raw buffer.  with a reference count.
@@ -2,6 +2,9 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "KeyValueDB.h"
+#include "common/strtol.h"
+#include "include/str_map.h"
+#include "include/stringify.h"
 #ifdef WITH_LEVELDB
 #include "LevelDBStore.h"
 #endif
@@ -65,3 +68,98 @@ int KeyValueDB::test_init(const string& type, const string& dir)
   }
   return -EINVAL;
 }
+
+int KeyValueDB::parse_column_families(const string& spec,
+				      vector<ColumnFamily> *cfs,
+				      std::ostream *err)
+{
+  map<string,string> cf_map;
+  get_str_map(spec, &cf_map, " \t");
+  for (auto& i : cf_map) {
+    string name = i.first;
+    uint32_t shard_cnt = 1;
+    uint32_t hash_l = 0;
+    uint32_t hash_h = UINT32_MAX;
+    size_t paren = name.find('(');
+    if (paren != string::npos) {
+      if (name.back() != ')') {
+	if (err)
+	  *err << "column family '" << name << "': missing ')'";
+	return -EINVAL;
+      }
+      string args = name.substr(paren + 1, name.size() - paren - 2);
+      name.resize(paren);
+      string range;
+      size_t comma = args.find(',');
+      if (comma != string::npos) {
+	range = args.substr(comma + 1);
+	args.resize(comma);
+      }
+      string e;
+      long long n = strict_strtoll(args.c_str(), 10, &e);
+      if (!e.empty() || n < 1 || n > 256) {
+	if (err)
+	  *err << "column family '" << name << "': bad shard count '"
+	       << args << "'";
+	return -EINVAL;
+      }
+      shard_cnt = n;
+      if (!range.empty()) {
+	size_t dash = range.find('-');
+	if (dash == string::npos) {
+	  if (err)
+	    *err << "column family '" << name << "': bad hash range '"
+		 << range << "'";
+	  return -EINVAL;
+	}
+	string l = range.substr(0, dash);
+	string h = range.substr(dash + 1);
+	n = strict_strtoll(l.c_str(), 10, &e);
+	if (!e.empty() || n < 0) {
+	  if (err)
+	    *err << "column family '" << name << "': bad hash range '"
+		 << range << "'";
+	  return -EINVAL;
+	}
+	hash_l = n;
+	if (!h.empty()) {
+	  n = strict_strtoll(h.c_str(), 10, &e);
+	  if (!e.empty() || n <= (long long)hash_l) {
+	    if (err)
+	      *err << "column family '" << name << "': bad hash range '"
+		   << range << "'";
+	    return -EINVAL;
+	  }
+	  hash_h = n;
+	}
+      }
+    }
+    if (name.empty()) {
+      if (err)
+	*err << "empty column family name in '" << spec << "'";
+      return -EINVAL;
+    }
+    cfs->push_back(ColumnFamily(name, i.second, shard_cnt, hash_l, hash_h));
+  }
+  return 0;
+}
+
+string KeyValueDB::column_families_to_str(const vector<ColumnFamily>& cfs)
+{
+  string s;
+  for (auto& cf : cfs) {
+    if (!s.empty())
+      s += ' ';
+    s += cf.name;
+    if (cf.shard_cnt > 1) {
+      s += '(' + stringify(cf.shard_cnt);
+      if (cf.hash_l != 0 || cf.hash_h != UINT32_MAX) {
+	s += ',' + stringify(cf.hash_l) + '-';
+	if (cf.hash_h != UINT32_MAX)
+	  s += stringify(cf.hash_h);
+      }
+      s += ')';
+    }
+  }
+  return s;
+}
@@ -31,10 +31,29 @@ public:
   struct ColumnFamily {
     string name;      //< name of this individual column family
     string option;    //< configure option string for this CF
+    uint32_t shard_cnt = 1;       //< number of CFs the prefix is hashed over
+    uint32_t hash_l = 0;          //< first key byte fed to the shard hash
+    uint32_t hash_h = UINT32_MAX; //< one past the last key byte fed to it
     ColumnFamily(const string &name, const string &option)
       : name(name), option(option) {}
+    ColumnFamily(const string &name, const string &option,
+		 uint32_t shard_cnt, uint32_t hash_l, uint32_t hash_h)
+      : name(name), option(option),
+	shard_cnt(shard_cnt), hash_l(hash_l), hash_h(hash_h) {}
   };
 
+  /**
+   * Parse a whitespace separated list of "name[(shards[,l-h])][=options]"
+   * column family definitions.  A prefix with more than one shard is
+   * spread over that many column families by a hash of key bytes [l, h),
+   * which defaults to the whole key.
+   */
+  static int parse_column_families(const std::string& spec,
+				   vector<ColumnFamily> *cfs,
+				   std::ostream *err);
+  /// the inverse of parse_column_families, without the options
+  static std::string column_families_to_str(const vector<ColumnFamily>& cfs);
+
   class TransactionImpl {
   public:
     /// Set Keys
@@ -171,6 +190,12 @@ public:
   /// Try to repair K/V database. leveldb and rocksdb require that database must be not opened.
   virtual int repair(std::ostream &out) { return 0; }
 
+  /// move keys to the column family layout described by new_sharding
+  /// (see parse_column_families); the db must be open and otherwise idle
+  virtual int reshard(const std::string& new_sharding, std::ostream &out) {
+    return -EOPNOTSUPP;
+  }
+
   virtual Transaction get_transaction() = 0;
   virtual int submit_transaction(Transaction) = 0;
   virtual int submit_transaction_sync(Transaction t) {
@@ -274,7 +299,7 @@ public:
   };
   typedef std::shared_ptr< WholeSpaceIteratorImpl > WholeSpaceIterator;
 
-private:
+protected:
   // This class filters a WholeSpaceIterator by a prefix.
   class PrefixIteratorImpl : public IteratorImpl {
     const std::string prefix;
@@ -332,6 +357,22 @@ public:
       get_wholespace_iterator());
   }
 
+  /// read-only view of the db as of the moment it was taken
+  class SnapshotImpl {
+  public:
+    virtual ~SnapshotImpl() {}
+    virtual Iterator get_iterator(const std::string &prefix) = 0;
+    virtual int get(const std::string &prefix,
+		    const std::string &key,
+		    bufferlist *value) = 0;
+  };
+  typedef std::shared_ptr<SnapshotImpl> Snapshot;
+
+  /// take a snapshot, or return null if the backend can't
+  virtual Snapshot get_snapshot() {
+    return Snapshot();
+  }
+
   void add_column_family(const std::string& cf_name, void *handle) {
     cf_handles.insert(std::make_pair(cf_name, handle));
   }
@@ -25,6 +25,7 @@ using std::string;
 #include "include/str_list.h"
 #include "include/stringify.h"
 #include "include/str_map.h"
+#include "include/ceph_hash.h"
 #include "KeyValueDB.h"
 #include "RocksDBStore.h"
 
@@ -53,6 +54,34 @@ static rocksdb::SliceParts prepare_sliceparts(const bufferlist &bl,
   return rocksdb::SliceParts(slices->data(), slices->size());
 }
 
+// the persisted column family layout lives in the default CF
+static const string SHARDING_PREFIX = "_sharding";
+static const string SHARDING_DEF_KEY = "def";
+
+static string shard_cf_name(const string& prefix, uint32_t shard,
+			    uint32_t shard_cnt)
+{
+  if (shard_cnt == 1) {
+    return prefix;
+  }
+  return prefix + "-" + stringify(shard);
+}
+
+// "M-3" -> "M"; an unsharded column family is named after its prefix
+static string cf_name_to_prefix(const string& name)
+{
+  size_t pos = name.find_last_of('-');
+  if (pos == string::npos || pos == 0 || pos + 1 == name.size()) {
+    return name;
+  }
+  for (size_t i = pos + 1; i < name.size(); ++i) {
+    if (!isdigit(name[i])) {
+      return name;
+    }
+  }
+  return name.substr(0, pos);
+}
+
 
 //
 // One of these for the default rocksdb column family, routing each prefix
@@ -310,6 +339,74 @@ int RocksDBStore::install_cf_mergeop(
   return 0;
 }
 
+rocksdb::ColumnFamilyHandle *RocksDBStore::pick_shard(const prefix_shards& s,
+						      const char *key,
+						      size_t keylen)
+{
+  if (s.handles.size() == 1) {
+    return s.handles[0];
+  }
+  size_t l = std::min<size_t>(s.hash_l, keylen);
+  size_t h = std::min<size_t>(s.hash_h, keylen);
+  uint32_t hash = ceph_str_hash_rjenkins(key + l, h - l);
+  return s.handles[hash % s.handles.size()];
+}
+
+int RocksDBStore::apply_sharding(const vector<ColumnFamily>& layout)
+{
+  std::unordered_map<std::string, prefix_shards> shards;
+  for (auto& p : layout) {
+    prefix_shards& s = shards[p.name];
+    s.hash_l = p.hash_l;
+    s.hash_h = p.hash_h;
+    for (uint32_t i = 0; i < p.shard_cnt; ++i) {
+      string n = shard_cf_name(p.name, i, p.shard_cnt);
+      auto iter = cf_handles.find(n);
+      if (iter == cf_handles.end()) {
+	derr << __func__ << " column family '" << n << "' of prefix '"
+	     << p.name << "' does not exist" << dendl;
+	return -ENOENT;
+      }
+      s.handles.push_back(
+	static_cast<rocksdb::ColumnFamilyHandle*>(iter->second));
+    }
+  }
+  cf_shards.swap(shards);
+  return 0;
+}
+
+int RocksDBStore::load_sharding(vector<ColumnFamily> *layout)
+{
+  layout->clear();
+  string value;
+  rocksdb::Status status = db->Get(
+    rocksdb::ReadOptions(), default_cf,
+    rocksdb::Slice(combine_strings(SHARDING_PREFIX, SHARDING_DEF_KEY)),
+    &value);
+  if (status.IsNotFound()) {
+    // created before sharding: each column family holds one whole prefix
+    for (auto& p : cf_handles) {
+      layout->push_back(ColumnFamily(p.first, string()));
+    }
+    std::sort(layout->begin(), layout->end(),
+	      [](const ColumnFamily& a, const ColumnFamily& b) {
+		return a.name < b.name;
+	      });
+    return 0;
+  }
+  if (!status.ok()) {
+    derr << __func__ << " " << status.ToString() << dendl;
+    return -EIO;
+  }
+  stringstream err;
+  int r = parse_column_families(value, layout, &err);
+  if (r < 0) {
+    derr << __func__ << " bad stored sharding '" << value << "': "
+	 << err.str() << dendl;
+  }
+  return r;
+}
+
 int RocksDBStore::create_and_open(ostream &out,
 				  const vector<ColumnFamily>& cfs)
 {
@@ -482,6 +579,7 @@ int RocksDBStore::do_open(ostream &out,
       derr << status.ToString() << dendl;
       return -EINVAL;
     }
+    default_cf = db->DefaultColumnFamily();
     // create and open column families
     if (cfs) {
       for (auto& p : *cfs) {
@@ -497,18 +595,34 @@ int RocksDBStore::do_open(ostream &out,
 	  return -EINVAL;
 	}
 	install_cf_mergeop(p.name, &cf_opt);
-	rocksdb::ColumnFamilyHandle *cf;
-	status = db->CreateColumnFamily(cf_opt, p.name, &cf);
-	if (!status.ok()) {
-	  derr << __func__ << " Failed to create rocksdb column family: "
-	       << p.name << dendl;
-	  return -EINVAL;
+	for (uint32_t i = 0; i < p.shard_cnt; ++i) {
+	  string n = shard_cf_name(p.name, i, p.shard_cnt);
+	  rocksdb::ColumnFamilyHandle *cf;
+	  status = db->CreateColumnFamily(cf_opt, n, &cf);
+	  if (!status.ok()) {
+	    derr << __func__ << " Failed to create rocksdb column family: "
+		 << n << dendl;
+	    return -EINVAL;
+	  }
+	  // store the new CF handle
+	  add_column_family(n, static_cast<void*>(cf));
 	}
-	// store the new CF handle
-	add_column_family(p.name, static_cast<void*>(cf));
+      }
+      // remember the layout so that a later open does not depend on config
+      status = db->Put(
+	rocksdb::WriteOptions(), default_cf,
+	rocksdb::Slice(combine_strings(SHARDING_PREFIX, SHARDING_DEF_KEY)),
+	rocksdb::Slice(column_families_to_str(*cfs)));
+      if (!status.ok()) {
+	derr << __func__ << " failed to store sharding: "
+	     << status.ToString() << dendl;
+	return -EIO;
+      }
+      r = apply_sharding(*cfs);
+      if (r < 0) {
+	return r;
       }
     }
-    default_cf = db->DefaultColumnFamily();
   } else {
     std::vector<string> existing_cfs;
     status = rocksdb::DB::ListColumnFamilies(
@@ -536,10 +650,11 @@ int RocksDBStore::do_open(ostream &out,
 	// copy default CF settings, block cache, merge operators as
 	// the base for new CF
 	rocksdb::ColumnFamilyOptions cf_opt(opt);
+	string prefix = cf_name_to_prefix(n);
 	bool found = false;
 	if (cfs) {
 	  for (auto& i : *cfs) {
-	    if (i.name == n) {
+	    if (i.name == n || i.name == prefix) {
 	      found = true;
 	      status = rocksdb::GetColumnFamilyOptionsFromString(
 		cf_opt, i.option, &cf_opt);
@@ -552,7 +667,7 @@ int RocksDBStore::do_open(ostream &out,
 	  }
 	}
 	if (n != rocksdb::kDefaultColumnFamilyName) {
-	  install_cf_mergeop(n, &cf_opt);
+	  install_cf_mergeop(prefix, &cf_opt);
 	}
 	column_families.push_back(rocksdb::ColumnFamilyDescriptor(n, cf_opt));
 	if (!found && n != rocksdb::kDefaultColumnFamilyName) {
@@ -581,6 +696,21 @@ int RocksDBStore::do_open(ostream &out,
 	  add_column_family(existing_cfs[i], static_cast<void*>(handles[i]));
 	}
       }
+      vector<ColumnFamily> layout;
+      r = load_sharding(&layout);
+      if (r < 0) {
+	return r;
+      }
+      r = apply_sharding(layout);
+      if (r < 0) {
+	return r;
+      }
+      if (cfs && column_families_to_str(*cfs) != column_families_to_str(layout)) {
+	dout(1) << __func__ << " column families '"
+		<< column_families_to_str(layout)
+		<< "' differ from configured '" << column_families_to_str(*cfs)
+		<< "'; use ceph-bluestore-tool reshard to change them" << dendl;
+      }
     }
   }
   ceph_assert(default_cf != nullptr);
@@ -682,6 +812,160 @@ int RocksDBStore::repair(std::ostream &out)
   }
 }
 
+int RocksDBStore::reshard(const std::string& new_sharding, std::ostream &out)
+{
+  const uint64_t keys_per_batch = 10000;
+  vector<ColumnFamily> layout;
+  stringstream err;
+  int r = parse_column_families(new_sharding, &layout, &err);
+  if (r < 0) {
+    out << "invalid sharding '" << new_sharding << "': " << err.str()
+	<< std::endl;
+    return r;
+  }
+  const string def_key = combine_strings(SHARDING_PREFIX, SHARDING_DEF_KEY);
+
+  // every column family that may hold keys, keyed by the prefix it
+  // belongs to.  column family names are derived from the prefix, so
+  // this also picks up the ones created by an interrupted reshard.
+  vector<std::pair<string, rocksdb::ColumnFamilyHandle*>> sources;
+  for (auto& p : cf_handles) {
+    sources.emplace_back(cf_name_to_prefix(p.first),
+			 static_cast<rocksdb::ColumnFamilyHandle*>(p.second));
+  }
+
+  // create the column families the new layout is missing
+  rocksdb::Status status;
+  rocksdb::ColumnFamilyOptions base_opt(db->GetOptions(default_cf));
+  for (auto& p : layout) {
+    rocksdb::ColumnFamilyOptions cf_opt(base_opt);
+    status = rocksdb::GetColumnFamilyOptionsFromString(
+      cf_opt, p.option, &cf_opt);
+    if (!status.ok()) {
+      out << "invalid column family options for '" << p.name << "': "
+	  << p.option << std::endl;
+      return -EINVAL;
+    }
+    install_cf_mergeop(p.name, &cf_opt);
+    for (uint32_t i = 0; i < p.shard_cnt; ++i) {
+      string n = shard_cf_name(p.name, i, p.shard_cnt);
+      if (cf_handles.count(n)) {
+	continue;
+      }
+      rocksdb::ColumnFamilyHandle *cf;
+      status = db->CreateColumnFamily(cf_opt, n, &cf);
+      if (!status.ok()) {
+	out << "failed to create column family '" << n << "': "
+	    << status.ToString() << std::endl;
+	return -EINVAL;
+      }
+      add_column_family(n, static_cast<void*>(cf));
+    }
+  }
+  r = apply_sharding(layout);
+  ceph_assert(r == 0);
+
+  // move every key that is not where the new layout expects it
+  uint64_t moved = 0, pending = 0;
+  rocksdb::WriteBatch bat;
+  auto flush = [&]() -> int {
+    if (pending == 0) {
+      return 0;
+    }
+    rocksdb::Status s = db->Write(rocksdb::WriteOptions(), &bat);
+    if (!s.ok()) {
+      out << "failed to move keys: " << s.ToString() << std::endl;
+      return -EIO;
+    }
+    bat.Clear();
+    pending = 0;
+    return 0;
+  };
+  {
+    std::unique_ptr<rocksdb::Iterator> it(
+      db->NewIterator(rocksdb::ReadOptions(), default_cf));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+      string prefix, key;
+      if (split_key(it->key(), &prefix, &key) < 0 ||
+	  prefix == SHARDING_PREFIX) {
+	continue;
+      }
+      auto cf = get_cf_handle(prefix, key);
+      if (!cf) {
+	continue;
+      }
+      bat.Put(cf, rocksdb::Slice(key), it->value());
+      bat.Delete(default_cf, it->key());
+      ++moved;
+      if (++pending >= keys_per_batch && (r = flush()) < 0) {
+	return r;
+      }
+    }
+  }
+  for (auto& src : sources) {
+    std::unique_ptr<rocksdb::Iterator> it(
+      db->NewIterator(rocksdb::ReadOptions(), src.second));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+      auto cf = get_cf_handle(src.first, it->key().data(), it->key().size());
+      if (cf == src.second) {
+	continue;
+      }
+      if (cf) {
+	bat.Put(cf, it->key(), it->value());
+      } else {
+	bat.Put(default_cf,
+		rocksdb::Slice(combine_strings(src.first, it->key().ToString())),
+		it->value());
+      }
+      bat.Delete(src.second, it->key());
+      ++moved;
+      if (++pending >= keys_per_batch && (r = flush()) < 0) {
+	return r;
+      }
+    }
+  }
+  r = flush();
+  if (r < 0) {
+    return r;
+  }
+
+  // drop the column families the new layout no longer uses
+  std::set<rocksdb::ColumnFamilyHandle*> used;
+  for (auto& p : cf_shards) {
+    used.insert(p.second.handles.begin(), p.second.handles.end());
+  }
+  unsigned dropped = 0;
+  for (auto p = cf_handles.begin(); p != cf_handles.end(); ) {
+    auto cf = static_cast<rocksdb::ColumnFamilyHandle*>(p->second);
+    if (used.count(cf)) {
+      ++p;
+      continue;
+    }
+    status = db->DropColumnFamily(cf);
+    if (!status.ok()) {
+      out << "failed to drop column family '" << p->first << "': "
+	  << status.ToString() << std::endl;
+      return -EIO;
+    }
+    db->DestroyColumnFamilyHandle(cf);
+    p = cf_handles.erase(p);
+    ++dropped;
+  }
+
+  rocksdb::WriteOptions woptions;
+  woptions.sync = true;
+  status = db->Put(woptions, default_cf, rocksdb::Slice(def_key),
+		   rocksdb::Slice(column_families_to_str(layout)));
+  if (!status.ok()) {
+    out << "failed to store sharding: " << status.ToString() << std::endl;
+    return -EIO;
+  }
+  out << "resharded to '" << column_families_to_str(layout) << "': moved "
+      << moved << " keys, dropped " << dropped << " column families"
+      << std::endl;
+  return 0;
+}
+
 void RocksDBStore::split_stats(const std::string &s, char delim, std::vector<std::string> &elems) {
     std::stringstream ss;
     ss.str(s);
@@ -693,16 +977,20 @@ void RocksDBStore::split_stats(const std::string &s, char delim, std::vector<std
 
 int64_t RocksDBStore::estimate_prefix_size(const string& prefix)
 {
-  auto cf = get_cf_handle(prefix);
+  auto shards = get_cf_shards(prefix);
   uint64_t size = 0;
   uint8_t flags =
     //rocksdb::DB::INCLUDE_MEMTABLES |  // do not include memtables...
     rocksdb::DB::INCLUDE_FILES;
-  if (cf) {
+  if (shards) {
     string start(1, '\x00');
     string limit("\xff\xff\xff\xff");
     rocksdb::Range r(start, limit);
-    db->GetApproximateSizes(cf, &r, 1, &size, flags);
+    for (auto cf : shards->handles) {
+      uint64_t s = 0;
+      db->GetApproximateSizes(cf, &r, 1, &s, flags);
+      size += s;
+    }
   } else {
     string limit = prefix + "\xff\xff\xff\xff";
     rocksdb::Range r(prefix, limit);
@@ -879,7 +1167,7 @@ void RocksDBStore::RocksDBTransactionImpl::set(
   const string &k,
   const bufferlist &to_set_bl)
 {
-  auto cf = db->get_cf_handle(prefix);
+  auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
     put_bat(bat, cf, k, to_set_bl);
   } else {
@@ -893,7 +1181,7 @@ void RocksDBStore::RocksDBTransactionImpl::set(
   const char *k, size_t keylen,
   const bufferlist &to_set_bl)
 {
-  auto cf = db->get_cf_handle(prefix);
+  auto cf = db->get_cf_handle(prefix, k, keylen);
   if (cf) {
     string key(k, keylen);  // fixme?
     put_bat(bat, cf, key, to_set_bl);
@@ -907,7 +1195,7 @@ void RocksDBStore::RocksDBTransactionImpl::set(
 void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const string &k)
 {
-  auto cf = db->get_cf_handle(prefix);
+  auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
     bat.Delete(cf, rocksdb::Slice(k));
   } else {
@@ -919,7 +1207,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const char *k,
 						 size_t keylen)
 {
-  auto cf = db->get_cf_handle(prefix);
+  auto cf = db->get_cf_handle(prefix, k, keylen);
   if (cf) {
     bat.Delete(cf, rocksdb::Slice(k, keylen));
   } else {
@@ -932,7 +1220,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
 					                 const string &k)
 {
-  auto cf = db->get_cf_handle(prefix);
+  auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
     bat.SingleDelete(cf, k);
   } else {
@@ -942,17 +1230,20 @@ void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
 
 void RocksDBStore::RocksDBTransactionImpl::rmkeys_by_prefix(const string &prefix)
 {
-  auto cf = db->get_cf_handle(prefix);
-  if (cf) {
+  auto shards = db->get_cf_shards(prefix);
+  if (shards) {
     if (db->enable_rmrange) {
       string endprefix("\xff\xff\xff\xff");  // FIXME: this is cheating...
-      bat.DeleteRange(cf, string(), endprefix);
+      for (auto cf : shards->handles) {
+	bat.DeleteRange(cf, string(), endprefix);
+      }
     } else {
       auto it = db->get_iterator(prefix);
       for (it->seek_to_first();
 	   it->valid();
 	   it->next()) {
-	bat.Delete(cf, rocksdb::Slice(it->key()));
+	string k = it->key();
+	bat.Delete(db->get_cf_handle(prefix, k), rocksdb::Slice(k));
       }
     }
   } else {
@@ -977,18 +1268,21 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
                                                          const string &start,
                                                          const string &end)
 {
-  auto cf = db->get_cf_handle(prefix);
-  if (cf) {
+  auto shards = db->get_cf_shards(prefix);
+  if (shards) {
     if (db->enable_rmrange) {
-      bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
+      for (auto cf : shards->handles) {
+	bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
+      }
     } else {
       auto it = db->get_iterator(prefix);
       it->lower_bound(start);
       while (it->valid()) {
-	if (it->key() >= end) {
+	string k = it->key();
+	if (k >= end) {
 	  break;
 	}
-	bat.Delete(cf, rocksdb::Slice(it->key()));
+	bat.Delete(db->get_cf_handle(prefix, k), rocksdb::Slice(k));
 	it->next();
       }
     }
@@ -1018,7 +1312,7 @@ void RocksDBStore::RocksDBTransactionImpl::merge(
   const string &k,
   const bufferlist &to_set_bl)
 {
-  auto cf = db->get_cf_handle(prefix);
+  auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
     // bufferlist::c_str() is non-constant, so we can't call c_str()
     if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
@@ -1059,34 +1353,38 @@ int RocksDBStore::get(
     std::map<string, bufferlist> *out)
 {
   utime_t start = ceph_clock_now();
-  auto cf = get_cf_handle(prefix);
-  if (cf) {
+  // fetch everything with a single MultiGet, which lets rocksdb batch the
+  // memtable/block lookups instead of paying the full Get() path per key
+  auto shards = get_cf_shards(prefix);
+  std::vector<string> combined;
+  std::vector<rocksdb::Slice> slices;
+  std::vector<rocksdb::ColumnFamilyHandle*> cfs;
+  slices.reserve(keys.size());
+  cfs.reserve(keys.size());
+  if (shards) {
     for (auto& key : keys) {
-      std::string value;
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    cf,
-			    rocksdb::Slice(key),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value);
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
+      slices.emplace_back(key);
+      cfs.push_back(pick_shard(*shards, key.data(), key.size()));
     }
   } else {
+    combined.reserve(keys.size());
     for (auto& key : keys) {
-      std::string value;
-      string k = combine_strings(prefix, key);
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    default_cf,
-			    rocksdb::Slice(k),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value);
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
+      combined.push_back(combine_strings(prefix, key));
+      slices.emplace_back(combined.back());
+      cfs.push_back(default_cf);
+    }
+  }
+  std::vector<string> values;
+  std::vector<rocksdb::Status> status = db->MultiGet(rocksdb::ReadOptions(),
+						     cfs, slices, &values);
+  size_t i = 0;
+  for (auto& key : keys) {
+    if (status[i].ok()) {
+      (*out)[key].append(values[i]);
+    } else if (status[i].IsIOError()) {
+      ceph_abort_msg(status[i].getState());
     }
+    ++i;
   }
   utime_t lat = ceph_clock_now() - start;
   logger->inc(l_rocksdb_gets);
@@ -1104,7 +1402,7 @@ int RocksDBStore::get(
   int r = 0;
   string value;
   rocksdb::Status s;
-  auto cf = get_cf_handle(prefix);
+  auto cf = get_cf_handle(prefix, key);
   if (cf) {
     s = db->Get(rocksdb::ReadOptions(),
 		cf,
@@ -1141,7 +1439,7 @@ int RocksDBStore::get(
   int r = 0;
   string value;
   rocksdb::Status s;
-  auto cf = get_cf_handle(prefix);
+  auto cf = get_cf_handle(prefix, key, keylen);
   if (cf) {
     s = db->Get(rocksdb::ReadOptions(),
 		cf,
@@ -1282,6 +1580,35 @@ void RocksDBStore::compact_range(const string& start, const string& end)
   db->CompactRange(options, &cstart, &cend);
 }
 
+void RocksDBStore::compact_prefix(const string& prefix)
+{
+  auto shards = get_cf_shards(prefix);
+  if (!shards) {
+    compact_range(prefix, past_prefix(prefix));
+    return;
+  }
+  rocksdb::CompactRangeOptions options;
+  for (auto cf : shards->handles) {
+    db->CompactRange(options, cf, nullptr, nullptr);
+  }
+}
+
+void RocksDBStore::compact_range(const string& prefix,
+				 const string& start, const string& end)
+{
+  auto shards = get_cf_shards(prefix);
+  if (!shards) {
+    compact_range(combine_strings(prefix, start), combine_strings(prefix, end));
+    return;
+  }
+  rocksdb::CompactRangeOptions options;
+  rocksdb::Slice cstart(start);
+  rocksdb::Slice cend(end);
+  for (auto cf : shards->handles) {
+    db->CompactRange(options, cf, &cstart, &cend);
+  }
+}
+
 RocksDBStore::RocksDBWholeSpaceIteratorImpl::~RocksDBWholeSpaceIteratorImpl()
 {
   delete dbiter;
@@ -1482,15 +1809,220 @@ public:
   }
 };
 
+// Iterates a prefix that is hashed over several column families.  Each
+// key lives in exactly one shard, so the merged order is simply the
+// smallest (or, going backwards, largest) current key over all shards.
+class ShardMergeIteratorImpl : public KeyValueDB::IteratorImpl {
+protected:
+  string prefix;
+  std::vector<rocksdb::Iterator*> iters;
+  int cur = -1;          ///< shard positioned at the current key
+  bool forward = true;   ///< direction the other shards are positioned for
+
+  void pick() {
+    cur = -1;
+    for (size_t i = 0; i < iters.size(); ++i) {
+      if (!iters[i]->Valid()) {
+	continue;
+      }
+      if (cur < 0) {
+	cur = i;
+	continue;
+      }
+      int c = iters[i]->key().compare(iters[cur]->key());
+      if (forward ? c < 0 : c > 0) {
+	cur = i;
+      }
+    }
+  }
+public:
+  ShardMergeIteratorImpl(const std::string& p,
+			 std::vector<rocksdb::Iterator*>&& its)
+    : prefix(p), iters(std::move(its)) { }
+  ~ShardMergeIteratorImpl() {
+    for (auto it : iters) {
+      delete it;
+    }
+  }
+
+  int seek_to_first() override {
+    forward = true;
+    for (auto it : iters) {
+      it->SeekToFirst();
+    }
+    pick();
+    return status();
+  }
+  int seek_to_last() override {
+    forward = false;
+    for (auto it : iters) {
+      it->SeekToLast();
+    }
+    pick();
+    return status();
+  }
+  int upper_bound(const string &after) override {
+    lower_bound(after);
+    if (valid() && (key() == after)) {
+      next();
+    }
+    return status();
+  }
+  int lower_bound(const string &to) override {
+    forward = true;
+    rocksdb::Slice slice_bound(to);
+    for (auto it : iters) {
+      it->Seek(slice_bound);
+    }
+    pick();
+    return status();
+  }
+  int next() override {
+    if (!valid()) {
+      return status();
+    }
+    if (!forward) {
+      // the other shards sit before the current key; move them past it
+      string k = key();
+      for (size_t i = 0; i < iters.size(); ++i) {
+	if ((int)i != cur) {
+	  iters[i]->Seek(k);
+	}
+      }
+      forward = true;
+    }
+    iters[cur]->Next();
+    pick();
+    return status();
+  }
+  int prev() override {
+    if (!valid()) {
+      return status();
+    }
+    if (forward) {
+      // the other shards sit after the current key; move them before it
+      string k = key();
+      for (size_t i = 0; i < iters.size(); ++i) {
+	if ((int)i == cur) {
+	  continue;
+	}
+	iters[i]->Seek(k);
+	if (iters[i]->Valid()) {
+	  iters[i]->Prev();
+	} else {
+	  iters[i]->SeekToLast();
+	}
+      }
+      forward = false;
+    }
+    iters[cur]->Prev();
+    pick();
+    return status();
+  }
+  bool valid() override {
+    return cur >= 0;
+  }
+  string key() override {
+    return iters[cur]->key().ToString();
+  }
+  std::pair<std::string, std::string> raw_key() override {
+    return make_pair(prefix, key());
+  }
+  bufferlist value() override {
+    return to_bufferlist(iters[cur]->value());
+  }
+  bufferptr value_as_ptr() override {
+    rocksdb::Slice val = iters[cur]->value();
+    return bufferptr(val.data(), val.size());
+  }
+  int status() override {
+    for (auto it : iters) {
+      if (!it->status().ok()) {
+	return -1;
+      }
+    }
+    return 0;
+  }
+};
+
 KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix)
 {
-  rocksdb::ColumnFamilyHandle *cf_handle =
-    static_cast<rocksdb::ColumnFamilyHandle*>(get_cf_handle(prefix));
-  if (cf_handle) {
+  auto shards = get_cf_shards(prefix);
+  if (!shards) {
+    return KeyValueDB::get_iterator(prefix);
+  }
+  if (shards->handles.size() == 1) {
     return std::make_shared<CFIteratorImpl>(
       prefix,
-      db->NewIterator(rocksdb::ReadOptions(), cf_handle));
-  } else {
-    return KeyValueDB::get_iterator(prefix);
+      db->NewIterator(rocksdb::ReadOptions(), shards->handles[0]));
+  }
+  std::vector<rocksdb::Iterator*> iters;
+  for (auto cf : shards->handles) {
+    iters.push_back(db->NewIterator(rocksdb::ReadOptions(), cf));
+  }
+  return std::make_shared<ShardMergeIteratorImpl>(prefix, std::move(iters));
+}
+
+class RocksDBStore::RocksDBSnapshotImpl : public KeyValueDB::SnapshotImpl {
+  RocksDBStore *store;
+  const rocksdb::Snapshot *snapshot;
+
+  rocksdb::ReadOptions read_options() const {
+    rocksdb::ReadOptions options;
+    options.snapshot = snapshot;
+    return options;
   }
+public:
+  explicit RocksDBSnapshotImpl(RocksDBStore *s)
+    : store(s), snapshot(s->db->GetSnapshot()) {}
+  ~RocksDBSnapshotImpl() override {
+    store->db->ReleaseSnapshot(snapshot);
+  }
+
+  Iterator get_iterator(const std::string& prefix) override {
+    auto shards = store->get_cf_shards(prefix);
+    if (shards && shards->handles.size() == 1) {
+      return std::make_shared<CFIteratorImpl>(
+	prefix,
+	store->db->NewIterator(read_options(), shards->handles[0]));
+    } else if (shards) {
+      std::vector<rocksdb::Iterator*> iters;
+      for (auto cf : shards->handles) {
+	iters.push_back(store->db->NewIterator(read_options(), cf));
+      }
+      return std::make_shared<ShardMergeIteratorImpl>(prefix,
+						      std::move(iters));
+    }
+    return std::make_shared<PrefixIteratorImpl>(
+      prefix,
+      std::make_shared<RocksDBWholeSpaceIteratorImpl>(
+	store->db->NewIterator(read_options(), store->default_cf)));
+  }
+
+  int get(const std::string& prefix,
+	  const std::string& key,
+	  bufferlist *out) override {
+    ceph_assert(out && (out->length() == 0));
+    string value;
+    rocksdb::Status s;
+    auto cf = store->get_cf_handle(prefix, key);
+    if (cf) {
+      s = store->db->Get(read_options(), cf, rocksdb::Slice(key), &value);
+    } else {
+      s = store->db->Get(read_options(), store->default_cf,
+			 rocksdb::Slice(combine_strings(prefix, key)), &value);
+    }
+    if (s.ok()) {
+      out->append(value);
+      return 0;
+    } else if (s.IsNotFound()) {
+      return -ENOENT;
+    }
+    ceph_abort_msg(s.getState());
+  }
+};
+
+KeyValueDB::Snapshot RocksDBStore::get_snapshot()
+{
+  return std::make_shared<RocksDBSnapshotImpl>(this);
 }
@@ -87,6 +87,21 @@ class RocksDBStore : public KeyValueDB {
   bool must_close_default_cf = false;
   rocksdb::ColumnFamilyHandle *default_cf = nullptr;
 
+  /// the column families a prefix lives in; a single one if unsharded
+  struct prefix_shards {
+    uint32_t hash_l = 0;          ///< first key byte fed to the shard hash
+    uint32_t hash_h = UINT32_MAX; ///< one past the last byte fed to it
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  };
+  /// prefix -> shards, for every prefix not kept in the default CF
+  std::unordered_map<std::string, prefix_shards> cf_shards;
+
+  static rocksdb::ColumnFamilyHandle *pick_shard(const prefix_shards& s,
+						 const char *key,
+						 size_t keylen);
+  int apply_sharding(const vector<ColumnFamily>& layout);
+  int load_sharding(vector<ColumnFamily> *layout);
+
   int submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Transaction t);
   int install_cf_mergeop(const string &cf_name, rocksdb::ColumnFamilyOptions *cf_opt);
   int create_db_dir();
@@ -131,16 +146,12 @@ public:
   static int _test_init(const string& dir);
   int init(string options_str) override;
   /// compact rocksdb for all keys with a given prefix
-  void compact_prefix(const string& prefix) override {
-    compact_range(prefix, past_prefix(prefix));
-  }
+  void compact_prefix(const string& prefix) override;
   void compact_prefix_async(const string& prefix) override {
     compact_range_async(prefix, past_prefix(prefix));
   }
 
-  void compact_range(const string& prefix, const string& start, const string& end) override {
-    compact_range(combine_strings(prefix, start), combine_strings(prefix, end));
-  }
+  void compact_range(const string& prefix, const string& start, const string& end) override;
   void compact_range_async(const string& prefix, const string& start, const string& end) override {
     compact_range_async(combine_strings(prefix, start), combine_strings(prefix, end));
   }
@@ -179,14 +190,27 @@ public:
 
   void close() override;
 
-  rocksdb::ColumnFamilyHandle *get_cf_handle(const std::string& cf_name) {
-    auto iter = cf_handles.find(cf_name);
-    if (iter == cf_handles.end())
+  /// the column family holding prefix/key, or nullptr for the default CF
+  rocksdb::ColumnFamilyHandle *get_cf_handle(const std::string& prefix,
+					     const char *key, size_t keylen) {
+    auto iter = cf_shards.find(prefix);
+    if (iter == cf_shards.end())
       return nullptr;
-    else
-      return static_cast<rocksdb::ColumnFamilyHandle*>(iter->second);
+    return pick_shard(iter->second, key, keylen);
+  }
+  rocksdb::ColumnFamilyHandle *get_cf_handle(const std::string& prefix,
+					     const std::string& key) {
+    return get_cf_handle(prefix, key.data(), key.size());
+  }
+  /// all column families of prefix, or nullptr for the default CF
+  const prefix_shards *get_cf_shards(const std::string& prefix) const {
+    auto iter = cf_shards.find(prefix);
+    if (iter == cf_shards.end())
+      return nullptr;
+    return &iter->second;
   }
   int repair(std::ostream &out) override;
+  int reshard(const std::string& new_sharding, std::ostream &out) override;
   void split_stats(const std::string &s, char delim, std::vector<std::string> &elems);
   void get_statistics(Formatter *f) override;
 
@@ -387,6 +411,9 @@ public:
 
   Iterator get_iterator(const std::string& prefix) override;
 
+  class RocksDBSnapshotImpl;
+  Snapshot get_snapshot() override;
+
   /// Utility
   static string combine_strings(const string &prefix, const string &value) {
     string out = prefix;
@@ -395,6 +395,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     }
     mapping_job.reset();
   }
+  mapping_inc.reset();
 
   load_health();
 
@@ -478,6 +479,10 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     OSDMap::Incremental inc(inc_bl);
     err = osdmap.apply_incremental(inc);
     ceph_assert(err == 0);
+    if (version == osdmap.epoch && mapping.get_epoch() + 1 == version) {
+      // the mapping can catch up with just this one
+      mapping_inc.reset(new OSDMap::Incremental(inc));
+    }
 
     if (!t)
       t.reset(new MonitorDBStore::Transaction);
@@ -520,6 +525,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 
 	osdmap = OSDMap();
 	osdmap.decode(orig_full_bl);
+	mapping_inc.reset();
 
 	dout(20) << __func__ << " canonical full osdmap:\n";
 	JSONFormatter jf(true);
@@ -609,8 +615,17 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
-    mapping_job = mapping.start_update(osdmap, mapper,
-				       g_conf()->mon_osd_mapping_pgs_per_chunk);
+    if (mapping_inc && mapping_inc->epoch == osdmap.get_epoch()) {
+      // recompute only what the last incremental touched, if we can
+      mapping_job = mapping.start_update(
+	osdmap, *mapping_inc, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    } else {
+      mapping_job = mapping.start_update(
+	osdmap, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    }
+    mapping_inc.reset();
     dout(10) << __func__ << " started mapping job " << mapping_job.get()
 	     << " at " << fin->start << dendl;
     mapping_job->set_finish_event(fin);
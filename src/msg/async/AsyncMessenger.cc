@@ -277,7 +277,8 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
     lock("AsyncMessenger::lock"),
     nonce(_nonce), need_addr(true), did_bind(false),
     global_seq(0), deleted_lock("AsyncMessenger::deleted_lock"),
-    cluster_protocol(0), stopped(true)
+    cluster_protocol(0), stopped(true),
+    send_batch_bytes(cct->_conf, "ms_async_send_batch_bytes")
 {
   std::string transport_type = "posix";
   if (type.find("rdma") != std::string::npos)
@@ -29,6 +29,7 @@
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/Thread.h"
+#include "common/config_cacher.h"
 
 #include "msg/SimplePolicyMessenger.h"
 #include "msg/DispatchQueue.h"
@@ -338,6 +339,9 @@ public:
   /// con used for sending messages to ourselves
   AsyncConnectionRef local_connection;
 
+  /// ms_async_send_batch_bytes, read for every message sent
+  md_config_cacher_t<Option::size_t> send_batch_bytes;
+
   /**
    * @defgroup AsyncMessenger internals
    * @{
@@ -164,14 +164,12 @@ int EventCenter::init(int n, unsigned i, const std::string &t)
 
 EventCenter::~EventCenter()
 {
-  {
-    std::lock_guard<std::mutex> l(external_lock);
-    while (!external_events.empty()) {
-      EventCallbackRef e = external_events.front();
-      if (e)
-        e->do_request(0);
-      external_events.pop_front();
-    }
+  for (ExternalEvent *p = take_external_events(); p; ) {
+    ExternalEvent *next = p->next;
+    if (p->cb)
+      p->cb->do_request(0);
+    delete p;
+    p = next;
   }
   time_events.clear();
   //assert(time_events.empty());
@@ -369,7 +367,8 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   auto now = clock_type::now();
 
   auto it = time_events.begin();
-  bool blocking = pollers.empty() && !external_num_events.load();
+  bool blocking = pollers.empty() &&
+    !external_events.load(std::memory_order_relaxed);
   // If exists external events or poller, don't block
   if (!blocking) {
     if (it != time_events.end() && now >= it->first)
@@ -428,18 +427,22 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   if (trigger_time)
     numevents += process_time_events();
 
-  if (external_num_events.load()) {
-    external_lock.lock();
-    deque<EventCallbackRef> cur_process;
-    cur_process.swap(external_events);
-    external_num_events.store(0);
-    external_lock.unlock();
-    numevents += cur_process.size();
-    while (!cur_process.empty()) {
-      EventCallbackRef e = cur_process.front();
-      ldout(cct, 30) << __func__ << " do " << e << dendl;
-      e->do_request(0);
-      cur_process.pop_front();
+  if (external_events.load(std::memory_order_relaxed)) {
+    EventCallbackRef last = nullptr;
+    for (ExternalEvent *p = take_external_events(); p; ) {
+      ExternalEvent *next = p->next;
+      // the same callback is often dispatched again before we get to it
+      // (e.g. a connection's write handler); once is enough.  p->cb can't
+      // be a new object at the address of a nowait event freed by the
+      // previous do_request: both were queued before we ran either.
+      if (p->cb != last) {
+	ldout(cct, 30) << __func__ << " do " << p->cb << dendl;
+	last = p->cb;
+	p->cb->do_request(0);
+	++numevents;
+      }
+      delete p;
+      p = next;
     }
   }
 
@@ -453,19 +456,35 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   return numevents;
 }
 
-void EventCenter::dispatch_event_external(EventCallbackRef e)
+EventCenter::ExternalEvent *EventCenter::take_external_events()
 {
-  uint64_t num = 0;
-  {
-    std::lock_guard lock{external_lock};
-    if (external_num_events > 0 && *external_events.rbegin() == e) {
-      return;
-    }
-    external_events.push_back(e);
-    num = ++external_num_events;
+  ExternalEvent *p = external_events.exchange(nullptr,
+					      std::memory_order_acquire);
+  // the stack holds the newest first
+  ExternalEvent *fifo = nullptr;
+  while (p) {
+    ExternalEvent *next = p->next;
+    p->next = fifo;
+    fifo = p;
+    p = next;
   }
-  if (num == 1 && !in_thread())
+  return fifo;
+}
+
+void EventCenter::dispatch_event_external(EventCallbackRef e)
+{
+  ExternalEvent *ev = new ExternalEvent{e, nullptr};
+  ExternalEvent *head = external_events.load(std::memory_order_relaxed);
+  do {
+    ev->next = head;
+  } while (!external_events.compare_exchange_weak(
+	     head, ev, std::memory_order_release, std::memory_order_relaxed));
+  // ev may already be taken (and freed) by the owner here.  if the queue
+  // was not empty, whoever pushed onto the empty queue has woken it up,
+  // and it will take our event along with theirs.
+  bool first = !head;
+  if (first && !in_thread())
     wakeup();
 
-  ldout(cct, 30) << __func__ << " " << e << " pending " << num << dendl;
+  ldout(cct, 30) << __func__ << " " << e << (first ? " first" : "") << dendl;
 }
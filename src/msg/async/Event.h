@@ -156,9 +156,13 @@ class EventCenter {
   int nevent;
   // Used only to external event
   pthread_t owner = 0;
-  std::mutex external_lock;
-  std::atomic_ulong external_num_events;
-  deque<EventCallbackRef> external_events;
+  /// external events are pushed by any thread onto this lock-free stack;
+  /// the owner takes them all at once and restores their order
+  struct ExternalEvent {
+    EventCallbackRef cb;
+    ExternalEvent *next;
+  };
+  std::atomic<ExternalEvent*> external_events = {nullptr};
   vector<FileEvent> file_events;
   EventDriver *driver;
   std::multimap<clock_type::time_point, TimeEvent> time_events;
@@ -176,6 +180,8 @@ class EventCenter {
   AssociatedCenters *global_centers = nullptr;
 
   int process_time_events();
+  /// take all pending external events, oldest first
+  ExternalEvent *take_external_events();
   FileEvent *_get_file_event(int fd) {
     ceph_assert(fd < nevent);
     return &file_events[fd];
@@ -184,7 +190,6 @@ class EventCenter {
  public:
   explicit EventCenter(CephContext *c):
     cct(c), nevent(0),
-    external_num_events(0),
     driver(NULL), time_event_next_id(1),
     notify_receive_fd(-1), notify_send_fd(-1), net(c),
     notify_handler(NULL), idx(0) { }
@@ -206,7 +211,8 @@ class EventCenter {
   int process_events(unsigned timeout_microseconds, ceph::timespan *working_dur = nullptr);
   void wakeup();
 
-  // Used by external thread
+  // Used by external thread.  Lock free; only the event that finds the
+  // queue empty wakes up the owner.
   void dispatch_event_external(EventCallbackRef e);
   inline bool in_thread() const {
     return pthread_equal(pthread_self(), owner);
@@ -21,6 +21,11 @@
 #include <errno.h>
 
 #include <algorithm>
+#include <deque>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include "PosixStack.h"
 
@@ -37,15 +42,46 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define HAVE_MSG_ZEROCOPY
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
 
+  /*
+   * MSG_ZEROCOPY: the kernel references the pages of the iovecs instead
+   * of copying them, and reports on the socket error queue when it is
+   * done with them.  Every sendmsg that queued data gets the next id of a
+   * per-socket counter; the bytes it sent stay pinned in zc_pending until
+   * a completion covers that id.
+   */
+  size_t zc_min = 0;        ///< smallest sendmsg to zerocopy, 0 for never
+  uint32_t zc_next = 0;     ///< id of the next zerocopy sendmsg
+  struct zc_sent_t {
+    uint32_t first;         ///< id of the first sendmsg that covered bl
+    uint32_t calls;         ///< ids first .. first + calls - 1 are ours
+    uint32_t left;          ///< of those, not completed yet
+    bufferlist bl;
+  };
+  std::deque<zc_sent_t> zc_pending;
+
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa,
+				    int f, bool connected, size_t zerocopy_min = 0)
+      : handler(h), _fd(f), sa(sa), connected(connected) {
+#ifdef HAVE_MSG_ZEROCOPY
+    int one = 1;
+    if (zerocopy_min &&
+	::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+      zc_min = zerocopy_min;
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -67,30 +103,92 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    // completions raise EPOLLERR, which the event loop reports as
+    // readable until the error queue is drained
+    reap_zerocopy();
     ssize_t r = ::read(_fd, buf, len);
     if (r < 0)
       r = -errno;
     return r;
   }
 
+  /// release what the kernel no longer references
+  void reap_zerocopy() {
+#ifdef HAVE_MSG_ZEROCOPY
+    while (!zc_pending.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+		   CMSG_SPACE(sizeof(struct sockaddr_in6))];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+	break;
+      }
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	      (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+	  continue;
+	}
+	auto ee = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+	if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	// ids [ee_info, ee_data] are done; usually, but not always, in order
+	uint32_t lo = ee->ee_info, n = ee->ee_data - lo;
+	for (auto& p : zc_pending) {
+	  for (uint32_t id = p.first; id != p.first + p.calls; ++id) {
+	    if (id - lo <= n) {
+	      --p.left;
+	    }
+	  }
+	}
+	if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+	  // the kernel fell back to copying (e.g. loopback): pinning buys
+	  // nothing on this socket
+	  zc_min = 0;
+	}
+      }
+      while (!zc_pending.empty() && !zc_pending.front().left) {
+	zc_pending.pop_front();
+      }
+    }
+#endif
+  }
+
   // return the sent length
   // < 0 means error occurred
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // *zc_calls counts the sendmsg calls that went out with MSG_ZEROCOPY
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    bool zerocopy = false, uint32_t *zc_calls = nullptr)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef HAVE_MSG_ZEROCOPY
+      if (zerocopy) {
+	flags |= MSG_ZEROCOPY;
+      }
+#endif
+      r = ::sendmsg(fd, &msg, flags);
       if (r < 0) {
         if (errno == EINTR) {
           continue;
         } else if (errno == EAGAIN) {
           break;
-        }
+        } else if (errno == ENOBUFS && zerocopy) {
+	  // out of optmem for completions: copy this one
+	  zerocopy = false;
+	  continue;
+	}
         return -errno;
       }
 
+      if (zerocopy) {
+	++*zc_calls;
+      }
       sent += r;
       if (len == sent) break;
 
@@ -111,7 +209,9 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(bufferlist &bl, bool more) override {
+    reap_zerocopy();
     size_t sent_bytes = 0;
+    uint32_t zc_calls = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = std::size(bl.buffers());
     while (left_pbrs) {
@@ -129,7 +229,8 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+			     zc_min && msglen >= zc_min, &zc_calls);
       if (r < 0)
         return r;
 
@@ -140,7 +241,13 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
       // only "r" == 0 continue
     }
 
-    if (sent_bytes) {
+    if (zc_calls) {
+      // the whole prefix stays pinned, copied chunks included: it is a
+      // few buffer refs, and keeps the bookkeeping to one entry per send
+      zc_pending.push_back({zc_next, zc_calls, zc_calls, {}});
+      zc_next += zc_calls;
+      bl.splice(0, sent_bytes, &zc_pending.back().bl);
+    } else if (sent_bytes) {
       bufferlist swapped;
       if (sent_bytes < bl.length()) {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
@@ -210,7 +317,9 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(
+      handler, *out, sd, true,
+      w->cct->_conf.get_val<Option::size_t>("ms_async_zerocopy_min_size")));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -279,7 +388,9 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(
+	  net, addr, sd, !opts.nonblock,
+	  cct->_conf.get_val<Option::size_t>("ms_async_zerocopy_min_size"))));
   return 0;
 }
 
@@ -626,6 +626,7 @@ void ProtocolV2::reset_session() {
   connection->dispatch_queue->discard_queue(connection->conn_id);
   discard_out_queue();
   connection->outcoming_bl.clear();
+  tx_frames = 0;
 
   connection->dispatch_queue->queue_remote_reset(connection);
 
@@ -1027,6 +1028,7 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
     connection->outcoming_bl.append(m->get_middle());
     connection->outcoming_bl.append(m->get_data());
   }
+  ++tx_frames;
 
   ldout(cct, 5) << __func__ << " sending message m=" << m
                 << " seq=" << m->get_seq() << " " << *m << dendl;
@@ -1036,16 +1038,25 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                  << " src=" << entity_name_t(messenger->get_myname())
                  << " off=" << header2.data_off
                  << dendl;
-  ssize_t total_send_size = connection->outcoming_bl.length();
-  ssize_t rc = connection->_try_send(more);
-  if (rc < 0) {
-    ldout(cct, 1) << __func__ << " error sending " << m << ", "
-                  << cpp_strerror(rc) << dendl;
+  ssize_t rc = 0;
+  if (more &&
+      connection->outcoming_bl.length() <
+        static_cast<Option::size_t>(messenger->send_batch_bytes) &&
+      connection->outcoming_bl.get_num_buffers() < IOV_MAX) {
+    // more messages are queued behind this one: let them join it in a
+    // single sendmsg, write_event() flushes the batch
+    ldout(cct, 20) << __func__ << " batching " << m << ", "
+                   << connection->outcoming_bl.length() << " bytes pending"
+                   << dendl;
   } else {
-    connection->logger->inc(
-        l_msgr_send_bytes, total_send_size - connection->outcoming_bl.length());
-    ldout(cct, 10) << __func__ << " sending " << m
-                   << (rc ? " continuely." : " done.") << dendl;
+    rc = send_frames(more);
+    if (rc < 0) {
+      ldout(cct, 1) << __func__ << " error sending " << m << ", "
+                    << cpp_strerror(rc) << dendl;
+    } else {
+      ldout(cct, 10) << __func__ << " sending " << m
+                     << (rc ? " continuely." : " done.") << dendl;
+    }
   }
   if (m->get_type() == CEPH_MSG_OSD_OP)
     OID_EVENT_TRACE_WITH_MSG(m, "SEND_MSG_OSD_OP_END", false);
@@ -1056,15 +1067,31 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
   return rc;
 }
 
+ssize_t ProtocolV2::send_frames(bool more) {
+  uint64_t len = connection->outcoming_bl.length();
+  ssize_t r = connection->_try_send(more);
+  if (r >= 0 && (uint64_t)r < len) {
+    connection->logger->inc(l_msgr_send_bytes, len - r);
+    if (tx_frames) {
+      // a frame left partly in outcoming_bl is counted with this call
+      connection->logger->inc(l_msgr_send_frames_per_call, tx_frames);
+      tx_frames = 0;
+    }
+  }
+  return r;
+}
+
 void ProtocolV2::append_keepalive() {
   ldout(cct, 10) << __func__ << dendl;
   KeepAliveFrame keepalive_frame(*this);
   connection->outcoming_bl.claim_append(keepalive_frame.get_buffer());
+  ++tx_frames;
 }
 
 void ProtocolV2::append_keepalive_ack(utime_t &timestamp) {
   KeepAliveFrameAck keepalive_ack_frame(*this, timestamp);
   connection->outcoming_bl.claim_append(keepalive_ack_frame.get_buffer());
+  ++tx_frames;
 }
 
 void ProtocolV2::handle_message_ack(uint64_t seq) {
@@ -1145,13 +1172,14 @@ void ProtocolV2::write_event() {
         s = in_seq;
         AckFrame ack(*this, in_seq);
         connection->outcoming_bl.claim_append(ack.get_buffer());
+        ++tx_frames;
         ldout(cct, 10) << __func__ << " try send msg ack, acked " << left
                        << " messages" << dendl;
         ack_left -= left;
         left = ack_left;
-        r = connection->_try_send(left);
+        r = send_frames(left);
       } else if (is_queued()) {
-        r = connection->_try_send();
+        r = send_frames();
       }
     }
     connection->write_lock.unlock();
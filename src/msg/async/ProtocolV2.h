@@ -160,6 +160,7 @@ private:
   bufferlist front, middle, data, extra;
 
   bool keepalive;
+  unsigned tx_frames = 0;  ///< frames put in outcoming_bl since the last send
 
   ostream &_conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *continuation);
@@ -179,6 +180,7 @@ private:
   void prepare_send_message(uint64_t features, Message *m);
   out_queue_entry_t _get_next_outgoing();
   ssize_t write_message(Message *m, bool more);
+  ssize_t send_frames(bool more = false);
   void append_keepalive();
   void append_keepalive_ack(utime_t &timestamp);
   void handle_message_ack(uint64_t seq);
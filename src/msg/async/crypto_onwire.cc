@@ -18,6 +18,12 @@ static constexpr const std::size_t AESGCM_IV_LEN{12};
 static constexpr const std::size_t AESGCM_TAG_LEN{16};
 static constexpr const std::size_t AESGCM_BLOCK_LEN{16};
 
+// Plaintext buffers shorter than this are copied into the ciphertext
+// buffer and encrypted there in place, together with their neighbours,
+// by a single EVP call. Messages carry their front in many small pieces;
+// one call per piece costs more than the copy.
+static constexpr const std::size_t AESGCM_GATHER_LEN{4096};
+
 struct nonce_t {
   std::uint32_t random_seq;
   std::uint64_t random_rest;
@@ -37,6 +43,20 @@ class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   nonce_t nonce;
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
+  // gathered plaintext waiting in buffer to be encrypted in place; it may
+  // span several segments of the frame
+  unsigned char* gathered = nullptr;
+  std::size_t gathered_len = 0;
+
+  void encrypt(unsigned char* out, const unsigned char* in, std::size_t len);
+  void encrypt_gathered() {
+    if (gathered_len) {
+      encrypt(gathered, gathered, gathered_len);
+    }
+    gathered = nullptr;
+    gathered_len = 0;
+  }
+
 public:
   AES128GCM_OnWireTxHandler(CephContext* const cct,
 			    const key_t& key,
@@ -84,28 +104,50 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(
 
   buffer.reserve(std::accumulate(std::begin(update_size_sequence),
     std::end(update_size_sequence), AESGCM_TAG_LEN));
+  gathered = nullptr;
+  gathered_len = 0;
 
   ++nonce.random_seq;
 }
 
+void AES128GCM_OnWireTxHandler::encrypt(
+  unsigned char* out,
+  const unsigned char* in,
+  std::size_t len)
+{
+  int update_len = 0;
+
+  if(1 != EVP_EncryptUpdate(ectx.get(), out, &update_len, in, len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(static_cast<unsigned>(update_len) == len);
+}
+
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
   auto filler = buffer.append_hole(plaintext.length());
 
   for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
-
-    if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&update_len,
-	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
-	plainbuf.length())) {
-      throw std::runtime_error("EVP_EncryptUpdate failed");
+    auto* out = reinterpret_cast<unsigned char*>(filler.c_str());
+    if (plainbuf.length() < AESGCM_GATHER_LEN) {
+      // the hole is contiguous with the previous one unless the caller
+      // underestimated the sizes in reset_tx_handler()
+      if (gathered && gathered + gathered_len != out) {
+	encrypt_gathered();
+      }
+      if (!gathered) {
+	gathered = out;
+      }
+      filler.copy_in(plainbuf.length(), plainbuf.c_str());
+      gathered_len += plainbuf.length();
+    } else {
+      encrypt_gathered();
+      encrypt(out, reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
+	      plainbuf.length());
+      filler.advance(plainbuf.length());
     }
-    ceph_assert_always(update_len >= 0);
-    ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
   }
 
   ldout(cct, 15) << __func__
@@ -116,6 +158,8 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
+  encrypt_gathered();
+
   int final_len = 0;
   auto filler = buffer.append_hole(AESGCM_BLOCK_LEN);
   if(1 != EVP_EncryptFinal_ex(ectx.get(),
@@ -200,8 +244,26 @@ ceph::bufferlist AES128GCM_OnWireRxHandler::authenticated_decrypt_update(
   ceph_assert(ciphertext.length() > 0);
   //ceph_assert(ciphertext.length() % AESGCM_BLOCK_LEN == 0);
 
-  // NOTE: we might consider in-place transformations in the future. AFAIK
-  // OpenSSL's might sustain that but lack of clear confirmation postpones.
+  // GCM is a stream mode and OpenSSL is fine with in == out, so the
+  // plaintext replaces the ciphertext in the caller's receive buffers.
+  // Only a misaligned first buffer needs a copy.
+  if (ciphertext.front().is_aligned(alignment)) {
+    for (const auto& cipherbuf : ciphertext.buffers()) {
+      auto* p = reinterpret_cast<unsigned char*>(
+	const_cast<char*>(cipherbuf.c_str()));
+      int update_len = 0;
+
+      if (1 != EVP_DecryptUpdate(ectx.get(),
+	  p, &update_len, p, cipherbuf.length())) {
+	throw std::runtime_error("EVP_DecryptUpdate failed");
+      }
+      ceph_assert_always(update_len >= 0);
+      ceph_assert(cipherbuf.length() == static_cast<unsigned>(update_len));
+    }
+    ciphertext.invalidate_crc();
+    return std::move(ciphertext);
+  }
+
   auto plainnode = ceph::buffer::ptr_node::create(buffer::create_aligned(
     ciphertext.length(), alignment));
   auto* plainbuf = reinterpret_cast<unsigned char*>(plainnode->c_str());
@@ -22,21 +22,6 @@
 #include "auth/Auth.h"
 #include "include/buffer.h"
 
-namespace ceph::math {
-
-// TODO
-template <typename T>
-class always_aligned_t {
-  T val;
-
-  template <class... Args>
-  always_aligned_t(Args&&... args)
-    : val(std::forward<Args>(args)...) {
-  }
-};
-
-} // namespace ceph::math
-
 namespace ceph::crypto::onwire {
 
 struct MsgAuthError : public std::runtime_error {
@@ -60,8 +45,8 @@ struct TxHandler {
   // encryption while other might prefer one huge output buffer.
   //
   // It's undefined what will happen if client doesn't follow the order.
-  //
-  // TODO: switch to always_aligned_t
+  // Short buffers of consecutive -update calls are encrypted together at
+  // the next longer buffer or at -final, so the sizes should be exact.
   virtual void reset_tx_handler(
     std::initializer_list<std::uint32_t> update_size_sequence) = 0;
 
@@ -91,7 +76,10 @@ public:
   virtual void reset_rx_handler() = 0;
 
   // Perform decryption ciphertext must be ALWAYS aligned to 16 bytes.
-  // TODO: switch to always_aligned_t
+  // Decryption is done in place when the first buffer of ciphertext is
+  // aligned to `alignment`: the returned bufferlist shares its memory, so
+  // whoever else holds those buffers (e.g. an rx_buffers entry) sees the
+  // plaintext. Otherwise the plaintext is copied to a new aligned buffer.
   virtual ceph::bufferlist authenticated_decrypt_update(
     ceph::bufferlist&& ciphertext,
     std::uint32_t alignment) = 0;
@@ -819,10 +819,15 @@ public:
       return 0;  // none
     }
     /// offset of buffer as aligned to destination within object.
+    ///
+    /// If the encoded transaction is received into a buffer starting at
+    /// this offset within a page, the largest write lands on the same page
+    /// offset as its destination in the object, so the object store can
+    /// hand its pages to the device as they are.
     int get_data_alignment() {
       if (!data.largest_data_len)
 	return 0;
-      return (0 - get_data_offset()) & ~CEPH_PAGE_MASK;
+      return (data.largest_data_off - get_data_offset()) & ~CEPH_PAGE_MASK;
     }
     /// Is the Transaction empty (no operations)
     bool empty() {
@@ -1487,6 +1492,17 @@ public:
   virtual int repair(bool deep) {
     return -EOPNOTSUPP;
   }
+  /**
+   * fsck_online -- shallow consistency check of a mounted store
+   *
+   * Checks metadata against a point-in-time snapshot while the store keeps
+   * serving io.  Object data isn't read, and nothing is repaired.
+   *
+   * @returns number of errors found, or negative error code on failure.
+   */
+  virtual int fsck_online() {
+    return -EOPNOTSUPP;
+  }
 
   virtual void set_cache_shards(unsigned num) { }
 
@@ -1542,6 +1558,11 @@ public:
     return true;
   }
 
+  /// how busy the write pipeline is, from 0 to 1, 0 if unknown
+  virtual double get_queue_utilization() {
+    return 0;
+  }
+
   virtual string get_default_device_class() {
     return is_rotational() ? "hdd" : "ssd";
   }
@@ -1687,6 +1708,69 @@ public:
      bufferlist& bl,
      uint32_t op_flags = 0) = 0;
 
+  /// one entry of a read_multi() batch
+  struct read_multi_op_t {
+    ghobject_t oid;       ///< [in] object to read
+    uint64_t offset = 0;  ///< [in] first byte
+    size_t len = 0;       ///< [in] bytes to read (0~0 means whole object)
+    bufferlist bl;        ///< [out] data
+    int r = 0;            ///< [out] bytes read, or negative error code
+
+    read_multi_op_t() = default;
+    read_multi_op_t(const ghobject_t& oid, uint64_t offset, size_t len)
+      : oid(oid), offset(offset), len(len) {}
+  };
+
+  /**
+   * read_multi -- read byte ranges from several objects of a collection
+   *
+   * Same as calling read() on each entry in turn, but lets the backend
+   * batch the metadata lookups and device io of the whole set.  Each entry
+   * carries its own result.
+   *
+   * @param c collection for objects
+   * @param ops objects and ranges to read; results are filled in
+   * @param op_flags is CEPH_OSD_OP_FLAG_*, applies to every entry
+   * @returns 0 on success, or negative error code on failure.
+   */
+  virtual int read_multi(
+    CollectionHandle &c,
+    std::vector<read_multi_op_t>& ops,
+    uint32_t op_flags = 0) {
+    for (auto& op : ops) {
+      op.r = read(c, op.oid, op.offset, op.len, op.bl, op_flags);
+    }
+    return 0;
+  }
+
+  /**
+   * digest -- fold a byte range of an object into a crc32c digest
+   *
+   * Same result as read() followed by *digest = bl.crc32c(*digest), but
+   * the data never leaves the backend, which can verify it against its
+   * own checksums and reuse them for the digest.  Meant for deep scrub,
+   * so dirty data is digested but clean cached data is not trusted.
+   *
+   * @param c collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to digest
+   * @param len number of bytes to digest
+   * @param digest [in,out] running crc32c
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @returns number of bytes digested (short only at the end of the
+   *          object), -EOPNOTSUPP if the backend cannot do better than
+   *          read(), or another negative error code on failure.
+   */
+  virtual int digest(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    uint32_t *digest,
+    uint32_t op_flags = 0) {
+    return -EOPNOTSUPP;
+  }
+
   /**
    * fiemap -- get extent map of data of an object
    *
@@ -1467,6 +1467,7 @@ uint64_t BlueFS::_estimate_log_size()
 
 void BlueFS::compact_log()
 {
+  std::lock_guard ll(log_lock);
   std::unique_lock l(lock);
   if (cct->_conf->bluefs_compact_log_sync) {
      _compact_log_sync();
@@ -1704,13 +1705,9 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   new_log = new File;
   new_log->fnode.ino = 0;   // so that _flush_range won't try to log the fnode
 
-  // 0. wait for any racing flushes to complete.  (We do not want to block
-  // in _flush_sync_log with jump_to set or else a racing thread might flush
-  // our entries and our jump_to update won't be correct.)
-  while (log_flushing) {
-    dout(10) << __func__ << " log is currently flushing, waiting" << dendl;
-    log_cond.wait(l);
-  }
+  // 0. we hold log_lock throughout, so no racing flush can write out our
+  // entries ahead of us and make our jump_to update incorrect.
+  ceph_assert(ceph_mutex_is_locked(log_lock));
 
   // 1. allocate new log space and jump to it.
   old_log_jump_to = log_file->fnode.get_allocated();
@@ -1728,7 +1725,7 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
 
   flush_bdev();  // FIXME?
 
-  _flush_and_sync_log(l, 0, old_log_jump_to);
+  _flush_and_sync_log_L(l, 0, old_log_jump_to);
 
   // 2. prepare compacted log
   bluefs_transaction_t t;
@@ -1831,7 +1828,6 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   }
   new_log_writer = nullptr;
   new_log = nullptr;
-  log_cond.notify_all();
 
   dout(10) << __func__ << " log extents " << log_file->fnode.extents << dendl;
   logger->inc(l_bluefs_log_compactions);
@@ -1855,15 +1851,23 @@ void BlueFS::flush_log()
 }
 
 int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
-				uint64_t want_seq,
-				uint64_t jump_to)
+				uint64_t want_seq)
 {
-  while (log_flushing) {
-    dout(10) << __func__ << " want_seq " << want_seq
-	     << " log is currently flushing, waiting" << dendl;
-    ceph_assert(!jump_to);
-    log_cond.wait(l);
-  }
+  // take our turn at the log.  whoever held it before us has written out
+  // everything that was pending when it started, which may well include
+  // what we are after; if not, we write out everything pending now on
+  // behalf of all the syncs queued behind us.
+  l.unlock();
+  std::lock_guard ll(log_lock);
+  l.lock();
+  return _flush_and_sync_log_L(l, want_seq);
+}
+
+int BlueFS::_flush_and_sync_log_L(std::unique_lock<ceph::mutex>& l,
+				  uint64_t want_seq,
+				  uint64_t jump_to)
+{
+  ceph_assert(ceph_mutex_is_locked(log_lock));
   if (want_seq && want_seq <= log_seq_stable) {
     dout(10) << __func__ << " want_seq " << want_seq << " <= log_seq_stable "
 	     << log_seq_stable << ", done" << dendl;
@@ -1903,10 +1907,8 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
   if (runway < (int64_t)cct->_conf->bluefs_min_log_runway) {
     dout(10) << __func__ << " allocating more log runway (0x"
 	     << std::hex << runway << std::dec  << " remaining)" << dendl;
-    while (new_log_writer) {
-      dout(10) << __func__ << " waiting for async compaction" << dendl;
-      log_cond.wait(l);
-    }
+    // async compaction holds log_lock until it is done with the log fnode
+    ceph_assert(!new_log_writer);
     int r = _allocate(log_writer->file->fnode.prefer_bdev,
 		      cct->_conf->bluefs_max_log_runway,
 		      &log_writer->file->fnode);
@@ -1928,10 +1930,25 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
 
   log_t.clear();
   log_t.seq = 0;  // just so debug output is less confusing
-  log_flushing = true;
 
-  int r = _flush(log_writer, true);
-  ceph_assert(r == 0);
+  uint64_t offset = 0, length = 0, x_off = 0;
+  mempool::bluefs::vector<bluefs_extent_t> extents;
+  if (_get_flush_extent(log_writer, true, &offset, &length)) {
+    int r = _prepare_flush_range(log_writer, &offset, &length, &x_off,
+				 &extents);
+    ceph_assert(r == 0);
+  }
+
+  // write the log out without the namespace lock.  log_lock keeps
+  // everyone else off the log writer, and whatever gets logged in the
+  // meantime goes out with the next flush.
+  l.unlock();
+  if (length) {
+    int r = _flush_data(log_writer, offset, length, x_off, extents);
+    ceph_assert(r == 0);
+  }
+  _flush_bdev(log_writer);
+  l.lock();
 
   if (jump_to) {
     dout(10) << __func__ << " jumping log offset from 0x" << std::hex
@@ -1940,11 +1957,6 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
     log_writer->file->fnode.size = jump_to;
   }
 
-  _flush_bdev_safely(log_writer);
-
-  log_flushing = false;
-  log_cond.notify_all();
-
   // clean dirty files
   if (seq > log_seq_stable) {
     log_seq_stable = seq;
@@ -1998,8 +2010,15 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
   return 0;
 }
 
-int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
+int BlueFS::_prepare_flush_range(
+  FileWriter *h,
+  uint64_t *poffset,
+  uint64_t *plength,
+  uint64_t *px_off,
+  mempool::bluefs::vector<bluefs_extent_t> *extents)
 {
+  uint64_t offset = *poffset;
+  uint64_t length = *plength;
   dout(10) << __func__ << " " << h << " pos 0x" << std::hex << h->pos
 	   << " 0x" << offset << "~" << length << std::dec
 	   << " to " << h->file->fnode << dendl;
@@ -2008,14 +2027,10 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
 
   h->buffer_appender.flush();
 
-  bool buffered;
-  if (h->file->fnode.ino == 1)
-    buffered = false;
-  else
-    buffered = cct->_conf->bluefs_buffered_io;
-
-  if (offset + length <= h->pos)
+  if (offset + length <= h->pos) {
+    *plength = 0;
     return 0;
+  }
   if (offset < h->pos) {
     length -= h->pos - offset;
     offset = h->pos;
@@ -2032,7 +2047,7 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
   bool must_dirty = false;
   if (allocated < offset + length) {
     // we should never run out of log space here; see the min runway check
-    // in _flush_and_sync_log.
+    // in _flush_and_sync_log_L.
     ceph_assert(h->file->fnode.ino != 1);
     int r = _allocate(h->file->fnode.prefer_bdev,
 		      offset + length - allocated,
@@ -2098,6 +2113,36 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
   dout(20) << __func__ << " in " << *p << " x_off 0x"
            << std::hex << x_off << std::dec << dendl;
 
+  // snapshot the extents we are about to write to so that the data phase
+  // does not need to look at the fnode (which may be reallocated by a
+  // concurrent preallocate/compaction) without the lock.
+  extents->clear();
+  for (uint64_t left = x_off + length;
+       left > 0 && p != h->file->fnode.extents.end();
+       ++p) {
+    extents->push_back(*p);
+    left -= std::min<uint64_t>(left, p->length);
+  }
+  *poffset = offset;
+  *plength = length;
+  *px_off = x_off;
+  return 0;
+}
+
+int BlueFS::_flush_data(
+  FileWriter *h,
+  uint64_t offset,
+  uint64_t length,
+  uint64_t x_off,
+  const mempool::bluefs::vector<bluefs_extent_t>& extents)
+{
+  bool buffered;
+  if (h->file->fnode.ino == 1)
+    buffered = false;
+  else
+    buffered = cct->_conf->bluefs_buffered_io;
+
+  auto p = extents.begin();
   unsigned partial = x_off & ~super.block_mask();
   bufferlist bl;
   if (partial) {
@@ -2147,6 +2192,7 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
   uint64_t bloff = 0;
   uint64_t bytes_written_slow = 0;
   while (length > 0) {
+    ceph_assert(p != extents.end());
     uint64_t x_len = std::min(p->length - x_off, length);
     bufferlist t;
     t.substr_of(bl, bloff, x_len);
@@ -2203,6 +2249,31 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
   return 0;
 }
 
+int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
+{
+  mempool::bluefs::vector<bluefs_extent_t> extents;
+  uint64_t x_off = 0;
+  int r = _prepare_flush_range(h, &offset, &length, &x_off, &extents);
+  if (r < 0 || length == 0)
+    return r;
+  return _flush_data(h, offset, length, x_off, extents);
+}
+
+int BlueFS::_flush_range_F(FileWriter *h, uint64_t offset, uint64_t length)
+{
+  ceph_assert(ceph_mutex_is_locked(h->lock));
+  mempool::bluefs::vector<bluefs_extent_t> extents;
+  uint64_t x_off = 0;
+  {
+    std::lock_guard l(lock);
+    int r = _prepare_flush_range(h, &offset, &length, &x_off, &extents);
+    if (r < 0 || length == 0)
+      return r;
+  }
+  // the aio building and submission only touches writer state
+  return _flush_data(h, offset, length, x_off, extents);
+}
+
 #ifdef HAVE_LIBAIO
 // we need to retire old completed aios so they don't stick around in
 // memory indefinitely (along with their bufferlist refs).
@@ -2231,30 +2302,47 @@ void BlueFS::wait_for_aio(FileWriter *h)
 }
 #endif
 
-int BlueFS::_flush(FileWriter *h, bool force)
+bool BlueFS::_get_flush_extent(FileWriter *h, bool force,
+			       uint64_t *offset, uint64_t *length)
 {
   h->buffer_appender.flush();
-  uint64_t length = h->buffer.length();
-  uint64_t offset = h->pos;
+  *length = h->buffer.length();
+  *offset = h->pos;
   if (!force &&
-      length < cct->_conf->bluefs_min_flush_size) {
-    dout(10) << __func__ << " " << h << " ignoring, length " << length
+      *length < cct->_conf->bluefs_min_flush_size) {
+    dout(10) << __func__ << " " << h << " ignoring, length " << *length
 	     << " < min_flush_size " << cct->_conf->bluefs_min_flush_size
 	     << dendl;
-    return 0;
+    return false;
   }
-  if (length == 0) {
+  if (*length == 0) {
     dout(10) << __func__ << " " << h << " no dirty data on "
 	     << h->file->fnode << dendl;
-    return 0;
+    return false;
   }
   dout(10) << __func__ << " " << h << " 0x"
-           << std::hex << offset << "~" << length << std::dec
+           << std::hex << *offset << "~" << *length << std::dec
 	   << " to " << h->file->fnode << dendl;
   ceph_assert(h->pos <= h->file->fnode.size);
+  return true;
+}
+
+int BlueFS::_flush(FileWriter *h, bool force)
+{
+  uint64_t offset, length;
+  if (!_get_flush_extent(h, force, &offset, &length))
+    return 0;
   return _flush_range(h, offset, length);
 }
 
+int BlueFS::_flush_F(FileWriter *h, bool force)
+{
+  uint64_t offset, length;
+  if (!_get_flush_extent(h, force, &offset, &length))
+    return 0;
+  return _flush_range_F(h, offset, length);
+}
+
 int BlueFS::_truncate(FileWriter *h, uint64_t offset)
 {
   dout(10) << __func__ << " 0x" << std::hex << offset << std::dec
@@ -2296,20 +2384,25 @@ int BlueFS::_truncate(FileWriter *h, uint64_t offset)
   return 0;
 }
 
-int BlueFS::_fsync(FileWriter *h, std::unique_lock<ceph::mutex>& l)
+int BlueFS::_fsync(FileWriter *h)
 {
   dout(10) << __func__ << " " << h << " " << h->file->fnode << dendl;
-  int r = _flush(h, true);
+  int r = _flush_F(h, true);
   if (r < 0)
      return r;
-  uint64_t old_dirty_seq = h->file->dirty_seq;
 
-  _flush_bdev_safely(h);
+  // wait for our data to be stable without holding the global lock so
+  // that other writers can keep submitting in the meantime.
+  _flush_bdev(h);
 
+  std::unique_lock l(lock);
+  uint64_t old_dirty_seq = h->file->dirty_seq;
   if (old_dirty_seq) {
     uint64_t s = log_seq;
     dout(20) << __func__ << " file metadata was dirty (" << old_dirty_seq
 	     << ") on " << h->file->fnode << ", flushing log" << dendl;
+    // concurrent fsyncs queue up on log_lock here and are retired
+    // together by the next log write.
     _flush_and_sync_log(l, old_dirty_seq);
     ceph_assert(h->file->dirty_seq == 0 ||  // cleaned
 	   h->file->dirty_seq > s);    // or redirtied by someone else
@@ -2339,6 +2432,21 @@ void BlueFS::_flush_bdev_safely(FileWriter *h)
   }
 }
 
+void BlueFS::_flush_bdev(FileWriter *h)
+{
+  std::array<bool, MAX_BDEV> flush_devs = h->dirty_devs;
+  h->dirty_devs.fill(false);
+#ifdef HAVE_LIBAIO
+  if (!cct->_conf->bluefs_sync_write) {
+    list<aio_t> completed_ios;
+    _claim_completed_aios(h, &completed_ios);
+    wait_for_aio(h);
+    completed_ios.clear();
+  }
+#endif
+  flush_bdev(flush_devs);
+}
+
 void BlueFS::flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs)
 {
   // NOTE: this is safe to call without a lock.
@@ -2516,6 +2624,7 @@ int BlueFS::_preallocate(FileRef f, uint64_t off, uint64_t len)
 
 void BlueFS::sync_metadata()
 {
+  std::lock_guard ll(log_lock);
   std::unique_lock l(lock);
   if (log_t.empty()) {
     dout(10) << __func__ << " - no pending log events" << dendl;
@@ -2523,7 +2632,7 @@ void BlueFS::sync_metadata()
     dout(10) << __func__ << dendl;
     utime_t start = ceph_clock_now();
     flush_bdev(); // FIXME?
-    _flush_and_sync_log(l);
+    _flush_and_sync_log_L(l);
     dout(10) << __func__ << " done in " << (ceph_clock_now() - start) << dendl;
   }
 
@@ -2641,6 +2750,21 @@ BlueFS::FileWriter *BlueFS::_create_writer(FileRef f)
   return w;
 }
 
+void BlueFS::close_writer(FileWriter *h)
+{
+  {
+    // drain in-flight aios before taking the global lock
+    std::lock_guard hl(h->lock);
+    for (auto p : h->iocv) {
+      if (p) {
+	p->aio_wait();
+      }
+    }
+  }
+  std::lock_guard l(lock);
+  _close_writer(h);
+}
+
 void BlueFS::_close_writer(FileWriter *h)
 {
   dout(10) << __func__ << " " << h << " type " << h->writer_type << dendl;
@@ -140,6 +140,8 @@ public:
     int writer_type = 0;    ///< WRITER_*
     int write_hint = WRITE_LIFE_NOT_SET;
 
+    /// protects buffer, pos, tail_block, iocv and dirty_devs for
+    /// non-log writers; taken before BlueFS::lock
     ceph::mutex lock = ceph::make_mutex("BlueFS::FileWriter::lock");
     std::array<IOContext*,MAX_BDEV> iocv; ///< for each bdev
     std::array<bool, MAX_BDEV> dirty_devs;
@@ -237,7 +239,14 @@ public:
   };
 
 private:
+  // protects the namespace and all fnode/allocator state, along with the
+  // pending log transaction and the dirty file lists.
   ceph::mutex lock = ceph::make_mutex("BlueFS::lock");
+  // owns the log: held by whoever writes the log out (or compacts it),
+  // which drops BlueFS::lock for the io.  syncs that queue up on it while
+  // a log write is in flight are committed together by the next one.
+  // lock order is FileWriter::lock -> log_lock -> BlueFS::lock.
+  ceph::mutex log_lock = ceph::make_mutex("BlueFS::log_lock");
 
   PerfCounters *logger = nullptr;
 
@@ -261,8 +270,6 @@ private:
   uint64_t log_seq_stable = 0; ///< last stable/synced log seq
   FileWriter *log_writer = 0;  ///< writer for the log
   bluefs_transaction_t log_t;  ///< pending, unwritten log transaction
-  bool log_flushing = false;   ///< true while flushing the log
-  ceph::condition_variable log_cond;
 
   uint64_t new_log_jump_to = 0;
   uint64_t old_log_jump_to = 0;
@@ -305,9 +312,25 @@ private:
   int _allocate_without_fallback(uint8_t id, uint64_t len,
 				 PExtentVector* extents);
 
+  // Flushing a writer is split into a metadata phase, which allocates
+  // and dirties the fnode and needs the global lock, and a data phase,
+  // which builds and submits the aios and only needs h->lock.  The
+  // internal log writers do both under the global lock (_flush_range,
+  // _flush); everyone else goes through the _F variants, which must be
+  // called with h->lock held and the global lock *not* held.
+  bool _get_flush_extent(FileWriter *h, bool force,
+			 uint64_t *offset, uint64_t *length);
+  int _prepare_flush_range(FileWriter *h, uint64_t *offset, uint64_t *length,
+			   uint64_t *x_off,
+			   mempool::bluefs::vector<bluefs_extent_t> *extents);
+  int _flush_data(FileWriter *h, uint64_t offset, uint64_t length,
+		  uint64_t x_off,
+		  const mempool::bluefs::vector<bluefs_extent_t>& extents);
   int _flush_range(FileWriter *h, uint64_t offset, uint64_t length);
   int _flush(FileWriter *h, bool force);
-  int _fsync(FileWriter *h, std::unique_lock<ceph::mutex>& l);
+  int _flush_range_F(FileWriter *h, uint64_t offset, uint64_t length);
+  int _flush_F(FileWriter *h, bool force);
+  int _fsync(FileWriter *h);
 
 #ifdef HAVE_LIBAIO
   void _claim_completed_aios(FileWriter *h, list<aio_t> *ls);
@@ -315,8 +338,11 @@ private:
 #endif
 
   int _flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
-			  uint64_t want_seq = 0,
-			  uint64_t jump_to = 0);
+			  uint64_t want_seq = 0);
+  // caller holds log_lock as well
+  int _flush_and_sync_log_L(std::unique_lock<ceph::mutex>& l,
+			    uint64_t want_seq = 0,
+			    uint64_t jump_to = 0);
   uint64_t _estimate_log_size();
   bool _should_compact_log();
 
@@ -328,6 +354,7 @@ private:
   };
   void _compact_log_dump_metadata(bluefs_transaction_t *t,
 				  int flags);
+  // both of these need log_lock
   void _compact_log_sync();
   void _compact_log_async(std::unique_lock<ceph::mutex>& l);
 
@@ -340,6 +367,7 @@ private:
   //void _aio_finish(void *priv);
 
   void _flush_bdev_safely(FileWriter *h);
+  void _flush_bdev(FileWriter *h);  // caller owns h, not the global lock
   void flush_bdev();  // this is safe to call without a lock
   void flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs);  // this is safe to call without a lock
 
@@ -427,10 +455,7 @@ public:
     FileReader **h,
     bool random = false);
 
-  void close_writer(FileWriter *h) {
-    std::lock_guard l(lock);
-    _close_writer(h);
-  }
+  void close_writer(FileWriter *h);
 
   int rename(const string& old_dir, const string& old_file,
 	     const string& new_dir, const string& new_file);
@@ -478,17 +503,19 @@ public:
   // handler for discard event
   void handle_discard(unsigned dev, interval_set<uint64_t>& to_release);
 
+  // writer ops take the per-writer lock first; the global lock is only
+  // taken (nested inside it) for the metadata updates.
   void flush(FileWriter *h) {
-    std::lock_guard l(lock);
-    _flush(h, false);
+    std::lock_guard hl(h->lock);
+    _flush_F(h, false);
   }
   void flush_range(FileWriter *h, uint64_t offset, uint64_t length) {
-    std::lock_guard l(lock);
-    _flush_range(h, offset, length);
+    std::lock_guard hl(h->lock);
+    _flush_range_F(h, offset, length);
   }
   int fsync(FileWriter *h) {
-    std::unique_lock l(lock);
-    return _fsync(h, l);
+    std::lock_guard hl(h->lock);
+    return _fsync(h);
   }
   int read(FileReader *h, FileReaderBuffer *buf, uint64_t offset, size_t len,
 	   bufferlist *outbl, char *out) {
@@ -513,6 +540,7 @@ public:
     return _preallocate(f, offset, len);
   }
   int truncate(FileWriter *h, uint64_t offset) {
+    std::lock_guard hl(h->lock);
     std::lock_guard l(lock);
     return _truncate(h, offset);
   }
@@ -26,8 +26,10 @@
 #include "include/intarith.h"
 #include "include/stringify.h"
 #include "include/str_map.h"
+#include "include/scope_guard.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
+#include "common/strtol.h"
 #include "common/PriorityCache.h"
 #include "Allocator.h"
 #include "FreelistManager.h"
@@ -73,6 +75,8 @@ const string PREFIX_PGMETA_OMAP = "P"; // u64 + keyname -> value(for meta coll)
 const string PREFIX_DEFERRED = "L";    // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";       // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b";// (see BitmapFreelistManager)
+const string PREFIX_ALLOC_FAST = "F";  // freelist of the fast tier
+const string PREFIX_ALLOC_FAST_BITMAP = "f";
 const string PREFIX_SHARED_BLOB = "X"; // u64 offset -> shared_blob_t
 
 const string BLUESTORE_GLOBAL_STATFS_KEY = "bluestore_statfs";
@@ -801,10 +805,77 @@ BlueStore::Cache *BlueStore::Cache::create(CephContext* cct, string type,
   return c;
 }
 
+BlueStore::Cache::~Cache()
+{
+  if (shard_logger) {
+    cct->get_perfcounters_collection()->remove(shard_logger);
+    delete shard_logger;
+  }
+}
+
+void BlueStore::Cache::init_shard_logger(unsigned id)
+{
+  ceph_assert(!shard_logger);
+  PerfCountersBuilder b(cct, "bluestore-cache-shard-" + stringify(id),
+			l_bluestore_cache_shard_first,
+			l_bluestore_cache_shard_last);
+  b.add_u64(l_bluestore_cache_shard_onodes, "onodes",
+	    "Number of onodes in this shard");
+  b.add_u64(l_bluestore_cache_shard_buffer_bytes, "buffer_bytes",
+	    "Number of buffer bytes in this shard",
+	    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_cache_shard_lock_contended, "lock_contended",
+		    "Number of times the shard lock was found held");
+  b.add_time(l_bluestore_cache_shard_lock_wait, "lock_wait",
+	     "Total time spent waiting for the shard lock");
+  shard_logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(shard_logger);
+}
+
+void BlueStore::Cache::update_shard_logger(uint64_t onodes,
+					   uint64_t buffer_bytes)
+{
+  if (!shard_logger) {
+    return;
+  }
+  shard_logger->set(l_bluestore_cache_shard_onodes, onodes);
+  shard_logger->set(l_bluestore_cache_shard_buffer_bytes, buffer_bytes);
+  shard_logger->set(l_bluestore_cache_shard_lock_contended,
+		    lock.nr_contended);
+  utime_t wait;
+  wait.set_from_double(lock.wait_ns.load() / 1000000000.0);
+  shard_logger->tset(l_bluestore_cache_shard_lock_wait, wait);
+}
+
 void BlueStore::Cache::trim(uint64_t onode_max, uint64_t buffer_max)
 {
-  std::lock_guard l(lock);
-  _trim(onode_max, buffer_max);
+  // trim in bounded batches and drop the lock in between, so that op
+  // threads hashing to this shard never sit behind one long trim.
+  uint64_t onode_batch =
+    cct->_conf.get_val<uint64_t>("bluestore_cache_trim_max_onode_batch");
+  uint64_t buffer_batch =
+    cct->_conf.get_val<Option::size_t>("bluestore_cache_trim_max_buffer_batch");
+  while (true) {
+    std::lock_guard l(lock);
+    uint64_t num_onodes = _get_num_onodes();
+    uint64_t num_bytes = _get_buffer_bytes();
+    if (num_onodes <= onode_max && num_bytes <= buffer_max) {
+      break;
+    }
+    uint64_t onode_target = onode_max;
+    if (onode_batch && num_onodes > onode_max + onode_batch) {
+      onode_target = num_onodes - onode_batch;
+    }
+    uint64_t buffer_target = buffer_max;
+    if (buffer_batch && num_bytes > buffer_max + buffer_batch) {
+      buffer_target = num_bytes - buffer_batch;
+    }
+    _trim(onode_target, buffer_target);
+    if (_get_num_onodes() == num_onodes &&
+	_get_buffer_bytes() == num_bytes) {
+      break;  // everything left is pinned
+    }
+  }
 }
 
 void BlueStore::Cache::trim_all()
@@ -1481,6 +1552,9 @@ void BlueStore::BufferSpace::split(Cache* cache, size_t pos, BlueStore::BufferSp
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o)
 {
+  size_t slot = _get_slot(oid);
+  Cache *cache = caches[slot];
+  auto& onode_map = onode_maps[slot];
   std::lock_guard l(cache->lock);
   auto p = onode_map.find(oid);
   if (p != onode_map.end()) {
@@ -1497,6 +1571,9 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 {
+  size_t slot = _get_slot(oid);
+  Cache *cache = caches[slot];
+  auto& onode_map = onode_maps[slot];
   ldout(cache->cct, 30) << __func__ << dendl;
   OnodeRef o;
   bool hit = false;
@@ -1525,18 +1602,26 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 
 void BlueStore::OnodeSpace::clear()
 {
-  std::lock_guard l(cache->lock);
-  ldout(cache->cct, 10) << __func__ << dendl;
-  for (auto &p : onode_map) {
-    cache->_rm_onode(p.second);
+  for (size_t slot = 0; slot < caches.size(); ++slot) {
+    Cache *cache = caches[slot];
+    std::lock_guard l(cache->lock);
+    ldout(cache->cct, 10) << __func__ << dendl;
+    for (auto &p : onode_maps[slot]) {
+      cache->_rm_onode(p.second);
+    }
+    onode_maps[slot].clear();
   }
-  onode_map.clear();
 }
 
 bool BlueStore::OnodeSpace::empty()
 {
-  std::lock_guard l(cache->lock);
-  return onode_map.empty();
+  for (size_t slot = 0; slot < caches.size(); ++slot) {
+    std::lock_guard l(caches[slot]->lock);
+    if (!onode_maps[slot].empty()) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void BlueStore::OnodeSpace::rename(
@@ -1545,20 +1630,30 @@ void BlueStore::OnodeSpace::rename(
   const ghobject_t& new_oid,
   const mempool::bluestore_cache_other::string& new_okey)
 {
-  std::lock_guard l(cache->lock);
+  size_t old_slot = _get_slot(old_oid);
+  size_t new_slot = _get_slot(new_oid);
+  Cache *cache = caches[old_slot];
+  Cache *new_cache = caches[new_slot];
+  auto& old_map = onode_maps[old_slot];
+  auto& new_map = onode_maps[new_slot];
+
+  // the two oids may live in different lock domains
+  std::lock(cache->lock, new_cache->lock);
+  std::lock_guard l(cache->lock, std::adopt_lock);
+  std::lock_guard l2(new_cache->lock, std::adopt_lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
-  po = onode_map.find(old_oid);
-  pn = onode_map.find(new_oid);
-  ceph_assert(po != pn);
+  ceph_assert(old_oid != new_oid);
+  po = old_map.find(old_oid);
+  pn = new_map.find(new_oid);
 
-  ceph_assert(po != onode_map.end());
-  if (pn != onode_map.end()) {
+  ceph_assert(po != old_map.end());
+  if (pn != new_map.end()) {
     ldout(cache->cct, 30) << __func__ << "  removing target " << pn->second
 			  << dendl;
-    cache->_rm_onode(pn->second);
-    onode_map.erase(pn);
+    new_cache->_rm_onode(pn->second);
+    new_map.erase(pn);
   }
   OnodeRef o = po->second;
 
@@ -1568,19 +1663,27 @@ void BlueStore::OnodeSpace::rename(
   cache->_add_onode(po->second, 1);
 
   // add at new position and fix oid, key
-  onode_map.insert(make_pair(new_oid, o));
-  cache->_touch_onode(o);
+  new_map.insert(make_pair(new_oid, o));
+  if (new_cache == cache) {
+    cache->_touch_onode(o);
+  } else {
+    cache->_rm_onode(o);
+    new_cache->_add_onode(o, 1);
+  }
   o->oid = new_oid;
   o->key = new_okey;
 }
 
 bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 {
-  std::lock_guard l(cache->lock);
-  ldout(cache->cct, 20) << __func__ << dendl;
-  for (auto& i : onode_map) {
-    if (f(i.second)) {
-      return true;
+  for (size_t slot = 0; slot < caches.size(); ++slot) {
+    Cache *cache = caches[slot];
+    std::lock_guard l(cache->lock);
+    ldout(cache->cct, 20) << __func__ << dendl;
+    for (auto& i : onode_maps[slot]) {
+      if (f(i.second)) {
+	return true;
+      }
     }
   }
   return false;
@@ -1589,8 +1692,10 @@ bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 template <int LogLevelV = 30>
 void BlueStore::OnodeSpace::dump(CephContext *cct)
 {
-  for (auto& i : onode_map) {
-    ldout(cct, LogLevelV) << i.first << " : " << i.second << dendl;
+  for (size_t slot = 0; slot < caches.size(); ++slot) {
+    for (auto& i : onode_maps[slot]) {
+      ldout(cct, LogLevelV) << i.first << " : " << i.second << dendl;
+    }
   }
 }
 
@@ -1612,7 +1717,9 @@ ostream& operator<<(ostream& out, const BlueStore::SharedBlob& sb)
 }
 
 BlueStore::SharedBlob::SharedBlob(uint64_t i, Collection *_coll)
-  : coll(_coll), sbid_unloaded(i)
+  : coll(_coll),
+    cache(_coll ? _coll->pick_cache() : nullptr),
+    sbid_unloaded(i)
 {
   ceph_assert(sbid_unloaded > 0);
   if (get_cache()) {
@@ -1635,17 +1742,18 @@ void BlueStore::SharedBlob::put()
 			     << dendl;
   again:
     auto coll_snap = coll;
+    auto cache_snap = cache;
     if (coll_snap) {
-      std::lock_guard l(coll_snap->cache->lock);
-      if (coll_snap != coll) {
+      std::lock_guard l(cache_snap->lock);
+      if (coll_snap != coll || cache_snap != cache) {
 	goto again;
       }
       if (!coll_snap->shared_blob_set.remove(this, true)) {
 	// race with lookup
 	return;
       }
-      bc._clear(coll_snap->cache);
-      coll_snap->cache->rm_blob();
+      bc._clear(cache_snap);
+      cache_snap->rm_blob();
     }
     delete this;
   }
@@ -1669,16 +1777,16 @@ void BlueStore::SharedBlob::put_ref(uint64_t offset, uint32_t length,
 void BlueStore::SharedBlob::finish_write(uint64_t seq)
 {
   while (true) {
-    Cache *cache = coll->cache;
-    std::lock_guard l(cache->lock);
-    if (coll->cache != cache) {
+    Cache *cache_snap = cache;
+    std::lock_guard l(cache_snap->lock);
+    if (cache != cache_snap) {
       ldout(coll->store->cct, 20) << __func__
-				  << " raced with sb cache update, was " << cache
-				  << ", now " << coll->cache << ", retrying"
-				  << dendl;
+				  << " raced with sb cache update, was "
+				  << cache_snap << ", now " << cache
+				  << ", retrying" << dendl;
       continue;
     }
-    bc._finish_write(cache, seq);
+    bc._finish_write(cache_snap, seq);
     break;
   }
 }
@@ -3053,6 +3161,37 @@ BlueStore::BlobRef BlueStore::ExtentMap::split_blob(
 #undef dout_prefix
 #define dout_prefix *_dout << "bluestore.onode(" << this << ")." << __func__ << " "
 
+BlueStore::Onode* BlueStore::Onode::decode(
+  Collection *c,
+  const ghobject_t& oid,
+  const mempool::bluestore_cache_other::string& key,
+  const bufferlist& v)
+{
+  Onode *on = new Onode(c, oid, key);
+  on->exists = true;
+  auto p = v.front().begin_deep();
+  on->onode.decode(p);
+  for (auto& i : on->onode.attrs) {
+    i.second.reassign_to_mempool(mempool::mempool_bluestore_cache_other);
+  }
+  if (on->onode.has_inline_data()) {
+    on->onode.inline_data.reassign_to_mempool(
+      mempool::mempool_bluestore_cache_other);
+  }
+
+  // initialize extent_map
+  on->extent_map.decode_spanning_blobs(p);
+  if (on->onode.extent_map_shards.empty()) {
+    denc(on->extent_map.inline_bl, p);
+    on->extent_map.decode_some(on->extent_map.inline_bl);
+    on->extent_map.inline_bl.reassign_to_mempool(
+      mempool::mempool_bluestore_cache_other);
+  } else {
+    on->extent_map.init_shards(false, false);
+  }
+  return on;
+}
+
 void BlueStore::Onode::flush()
 {
   if (flushing_count.load()) {
@@ -3205,10 +3344,13 @@ void BlueStore::DeferredBatch::_audit(CephContext *cct)
 #undef dout_prefix
 #define dout_prefix *_dout << "bluestore(" << store->path << ").collection(" << cid << " " << this << ") "
 
-BlueStore::Collection::Collection(BlueStore *store_, Cache *c, coll_t cid)
+BlueStore::Collection::Collection(BlueStore *store_,
+				  const vector<Cache*>& c,
+				  coll_t cid)
   : CollectionImpl(cid),
     store(store_),
-    cache(c),
+    cache(c.front()),
+    caches(c),
     lock("BlueStore::Collection::lock", true, false),
     exists(true),
     onode_map(c),
@@ -3355,63 +3497,104 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   } else {
     // loaded
     ceph_assert(r >= 0);
-    on = new Onode(this, oid, key);
-    on->exists = true;
-    auto p = v.front().begin_deep();
-    on->onode.decode(p);
-    for (auto& i : on->onode.attrs) {
-      i.second.reassign_to_mempool(mempool::mempool_bluestore_cache_other);
-    }
-
-    // initialize extent_map
-    on->extent_map.decode_spanning_blobs(p);
-    if (on->onode.extent_map_shards.empty()) {
-      denc(on->extent_map.inline_bl, p);
-      on->extent_map.decode_some(on->extent_map.inline_bl);
-      on->extent_map.inline_bl.reassign_to_mempool(
-	mempool::mempool_bluestore_cache_other);
-    } else {
-      on->extent_map.init_shards(false, false);
-    }
+    on = Onode::decode(this, oid, key, v);
   }
   o.reset(on);
   return onode_map.add(oid, o);
 }
 
+void BlueStore::Collection::get_onodes(
+  const vector<ghobject_t>& oids,
+  vector<OnodeRef> *onodes)
+{
+  ceph_assert(lock.is_locked());
+
+  spg_t pgid;
+  bool is_pg = cid.is_pg(&pgid);
+  onodes->resize(oids.size());
+  std::set<string> keys;
+  vector<pair<size_t, mempool::bluestore_cache_other::string>> missing;
+  for (size_t i = 0; i < oids.size(); ++i) {
+    if (is_pg && !oids[i].match(cnode.bits, pgid.ps())) {
+      lderr(store->cct) << __func__ << " oid " << oids[i] << " not part of "
+			<< pgid << " bits " << cnode.bits << dendl;
+      ceph_abort();
+    }
+    (*onodes)[i] = onode_map.lookup(oids[i]);
+    if (!(*onodes)[i]) {
+      missing.emplace_back(i, mempool::bluestore_cache_other::string());
+      get_object_key(store->cct, oids[i], &missing.back().second);
+      keys.insert(string(missing.back().second.c_str(),
+			 missing.back().second.size()));
+    }
+  }
+  if (missing.empty()) {
+    return;
+  }
+
+  std::map<string, bufferlist> values;
+  store->db->get(PREFIX_OBJ, keys, &values);
+  ldout(store->cct, 20) << __func__ << " " << oids.size() << " oids, "
+			<< missing.size() << " uncached, " << values.size()
+			<< " found" << dendl;
+  for (auto& [i, key] : missing) {
+    auto p = values.find(string(key.c_str(), key.size()));
+    if (p == values.end()) {
+      // does not exist; leave it null, as get_onode(oid, false) would
+      continue;
+    }
+    OnodeRef o(Onode::decode(this, oids[i], key, p->second));
+    (*onodes)[i] = onode_map.add(oids[i], o);
+  }
+}
+
 void BlueStore::Collection::split_cache(
   Collection *dest)
 {
   ldout(store->cct, 10) << __func__ << " to " << dest << dendl;
 
-  // lock (one or both) cache shards
-  std::lock(cache->lock, dest->cache->lock);
-  std::lock_guard l(cache->lock, std::adopt_lock);
-  std::lock_guard l2(dest->cache->lock, std::adopt_lock);
+  // lock every cache shard either collection uses, in address order
+  vector<Cache*> shards(caches);
+  shards.insert(shards.end(), dest->caches.begin(), dest->caches.end());
+  std::sort(shards.begin(), shards.end());
+  shards.erase(std::unique(shards.begin(), shards.end()), shards.end());
+  for (auto c : shards) {
+    c->lock.lock();
+  }
+  auto unlock_shards = make_scope_guard([&shards] {
+    for (auto c : shards) {
+      c->lock.unlock();
+    }
+  });
 
   int destbits = dest->cnode.bits;
   spg_t destpg;
   bool is_pg = dest->cid.is_pg(&destpg);
   ceph_assert(is_pg);
 
-  auto p = onode_map.onode_map.begin();
-  while (p != onode_map.onode_map.end()) {
-    OnodeRef o = p->second;
-    if (!p->second->oid.match(destbits, destpg.pgid.ps())) {
-      // onode does not belong to this child
-      ldout(store->cct, 20) << __func__ << " not moving " << o << " " << o->oid
-			    << dendl;
-      ++p;
-    } else {
+  for (size_t slot = 0; slot < caches.size(); ++slot) {
+    Cache *src_cache = onode_map.caches[slot];
+    auto& src_map = onode_map.onode_maps[slot];
+    auto p = src_map.begin();
+    while (p != src_map.end()) {
+      OnodeRef o = p->second;
+      if (!p->second->oid.match(destbits, destpg.pgid.ps())) {
+	// onode does not belong to this child
+	ldout(store->cct, 20) << __func__ << " not moving " << o << " "
+			      << o->oid << dendl;
+	++p;
+	continue;
+      }
       ldout(store->cct, 20) << __func__ << " moving " << o << " " << o->oid
 			    << dendl;
 
-      cache->_rm_onode(p->second);
-      p = onode_map.onode_map.erase(p);
+      src_cache->_rm_onode(p->second);
+      p = src_map.erase(p);
 
+      size_t dest_slot = dest->onode_map._get_slot(o->oid);
       o->c = dest;
-      dest->cache->_add_onode(o, 1);
-      dest->onode_map.onode_map[o->oid] = o;
-      dest->onode_map.cache = dest->cache;
+      dest->onode_map.caches[dest_slot]->_add_onode(o, 1);
+      dest->onode_map.onode_maps[dest_slot][o->oid] = o;
 
       // move over shared blobs and buffers.  cover shared blobs from
       // both extent map and spanning blob map (the full extent map
@@ -3437,14 +3620,17 @@ void BlueStore::Collection::split_cache(
 	  dest->shared_blob_set.add(dest, sb);
 	}
 	sb->coll = dest;
-	if (dest->cache != cache) {
+	if (std::find(dest->caches.begin(), dest->caches.end(), sb->cache) ==
+	    dest->caches.end()) {
+	  Cache *dest_cache = dest->pick_cache();
 	  for (auto& i : sb->bc.buffer_map) {
 	    if (!i.second->is_writing()) {
 	      ldout(store->cct, 20) << __func__ << "   moving " << *i.second
 				    << dendl;
-	      dest->cache->_move_buffer(cache, i.second.get());
+	      dest_cache->_move_buffer(sb->cache, i.second.get());
 	    }
 	  }
+	  sb->cache = dest_cache;
 	}
       }
     }
@@ -3474,6 +3660,10 @@ void *BlueStore::MempoolThread::entry()
 
   utime_t next_balance = ceph_clock_now();
   utime_t next_resize = ceph_clock_now();
+  // don't checkpoint right away; the cache is still cold after mount
+  utime_t next_warmup_checkpoint = ceph_clock_now();
+  next_warmup_checkpoint += store->cct->_conf.get_val<double>(
+    "bluestore_onode_warmup_checkpoint_interval");
 
   bool interval_stats_trim = false;
   bool interval_stats_resize = false; 
@@ -3508,6 +3698,15 @@ void *BlueStore::MempoolThread::entry()
     _trim_shards(interval_stats_trim);
     interval_stats_trim = false;
 
+    double checkpoint_interval = store->cct->_conf.get_val<double>(
+      "bluestore_onode_warmup_checkpoint_interval");
+    if (checkpoint_interval > 0 && store->mounted &&
+	next_warmup_checkpoint < ceph_clock_now()) {
+      store->_write_onode_warmup();
+      next_warmup_checkpoint = ceph_clock_now();
+      next_warmup_checkpoint += checkpoint_interval;
+    }
+
     store->_update_cache_logger();
     auto wait = ceph::make_timespan(
       store->cct->_conf->bluestore_cache_trim_interval);
@@ -3873,6 +4072,65 @@ void BlueStore::handle_discard(interval_set<uint64_t>& to_release)
   alloc->release(to_release);
 }
 
+/// coarse clock for onode access stamps, in seconds
+static uint32_t tier_clock_now()
+{
+  return std::chrono::duration_cast<std::chrono::seconds>(
+    ceph::coarse_mono_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+// put small writes and hot objects on the fast tier while it has room;
+// demote anything that is not hot once it has been left alone for a while,
+// or right away when the tier is running out of space.
+class DefaultTierPolicy : public BlueStore::TierPolicy {
+  CephContext *cct;
+
+  uint32_t heat(const BlueStore::Onode& o, uint32_t now) const {
+    return o.get_tier_heat(
+      now, cct->_conf.get_val<uint64_t>("bluestore_fast_tier_heat_half_life"));
+  }
+  bool short_of_space(uint64_t free, uint64_t total) const {
+    return free < total *
+      cct->_conf.get_val<double>("bluestore_fast_tier_min_free_ratio");
+  }
+
+public:
+  explicit DefaultTierPolicy(CephContext *cct) : cct(cct) {}
+
+  bool should_promote(const BlueStore::Onode& o, uint64_t need,
+		      uint64_t fast_free, uint64_t fast_total) override {
+    if (need > fast_free || short_of_space(fast_free - need, fast_total)) {
+      return false;
+    }
+    if (need <= cct->_conf.get_val<Option::size_t>(
+	  "bluestore_fast_tier_max_write")) {
+      return true;
+    }
+    return heat(o, tier_clock_now()) >=
+      cct->_conf.get_val<uint64_t>("bluestore_fast_tier_hot_reads");
+  }
+
+  bool should_demote(const BlueStore::Onode& o,
+		     uint64_t fast_free, uint64_t fast_total) override {
+    uint32_t now = tier_clock_now();
+    if (heat(o, now) >=
+	cct->_conf.get_val<uint64_t>("bluestore_fast_tier_hot_reads")) {
+      return false;
+    }
+    if (short_of_space(fast_free, fast_total)) {
+      return true;
+    }
+    uint32_t stamp = o.tier_stamp;
+    return now > stamp &&
+      now - stamp >=
+        cct->_conf.get_val<uint64_t>("bluestore_fast_tier_demote_age");
+  }
+};
+
+} // anonymous namespace
+
 BlueStore::BlueStore(CephContext *cct, const string& path)
   : ObjectStore(cct, path),
     throttle_bytes(cct, "bluestore_throttle_bytes",
@@ -3884,8 +4142,11 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
-    mempool_thread(this)
+    mempool_thread(this),
+    onode_warmup_thread(this),
+    tier_thread(this)
 {
+  tier_policy.reset(new DefaultTierPolicy(cct));
   _init_logger();
   cct->_conf.add_observer(this);
   set_cache_shards(1);
@@ -3906,8 +4167,11 @@ BlueStore::BlueStore(CephContext *cct,
     kv_finalize_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(ctz(_min_alloc_size)),
-    mempool_thread(this)
+    mempool_thread(this),
+    onode_warmup_thread(this),
+    tier_thread(this)
 {
+  tier_policy.reset(new DefaultTierPolicy(cct));
   _init_logger();
   cct->_conf.add_observer(this);
   set_cache_shards(1);
@@ -3956,6 +4220,8 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_max_blob_size",
     "bluestore_max_blob_size_ssd",
     "bluestore_max_blob_size_hdd",
+    "bluestore_fast_tier_heat_half_life",
+    "bluestore_inline_data_max",
     NULL
   };
   return KEYS;
@@ -3967,6 +4233,10 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("bluestore_csum_type")) {
     _set_csum();
   }
+  if (changed.count("bluestore_fast_tier_heat_half_life")) {
+    tier_heat_half_life =
+      conf.get_val<uint64_t>("bluestore_fast_tier_heat_half_life");
+  }
   if (changed.count("bluestore_compression_mode") ||
       changed.count("bluestore_compression_algorithm") ||
       changed.count("bluestore_compression_min_blob_size") ||
@@ -3977,7 +4247,8 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
   }
   if (changed.count("bluestore_max_blob_size") ||
       changed.count("bluestore_max_blob_size_ssd") ||
-      changed.count("bluestore_max_blob_size_hdd")) {
+      changed.count("bluestore_max_blob_size_hdd") ||
+      changed.count("bluestore_inline_data_max")) {
     if (bdev) {
       // only after startup
       _set_blob_size();
@@ -4117,7 +4388,10 @@ void BlueStore::_set_blob_size()
       max_blob_size = cct->_conf->bluestore_max_blob_size_ssd;
     }
   }
+  inline_data_max =
+    cct->_conf.get_val<Option::size_t>("bluestore_inline_data_max");
   dout(10) << __func__ << " max_blob_size 0x" << std::hex << max_blob_size
+	   << " inline_data_max 0x" << inline_data_max
            << std::dec << dendl;
 }
 
@@ -4267,6 +4541,17 @@ void BlueStore::_init_logger()
     "Average read onode metadata latency");
   b.add_time_avg(l_bluestore_read_wait_aio_lat, "read_wait_aio_lat",
     "Average read latency");
+  b.add_time_avg(l_bluestore_read_multi_lat, "read_multi_lat",
+    "Average batched (read_multi) read latency");
+  b.add_u64_counter(l_bluestore_read_multi_ops, "read_multi_ops",
+    "Objects read through read_multi");
+  b.add_time_avg(l_bluestore_digest_lat, "digest_lat",
+    "Average store-side (deep scrub) digest latency");
+  b.add_u64_counter(l_bluestore_digest_bytes, "digest_bytes",
+    "Bytes digested in the store", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_digest_csum_bytes, "digest_csum_bytes",
+    "Digested bytes whose crc came from blob checksums", NULL, 0,
+    unit_t(UNIT_BYTES));
   b.add_time_avg(l_bluestore_compress_lat, "compress_lat",
     "Average compress latency");
   b.add_time_avg(l_bluestore_decompress_lat, "decompress_lat",
@@ -4342,6 +4627,12 @@ void BlueStore::_init_logger()
 		    "cached) to fill out the block");
   b.add_u64_counter(l_bluestore_write_small_new, "bluestore_write_small_new",
 		    "Small write into new (sparse) blob");
+  b.add_u64_counter(l_bluestore_write_inline, "bluestore_write_inline",
+		    "Writes stored inline in the onode");
+  b.add_u64_counter(l_bluestore_write_inline_bytes, "bluestore_write_inline_bytes",
+		    "Writes stored inline in the onode (bytes)", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_inline_spill, "bluestore_inline_spill",
+		    "Objects moved from inline data to blobs");
 
   b.add_u64_counter(l_bluestore_txc, "bluestore_txc", "Transactions committed");
   b.add_u64_counter(l_bluestore_onode_reshard, "bluestore_onode_reshard",
@@ -4357,6 +4648,33 @@ void BlueStore::_init_logger()
                     "Read EIO errors propagated to high level callers");
   b.add_u64_counter(l_bluestore_reads_with_retries, "bluestore_reads_with_retries",
                     "Read operations that required at least one retry due to failed checksum validation");
+  b.add_u64_counter(l_bluestore_onode_warmup_loaded, "onode_warmup_loaded",
+		    "Onodes prefetched into the cache after mount");
+  b.add_u64_counter(l_bluestore_onode_warmup_skipped, "onode_warmup_skipped",
+		    "Recorded onodes which no longer exist");
+  b.add_u64_counter(l_bluestore_onode_warmup_bytes, "onode_warmup_bytes",
+		    "Data bytes prefetched into the cache after mount",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_onode_warmup_pending, "onode_warmup_pending",
+	    "Recorded onodes still to be prefetched");
+  b.add_u64_counter(l_bluestore_tier_fast_read_bytes, "tier_fast_read_bytes",
+		    "Data bytes read from the fast tier",
+		    "tfrd", PerfCountersBuilder::PRIO_INTERESTING,
+		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_tier_slow_read_bytes, "tier_slow_read_bytes",
+		    "Data bytes read from the main device",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_tier_fast_alloc_bytes, "tier_fast_alloc_bytes",
+		    "Bytes allocated on the fast tier",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_tier_fast_full, "tier_fast_full",
+		    "Fast tier allocations which fell back to the main device");
+  b.add_u64_counter(l_bluestore_tier_demoted_bytes, "tier_demoted_bytes",
+		    "Data bytes moved from the fast tier to the main device",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_tier_fast_free, "tier_fast_free",
+	    "Free space on the fast tier",
+	    NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64(l_bluestore_fragmentation, "bluestore_fragmentation_micros",
             "How fragmented bluestore free space is (free extents / max possible number of free extents) * 1000");
   logger = b.create_perf_counters();
@@ -4629,6 +4947,162 @@ void BlueStore::_close_bdev()
   bdev = NULL;
 }
 
+// The fast tier device runs its own aio thread, and a device only flushes
+// what its own thread has reaped, so IO to the fast tier never joins the
+// main device's aio batches.  The tier is flash and, by construction, holds
+// small extents, so plain synchronous IO does fine there.
+
+int BlueStore::_bdev_read(uint64_t off, uint64_t len, bufferlist *pbl,
+			  IOContext *ioc)
+{
+  BlockDevice *d = _get_bdev(&off);
+  logger->inc(d != bdev ? l_bluestore_tier_fast_read_bytes :
+	      l_bluestore_tier_slow_read_bytes, len);
+  return d->read(off, len, pbl, ioc, false);
+}
+
+int BlueStore::_bdev_aio_read(uint64_t off, uint64_t len, bufferlist *pbl,
+			      IOContext *ioc)
+{
+  BlockDevice *d = _get_bdev(&off);
+  if (d != bdev) {
+    logger->inc(l_bluestore_tier_fast_read_bytes, len);
+    return d->read(off, len, pbl, ioc, false);
+  }
+  logger->inc(l_bluestore_tier_slow_read_bytes, len);
+  return d->aio_read(off, len, pbl, ioc);
+}
+
+int BlueStore::_bdev_aio_write(uint64_t off, bufferlist& bl, IOContext *ioc,
+			       bool buffered)
+{
+  BlockDevice *d = _get_bdev(&off);
+  if (d != bdev) {
+    return d->write(off, bl, buffered);
+  }
+  return d->aio_write(off, bl, ioc, buffered);
+}
+
+int BlueStore::_bdev_write(uint64_t off, bufferlist& bl, bool buffered)
+{
+  BlockDevice *d = _get_bdev(&off);
+  return d->write(off, bl, buffered);
+}
+
+int BlueStore::_read_fast_tier_meta()
+{
+  fast_tier_offset = fast_tier_size = 0;
+  string s;
+  int r = read_meta("fast_tier_size", &s);
+  if (r < 0) {
+    return 0;  // no fast tier
+  }
+  string err;
+  fast_tier_size = strict_strtoll(s.c_str(), 10, &err);
+  if (!err.empty()) {
+    derr << __func__ << " bad fast_tier_size '" << s << "': " << err << dendl;
+    return -EIO;
+  }
+  if (!fast_tier_size) {
+    return 0;
+  }
+  r = read_meta("fast_tier_offset", &s);
+  if (r < 0) {
+    derr << __func__ << " fast_tier_size is set but fast_tier_offset is not"
+	 << dendl;
+    return -EIO;
+  }
+  fast_tier_offset = strict_strtoll(s.c_str(), 10, &err);
+  if (!err.empty()) {
+    derr << __func__ << " bad fast_tier_offset '" << s << "': " << err << dendl;
+    return -EIO;
+  }
+  return 0;
+}
+
+bool BlueStore::_has_fast_tier()
+{
+  string s;
+  return read_meta("fast_tier_size", &s) == 0 && s != "0";
+}
+
+int BlueStore::_open_fast_tier()
+{
+  ceph_assert(fast_bdev == nullptr);
+  ceph_assert(fast_alloc == nullptr);
+  ceph_assert(fast_fm);
+  string p = path + "/block.db";
+  // bluefs owns the rest of the device, and its label
+  fast_bdev = BlockDevice::create(cct, p, aio_cb, static_cast<void*>(this),
+				  nullptr, nullptr);
+  fast_bdev->set_no_exclusive_lock();
+  int r = fast_bdev->open(p);
+  if (r < 0) {
+    derr << __func__ << " failed to open " << p << ": " << cpp_strerror(r)
+	 << dendl;
+    delete fast_bdev;
+    fast_bdev = nullptr;
+    return r;
+  }
+  if (fast_tier_offset + fast_tier_size > fast_bdev->get_size()) {
+    derr << __func__ << " fast tier 0x" << std::hex << fast_tier_offset
+	 << "~" << fast_tier_size << " is past the end of " << p
+	 << " (0x" << fast_bdev->get_size() << ")" << std::dec << dendl;
+    _close_fast_tier();
+    return -EINVAL;
+  }
+
+  fast_alloc = Allocator::create(cct, cct->_conf->bluestore_allocator,
+				 fast_tier_size, min_alloc_size);
+  if (!fast_alloc) {
+    _close_fast_tier();
+    return -EINVAL;
+  }
+  uint64_t num = 0, bytes = 0;
+  uint64_t offset, length;
+  fast_fm->enumerate_reset();
+  while (fast_fm->enumerate_next(db, &offset, &length)) {
+    fast_alloc->init_add_free(offset, length);
+    ++num;
+    bytes += length;
+  }
+  fast_fm->enumerate_reset();
+  logger->set(l_bluestore_tier_fast_free, fast_alloc->get_free());
+  tier_heat_half_life =
+    cct->_conf.get_val<uint64_t>("bluestore_fast_tier_heat_half_life");
+  dout(1) << __func__ << " " << p << " 0x" << std::hex << fast_tier_offset
+	  << "~" << fast_tier_size << std::dec << ", " << byte_u_t(bytes)
+	  << " free in " << num << " extents" << dendl;
+  return 0;
+}
+
+void BlueStore::_close_fast_tier()
+{
+  if (fast_alloc) {
+    fast_alloc->shutdown();
+    delete fast_alloc;
+    fast_alloc = nullptr;
+  }
+  if (fast_bdev) {
+    fast_bdev->close();
+    delete fast_bdev;
+    fast_bdev = nullptr;
+  }
+}
+
+void BlueStore::_split_fast_tier(const interval_set<uint64_t>& s,
+				 interval_set<uint64_t> *main,
+				 interval_set<uint64_t> *fast)
+{
+  for (auto p = s.begin(); p != s.end(); ++p) {
+    if (_is_fast_tier(p.get_start())) {
+      fast->insert(p.get_start() - FAST_TIER_BASE, p.get_len());
+    } else {
+      main->insert(p.get_start(), p.get_len());
+    }
+  }
+}
+
 int BlueStore::_open_fm(KeyValueDB::Transaction t)
 {
   ceph_assert(fm == NULL);
@@ -4711,6 +5185,29 @@ int BlueStore::_open_fm(KeyValueDB::Transaction t)
     fm = NULL;
     return r;
   }
+
+  // at mkfs the fast tier has been carved out by _minimal_open_bluefs()
+  if (!t) {
+    r = _read_fast_tier_meta();
+    if (r < 0) {
+      _close_fm();
+      return r;
+    }
+  }
+  if (fast_tier_size) {
+    fast_fm = FreelistManager::create(cct, freelist_type, PREFIX_ALLOC_FAST);
+    ceph_assert(fast_fm);
+    if (t) {
+      fast_fm->create(fast_tier_size, (int64_t)min_alloc_size, t);
+    }
+    r = fast_fm->init(db);
+    if (r < 0) {
+      derr << __func__ << " fast tier freelist init failed: "
+	   << cpp_strerror(r) << dendl;
+      _close_fm();
+      return r;
+    }
+  }
   return 0;
 }
 
@@ -4721,6 +5218,12 @@ void BlueStore::_close_fm()
   fm->shutdown();
   delete fm;
   fm = NULL;
+  if (fast_fm) {
+    fast_fm->shutdown();
+    delete fast_fm;
+    fast_fm = nullptr;
+  }
+  fast_tier_offset = fast_tier_size = 0;
 }
 
 int BlueStore::_open_alloc()
@@ -4773,6 +5276,15 @@ int BlueStore::_open_alloc()
     alloc->init_rm_free(e.get_start(), e.get_len());
   }
 
+  if (fast_fm) {
+    int r = _open_fast_tier();
+    if (r < 0) {
+      alloc->shutdown();
+      delete alloc;
+      alloc = NULL;
+      return r;
+    }
+  }
   return 0;
 }
 
@@ -4781,6 +5293,7 @@ void BlueStore::_close_alloc()
   ceph_assert(bdev);
   bdev->discard_drain();
 
+  _close_fast_tier();
   ceph_assert(alloc);
   alloc->shutdown();
   delete alloc;
@@ -4964,10 +5477,28 @@ int BlueStore::_minimal_open_bluefs(bool create)
       }
     }
     if (create) {
+      uint64_t db_size = bluefs->get_block_device_size(BlueFS::BDEV_DB);
+      uint64_t bluefs_end = db_size;
+      uint64_t want =
+	cct->_conf.get_val<Option::size_t>("bluestore_fast_tier_size");
+      if (want) {
+	// the fast tier takes the end of the device, bluefs the rest
+	want = std::min(want, db_size / 2);
+	uint64_t start = p2roundup(db_size - want,
+				   (uint64_t)cct->_conf->bluefs_alloc_size);
+	uint64_t len = p2align(db_size - start, (uint64_t)min_alloc_size);
+	if (len) {
+	  fast_tier_offset = start;
+	  fast_tier_size = len;
+	  bluefs_end = start;
+	  dout(1) << __func__ << " fast tier 0x" << std::hex << start << "~"
+		  << len << std::dec << " on " << bfn << dendl;
+	}
+      }
       bluefs->add_block_extent(
 	BlueFS::BDEV_DB,
 	SUPER_RESERVED,
-	bluefs->get_block_device_size(BlueFS::BDEV_DB) - SUPER_RESERVED);
+	bluefs_end - SUPER_RESERVED);
     }
     bluefs_shared_bdev = BlueFS::BDEV_SLOW;
     bluefs_single_shared_device = false;
@@ -5390,14 +5921,16 @@ int BlueStore::_open_db(bool create, bool to_repair_db, bool read_only)
   if (kv_backend == "rocksdb") {
     options = cct->_conf->bluestore_rocksdb_options;
 
-    map<string,string> cf_map;
-    cct->_conf.with_val<string>("bluestore_rocksdb_cfs",
-                                 get_str_map,
-                                 &cf_map,
-                                 " \t");
-    for (auto& i : cf_map) {
-      dout(10) << "column family " << i.first << ": " << i.second << dendl;
-      cfs.push_back(KeyValueDB::ColumnFamily(i.first, i.second));
+    r = KeyValueDB::parse_column_families(
+      cct->_conf.get_val<string>("bluestore_rocksdb_cfs"), &cfs, &err);
+    if (r < 0) {
+      derr << __func__ << " bad bluestore_rocksdb_cfs: " << err.str() << dendl;
+      _close_db();
+      return r;
+    }
+    for (auto& i : cfs) {
+      dout(10) << "column family " << i.name << " shards " << i.shard_cnt
+	       << ": " << i.option << dendl;
     }
   }
 
@@ -5637,7 +6170,7 @@ int BlueStore::_open_collections(int *errors)
       CollectionRef c(
 	new Collection(
 	  this,
-	  cache_shards[cid.hash_to_shard(cache_shards.size())],
+	  _get_collection_caches(cid),
 	  cid));
       bufferlist bl = it->value();
       auto p = bl.cbegin();
@@ -5954,6 +6487,15 @@ int BlueStore::mkfs()
   if (r < 0)
     goto out_close_fm;
 
+  if (fast_tier_size) {
+    r = write_meta("fast_tier_offset", stringify(fast_tier_offset));
+    if (r < 0)
+      goto out_close_fm;
+  }
+  r = write_meta("fast_tier_size", stringify(fast_tier_size));
+  if (r < 0)
+    goto out_close_fm;
+
   if (fsid != old_fsid) {
     r = _write_fsid();
     if (r < 0) {
@@ -6115,6 +6657,11 @@ int BlueStore::migrate_to_existing_bluefs_device(const set<int>& devs_source,
     derr << __func__ << " bluefs isn't configured, can't add new device " << dendl;
     return -EIO;
   }
+  if (devs_source.count(BlueFS::BDEV_DB) && _has_fast_tier()) {
+    derr << __func__ << " block.db holds the fast data tier, can't migrate it"
+	 << dendl;
+    return -EBUSY;
+  }
 
   int r = _mount_for_bluefs();
 
@@ -6187,6 +6734,11 @@ int BlueStore::migrate_to_new_bluefs_device(const set<int>& devs_source,
     derr << __func__ << " bluefs isn't configured, can't add new device " << dendl;
     return -EIO;
   }
+  if (devs_source.count(BlueFS::BDEV_DB) && _has_fast_tier()) {
+    derr << __func__ << " block.db holds the fast data tier, can't migrate it"
+	 << dendl;
+    return -EBUSY;
+  }
 
   r = _mount_for_bluefs();
 
@@ -6306,11 +6858,26 @@ int BlueStore::expand_devices(ostream& out)
     if (devid == bluefs_shared_bdev ) {
       continue;
     }
+    uint64_t size = bluefs->get_block_device_size(devid);
+    if (size == 0) {
+      // no bdev
+      continue;
+    }
     interval_set<uint64_t> before;
     bluefs->get_block_extents(devid, &before);
     ceph_assert(!before.empty());
     uint64_t end = before.range_end();
-    uint64_t size = bluefs->get_block_device_size(devid);
+    if (devid == BlueFS::BDEV_DB && fast_tier_size) {
+      // bluefs' space ends where the fast tier starts, so end~size would
+      // hand it the tier; the tier itself is sized at mkfs
+      if (end < size) {
+	out << devid
+	    << " : holds the fast data tier at 0x" << std::hex
+	    << fast_tier_offset << "~" << fast_tier_size << std::dec
+	    << ", not expanding" << std::endl;
+      }
+      continue;
+    }
     if (end < size) {
       out << devid
 	  <<" : expanding " << " from 0x" << std::hex
@@ -6389,7 +6956,21 @@ void BlueStore::set_cache_shards(unsigned num)
   for (unsigned i = old; i < num; ++i) {
     cache_shards[i] = Cache::create(cct, cct->_conf->bluestore_cache_type,
 				    logger);
+    cache_shards[i]->init_shard_logger(i);
+  }
+}
+
+vector<BlueStore::Cache*> BlueStore::_get_collection_caches(const coll_t& cid)
+{
+  size_t num = cache_shards.size();
+  size_t n = std::min<size_t>(
+    num, cct->_conf.get_val<uint64_t>("bluestore_cache_collection_shards"));
+  size_t first = cid.hash_to_shard(num);
+  vector<Cache*> caches(n);
+  for (size_t i = 0; i < n; ++i) {
+    caches[i] = cache_shards[(first + i) % num];
   }
+  return caches;
 }
 
 int BlueStore::_mount(bool kv_only, bool open_db)
@@ -6477,6 +7058,8 @@ int BlueStore::_mount(bool kv_only, bool open_db)
   mempool_thread.init();
 
   mounted = true;
+  _onode_warmup_start();
+  _tier_start();
   return 0;
 
  out_stop:
@@ -6499,6 +7082,10 @@ int BlueStore::umount()
   ceph_assert(_kv_only || mounted);
   dout(1) << __func__ << dendl;
 
+  if (!_kv_only) {
+    _onode_warmup_stop();
+    _tier_stop();
+  }
   _osr_drain_all();
 
   mounted = false;
@@ -6506,6 +7093,7 @@ int BlueStore::umount()
     mempool_thread.shutdown();
     dout(20) << __func__ << " stopping kv thread" << dendl;
     _kv_stop();
+    _write_onode_warmup();
     _flush_cache();
     dout(20) << __func__ << " closing" << dendl;
 
@@ -6527,44 +7115,617 @@ int BlueStore::umount()
   return 0;
 }
 
-static void apply(uint64_t off,
-                  uint64_t len,
-                  uint64_t granularity,
-                  BlueStore::mempool_dynamic_bitset &bitset,
-                  std::function<void(uint64_t,
-				     BlueStore::mempool_dynamic_bitset &)> f) {
-  auto end = round_up_to(off + len, granularity);
-  while (off < end) {
-    uint64_t pos = off / granularity;
-    f(pos, bitset);
-    off += granularity;
-  }
-}
+// onode cache warm-up
 
-int BlueStore::_fsck_check_extents(
-  const coll_t& cid,
-  const ghobject_t& oid,
-  const PExtentVector& extents,
-  bool compressed,
-  mempool_dynamic_bitset &used_blocks,
-  uint64_t granularity,
-  BlueStoreRepairer* repairer,
-  store_statfs_t& expected_statfs)
+#define ONODE_WARMUP_DIR "bluestore"
+#define ONODE_WARMUP_FILE "onode_warmup"
+
+int BlueStore::_write_onode_warmup()
 {
-  dout(30) << __func__ << " oid " << oid << " extents " << extents << dendl;
-  int errors = 0;
-  for (auto e : extents) {
-    if (!e.is_valid())
-      continue;
-    expected_statfs.allocated += e.length;
-    if (compressed) {
-      expected_statfs.data_compressed_allocated += e.length;
+  if (!bluefs || !cct->_conf.get_val<bool>("bluestore_onode_warmup")) {
+    return 0;
+  }
+  uint64_t max =
+    cct->_conf.get_val<uint64_t>("bluestore_onode_warmup_max_onodes");
+  if (!max) {
+    return 0;
+  }
+  utime_t start = ceph_clock_now();
+
+  // take the hottest onodes of every shard, and interleave them so that a
+  // partial warm-up still covers the hottest objects of all shards.
+  vector<vector<onode_warmup_item_t>> per_shard(cache_shards.size());
+  size_t shard_max = std::max<size_t>(1, max / cache_shards.size());
+  for (size_t n = 0; n < cache_shards.size(); ++n) {
+    Cache *cache = cache_shards[n];
+    std::lock_guard l(cache->lock);
+    vector<Onode*> hot;
+    cache->_get_hot_onodes(shard_max, &hot);
+    for (auto o : hot) {
+      if (!o->exists) {
+	continue;
+      }
+      per_shard[n].emplace_back();
+      per_shard[n].back().cid = o->c->cid;
+      per_shard[n].back().oid = o->oid;
     }
-    bool already = false;
-    apply(
-      e.offset, e.length, granularity, used_blocks,
-      [&](uint64_t pos, mempool_dynamic_bitset &bs) {
-	ceph_assert(pos < bs.size());
+  }
+  vector<onode_warmup_item_t> items;
+  for (size_t rank = 0; items.size() < max; ++rank) {
+    bool any = false;
+    for (auto& v : per_shard) {
+      if (rank < v.size()) {
+	items.push_back(std::move(v[rank]));
+	any = true;
+      }
+    }
+    if (!any) {
+      break;
+    }
+  }
+
+  if (cct->_conf.get_val<bool>("bluestore_onode_warmup_buffers")) {
+    // note which logical ranges of each object currently have clean
+    // buffers.  only look at the extent map shards that are loaded.
+    for (auto& i : items) {
+      CollectionRef c = _get_collection(i.cid);
+      if (!c) {
+	continue;
+      }
+      RWLock::RLocker l(c->lock);
+      OnodeRef o = c->onode_map.lookup(i.oid);
+      if (!o) {
+	continue;
+      }
+      for (auto& e : o->extent_map.extent_map) {
+	SharedBlob *sb = e.blob->shared_blob.get();
+	uint32_t b_end = e.blob_offset + e.length;
+	std::lock_guard cl(sb->get_cache()->lock);
+	for (auto p = sb->bc._data_lower_bound(e.blob_offset);
+	     p != sb->bc.buffer_map.end() && p->second->offset < b_end;
+	     ++p) {
+	  if (!p->second->is_clean()) {
+	    continue;
+	  }
+	  uint32_t from = std::max(p->second->offset, e.blob_offset);
+	  uint32_t to = std::min(p->second->end(), b_end);
+	  if (from < to) {
+	    i.cached.union_insert(e.logical_offset + from - e.blob_offset,
+				  to - from);
+	  }
+	}
+      }
+    }
+  }
+
+  bufferlist bl;
+  ENCODE_START(1, 1, bl);
+  encode((uint32_t)items.size(), bl);
+  for (auto& i : items) {
+    i.encode(bl);
+  }
+  ENCODE_FINISH(bl);
+
+  int r = _write_onode_warmup_file(bl);
+  if (r < 0) {
+    return r;
+  }
+  dout(10) << __func__ << " recorded " << items.size() << " onodes ("
+	   << bl.length() << " bytes) in " << (ceph_clock_now() - start)
+	   << dendl;
+  return 0;
+}
+
+int BlueStore::_write_onode_warmup_file(bufferlist& bl)
+{
+  int r = 0;
+  if (!bluefs->dir_exists(ONODE_WARMUP_DIR)) {
+    r = bluefs->mkdir(ONODE_WARMUP_DIR);
+    if (r < 0) {
+      derr << __func__ << " failed to create " << ONODE_WARMUP_DIR << ": "
+	   << cpp_strerror(r) << dendl;
+      return r;
+    }
+  }
+  // write a temp file and rename it over the old one, so that a crash
+  // midway never leaves a torn record behind
+  BlueFS::FileWriter *h = nullptr;
+  r = bluefs->open_for_write(ONODE_WARMUP_DIR, ONODE_WARMUP_FILE ".tmp", &h,
+			     false);
+  if (r < 0) {
+    derr << __func__ << " failed to open " << ONODE_WARMUP_FILE ".tmp: "
+	 << cpp_strerror(r) << dendl;
+    return r;
+  }
+  h->append(bl.c_str(), bl.length());
+  r = bluefs->fsync(h);
+  bluefs->close_writer(h);
+  if (r == 0) {
+    r = bluefs->rename(ONODE_WARMUP_DIR, ONODE_WARMUP_FILE ".tmp",
+		       ONODE_WARMUP_DIR, ONODE_WARMUP_FILE);
+  }
+  if (r < 0) {
+    derr << __func__ << " failed to write " << ONODE_WARMUP_FILE << ": "
+	 << cpp_strerror(r) << dendl;
+  }
+  return r;
+}
+
+int BlueStore::_read_onode_warmup(vector<onode_warmup_item_t> *items)
+{
+  uint64_t size = 0;
+  utime_t mtime;
+  int r = bluefs->stat(ONODE_WARMUP_DIR, ONODE_WARMUP_FILE, &size, &mtime);
+  if (r < 0) {
+    return r;
+  }
+  BlueFS::FileReader *h = nullptr;
+  r = bluefs->open_for_read(ONODE_WARMUP_DIR, ONODE_WARMUP_FILE, &h);
+  if (r < 0) {
+    return r;
+  }
+  bufferlist bl;
+  r = bluefs->read(h, &h->buf, 0, size, &bl, NULL);
+  delete h;
+  if (r < 0) {
+    return r;
+  }
+  try {
+    auto p = bl.cbegin();
+    DECODE_START(1, p);
+    uint32_t n;
+    decode(n, p);
+    // n may be garbage, so don't size the vector by it
+    while (n--) {
+      items->emplace_back();
+      items->back().decode(p);
+    }
+    DECODE_FINISH(p);
+  } catch (buffer::error& e) {
+    derr << __func__ << " failed to decode " << ONODE_WARMUP_FILE << ": "
+	 << e.what() << dendl;
+    items->clear();
+    return -EIO;
+  }
+  dout(10) << __func__ << " " << items->size() << " onodes recorded at "
+	   << mtime << dendl;
+  return 0;
+}
+
+void BlueStore::_onode_warmup_start()
+{
+  if (!bluefs || !cct->_conf.get_val<bool>("bluestore_onode_warmup")) {
+    return;
+  }
+  onode_warmup_stop = false;
+  onode_warmup_thread.create("bstore_warmup");
+}
+
+void BlueStore::_onode_warmup_stop()
+{
+  if (!onode_warmup_thread.is_started()) {
+    return;
+  }
+  {
+    std::lock_guard l(onode_warmup_lock);
+    onode_warmup_stop = true;
+    onode_warmup_cond.notify_all();
+  }
+  onode_warmup_thread.join();
+}
+
+void BlueStore::_onode_warmup_thread()
+{
+  vector<onode_warmup_item_t> items;
+  int r = _read_onode_warmup(&items);
+  if (r == -ENOENT) {
+    dout(10) << __func__ << " nothing recorded" << dendl;
+    return;
+  } else if (r < 0) {
+    derr << __func__ << " failed to load warm-up record: "
+	 << cpp_strerror(r) << dendl;
+    return;
+  }
+  uint64_t max_onodes =
+    cct->_conf.get_val<uint64_t>("bluestore_onode_warmup_max_onodes");
+  uint64_t max_bytes =
+    cct->_conf.get_val<Option::size_t>("bluestore_onode_warmup_max_bytes");
+  uint64_t ops_per_sec =
+    cct->_conf.get_val<uint64_t>("bluestore_onode_warmup_max_ops_per_sec");
+  if (items.size() > max_onodes) {
+    items.resize(max_onodes);
+  }
+  dout(1) << __func__ << " prefetching " << items.size() << " onodes" << dendl;
+  logger->set(l_bluestore_onode_warmup_pending, items.size());
+
+  auto start = mono_clock::now();
+  uint64_t ops = 0, bytes = 0, loaded = 0, skipped = 0;
+  for (auto& i : items) {
+    {
+      // pace ourselves; client io comes first
+      std::unique_lock l(onode_warmup_lock);
+      if (ops_per_sec && !onode_warmup_stop) {
+	auto due = start + ceph::make_timespan((double)ops / ops_per_sec);
+	auto now = mono_clock::now();
+	if (due > now) {
+	  onode_warmup_cond.wait_for(l, due - now);
+	}
+      }
+      if (onode_warmup_stop) {
+	dout(10) << __func__ << " stopping early" << dendl;
+	break;
+      }
+    }
+    logger->dec(l_bluestore_onode_warmup_pending);
+
+    CollectionRef c = _get_collection(i.cid);
+    OnodeRef o;
+    if (c) {
+      RWLock::RLocker l(c->lock);
+      o = c->get_onode(i.oid, false);
+      if (o && o->exists) {
+	// fault in the extent map shards too
+	o->extent_map.fault_range(db, 0, o->onode.size);
+      }
+    }
+    ++ops;
+    if (!o || !o->exists) {
+      ++skipped;
+      logger->inc(l_bluestore_onode_warmup_skipped);
+      continue;
+    }
+    ++loaded;
+    logger->inc(l_bluestore_onode_warmup_loaded);
+
+    CollectionHandle ch = c;
+    for (auto p = i.cached.begin(); p != i.cached.end(); ++p) {
+      if (bytes + p.get_len() > max_bytes) {
+	break;
+      }
+      bufferlist bl;
+      r = read(ch, i.oid, p.get_start(), p.get_len(), bl,
+	       CEPH_OSD_OP_FLAG_FADVISE_WILLNEED);
+      ++ops;
+      if (r > 0) {
+	bytes += r;
+	logger->inc(l_bluestore_onode_warmup_bytes, r);
+      }
+    }
+  }
+  logger->set(l_bluestore_onode_warmup_pending, 0);
+  dout(1) << __func__ << " loaded " << loaded << " onodes and "
+	  << byte_u_t(bytes) << ", skipped " << skipped << " in "
+	  << (mono_clock::now() - start) << dendl;
+}
+
+// fast tier placement
+
+bool BlueStore::_tier_should_promote(OnodeRef& o, uint64_t need)
+{
+  return fast_alloc &&
+    tier_policy->should_promote(*o, need, fast_alloc->get_free(),
+				fast_tier_size);
+}
+
+void BlueStore::_tier_add_resident(const coll_t& cid, Onode *o)
+{
+  o->note_tier_access(tier_clock_now(), tier_heat_half_life, 0);
+  if (o->tier_state == Onode::TIER_RESIDENT) {
+    return;
+  }
+  o->tier_state = Onode::TIER_RESIDENT;
+  std::lock_guard l(tier_lock);
+  tier_residents[cid].insert(o->oid);
+}
+
+void BlueStore::_tier_note_read(Collection *c, Onode *o)
+{
+  if (!fast_alloc) {
+    return;
+  }
+  o->note_tier_access(tier_clock_now(), tier_heat_half_life, 1);
+  if (o->tier_state != Onode::TIER_UNKNOWN) {
+    return;
+  }
+  // the resident list is not persistent; find out (once) whether the
+  // loaded part of this onode uses the fast tier, e.g. after a restart
+  for (auto& e : o->extent_map.extent_map) {
+    for (auto& p : e.blob->get_blob().get_extents()) {
+      if (p.is_valid() && _is_fast_tier(p.offset)) {
+	_tier_add_resident(c->cid, o);
+	return;
+      }
+    }
+  }
+  o->tier_state = Onode::TIER_SLOW;
+}
+
+void BlueStore::_tier_start()
+{
+  if (!fast_alloc) {
+    return;
+  }
+  tier_stop = false;
+  tier_thread.create("bstore_tier");
+}
+
+void BlueStore::_tier_stop()
+{
+  if (!tier_thread.is_started()) {
+    return;
+  }
+  {
+    std::lock_guard l(tier_lock);
+    tier_stop = true;
+    tier_cond.notify_all();
+  }
+  tier_thread.join();
+  tier_residents.clear();
+  tier_demote_queue.clear();
+  tier_demote_pending = false;
+}
+
+void BlueStore::_tier_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l(tier_lock);
+  while (!tier_stop) {
+    tier_cond.wait_for(l, ceph::make_timespan(
+      cct->_conf.get_val<double>("bluestore_fast_tier_demote_interval")));
+    if (tier_stop) {
+      break;
+    }
+    uint64_t fast_free = fast_alloc->get_free();
+    logger->set(l_bluestore_tier_fast_free, fast_free);
+
+    map<coll_t, set<ghobject_t>> residents, demote;
+    residents.swap(tier_residents);
+    l.unlock();
+
+    uint64_t num = 0;
+    for (auto& p : residents) {
+      CollectionRef c = _get_collection(p.first);
+      if (!c) {
+	continue;
+      }
+      RWLock::RLocker cl(c->lock);
+      for (auto q = p.second.begin(); q != p.second.end(); ) {
+	// an onode which fell out of the cache went cold by definition
+	OnodeRef o = c->onode_map.lookup(*q);
+	if (o && !o->exists) {
+	  q = p.second.erase(q);
+	} else if (!o ||
+		   tier_policy->should_demote(*o, fast_free, fast_tier_size)) {
+	  if (o) {
+	    o->tier_state = Onode::TIER_UNKNOWN;
+	  }
+	  demote[p.first].insert(*q);
+	  q = p.second.erase(q);
+	  ++num;
+	} else {
+	  ++q;
+	}
+      }
+    }
+
+    l.lock();
+    for (auto& p : residents) {
+      if (!p.second.empty()) {
+	tier_residents[p.first].insert(p.second.begin(), p.second.end());
+      }
+    }
+    for (auto& p : demote) {
+      tier_demote_queue[p.first].insert(p.second.begin(), p.second.end());
+    }
+    // forget about collections which went away meanwhile
+    for (auto p = tier_demote_queue.begin(); p != tier_demote_queue.end(); ) {
+      if (!_get_collection(p->first)) {
+	p = tier_demote_queue.erase(p);
+      } else {
+	++p;
+      }
+    }
+    tier_demote_pending = !tier_demote_queue.empty();
+    dout(10) << __func__ << " " << num << " objects queued for demotion, "
+	     << byte_u_t(fast_free) << " free on the fast tier" << dendl;
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
+void BlueStore::_tier_demote_queued(TransContext *txc, CollectionRef& c)
+{
+  if (!tier_demote_pending) {
+    return;
+  }
+  set<ghobject_t> oids;
+  {
+    std::lock_guard l(tier_lock);
+    auto p = tier_demote_queue.find(c->cid);
+    if (p == tier_demote_queue.end()) {
+      return;
+    }
+    oids.swap(p->second);
+    tier_demote_queue.erase(p);
+    tier_demote_pending = !tier_demote_queue.empty();
+  }
+
+  uint64_t budget =
+    cct->_conf.get_val<Option::size_t>("bluestore_fast_tier_demote_max_bytes");
+  set<ghobject_t> left;
+  {
+    RWLock::WLocker l(c->lock);
+    for (auto& oid : oids) {
+      if (!budget) {
+	left.insert(oid);
+	continue;
+      }
+      OnodeRef o = c->get_onode(oid, false);
+      if (!o || !o->exists) {
+	continue;
+      }
+      int r = _tier_demote(txc, c, o, &budget);
+      if (r < 0) {
+	derr << __func__ << " failed to demote " << oid << ": "
+	     << cpp_strerror(r) << dendl;
+      } else if (r > 0) {
+	left.insert(oid);
+      }
+    }
+  }
+  if (!left.empty()) {
+    std::lock_guard l(tier_lock);
+    tier_demote_queue[c->cid].insert(left.begin(), left.end());
+    tier_demote_pending = true;
+  }
+}
+
+/*
+ * Rewrite the object data that lives on the fast tier, up to *budget
+ * bytes, onto the main device.  Shared blobs are left alone, rewriting
+ * them would undo the sharing.  Returns 1 if there is more to do.
+ */
+int BlueStore::_tier_demote(TransContext *txc, CollectionRef& c, OnodeRef& o,
+			    uint64_t *budget)
+{
+  o->extent_map.fault_range(db, 0, o->onode.size);
+
+  interval_set<uint64_t> todo;
+  bool more = false;
+  for (auto& e : o->extent_map.extent_map) {
+    auto& blob = e.blob->get_blob();
+    if (blob.is_shared()) {
+      continue;
+    }
+    bool fast = false;
+    for (auto& p : blob.get_extents()) {
+      if (p.is_valid() && _is_fast_tier(p.offset)) {
+	fast = true;
+	break;
+      }
+    }
+    if (!fast) {
+      continue;
+    }
+    if (!todo.empty() && e.length > *budget) {
+      more = true;
+      break;
+    }
+    todo.union_insert(e.logical_offset, e.length);
+    *budget -= std::min<uint64_t>(*budget, e.length);
+  }
+  if (todo.empty()) {
+    o->tier_state = Onode::TIER_SLOW;
+    return 0;
+  }
+  dout(20) << __func__ << " " << o->oid << " 0x" << std::hex << todo
+	   << std::dec << (more ? " (partial)" : "") << dendl;
+
+  // read everything first; the old extents are punched out before the
+  // rewrite so that it can't be turned into an in-place (deferred)
+  // overwrite of the very same fast tier blocks
+  map<uint64_t, bufferlist> data;
+  for (auto p = todo.begin(); p != todo.end(); ++p) {
+    bufferlist& bl = data[p.get_start()];
+    int r = _do_read(c.get(), o, p.get_start(), p.get_len(), bl, 0);
+    if (r < 0) {
+      return r;
+    }
+    ceph_assert(r == (int)p.get_len());
+  }
+
+  WriteContext wctx;
+  _choose_write_options(c, o, 0, &wctx);
+  wctx.demote = true;
+  for (auto p = todo.begin(); p != todo.end(); ++p) {
+    o->extent_map.punch_hole(c, p.get_start(), p.get_len(), &wctx.old_extents);
+  }
+  for (auto& p : data) {
+    _do_write_data(txc, c, o, p.first, p.second.length(), p.second, &wctx);
+  }
+  int r = _do_alloc_write(txc, c, o, &wctx);
+  if (r < 0) {
+    return r;
+  }
+  _wctx_finish(txc, c, o, &wctx);
+
+  uint64_t start = todo.range_start();
+  uint64_t end = todo.range_end();
+  o->extent_map.compress_extent_map(start, end - start);
+  o->extent_map.dirty_range(start, end - start);
+  txc->write_onode(o);
+  logger->inc(l_bluestore_tier_demoted_bytes, todo.size());
+  if (!more) {
+    o->tier_state = Onode::TIER_SLOW;
+  }
+  return more ? 1 : 0;
+}
+
+static void apply(uint64_t off,
+                  uint64_t len,
+                  uint64_t granularity,
+                  BlueStore::mempool_dynamic_bitset &bitset,
+                  std::function<void(uint64_t,
+				     BlueStore::mempool_dynamic_bitset &)> f) {
+  auto end = round_up_to(off + len, granularity);
+  while (off < end) {
+    uint64_t pos = off / granularity;
+    f(pos, bitset);
+    off += granularity;
+  }
+}
+
+int BlueStore::_fsck_check_extents(
+  const coll_t& cid,
+  const ghobject_t& oid,
+  const PExtentVector& extents,
+  bool compressed,
+  mempool_dynamic_bitset &used_blocks,
+  mempool_dynamic_bitset &fast_used_blocks,
+  uint64_t granularity,
+  BlueStoreRepairer* repairer,
+  store_statfs_t& expected_statfs)
+{
+  dout(30) << __func__ << " oid " << oid << " extents " << extents << dendl;
+  int errors = 0;
+  for (auto e : extents) {
+    if (!e.is_valid())
+      continue;
+    expected_statfs.allocated += e.length;
+    if (compressed) {
+      expected_statfs.data_compressed_allocated += e.length;
+    }
+    bool already = false;
+    if (_is_fast_tier(e.offset)) {
+      // the repairer only knows about the main device; just report these
+      uint64_t off = e.offset - FAST_TIER_BASE;
+      if (off + e.length > fast_tier_size) {
+	derr << "fsck error:  " << oid << " extent " << e
+	     << " past end of the fast tier" << dendl;
+	++errors;
+	continue;
+      }
+      apply(
+	off, e.length, granularity, fast_used_blocks,
+	[&](uint64_t pos, mempool_dynamic_bitset &bs) {
+	  ceph_assert(pos < bs.size());
+	  if (bs.test(pos)) {
+	    if (!already) {
+	      derr << "fsck error: " << oid << " extent " << e
+		   << " or a subset is already allocated (misreferenced)"
+		   << dendl;
+	      ++errors;
+	      already = true;
+	    }
+	  } else {
+	    bs.set(pos);
+	  }
+	});
+      continue;
+    }
+    apply(
+      e.offset, e.length, granularity, used_blocks,
+      [&](uint64_t pos, mempool_dynamic_bitset &bs) {
+	ceph_assert(pos < bs.size());
 	if (bs.test(pos)) {
 	  if (repairer) {
 	    repairer->note_misreference(
@@ -6678,36 +7839,765 @@ void BlueStore::_fsck_check_pool_statfs(
 	}
 	continue;
       }
-      store_statfs_t statfs;
-      vstatfs.publish(&statfs);
-      if (!(stat_it->second == statfs)) {
-        derr << "fsck error: actual " << statfs
-	     << " != expected " << stat_it->second
-	     << " for pool "
-	     << std::hex << pool_id << std::dec << dendl;
-	if (repairer) {
-	  repairer->fix_statfs(db, key, stat_it->second);
-	}
-        ++errors;
+      store_statfs_t statfs;
+      vstatfs.publish(&statfs);
+      if (!(stat_it->second == statfs)) {
+        derr << "fsck error: actual " << statfs
+	     << " != expected " << stat_it->second
+	     << " for pool "
+	     << std::hex << pool_id << std::dec << dendl;
+	if (repairer) {
+	  repairer->fix_statfs(db, key, stat_it->second);
+	}
+        ++errors;
+      }
+      expected_pool_statfs.erase(stat_it);
+    }
+  } // if (it)
+  for( auto s = expected_pool_statfs.begin(); s != expected_pool_statfs.end();
+    ++s) {
+    if (s->second.is_zero()) {
+      // we might lack empty statfs recs in DB
+      continue;
+    }
+    derr << "fsck error: missing Pool StatFS record for pool "
+	  << std::hex << s->first << std::dec << dendl;
+    if (repairer) {
+      string key;
+      get_pool_stat_key(s->first, &key);
+      repairer->fix_statfs(db, key, s->second);
+    }
+    ++errors;
+  }
+}
+
+namespace {
+struct sb_info_t {
+  coll_t cid;
+  int64_t pool_id = INT64_MIN;
+  list<ghobject_t> oids;
+  BlueStore::SharedBlobRef sb;
+  bluestore_extent_ref_map_t ref_map;
+  bool compressed = false;
+  bool passed = false;
+  bool updated = false;
+};
+typedef btree::btree_set<
+  uint64_t,std::less<uint64_t>,
+  mempool::bluestore_fsck::pool_allocator<uint64_t>> uint64_t_btree_t;
+}
+
+struct BlueStore::FSCK_ObjectCtx {
+  const bool deep;
+  BlueStoreRepairer* const repairer;  ///< null unless repairing
+  bool need_per_pool_stats = false;
+
+  KeyValueDB::Snapshot snap;      ///< online check: read from here
+  Cache *shadow_cache = nullptr;  ///< online check: decode onodes into here
+  vector<CollectionRef> colls;
+  std::atomic<bool> aborted = {false};
+
+  ceph::mutex lock = ceph::make_mutex("BlueStore::FSCK_ObjectCtx::lock");
+  // protected by lock while the object walk runs
+  int errors = 0;
+  uint64_t num_objects = 0;
+  uint64_t num_extents = 0;
+  uint64_t num_blobs = 0;
+  uint64_t num_spanning_blobs = 0;
+  uint64_t num_shared_blobs = 0;
+  uint64_t num_sharded_objects = 0;
+  uint64_t num_object_shards = 0;
+  uint64_t_btree_t used_nids;
+  uint64_t_btree_t used_omap_head;
+  uint64_t_btree_t used_pgmeta_omap_head;
+  mempool_dynamic_bitset used_blocks;
+  mempool_dynamic_bitset fast_used_blocks;
+  mempool::bluestore_fsck::map<uint64_t,sb_info_t> sb_info;
+  store_statfs_t expected_store_statfs;
+  per_pool_statfs expected_pool_statfs;
+
+  FSCK_ObjectCtx(bool deep, BlueStoreRepairer* repairer)
+    : deep(deep),
+      repairer(repairer) {}
+
+  store_statfs_t& expected_statfs(int64_t pool_id) {
+    return need_per_pool_stats ?
+      expected_pool_statfs[pool_id] : expected_store_statfs;
+  }
+};
+
+void BlueStore::_fsck_check_object(
+  FSCK_ObjectCtx& ctx,
+  Collection *c,
+  OnodeRef o,
+  mempool::bluestore_fsck::list<string>& expecting_shards,
+  store_statfs_t& onode_statfs)
+{
+  const ghobject_t& oid = o->oid;
+  int errors = 0;
+  {
+    std::lock_guard l(ctx.lock);
+    if (o->onode.nid) {
+      if (o->onode.nid > nid_max) {
+	derr << "fsck error: " << oid << " nid " << o->onode.nid
+	     << " > nid_max " << nid_max << dendl;
+	++errors;
+      }
+      if (ctx.used_nids.count(o->onode.nid)) {
+	derr << "fsck error: " << oid << " nid " << o->onode.nid
+	     << " already in use" << dendl;
+	ctx.errors += errors + 1;
+	return; // go for next object
+      }
+      ctx.used_nids.insert(o->onode.nid);
+    }
+    ++ctx.num_objects;
+    ctx.num_spanning_blobs += o->extent_map.spanning_blob_map.size();
+    if (!o->extent_map.shards.empty()) {
+      ++ctx.num_sharded_objects;
+      ctx.num_object_shards += o->extent_map.shards.size();
+    }
+  }
+  _dump_onode(o);
+  if (o->onode.has_inline_data()) {
+    if (o->onode.inline_data.length() > o->onode.size) {
+      derr << "fsck error: " << oid << " inline data 0x" << std::hex
+	   << o->onode.inline_data.length() << " past EOF at 0x"
+	   << o->onode.size << std::dec << dendl;
+      ++errors;
+    }
+    if (!o->extent_map.extent_map.empty() ||
+	!o->onode.extent_map_shards.empty()) {
+      derr << "fsck error: " << oid << " has both inline data and extents"
+	   << dendl;
+      ++errors;
+    }
+  }
+  // shards
+  for (auto& s : o->extent_map.shards) {
+    dout(20) << __func__ << "    shard " << *s.shard_info << dendl;
+    expecting_shards.push_back(string());
+    get_extent_shard_key(o->key, s.shard_info->offset,
+			 &expecting_shards.back());
+    if (s.shard_info->offset >= o->onode.size) {
+      derr << "fsck error: " << oid << " shard 0x" << std::hex
+	   << s.shard_info->offset << " past EOF at 0x" << o->onode.size
+	   << std::dec << dendl;
+      ++errors;
+    }
+  }
+  // lextents
+  map<BlobRef,bluestore_blob_t::unused_t> referenced;
+  uint64_t pos = 0;
+  uint64_t num_extents = 0;
+  mempool::bluestore_fsck::map<BlobRef,
+			       bluestore_blob_use_tracker_t> ref_map;
+  for (auto& l : o->extent_map.extent_map) {
+    dout(20) << __func__ << "    " << l << dendl;
+    if (l.logical_offset < pos) {
+      derr << "fsck error: " << oid << " lextent at 0x"
+	   << std::hex << l.logical_offset
+	   << " overlaps with the previous, which ends at 0x" << pos
+	   << std::dec << dendl;
+      ++errors;
+    }
+    if (o->extent_map.spans_shard(l.logical_offset, l.length)) {
+      derr << "fsck error: " << oid << " lextent at 0x"
+	   << std::hex << l.logical_offset << "~" << l.length
+	   << " spans a shard boundary"
+	   << std::dec << dendl;
+      ++errors;
+    }
+    pos = l.logical_offset + l.length;
+    onode_statfs.data_stored += l.length;
+    ceph_assert(l.blob);
+    const bluestore_blob_t& blob = l.blob->get_blob();
+
+    auto& ref = ref_map[l.blob];
+    if (ref.is_empty()) {
+      uint32_t min_release_size = blob.get_release_size(min_alloc_size);
+      uint32_t l = blob.get_logical_length();
+      ref.init(l, min_release_size);
+    }
+    ref.get(
+      l.blob_offset, 
+      l.length);
+    ++num_extents;
+    if (blob.has_unused()) {
+      auto p = referenced.find(l.blob);
+      bluestore_blob_t::unused_t *pu;
+      if (p == referenced.end()) {
+	pu = &referenced[l.blob];
+      } else {
+	pu = &p->second;
+      }
+      uint64_t blob_len = blob.get_logical_length();
+      ceph_assert((blob_len % (sizeof(*pu)*8)) == 0);
+      ceph_assert(l.blob_offset + l.length <= blob_len);
+      uint64_t chunk_size = blob_len / (sizeof(*pu)*8);
+      uint64_t start = l.blob_offset / chunk_size;
+      uint64_t end =
+	round_up_to(l.blob_offset + l.length, chunk_size) / chunk_size;
+      for (auto i = start; i < end; ++i) {
+	(*pu) |= (1u << i);
+      }
+    }
+  }
+  for (auto &i : referenced) {
+    dout(20) << __func__ << "  referenced 0x" << std::hex << i.second
+	     << std::dec << " for " << *i.first << dendl;
+    const bluestore_blob_t& blob = i.first->get_blob();
+    if (i.second & blob.unused) {
+      derr << "fsck error: " << oid << " blob claims unused 0x"
+	   << std::hex << blob.unused
+	   << " but extents reference 0x" << i.second << std::dec
+	   << " on blob " << *i.first << dendl;
+      ++errors;
+    }
+    if (blob.has_csum()) {
+      uint64_t blob_len = blob.get_logical_length();
+      uint64_t unused_chunk_size = blob_len / (sizeof(blob.unused)*8);
+      unsigned csum_count = blob.get_csum_count();
+      unsigned csum_chunk_size = blob.get_csum_chunk_size();
+      for (unsigned p = 0; p < csum_count; ++p) {
+	unsigned pos = p * csum_chunk_size;
+	unsigned firstbit = pos / unused_chunk_size;    // [firstbit,lastbit]
+	unsigned lastbit = (pos + csum_chunk_size - 1) / unused_chunk_size;
+	unsigned mask = 1u << firstbit;
+	for (unsigned b = firstbit + 1; b <= lastbit; ++b) {
+	  mask |= 1u << b;
+	}
+	if ((blob.unused & mask) == mask) {
+	  // this csum chunk region is marked unused
+	  if (blob.get_csum_item(p) != 0) {
+	    derr << "fsck error: " << oid
+		 << " blob claims csum chunk 0x" << std::hex << pos
+		 << "~" << csum_chunk_size
+		 << " is unused (mask 0x" << mask << " of unused 0x"
+		 << blob.unused << ") but csum is non-zero 0x"
+		 << blob.get_csum_item(p) << std::dec << " on blob "
+		 << *i.first << dendl;
+	    ++errors;
+	  }
+	}
+      }
+    }
+  }
+  {
+    // cross-checks against what the other objects use
+    std::lock_guard l(ctx.lock);
+    ctx.num_extents += num_extents;
+    for (auto &i : ref_map) {
+      ++ctx.num_blobs;
+      const bluestore_blob_t& blob = i.first->get_blob();
+      bool equal = i.first->get_blob_use_tracker().equal(i.second);
+      if (!equal) {
+	derr << "fsck error: " << oid << " blob " << *i.first
+	     << " doesn't match expected ref_map " << i.second << dendl;
+	++errors;
+      }
+      if (blob.is_compressed()) {
+	onode_statfs.data_compressed += blob.get_compressed_payload_length();
+	onode_statfs.data_compressed_original +=
+	  i.first->get_referenced_bytes();
+      }
+      if (blob.is_shared()) {
+	if (i.first->shared_blob->get_sbid() > blobid_max) {
+	  derr << "fsck error: " << oid << " blob " << blob
+	       << " sbid " << i.first->shared_blob->get_sbid() << " > blobid_max "
+	       << blobid_max << dendl;
+	  ++errors;
+	} else if (i.first->shared_blob->get_sbid() == 0) {
+	  derr << "fsck error: " << oid << " blob " << blob
+	       << " marked as shared but has uninitialized sbid"
+	       << dendl;
+	  ++errors;
+	}
+	sb_info_t& sbi = ctx.sb_info[i.first->shared_blob->get_sbid()];
+	ceph_assert(sbi.cid == coll_t() || sbi.cid == c->cid);
+	ceph_assert(sbi.pool_id == INT64_MIN ||
+		    sbi.pool_id == oid.hobj.get_logical_pool());
+	sbi.cid = c->cid;
+	sbi.pool_id = oid.hobj.get_logical_pool();
+	sbi.sb = i.first->shared_blob;
+	sbi.oids.push_back(oid);
+	sbi.compressed = blob.is_compressed();
+	for (auto e : blob.get_extents()) {
+	  if (e.is_valid()) {
+	    sbi.ref_map.get(e.offset, e.length);
+	  }
+	}
+      } else {
+	errors += _fsck_check_extents(c->cid, oid, blob.get_extents(),
+				      blob.is_compressed(),
+				      ctx.used_blocks,
+				      ctx.fast_used_blocks,
+				      fm->get_alloc_size(),
+				      ctx.repairer,
+				      onode_statfs);
+      }
+    }
+  }
+  if (ctx.deep) {
+    bufferlist bl;
+    uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
+    uint64_t offset = 0;
+    do {
+      uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
+      int r = _do_read(c, o, offset, l, bl,
+	CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+      if (r < 0) {
+	++errors;
+	derr << "fsck error: " << oid << std::hex
+	     << " error during read: "
+	     << " " << offset << "~" << l
+	     << " " << cpp_strerror(r) << std::dec
+	     << dendl;
+	break;
+      }
+      offset += l;
+    } while (offset < o->onode.size);
+  }
+  std::lock_guard l(ctx.lock);
+  // omap
+  if (o->onode.has_omap()) {
+    auto& m = o->onode.is_pgmeta_omap() ?
+      ctx.used_pgmeta_omap_head : ctx.used_omap_head;
+    if (m.count(o->onode.nid)) {
+      derr << "fsck error: " << oid << " omap_head " << o->onode.nid
+	   << " already in use" << dendl;
+      ++errors;
+    } else {
+      m.insert(o->onode.nid);
+    }
+  }
+  ctx.errors += errors;
+}
+
+void BlueStore::_fsck_check_objects_range(
+  FSCK_ObjectCtx& ctx,
+  const string& start,
+  const string& end)
+{
+  dout(10) << __func__ << " " << pretty_binary_string(start) << " to "
+	   << pretty_binary_string(end) << dendl;
+  KeyValueDB::Iterator it = ctx.snap ?
+    ctx.snap->get_iterator(PREFIX_OBJ) : db->get_iterator(PREFIX_OBJ);
+  if (!it) {
+    return;
+  }
+
+  int errors = 0;
+  store_statfs_t expected_store_statfs;
+  per_pool_statfs expected_pool_statfs;
+  //fill global if not overriden below
+  store_statfs_t* expected_statfs = &expected_store_statfs;
+  CollectionRef c;
+  CollectionRef shadow;  // online check: private twin of c
+  spg_t pgid;
+  mempool::bluestore_fsck::list<string> expecting_shards;
+  auto owns = [](const CollectionRef& c, const ghobject_t& oid) {
+    RWLock::RLocker l(c->lock);
+    return c->contains(oid);
+  };
+  for (it->lower_bound(start);
+       it->valid() && (end.empty() || it->key() < end);
+       it->next()) {
+    if (g_conf()->bluestore_debug_fsck_abort) {
+      ctx.aborted = true;
+    }
+    if (ctx.aborted) {
+      break;
+    }
+    dout(30) << __func__ << " key "
+	     << pretty_binary_string(it->key()) << dendl;
+    if (is_extent_shard_key(it->key())) {
+      while (!expecting_shards.empty() &&
+	     expecting_shards.front() < it->key()) {
+	derr << "fsck error: missing shard key "
+	     << pretty_binary_string(expecting_shards.front())
+	     << dendl;
+	++errors;
+	expecting_shards.pop_front();
+      }
+      if (!expecting_shards.empty() &&
+	  expecting_shards.front() == it->key()) {
+	// all good
+	expecting_shards.pop_front();
+	continue;
+      }
+
+      uint32_t offset;
+      string okey;
+      get_key_extent_shard(it->key(), &okey, &offset);
+      derr << "fsck error: stray shard 0x" << std::hex << offset
+	   << std::dec << dendl;
+      if (expecting_shards.empty()) {
+	derr << "fsck error: " << pretty_binary_string(it->key())
+	     << " is unexpected" << dendl;
+	++errors;
+	continue;
+      }
+      while (expecting_shards.front() > it->key()) {
+	derr << "fsck error:   saw " << pretty_binary_string(it->key())
+	     << dendl;
+	derr << "fsck error:   exp "
+	     << pretty_binary_string(expecting_shards.front()) << dendl;
+	++errors;
+	expecting_shards.pop_front();
+	if (expecting_shards.empty()) {
+	  break;
+	}
+      }
+      continue;
+    }
+
+    ghobject_t oid;
+    int r = get_key_object(it->key(), &oid);
+    if (r < 0) {
+      derr << "fsck error: bad object key "
+	   << pretty_binary_string(it->key()) << dendl;
+      ++errors;
+      continue;
+    }
+    if (!c ||
+	oid.shard_id != pgid.shard ||
+	oid.hobj.get_logical_pool() != (int64_t)pgid.pool() ||
+	!owns(c, oid)) {
+      c = nullptr;
+      for (auto& p : ctx.colls) {
+	if (owns(p, oid)) {
+	  c = p;
+	  break;
+	}
+      }
+      if (!c) {
+	derr << "fsck error: stray object " << oid
+	     << " not owned by any collection" << dendl;
+	++errors;
+	continue;
+      }
+      auto pool_id = c->cid.is_pg(&pgid) ? pgid.pool() : META_POOL_ID;
+      dout(20) << __func__ << "  collection " << c->cid << " " << c->cnode
+	       << dendl;
+      if (ctx.need_per_pool_stats) {
+	expected_statfs = &expected_pool_statfs[pool_id];
+      }
+      if (ctx.snap) {
+	shadow = new Collection(this, ctx.shadow_cache, c->cid);
+      }
+    }
+
+    if (!expecting_shards.empty()) {
+      for (auto &k : expecting_shards) {
+	derr << "fsck error: missing shard key "
+	     << pretty_binary_string(k) << dendl;
+      }
+      ++errors;
+      expecting_shards.clear();
+    }
+
+    dout(10) << __func__ << "  " << oid << dendl;
+    store_statfs_t onode_statfs;
+    if (ctx.snap) {
+      // decode into the shadow collection so that the live onode and
+      // shared blob caches aren't touched, and take the extent map shards
+      // from the same snapshot
+      mempool::bluestore_cache_other::string key(it->key().c_str(),
+						 it->key().size());
+      OnodeRef o(Onode::decode(shadow.get(), oid, key, it->value()));
+      bool faulted = true;
+      for (auto& s : o->extent_map.shards) {
+	string skey;
+	bufferlist v;
+	get_extent_shard_key(o->key, s.shard_info->offset, &skey);
+	if (ctx.snap->get(PREFIX_OBJ, skey, &v) < 0) {
+	  derr << "fsck error: " << oid << " missing shard 0x" << std::hex
+	       << s.shard_info->offset << std::dec << dendl;
+	  ++errors;
+	  faulted = false;
+	  break;
+	}
+	s.extents = o->extent_map.decode_some(v);
+	s.loaded = true;
+      }
+      if (faulted) {
+	_fsck_check_object(ctx, c.get(), o, expecting_shards, onode_statfs);
+      }
+    } else {
+      RWLock::RLocker l(c->lock);
+      OnodeRef o = c->get_onode(oid, false);
+      o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+      _fsck_check_object(ctx, c.get(), o, expecting_shards, onode_statfs);
+    }
+    expected_statfs->add(onode_statfs);
+  }
+  if (!expecting_shards.empty() && !ctx.aborted) {
+    for (auto &k : expecting_shards) {
+      derr << "fsck error: missing shard key "
+	   << pretty_binary_string(k) << dendl;
+    }
+    ++errors;
+  }
+
+  std::lock_guard l(ctx.lock);
+  ctx.errors += errors;
+  ctx.expected_store_statfs.add(expected_store_statfs);
+  for (auto& p : expected_pool_statfs) {
+    ctx.expected_pool_statfs[p.first].add(p.second);
+  }
+}
+
+void BlueStore::_fsck_check_objects(FSCK_ObjectCtx& ctx)
+{
+  // each collection owns a contiguous key range (plus one for its temp
+  // objects).  cut the keyspace at their starts so that the ranges can be
+  // walked independently; keys not owned by anyone still fall into some
+  // range and are reported as strays there.
+  vector<string> bounds;
+  for (auto& c : ctx.colls) {
+    string temp_start, temp_end, start, end;
+    RWLock::RLocker l(c->lock);
+    get_coll_key_range(c->cid, c->cnode.bits, &temp_start, &temp_end,
+		       &start, &end);
+    bounds.push_back(temp_start);
+    bounds.push_back(start);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  if (!bounds.empty() && bounds.front().empty()) {
+    bounds.erase(bounds.begin());
+  }
+  vector<pair<string,string>> ranges;
+  string prev;
+  for (auto& b : bounds) {
+    ranges.emplace_back(prev, b);
+    prev = b;
+  }
+  ranges.emplace_back(prev, string());  // open ended
+
+  size_t num_threads = std::min<size_t>(
+    ranges.size(),
+    std::max<uint64_t>(1, cct->_conf.get_val<uint64_t>("bluestore_fsck_threads")));
+  dout(1) << __func__ << " " << ranges.size() << " key ranges, "
+	  << num_threads << " threads" << dendl;
+  std::atomic<size_t> next = {0};
+  auto worker = [&]() {
+    size_t i;
+    while (!ctx.aborted && (i = next++) < ranges.size()) {
+      _fsck_check_objects_range(ctx, ranges[i].first, ranges[i].second);
+    }
+  };
+  if (num_threads <= 1) {
+    worker();
+    return;
+  }
+  vector<std::thread> threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.push_back(make_named_thread("bstore_fsck", worker));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void BlueStore::_fsck_check_shared_blobs(FSCK_ObjectCtx& ctx)
+{
+  KeyValueDB::Iterator it = ctx.snap ?
+    ctx.snap->get_iterator(PREFIX_SHARED_BLOB) :
+    db->get_iterator(PREFIX_SHARED_BLOB);
+  if (!it) {
+    return;
+  }
+  BlueStoreRepairer* repairer = ctx.repairer;
+  for (it->lower_bound(string()); it->valid(); it->next()) {
+    string key = it->key();
+    uint64_t sbid;
+    if (get_key_shared_blob(key, &sbid)) {
+      derr << "fsck error: bad key '" << key
+	   << "' in shared blob namespace" << dendl;
+      if (repairer) {
+	repairer->remove_key(db, PREFIX_SHARED_BLOB, key);
+      }
+      ++ctx.errors;
+      continue;
+    }
+    auto p = ctx.sb_info.find(sbid);
+    if (p == ctx.sb_info.end()) {
+      derr << "fsck error: found stray shared blob data for sbid 0x"
+	   << std::hex << sbid << std::dec << dendl;
+      if (repairer) {
+	repairer->remove_key(db, PREFIX_SHARED_BLOB, key);
+      }
+      ++ctx.errors;
+    } else {
+      ++ctx.num_shared_blobs;
+      sb_info_t& sbi = p->second;
+      bluestore_shared_blob_t shared_blob(sbid);
+      bufferlist bl = it->value();
+      auto blp = bl.cbegin();
+      try {
+	decode(shared_blob, blp);
+      } catch (buffer::error& e) {
+	++ctx.errors;
+	// Force update and don't report as missing
+	sbi.updated = sbi.passed = true;
+
+	derr << "fsck error: failed to decode Shared Blob"
+	     << pretty_binary_string(it->key()) << dendl;
+	if (repairer) {
+	  dout(20) << __func__ << " undecodable Shared Blob, key:'"
+		   << pretty_binary_string(it->key())
+		   << "', removing" << dendl;
+	  repairer->remove_key(db, PREFIX_DEFERRED, it->key());
+	}
+	continue;
+      }
+      dout(20) << __func__ << "  " << *sbi.sb << " " << shared_blob << dendl;
+      if (shared_blob.ref_map != sbi.ref_map) {
+	derr << "fsck error: shared blob 0x" << std::hex << sbid
+	     << std::dec << " ref_map " << shared_blob.ref_map
+	     << " != expected " << sbi.ref_map << dendl;
+	sbi.updated = true; // will update later in repair mode only!
+	++ctx.errors;
       }
-      expected_pool_statfs.erase(stat_it);
+      PExtentVector extents;
+      for (auto &r : shared_blob.ref_map.ref_map) {
+	extents.emplace_back(bluestore_pextent_t(r.first, r.second.length));
+      }
+      ctx.errors += _fsck_check_extents(sbi.cid,
+					p->second.oids.front(),
+					extents,
+					p->second.compressed,
+					ctx.used_blocks,
+					ctx.fast_used_blocks,
+					fm->get_alloc_size(),
+					repairer,
+					ctx.expected_statfs(sbi.pool_id));
+      sbi.passed = true;
     }
-  } // if (it)
-  for( auto s = expected_pool_statfs.begin(); s != expected_pool_statfs.end();
-    ++s) {
-    if (s->second.is_zero()) {
-      // we might lack empty statfs recs in DB
+  }
+}
+
+void BlueStore::_fsck_check_stray_omap(FSCK_ObjectCtx& ctx, bool pgmeta)
+{
+  const string& prefix = pgmeta ? PREFIX_PGMETA_OMAP : PREFIX_OMAP;
+  auto& used = pgmeta ? ctx.used_pgmeta_omap_head : ctx.used_omap_head;
+  KeyValueDB::Iterator it = ctx.snap ?
+    ctx.snap->get_iterator(prefix) : db->get_iterator(prefix);
+  if (it) {
+    for (it->lower_bound(string()); it->valid(); it->next()) {
+      uint64_t omap_head;
+      _key_decode_u64(it->key().c_str(), &omap_head);
+      if (used.count(omap_head) == 0) {
+	derr << "fsck error: found stray omap data on omap_head "
+	     << omap_head << dendl;
+	++ctx.errors;
+      }
+    }
+  }
+}
+
+int BlueStore::fsck_online()
+{
+  dout(1) << __func__ << " <<<START>>>" << dendl;
+  if (!mounted) {
+    return -EINVAL;
+  }
+  utime_t start = ceph_clock_now();
+  // the hits and misses of the shadow cache are kept out of the store's
+  // counters, so they don't skew the stats of the live cache
+  std::unique_ptr<PerfCounters> shadow_logger;
+  {
+    PerfCountersBuilder b(cct, "bluestore-fsck-shadow-cache",
+			  l_bluestore_first, l_bluestore_last);
+    b.add_u64_counter(l_bluestore_onode_hits, "bluestore_onode_hits",
+		      "Sum for onode-lookups hit in the cache");
+    b.add_u64_counter(l_bluestore_onode_misses, "bluestore_onode_misses",
+		      "Sum for onode-lookups missed in the cache");
+    b.add_u64_counter(l_bluestore_buffer_hit_bytes,
+		      "bluestore_buffer_hit_bytes",
+		      "Sum for bytes of read hit in the cache",
+		      NULL, 0, unit_t(UNIT_BYTES));
+    b.add_u64_counter(l_bluestore_buffer_miss_bytes,
+		      "bluestore_buffer_miss_bytes",
+		      "Sum for bytes of read missed in the cache",
+		      NULL, 0, unit_t(UNIT_BYTES));
+    shadow_logger.reset(b.create_perf_counters());
+  }
+  // declared ahead of ctx: the shared blobs ctx holds on to live in it
+  std::unique_ptr<Cache> shadow_cache(
+    Cache::create(cct, "lru", shadow_logger.get()));
+  FSCK_ObjectCtx ctx(false, nullptr);
+  ctx.snap = db->get_snapshot();
+  if (!ctx.snap) {
+    derr << __func__ << " kv store can't take snapshots" << dendl;
+    return -EOPNOTSUPP;
+  }
+  ctx.shadow_cache = shadow_cache.get();
+  // take the collections from the snapshot too: a collection removed since
+  // would otherwise leave its objects in the snapshot with no owner, and
+  // they would be reported as strays
+  KeyValueDB::Iterator it = ctx.snap->get_iterator(PREFIX_COLL);
+  for (it->upper_bound(string());
+       it->valid();
+       it->next()) {
+    coll_t cid;
+    if (!cid.parse(it->key())) {
+      derr << "fsck error: unrecognized collection " << it->key() << dendl;
+      ++ctx.errors;
       continue;
     }
-    derr << "fsck error: missing Pool StatFS record for pool "
-	  << std::hex << s->first << std::dec << dendl;
-    if (repairer) {
-      string key;
-      get_pool_stat_key(s->first, &key);
-      repairer->fix_statfs(db, key, s->second);
+    CollectionRef c(new Collection(this, shadow_cache.get(), cid));
+    bufferlist bl = it->value();
+    auto p = bl.cbegin();
+    try {
+      decode(c->cnode, p);
+    } catch (buffer::error& e) {
+      derr << "fsck error: failed to decode cnode, key:"
+	   << pretty_binary_string(it->key()) << dendl;
+      ++ctx.errors;
+      continue;
+    }
+    ctx.colls.push_back(c);
+  }
+  // the freelist, bluefs extents and statfs move on independently of the
+  // snapshot, so only object vs. object overlaps are checked here.
+  ctx.used_blocks.resize(fm->get_alloc_units());
+  if (fast_fm) {
+    ctx.fast_used_blocks.resize(fast_fm->get_alloc_units());
+  }
+
+  dout(1) << __func__ << " walking object keyspace" << dendl;
+  _fsck_check_objects(ctx);
+  if (ctx.aborted) {
+    return -ECANCELED;
+  }
+  dout(1) << __func__ << " checking shared_blobs" << dendl;
+  _fsck_check_shared_blobs(ctx);
+  for (auto &p : ctx.sb_info) {
+    if (!p.second.passed) {
+      derr << "fsck error: missing " << *p.second.sb << dendl;
+      ++ctx.errors;
     }
-    ++errors;
   }
+  ctx.sb_info.clear();
+  dout(1) << __func__ << " checking for stray omap data" << dendl;
+  _fsck_check_stray_omap(ctx, false);
+  _fsck_check_stray_omap(ctx, true);
+
+  dout(2) << __func__ << " " << ctx.num_objects << " objects, "
+	  << ctx.num_sharded_objects << " of them sharded.  "
+	  << dendl;
+  dout(2) << __func__ << " " << ctx.num_extents << " extents to "
+	  << ctx.num_blobs << " blobs, "
+	  << ctx.num_spanning_blobs << " spanning, "
+	  << ctx.num_shared_blobs << " shared."
+	  << dendl;
+  utime_t duration = ceph_clock_now() - start;
+  dout(1) << __func__ << " <<<FINISH>>> with " << ctx.errors << " errors in "
+	  << duration << " seconds" << dendl;
+  return ctx.errors;
 }
 
 /**
@@ -6755,38 +8645,8 @@ int BlueStore::_fsck(bool deep, bool repair)
   int errors = 0;
   unsigned repaired = 0;
 
-  typedef btree::btree_set<
-    uint64_t,std::less<uint64_t>,
-    mempool::bluestore_fsck::pool_allocator<uint64_t>> uint64_t_btree_t;
-  uint64_t_btree_t used_nids;
-  uint64_t_btree_t used_omap_head;
-  uint64_t_btree_t used_pgmeta_omap_head;
-  uint64_t_btree_t used_sbids;
-
-  mempool_dynamic_bitset used_blocks;
   KeyValueDB::Iterator it;
-  store_statfs_t expected_store_statfs, actual_statfs;
-  per_pool_statfs expected_pool_statfs;
-
-  struct sb_info_t {
-    coll_t cid;
-    int64_t pool_id = INT64_MIN;
-    list<ghobject_t> oids;
-    SharedBlobRef sb;
-    bluestore_extent_ref_map_t ref_map;
-    bool compressed = false;
-    bool passed = false;
-    bool updated = false;
-  };
-  mempool::bluestore_fsck::map<uint64_t,sb_info_t> sb_info;
-
-  uint64_t num_objects = 0;
-  uint64_t num_extents = 0;
-  uint64_t num_blobs = 0;
-  uint64_t num_spanning_blobs = 0;
-  uint64_t num_shared_blobs = 0;
-  uint64_t num_sharded_objects = 0;
-  uint64_t num_object_shards = 0;
+  store_statfs_t actual_statfs;
   BlueStoreRepairer repairer;
   store_statfs_t* expected_statfs = nullptr;
   // in deep mode we need R/W write access to be able to replay deferred ops
@@ -6798,6 +8658,12 @@ int BlueStore::_fsck(bool deep, bool repair)
     (no_pps_mode == "until_repair" && repair);
   bool enforce_no_per_pool_stats = no_pps_mode == "enforce";
 
+  FSCK_ObjectCtx ctx(deep, repair ? &repairer : nullptr);
+  auto& used_blocks = ctx.used_blocks;
+  auto& sb_info = ctx.sb_info;
+  auto& expected_store_statfs = ctx.expected_store_statfs;
+  auto& expected_pool_statfs = ctx.expected_pool_statfs;
+
   int r = _open_path();
   if (r < 0)
     return r;
@@ -6845,6 +8711,9 @@ int BlueStore::_fsck(bool deep, bool repair)
     goto out_scan;
 
   used_blocks.resize(fm->get_alloc_units());
+  if (fast_fm) {
+    ctx.fast_used_blocks.resize(fast_fm->get_alloc_units());
+  }
   apply(
     0, std::max<uint64_t>(min_alloc_size, SUPER_RESERVED), fm->get_alloc_size(), used_blocks,
     [&](uint64_t pos, mempool_dynamic_bitset &bs) {
@@ -6867,450 +8736,65 @@ int BlueStore::_fsck(bool deep, bool repair)
       auto prev_errors = errors;
       try {
         decode(bluefs_extents_db, p);
-	bluefs_extents_db.union_of(bluefs_extents);
-	bluefs_extents_db.subtract(bluefs_extents);
-	if (!bluefs_extents_db.empty()) {
-	  derr << "fsck error: bluefs_extents inconsistency, "
-	       << "downgrade to previous releases might be broken."
-	       << dendl;
-	  ++errors;
-	}
-      }
-      catch (buffer::error& e) {
-	derr << "fsck error: failed to retrieve bluefs_extents from kv" << dendl;
-	++errors;
-      }
-      if (errors != prev_errors && repair) {
-	repairer.fix_bluefs_extents(out_of_sync_fm);
-      }
-    }
-
-    for (auto e = bluefs_extents.begin(); e != bluefs_extents.end(); ++e) {
-      apply(
-        e.get_start(), e.get_len(), fm->get_alloc_size(), used_blocks,
-        [&](uint64_t pos, mempool_dynamic_bitset &bs) {
-	ceph_assert(pos < bs.size());
-          bs.set(pos);
-        }
-	);
-    }
-    r = bluefs->fsck();
-    if (r < 0) {
-      goto out_scan;
-    }
-    if (r > 0)
-      errors += r;
-  }
-
-  // get expected statfs; reset unaffected fields to be able to compare
-  // structs
-  statfs(&actual_statfs);
-  actual_statfs.total = 0;
-  actual_statfs.internally_reserved = 0;
-  actual_statfs.available = 0;
-  actual_statfs.internal_metadata = 0;
-  actual_statfs.omap_allocated = 0;
-
-  need_per_pool_stats = per_pool_stat_collection || need_per_pool_stats;
-
-  // walk PREFIX_OBJ
-  dout(1) << __func__ << " walking object keyspace" << dendl;
-  it = db->get_iterator(PREFIX_OBJ);
-  if (it) {
-     //fill global if not overriden below
-    expected_statfs = &expected_store_statfs;
-
-    CollectionRef c;
-    spg_t pgid;
-    mempool::bluestore_fsck::list<string> expecting_shards;
-    for (it->lower_bound(string()); it->valid(); it->next()) {
-      if (g_conf()->bluestore_debug_fsck_abort) {
-	goto out_scan;
-      }
-      dout(30) << __func__ << " key "
-               << pretty_binary_string(it->key()) << dendl;
-      if (is_extent_shard_key(it->key())) {
-	while (!expecting_shards.empty() &&
-	       expecting_shards.front() < it->key()) {
-	  derr << "fsck error: missing shard key "
-	       << pretty_binary_string(expecting_shards.front())
-	       << dendl;
-	  ++errors;
-	  expecting_shards.pop_front();
-	}
-	if (!expecting_shards.empty() &&
-	    expecting_shards.front() == it->key()) {
-	  // all good
-	  expecting_shards.pop_front();
-	  continue;
-	}
-
-        uint32_t offset;
-        string okey;
-        get_key_extent_shard(it->key(), &okey, &offset);
-        derr << "fsck error: stray shard 0x" << std::hex << offset
-	     << std::dec << dendl;
-        if (expecting_shards.empty()) {
-          derr << "fsck error: " << pretty_binary_string(it->key())
-               << " is unexpected" << dendl;
-          ++errors;
-          continue;
-        }
-	while (expecting_shards.front() > it->key()) {
-	  derr << "fsck error:   saw " << pretty_binary_string(it->key())
-	       << dendl;
-	  derr << "fsck error:   exp "
-	       << pretty_binary_string(expecting_shards.front()) << dendl;
-	  ++errors;
-	  expecting_shards.pop_front();
-	  if (expecting_shards.empty()) {
-	    break;
-	  }
-	}
-	continue;
-      }
-
-      ghobject_t oid;
-      int r = get_key_object(it->key(), &oid);
-      if (r < 0) {
-        derr << "fsck error: bad object key "
-             << pretty_binary_string(it->key()) << dendl;
-	++errors;
-	continue;
-      }
-      if (!c ||
-	  oid.shard_id != pgid.shard ||
-	  oid.hobj.get_logical_pool() != (int64_t)pgid.pool() ||
-	  !c->contains(oid)) {
-	c = nullptr;
-	for (auto& p : coll_map) {
-	  if (p.second->contains(oid)) {
-	    c = p.second;
-	    break;
-	  }
-	}
-	if (!c) {
-          derr << "fsck error: stray object " << oid
-               << " not owned by any collection" << dendl;
-	  ++errors;
-	  continue;
-	}
-	auto pool_id = c->cid.is_pg(&pgid) ? pgid.pool() : META_POOL_ID;
-	dout(20) << __func__ << "  collection " << c->cid << " " << c->cnode
-		 << dendl;
-	if (need_per_pool_stats) {
-	  expected_statfs = &expected_pool_statfs[pool_id];
-	}
-
-	dout(20) << __func__ << "  collection " << c->cid << " " << c->cnode
-		 << dendl;
-      }
-
-      if (!expecting_shards.empty()) {
-	for (auto &k : expecting_shards) {
-	  derr << "fsck error: missing shard key "
-	       << pretty_binary_string(k) << dendl;
-	}
-	++errors;
-	expecting_shards.clear();
-      }
-
-      dout(10) << __func__ << "  " << oid << dendl;
-      store_statfs_t onode_statfs;
-      RWLock::RLocker l(c->lock);
-      OnodeRef o = c->get_onode(oid, false);
-      if (o->onode.nid) {
-	if (o->onode.nid > nid_max) {
-	  derr << "fsck error: " << oid << " nid " << o->onode.nid
-	       << " > nid_max " << nid_max << dendl;
-	  ++errors;
-	}
-	if (used_nids.count(o->onode.nid)) {
-	  derr << "fsck error: " << oid << " nid " << o->onode.nid
-	       << " already in use" << dendl;
-	  ++errors;
-	  continue; // go for next object
-	}
-	used_nids.insert(o->onode.nid);
-      }
-      ++num_objects;
-      num_spanning_blobs += o->extent_map.spanning_blob_map.size();
-      o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
-      _dump_onode(o);
-      // shards
-      if (!o->extent_map.shards.empty()) {
-	++num_sharded_objects;
-	num_object_shards += o->extent_map.shards.size();
-      }
-      for (auto& s : o->extent_map.shards) {
-	dout(20) << __func__ << "    shard " << *s.shard_info << dendl;
-	expecting_shards.push_back(string());
-	get_extent_shard_key(o->key, s.shard_info->offset,
-			     &expecting_shards.back());
-	if (s.shard_info->offset >= o->onode.size) {
-	  derr << "fsck error: " << oid << " shard 0x" << std::hex
-	       << s.shard_info->offset << " past EOF at 0x" << o->onode.size
-	       << std::dec << dendl;
-	  ++errors;
-	}
-      }
-      // lextents
-      map<BlobRef,bluestore_blob_t::unused_t> referenced;
-      uint64_t pos = 0;
-      mempool::bluestore_fsck::map<BlobRef,
-				   bluestore_blob_use_tracker_t> ref_map;
-      for (auto& l : o->extent_map.extent_map) {
-	dout(20) << __func__ << "    " << l << dendl;
-	if (l.logical_offset < pos) {
-	  derr << "fsck error: " << oid << " lextent at 0x"
-	       << std::hex << l.logical_offset
-	       << " overlaps with the previous, which ends at 0x" << pos
-	       << std::dec << dendl;
-	  ++errors;
-	}
-	if (o->extent_map.spans_shard(l.logical_offset, l.length)) {
-	  derr << "fsck error: " << oid << " lextent at 0x"
-	       << std::hex << l.logical_offset << "~" << l.length
-	       << " spans a shard boundary"
-	       << std::dec << dendl;
-	  ++errors;
-	}
-	pos = l.logical_offset + l.length;
-	onode_statfs.data_stored += l.length;
-	ceph_assert(l.blob);
-	const bluestore_blob_t& blob = l.blob->get_blob();
-
-        auto& ref = ref_map[l.blob];
-        if (ref.is_empty()) {
-          uint32_t min_release_size = blob.get_release_size(min_alloc_size);
-          uint32_t l = blob.get_logical_length();
-          ref.init(l, min_release_size);
-        }
-	ref.get(
-	  l.blob_offset, 
-	  l.length);
-	++num_extents;
-	if (blob.has_unused()) {
-	  auto p = referenced.find(l.blob);
-	  bluestore_blob_t::unused_t *pu;
-	  if (p == referenced.end()) {
-	    pu = &referenced[l.blob];
-	  } else {
-	    pu = &p->second;
-	  }
-	  uint64_t blob_len = blob.get_logical_length();
-	  ceph_assert((blob_len % (sizeof(*pu)*8)) == 0);
-	  ceph_assert(l.blob_offset + l.length <= blob_len);
-	  uint64_t chunk_size = blob_len / (sizeof(*pu)*8);
-	  uint64_t start = l.blob_offset / chunk_size;
-	  uint64_t end =
-	    round_up_to(l.blob_offset + l.length, chunk_size) / chunk_size;
-	  for (auto i = start; i < end; ++i) {
-	    (*pu) |= (1u << i);
-	  }
-	}
-      }
-      for (auto &i : referenced) {
-	dout(20) << __func__ << "  referenced 0x" << std::hex << i.second
-		 << std::dec << " for " << *i.first << dendl;
-	const bluestore_blob_t& blob = i.first->get_blob();
-	if (i.second & blob.unused) {
-	  derr << "fsck error: " << oid << " blob claims unused 0x"
-	       << std::hex << blob.unused
-	       << " but extents reference 0x" << i.second << std::dec
-	       << " on blob " << *i.first << dendl;
-	  ++errors;
-	}
-	if (blob.has_csum()) {
-	  uint64_t blob_len = blob.get_logical_length();
-	  uint64_t unused_chunk_size = blob_len / (sizeof(blob.unused)*8);
-	  unsigned csum_count = blob.get_csum_count();
-	  unsigned csum_chunk_size = blob.get_csum_chunk_size();
-	  for (unsigned p = 0; p < csum_count; ++p) {
-	    unsigned pos = p * csum_chunk_size;
-	    unsigned firstbit = pos / unused_chunk_size;    // [firstbit,lastbit]
-	    unsigned lastbit = (pos + csum_chunk_size - 1) / unused_chunk_size;
-	    unsigned mask = 1u << firstbit;
-	    for (unsigned b = firstbit + 1; b <= lastbit; ++b) {
-	      mask |= 1u << b;
-	    }
-	    if ((blob.unused & mask) == mask) {
-	      // this csum chunk region is marked unused
-	      if (blob.get_csum_item(p) != 0) {
-		derr << "fsck error: " << oid
-		     << " blob claims csum chunk 0x" << std::hex << pos
-		     << "~" << csum_chunk_size
-		     << " is unused (mask 0x" << mask << " of unused 0x"
-		     << blob.unused << ") but csum is non-zero 0x"
-		     << blob.get_csum_item(p) << std::dec << " on blob "
-		     << *i.first << dendl;
-		++errors;
-	      }
-	    }
-	  }
-	}
-      }
-      for (auto &i : ref_map) {
-	++num_blobs;
-	const bluestore_blob_t& blob = i.first->get_blob();
-	bool equal = i.first->get_blob_use_tracker().equal(i.second);
-	if (!equal) {
-	  derr << "fsck error: " << oid << " blob " << *i.first
-	       << " doesn't match expected ref_map " << i.second << dendl;
-	  ++errors;
-	}
-	if (blob.is_compressed()) {
-	  onode_statfs.data_compressed += blob.get_compressed_payload_length();
-	  onode_statfs.data_compressed_original +=
-	    i.first->get_referenced_bytes();
-	}
-	if (blob.is_shared()) {
-	  if (i.first->shared_blob->get_sbid() > blobid_max) {
-	    derr << "fsck error: " << oid << " blob " << blob
-		 << " sbid " << i.first->shared_blob->get_sbid() << " > blobid_max "
-		 << blobid_max << dendl;
-	    ++errors;
-	  } else if (i.first->shared_blob->get_sbid() == 0) {
-            derr << "fsck error: " << oid << " blob " << blob
-                 << " marked as shared but has uninitialized sbid"
-                 << dendl;
-            ++errors;
-          }
-	  sb_info_t& sbi = sb_info[i.first->shared_blob->get_sbid()];
-	  ceph_assert(sbi.cid == coll_t() || sbi.cid == c->cid);
-	  ceph_assert(sbi.pool_id == INT64_MIN ||
-	              sbi.pool_id == oid.hobj.get_logical_pool());
-	  sbi.cid = c->cid;
-	  sbi.pool_id = oid.hobj.get_logical_pool();
-	  sbi.sb = i.first->shared_blob;
-	  sbi.oids.push_back(oid);
-	  sbi.compressed = blob.is_compressed();
-	  for (auto e : blob.get_extents()) {
-	    if (e.is_valid()) {
-	      sbi.ref_map.get(e.offset, e.length);
-	    }
-	  }
-	} else {
-	  errors += _fsck_check_extents(c->cid, oid, blob.get_extents(),
-					blob.is_compressed(),
-					used_blocks,
-					fm->get_alloc_size(),
-					repair ? &repairer : nullptr,
-					onode_statfs);
-        }
-      }
-      if (deep) {
-	bufferlist bl;
-	uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
-	uint64_t offset = 0;
-	do {
-	  uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
-	  int r = _do_read(c.get(), o, offset, l, bl,
-	    CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
-	  if (r < 0) {
-	    ++errors;
-	    derr << "fsck error: " << oid << std::hex
-	         << " error during read: "
-		 << " " << offset << "~" << l
-		 << " " << cpp_strerror(r) << std::dec
-		 << dendl;
-	    break;
-	  }
-	  offset += l;
-	} while (offset < o->onode.size);
-      }
-      // omap
-      if (o->onode.has_omap()) {
-	auto& m =
-	  o->onode.is_pgmeta_omap() ? used_pgmeta_omap_head : used_omap_head;
-	if (m.count(o->onode.nid)) {
-	  derr << "fsck error: " << oid << " omap_head " << o->onode.nid
-	       << " already in use" << dendl;
-	  ++errors;
-	} else {
-	  m.insert(o->onode.nid);
-	}
-      }
-      expected_statfs->add(onode_statfs);
-    } // for (it->lower_bound(string()); it->valid(); it->next())
-  } // if (it)
-
-  dout(1) << __func__ << " checking shared_blobs" << dendl;
-  it = db->get_iterator(PREFIX_SHARED_BLOB);
-  if (it) {
-    //fill global if not overriden below
-    expected_statfs = &expected_store_statfs;
-
-    for (it->lower_bound(string()); it->valid(); it->next()) {
-      string key = it->key();
-      uint64_t sbid;
-      if (get_key_shared_blob(key, &sbid)) {
-	derr << "fsck error: bad key '" << key
-	     << "' in shared blob namespace" << dendl;
-	if (repair) {
-	  repairer.remove_key(db, PREFIX_SHARED_BLOB, key);
-	}
-	++errors;
-	continue;
-      }
-      auto p = sb_info.find(sbid);
-      if (p == sb_info.end()) {
-	derr << "fsck error: found stray shared blob data for sbid 0x"
-	     << std::hex << sbid << std::dec << dendl;
-	if (repair) {
-	  repairer.remove_key(db, PREFIX_SHARED_BLOB, key);
-	}
-	++errors;
-      } else {
-	++num_shared_blobs;
-	sb_info_t& sbi = p->second;
-	bluestore_shared_blob_t shared_blob(sbid);
-	bufferlist bl = it->value();
-	auto blp = bl.cbegin();
-	try {
-    	  decode(shared_blob, blp);
-	} catch (buffer::error& e) {
-          ++errors;
-          // Force update and don't report as missing
-          sbi.updated = sbi.passed = true;
-
-          derr << "fsck error: failed to decode Shared Blob"
-    	       << pretty_binary_string(it->key()) << dendl;
-          if (repair) {
-    	    dout(20) << __func__ << " undecodable Shared Blob, key:'"
-	             << pretty_binary_string(it->key())
-	    	     << "', removing" << dendl;
-            repairer.remove_key(db, PREFIX_DEFERRED, it->key());
-          }
-          continue;
-        }	
-	dout(20) << __func__ << "  " << *sbi.sb << " " << shared_blob << dendl;
-	if (shared_blob.ref_map != sbi.ref_map) {
-	  derr << "fsck error: shared blob 0x" << std::hex << sbid
-		<< std::dec << " ref_map " << shared_blob.ref_map
-		<< " != expected " << sbi.ref_map << dendl;
-	  sbi.updated = true; // will update later in repair mode only!
+	bluefs_extents_db.union_of(bluefs_extents);
+	bluefs_extents_db.subtract(bluefs_extents);
+	if (!bluefs_extents_db.empty()) {
+	  derr << "fsck error: bluefs_extents inconsistency, "
+	       << "downgrade to previous releases might be broken."
+	       << dendl;
 	  ++errors;
 	}
-	PExtentVector extents;
-	for (auto &r : shared_blob.ref_map.ref_map) {
-	  extents.emplace_back(bluestore_pextent_t(r.first, r.second.length));
-	}
-	if (need_per_pool_stats) {
-	  expected_statfs = &expected_pool_statfs[sbi.pool_id];
-	}
-	errors += _fsck_check_extents(sbi.cid,
-				      p->second.oids.front(),
-				      extents,
-				      p->second.compressed,
-				      used_blocks,
-				      fm->get_alloc_size(),
-				      repair ? &repairer : nullptr,
-				      *expected_statfs);
-	sbi.passed = true;
+      }
+      catch (buffer::error& e) {
+	derr << "fsck error: failed to retrieve bluefs_extents from kv" << dendl;
+	++errors;
+      }
+      if (errors != prev_errors && repair) {
+	repairer.fix_bluefs_extents(out_of_sync_fm);
       }
     }
-  } // if (it)
+
+    for (auto e = bluefs_extents.begin(); e != bluefs_extents.end(); ++e) {
+      apply(
+        e.get_start(), e.get_len(), fm->get_alloc_size(), used_blocks,
+        [&](uint64_t pos, mempool_dynamic_bitset &bs) {
+	ceph_assert(pos < bs.size());
+          bs.set(pos);
+        }
+	);
+    }
+    r = bluefs->fsck();
+    if (r < 0) {
+      goto out_scan;
+    }
+    if (r > 0)
+      errors += r;
+  }
+
+  // get expected statfs; reset unaffected fields to be able to compare
+  // structs
+  statfs(&actual_statfs);
+  actual_statfs.total = 0;
+  actual_statfs.internally_reserved = 0;
+  actual_statfs.available = 0;
+  actual_statfs.internal_metadata = 0;
+  actual_statfs.omap_allocated = 0;
+
+  need_per_pool_stats = per_pool_stat_collection || need_per_pool_stats;
+  ctx.need_per_pool_stats = need_per_pool_stats;
+
+  // walk PREFIX_OBJ
+  dout(1) << __func__ << " walking object keyspace" << dendl;
+  for (auto& p : coll_map) {
+    ctx.colls.push_back(p.second);
+  }
+  _fsck_check_objects(ctx);
+  if (ctx.aborted) {
+    goto out_scan;
+  }
+
+  dout(1) << __func__ << " checking shared_blobs" << dendl;
+  _fsck_check_shared_blobs(ctx);
 
   if (repair && repairer.preprocess_misreference(db)) {
 
@@ -7435,7 +8919,7 @@ int BlueStore::_fsck(bool deep, bool repair)
 
 	    bufferlist bl;
 	    IOContext ioc(cct, NULL, true); // allow EIO
-	    r = bdev->read(e->offset, e->length, &bl, &ioc, false);
+	    r = _bdev_read(e->offset, e->length, &bl, &ioc);
 	    if (r < 0) {
 	      derr << __func__ << " failed to read from 0x" << std::hex << e->offset
 		    <<"~" << e->length << std::dec << dendl;
@@ -7447,7 +8931,7 @@ int BlueStore::_fsck(bool deep, bool repair)
 	    b->get_blob().map_bl(
 	      b_off, bl,
 	      [&](uint64_t offset, bufferlist& t) {
-		int r = bdev->write(offset, t, false);
+		int r = _bdev_write(offset, t, false);
 		ceph_assert(r == 0);
 	      });
 	    e += exts.size() - 1;
@@ -7553,30 +9037,8 @@ int BlueStore::_fsck(bool deep, bool repair)
   }
 
   dout(1) << __func__ << " checking for stray omap data" << dendl;
-  it = db->get_iterator(PREFIX_OMAP);
-  if (it) {
-    for (it->lower_bound(string()); it->valid(); it->next()) {
-      uint64_t omap_head;
-      _key_decode_u64(it->key().c_str(), &omap_head);
-      if (used_omap_head.count(omap_head) == 0) {
-	derr << "fsck error: found stray omap data on omap_head "
-	     << omap_head << dendl;
-	++errors;
-      }
-    }
-  }
-  it = db->get_iterator(PREFIX_PGMETA_OMAP);
-  if (it) {
-    for (it->lower_bound(string()); it->valid(); it->next()) {
-      uint64_t omap_head;
-      _key_decode_u64(it->key().c_str(), &omap_head);
-      if (used_pgmeta_omap_head.count(omap_head) == 0) {
-	derr << "fsck error: found stray omap data on omap_head "
-	     << omap_head << dendl;
-	++errors;
-      }
-    }
-  }
+  _fsck_check_stray_omap(ctx, false);
+  _fsck_check_stray_omap(ctx, true);
 
   dout(1) << __func__ << " checking deferred events" << dendl;
   it = db->get_iterator(PREFIX_DEFERRED);
@@ -7602,8 +9064,10 @@ int BlueStore::_fsck(bool deep, bool repair)
 	       << " ops " << wt.ops.size()
 	       << " released 0x" << std::hex << wt.released << std::dec << dendl;
       for (auto e = wt.released.begin(); e != wt.released.end(); ++e) {
+	bool fast = _is_fast_tier(e.get_start());
         apply(
-          e.get_start(), e.get_len(), fm->get_alloc_size(), used_blocks,
+          fast ? e.get_start() - FAST_TIER_BASE : e.get_start(), e.get_len(),
+	  fm->get_alloc_size(), fast ? ctx.fast_used_blocks : used_blocks,
           [&](uint64_t pos, mempool_dynamic_bitset &bs) {
 	ceph_assert(pos < bs.size());
             bs.set(pos);
@@ -7671,7 +9135,7 @@ int BlueStore::_fsck(bool deep, bool repair)
       ceph_assert(used_blocks.size() > count);
       used_blocks.flip();
       size_t start = used_blocks.find_first();
-      while (start != decltype(used_blocks)::npos) {
+      while (start != mempool_dynamic_bitset::npos) {
 	size_t cur = start;
 	while (true) {
 	  size_t next = used_blocks.find_next(cur);
@@ -7695,6 +9159,64 @@ int BlueStore::_fsck(bool deep, bool repair)
       }
       used_blocks.flip();
     }
+    if (fast_fm) {
+      // same check for the fast tier; offsets are tier-relative here
+      fast_fm->enumerate_reset();
+      while (fast_fm->enumerate_next(db, &offset, &length)) {
+	bool intersects = false;
+	apply(
+	  offset, length, fast_fm->get_alloc_size(), ctx.fast_used_blocks,
+	  [&](uint64_t pos, mempool_dynamic_bitset &bs) {
+	    ceph_assert(pos < bs.size());
+	    if (bs.test(pos)) {
+	      intersects = true;
+	      if (repair) {
+		repairer.fix_false_free(db, fast_fm,
+					pos * min_alloc_size,
+					min_alloc_size);
+	      }
+	    } else {
+	      bs.set(pos);
+	    }
+	  }
+	);
+	if (intersects) {
+	  derr << "fsck error: free extent 0x" << std::hex << offset
+	       << "~" << length << std::dec
+	       << " intersects allocated blocks (fast tier)" << dendl;
+	  ++errors;
+	}
+      }
+      fast_fm->enumerate_reset();
+      auto& fast_used = ctx.fast_used_blocks;
+      if (fast_used.size() != fast_used.count()) {
+	fast_used.flip();
+	size_t start = fast_used.find_first();
+	while (start != mempool_dynamic_bitset::npos) {
+	  size_t cur = start;
+	  while (true) {
+	    size_t next = fast_used.find_next(cur);
+	    if (next != cur + 1) {
+	      ++errors;
+	      derr << "fsck error: leaked extent 0x" << std::hex
+		   << ((uint64_t)start * fast_fm->get_alloc_size()) << "~"
+		   << ((cur + 1 - start) * fast_fm->get_alloc_size()) << std::dec
+		   << " (fast tier)" << dendl;
+	      if (repair) {
+		repairer.fix_leaked(db,
+				    fast_fm,
+				    start * min_alloc_size,
+				    (cur + 1 - start) * min_alloc_size);
+	      }
+	      start = next;
+	      break;
+	    }
+	    cur = next;
+	  }
+	}
+	fast_used.flip();
+      }
+    }
   }
   if (repair) {
     dout(5) << __func__ << " applying repair results" << dendl;
@@ -7717,14 +9239,15 @@ int BlueStore::_fsck(bool deep, bool repair)
   // fatal errors take precedence
   if (r < 0)
     return r;
+  errors += ctx.errors;
 
-  dout(2) << __func__ << " " << num_objects << " objects, "
-	  << num_sharded_objects << " of them sharded.  "
+  dout(2) << __func__ << " " << ctx.num_objects << " objects, "
+	  << ctx.num_sharded_objects << " of them sharded.  "
 	  << dendl;
-  dout(2) << __func__ << " " << num_extents << " extents to "
-	  << num_blobs << " blobs, "
-	  << num_spanning_blobs << " spanning, "
-	  << num_shared_blobs << " shared."
+  dout(2) << __func__ << " " << ctx.num_extents << " extents to "
+	  << ctx.num_blobs << " blobs, "
+	  << ctx.num_spanning_blobs << " spanning, "
+	  << ctx.num_shared_blobs << " shared."
 	  << dendl;
 
   utime_t duration = ceph_clock_now() - start;
@@ -7803,6 +9326,20 @@ void BlueStore::inject_false_free(coll_t cid, ghobject_t oid)
   db->submit_transaction_sync(txn);
 }
 
+void BlueStore::inject_onode_warmup_record(bufferlist& bl)
+{
+  ceph_assert(bluefs);
+  int r = _write_onode_warmup_file(bl);
+  ceph_assert(r == 0);
+}
+
+void BlueStore::wait_for_onode_warmup()
+{
+  if (onode_warmup_thread.is_started()) {
+    onode_warmup_thread.join();
+  }
+}
+
 void BlueStore::inject_statfs(const string& key, const store_statfs_t& new_statfs)
 {
   BlueStoreRepairer repairer;
@@ -7996,6 +9533,11 @@ void BlueStore::_get_statfs_overall(struct store_statfs_t *buf)
     if (bluefs_shared_bdev != BlueFS::BDEV_DB) {
       buf->total += bluefs->get_total(BlueFS::BDEV_DB);
     }
+    // and the part of it which bluefs doesn't own
+    if (fast_alloc) {
+      buf->total += fast_tier_size;
+      bfree += fast_alloc->get_free();
+    }
     // call any non-omap bluefs space "internal metadata"
     buf->internal_metadata =
       std::max(bluefs->get_used(), (uint64_t)cct->_conf->bluestore_bluefs_min)
@@ -8123,8 +9665,13 @@ void BlueStore::_update_cache_logger()
   uint64_t num_buffers = 0;
   uint64_t num_buffer_bytes = 0;
   for (auto c : cache_shards) {
-    c->add_stats(&num_onodes, &num_extents, &num_blobs,
-		 &num_buffers, &num_buffer_bytes);
+    uint64_t shard_onodes = 0;
+    uint64_t shard_buffer_bytes = 0;
+    c->add_stats(&shard_onodes, &num_extents, &num_blobs,
+		 &num_buffers, &shard_buffer_bytes);
+    c->update_shard_logger(shard_onodes, shard_buffer_bytes);
+    num_onodes += shard_onodes;
+    num_buffer_bytes += shard_buffer_bytes;
   }
   logger->set(l_bluestore_onodes, num_onodes);
   logger->set(l_bluestore_extents, num_extents);
@@ -8147,7 +9694,7 @@ ObjectStore::CollectionHandle BlueStore::create_new_collection(
   RWLock::WLocker l(coll_lock);
   Collection *c = new Collection(
     this,
-    cache_shards[cid.hash_to_shard(cache_shards.size())],
+    _get_collection_caches(cid),
     cid);
   new_coll_map[cid] = c;
   _osr_attach(c);
@@ -8265,6 +9812,8 @@ int BlueStore::read(
     r = _do_read(c, o, offset, length, bl, op_flags);
     if (r == -EIO) {
       logger->inc(l_bluestore_read_eio);
+    } else if (r >= 0) {
+      _tier_note_read(c, o.get());
     }
   }
 
@@ -8279,115 +9828,388 @@ int BlueStore::read(
     dout(0) << __func__ << ": inject random EIO" << dendl;
     r = -EIO;
   }
-  dout(10) << __func__ << " " << cid << " " << oid
-	   << " 0x" << std::hex << offset << "~" << length << std::dec
-	   << " = " << r << dendl;
-  logger->tinc(l_bluestore_read_lat, mono_clock::now() - start);
-  return r;
-}
-
-// --------------------------------------------------------
-// intermediate data structures used while reading
-struct region_t {
-  uint64_t logical_offset;
-  uint64_t blob_xoffset;   //region offset within the blob
-  uint64_t length;
-
-  // used later in read process
-  uint64_t front = 0;
-
-  region_t(uint64_t offset, uint64_t b_offs, uint64_t len, uint64_t front = 0)
-    : logical_offset(offset),
-    blob_xoffset(b_offs),
-    length(len),
-    front(front){}
-  region_t(const region_t& from)
-    : logical_offset(from.logical_offset),
-    blob_xoffset(from.blob_xoffset),
-    length(from.length),
-    front(from.front){}
-
-  friend ostream& operator<<(ostream& out, const region_t& r) {
-    return out << "0x" << std::hex << r.logical_offset << ":"
-      << r.blob_xoffset << "~" << r.length << std::dec;
+  dout(10) << __func__ << " " << cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << " = " << r << dendl;
+  logger->tinc(l_bluestore_read_lat, mono_clock::now() - start);
+  return r;
+}
+
+int BlueStore::read_multi(
+  CollectionHandle &c_,
+  vector<read_multi_op_t>& ops,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->cid << " " << ops.size() << " objects"
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+
+  // per-object state carried between the read phases
+  struct pending_t {
+    OnodeRef o;
+    uint64_t length = 0;
+    ready_regions_t ready_regions;
+    blobs2read_t blobs2read;
+    vector<bufferlist> compressed_blob_bls;
+  };
+  vector<pending_t> pending(ops.size());
+  bool buffered = _is_buffered_read(op_flags);
+  int read_cache_policy = 0;
+  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
+    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+  }
+  {
+    RWLock::RLocker l(c->lock);
+    auto start1 = mono_clock::now();
+    vector<ghobject_t> oids;
+    oids.reserve(ops.size());
+    for (auto& op : ops) {
+      oids.push_back(op.oid);
+    }
+    vector<OnodeRef> onodes;
+    c->get_onodes(oids, &onodes);
+
+    // serve what we can from the cache and collect the rest
+    unsigned num_regions = 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      auto& op = ops[i];
+      auto& p = pending[i];
+      op.bl.clear();
+      op.r = 0;
+      OnodeRef& o = onodes[i];
+      if (!o || !o->exists) {
+	op.r = -ENOENT;
+	continue;
+      }
+      uint64_t length = op.len;
+      if (op.offset == length && op.offset == 0)
+	length = o->onode.size;
+      if (op.offset >= o->onode.size) {
+	continue;
+      }
+      p.length = std::min(length, o->onode.size - op.offset);
+      if (o->onode.has_inline_data()) {
+	// nothing to batch, the data lives in the onode
+	op.r = _do_read(c, o, op.offset, p.length, op.bl, op_flags);
+	continue;
+      }
+      p.o = o;
+      o->extent_map.fault_range(db, op.offset, p.length);
+      _dump_onode(o);
+      num_regions += _read_cache(o, op.offset, p.length, read_cache_policy,
+				 p.ready_regions, p.blobs2read);
+    }
+    logger->tinc(l_bluestore_read_onode_meta_lat, mono_clock::now() - start1);
+
+    // a single submission for the whole batch
+    start1 = mono_clock::now();
+    IOContext ioc(cct, NULL, true); // allow EIO
+    bool eio = false;
+    for (auto& p : pending) {
+      if (p.o &&
+	  _prepare_read_ioc(p.blobs2read, num_regions, &p.compressed_blob_bls,
+			    &ioc) < 0) {
+	eio = true;
+	break;
+      }
+    }
+    if (!eio && ioc.has_pending_aios()) {
+      bdev->aio_submit(&ioc);
+      dout(20) << __func__ << " waiting for aio" << dendl;
+      ioc.aio_wait();
+      int r = ioc.get_return_value();
+      if (r < 0) {
+	ceph_assert(r == -EIO); // no other errors allowed
+	eio = true;
+      }
+    }
+    logger->tinc(l_bluestore_read_wait_aio_lat, mono_clock::now() - start1);
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+      auto& op = ops[i];
+      auto& p = pending[i];
+      if (!p.o) {
+	continue;
+      }
+      int r;
+      if (eio) {
+	// we can't tell which object failed; find out one by one
+	r = _do_read(c, p.o, op.offset, p.length, op.bl, op_flags);
+      } else {
+	bool csum_error = false;
+	r = _generate_read_result_bl(p.o, op.offset, p.length,
+				     p.ready_regions, p.compressed_blob_bls,
+				     p.blobs2read, buffered, &csum_error,
+				     op.bl);
+	if (csum_error) {
+	  // retry this one on its own, see _do_read
+	  if (cct->_conf->bluestore_retry_disk_reads) {
+	    r = _do_read(c, p.o, op.offset, p.length, op.bl, op_flags, 1);
+	  }
+	} else if (r == 0) {
+	  r = op.bl.length();
+	}
+      }
+      if (r == -EIO) {
+	logger->inc(l_bluestore_read_eio);
+      } else if (r >= 0) {
+	_tier_note_read(c, p.o.get());
+      }
+      op.r = r;
+    }
+  }
+
+  for (auto& op : ops) {
+    if (op.r >= 0 && _debug_data_eio(op.oid)) {
+      op.r = -EIO;
+      derr << __func__ << " " << c->cid << " " << op.oid << " INJECT EIO"
+	   << dendl;
+    }
+    dout(10) << __func__ << " " << c->cid << " " << op.oid
+	     << " 0x" << std::hex << op.offset << "~" << op.len << std::dec
+	     << " = " << op.r << dendl;
+  }
+  logger->inc(l_bluestore_read_multi_ops, ops.size());
+  logger->tinc(l_bluestore_read_multi_lat, mono_clock::now() - start);
+  return 0;
+}
+
+int BlueStore::digest(
+  CollectionHandle &c_,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t length,
+  uint32_t *digest,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+
+  int r;
+  {
+    RWLock::RLocker l(c->lock);
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      r = -ENOENT;
+    } else {
+      r = _do_digest(c, o, offset, length, digest, op_flags);
+      if (r == -EIO) {
+	logger->inc(l_bluestore_read_eio);
+      }
+    }
+  }
+  if (r >= 0 && _debug_data_eio(oid)) {
+    r = -EIO;
+    derr << __func__ << " " << c->cid << " " << oid << " INJECT EIO" << dendl;
+  }
+  dout(10) << __func__ << " " << c->cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length
+	   << " = " << std::dec << r << " digest 0x" << std::hex << *digest
+	   << std::dec << dendl;
+  logger->tinc(l_bluestore_digest_lat, mono_clock::now() - start);
+  return r;
+}
+
+int BlueStore::_do_digest(
+  Collection *c,
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  uint32_t *digest,
+  uint32_t op_flags,
+  uint64_t retry_count)
+{
+  dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
+	   << " size 0x" << o->onode.size << std::dec << dendl;
+  if (offset >= o->onode.size) {
+    return 0;
+  }
+  if (offset + length > o->onode.size) {
+    length = o->onode.size - offset;
+  }
+  if (o->onode.has_inline_data()) {
+    bufferlist bl;
+    int r = _do_read(c, o, offset, length, bl, op_flags);
+    if (r >= 0) {
+      *digest = bl.crc32c(*digest);
+      logger->inc(l_bluestore_digest_bytes, r);
+    }
+    return r;
+  }
+
+  o->extent_map.fault_range(db, offset, length);
+  _dump_onode(o);
+
+  // like _do_read, but only trust dirty buffers: the point is to look at
+  // what is on the device
+  ready_regions_t ready_regions;
+  blobs2read_t blobs2read;
+  unsigned num_regions = _read_cache(o, offset, length,
+				     BufferSpace::BYPASS_CLEAN_CACHE,
+				     ready_regions, blobs2read);
+  auto start = mono_clock::now();
+  vector<bufferlist> compressed_blob_bls;
+  IOContext ioc(cct, NULL, true); // allow EIO
+  int r = _prepare_read_ioc(blobs2read, num_regions, &compressed_blob_bls,
+			    &ioc);
+  if (r < 0)
+    return r;
+  if (ioc.has_pending_aios()) {
+    bdev->aio_submit(&ioc);
+    dout(20) << __func__ << " waiting for aio" << dendl;
+    ioc.aio_wait();
+    r = ioc.get_return_value();
+    if (r < 0) {
+      ceph_assert(r == -EIO); // no other errors allowed
+      return -EIO;
+    }
+  }
+  logger->tinc(l_bluestore_read_wait_aio_lat, mono_clock::now() - start);
+
+  // what to fold in at each logical offset: either data, or a range of a
+  // crc32c blob whose (just verified) stored checksums stand in for it
+  struct digest_region_t {
+    bufferlist bl;
+    const bluestore_blob_t *blob = nullptr;
+    uint64_t b_off = 0;
+    uint64_t length = 0;
+  };
+  map<uint64_t, digest_region_t> regions;
+  for (auto& p : ready_regions) {
+    regions[p.first].bl.claim(p.second);
+  }
+  bool csum_error = false;
+  auto pc = compressed_blob_bls.begin();
+  for (auto& b : blobs2read) {
+    const bluestore_blob_t& blob = b.first->get_blob();
+    regions2read_t& r2r = b.second;
+    if (blob.is_compressed()) {
+      bufferlist& compressed_bl = *pc++;
+      if (_verify_csum(o, &blob, 0, compressed_bl,
+		       r2r.front().regs.front().logical_offset) < 0) {
+	csum_error = true;
+	break;
+      }
+      bufferlist raw_bl;
+      r = _decompress(compressed_bl, &raw_bl);
+      if (r < 0)
+	return r;
+      for (auto& req : r2r) {
+	for (auto& reg : req.regs) {
+	  regions[reg.logical_offset].bl.substr_of(
+	    raw_bl, reg.blob_xoffset, reg.length);
+	}
+      }
+      continue;
+    }
+    uint64_t csum_chunk = blob.get_csum_chunk_size();
+    bool use_csum = blob.csum_type == Checksummer::CSUM_CRC32C &&
+      !cct->_conf->bluestore_ignore_data_csum;
+    for (auto& req : r2r) {
+      if (_verify_csum(o, &blob, req.r_off, req.bl,
+		       req.regs.front().logical_offset) < 0) {
+	csum_error = true;
+	break;
+      }
+      for (auto& reg : req.regs) {
+	auto& d = regions[reg.logical_offset];
+	if (use_csum &&
+	    reg.blob_xoffset % csum_chunk == 0 &&
+	    reg.length % csum_chunk == 0) {
+	  d.blob = &blob;
+	  d.b_off = reg.blob_xoffset;
+	  d.length = reg.length;
+	} else {
+	  d.bl.substr_of(req.bl, reg.front, reg.length);
+	}
+      }
+    }
+    if (csum_error) {
+      break;
+    }
+  }
+  if (csum_error) {
+    // see _do_read
+    if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
+      return -EIO;
+    }
+    return _do_digest(c, o, offset, length, digest, op_flags,
+		      retry_count + 1);
   }
-};
 
-// merged blob read request
-struct read_req_t {
-  uint64_t r_off = 0;
-  uint64_t r_len = 0;
-  bufferlist bl;
-  std::list<region_t> regs; // original read regions
-
-  read_req_t(uint64_t off, uint64_t len) : r_off(off), r_len(len) {}
-
-  friend ostream& operator<<(ostream& out, const read_req_t& r) {
-    out << "{<0x" << std::hex << r.r_off << ", 0x" << r.r_len << "> : [";
-    for (const auto& reg : r.regs)
-      out << reg;
-    return out << "]}" << std::dec;
+  // crc32c as used here is linear, so for a chunk x of n bytes
+  //   crc(s, x) = crc(s, 0^n) ^ crc(-1, 0^n) ^ crc(-1, x)
+  // where crc(-1, x) is exactly what the blob stores.
+  uint32_t crc = *digest;
+  uint64_t pos = offset;
+  uint64_t csum_bytes = 0;
+  for (auto& p : regions) {
+    if (p.first > pos) {
+      crc = ceph_crc32c_zeros(crc, p.first - pos);
+      pos = p.first;
+    }
+    auto& d = p.second;
+    if (d.blob) {
+      uint64_t csum_chunk = d.blob->get_csum_chunk_size();
+      uint32_t seed_zeros = ceph_crc32c_zeros(-1, csum_chunk);
+      for (uint64_t x = 0; x < d.length; x += csum_chunk) {
+	uint32_t csum = d.blob->get_csum_item((d.b_off + x) / csum_chunk);
+	crc = ceph_crc32c_zeros(crc, csum_chunk) ^ seed_zeros ^ csum;
+      }
+      pos += d.length;
+      csum_bytes += d.length;
+    } else {
+      crc = d.bl.crc32c(crc);
+      pos += d.bl.length();
+    }
   }
-};
-
-typedef list<read_req_t> regions2read_t;
-typedef map<BlueStore::BlobRef, regions2read_t> blobs2read_t;
-
-int BlueStore::_do_read(
-  Collection *c,
-  OnodeRef o,
-  uint64_t offset,
-  size_t length,
-  bufferlist& bl,
-  uint32_t op_flags,
-  uint64_t retry_count)
-{
-  FUNCTRACE(cct);
-  int r = 0;
-  int read_cache_policy = 0; // do not bypass clean or dirty cache
-
-  dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
-           << " size 0x" << o->onode.size << " (" << std::dec
-           << o->onode.size << ")" << dendl;
-  bl.clear();
-
-  if (offset >= o->onode.size) {
-    return r;
+  if (pos < offset + length) {
+    crc = ceph_crc32c_zeros(crc, offset + length - pos);
+  }
+  ceph_assert(pos <= offset + length);
+  *digest = crc;
+  if (retry_count) {
+    logger->inc(l_bluestore_reads_with_retries);
   }
+  logger->inc(l_bluestore_digest_bytes, length);
+  logger->inc(l_bluestore_digest_csum_bytes, csum_bytes);
+  return length;
+}
 
+// --------------------------------------------------------
+bool BlueStore::_is_buffered_read(uint32_t op_flags)
+{
   // generally, don't buffer anything, unless the client explicitly requests
   // it.
-  bool buffered = false;
   if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_WILLNEED) {
     dout(20) << __func__ << " will do buffered read" << dendl;
-    buffered = true;
+    return true;
   } else if (cct->_conf->bluestore_default_buffered_read &&
 	     (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
 			  CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0) {
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
-    buffered = true;
-  }
-
-  if (offset + length > o->onode.size) {
-    length = o->onode.size - offset;
-  }
-
-  auto start = mono_clock::now();
-  o->extent_map.fault_range(db, offset, length);
-  logger->tinc(l_bluestore_read_onode_meta_lat, mono_clock::now() - start);
-  _dump_onode(o);
-
-  ready_regions_t ready_regions;
-
-  // for deep-scrub, we only read dirty cache and bypass clean cache in
-  // order to read underlying block device in case there are silent disk errors.
-  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
-    dout(20) << __func__ << " will bypass cache and do direct read" << dendl;
-    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+    return true;
   }
+  return false;
+}
 
+unsigned BlueStore::_read_cache(
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  int read_cache_policy,
+  ready_regions_t& ready_regions,
+  blobs2read_t& blobs2read)
+{
   // build blob-wise list to of stuff read (that isn't cached)
-  blobs2read_t blobs2read;
   unsigned left = length;
   uint64_t pos = offset;
   unsigned num_regions = 0;
@@ -8476,13 +10298,15 @@ int BlueStore::_do_read(
     }
     ++lp;
   }
+  return num_regions;
+}
 
-  // read raw blob data.  use aio if we have >1 blobs to read.
-  start = mono_clock::now(); // for the sake of simplicity
-                             // measure the whole block below.
-                             // The error isn't that much...
-  vector<bufferlist> compressed_blob_bls;
-  IOContext ioc(cct, NULL, true); // allow EIO
+int BlueStore::_prepare_read_ioc(
+  blobs2read_t& blobs2read,
+  unsigned num_regions,
+  vector<bufferlist>* compressed_blob_bls,
+  IOContext* ioc)
+{
   for (auto& p : blobs2read) {
     const BlobRef& bptr = p.first;
     regions2read_t& r2r = p.second;
@@ -8490,21 +10314,21 @@ int BlueStore::_do_read(
 	     << " need " << r2r << std::dec << dendl;
     if (bptr->get_blob().is_compressed()) {
       // read the whole thing
-      if (compressed_blob_bls.empty()) {
+      if (compressed_blob_bls->empty()) {
 	// ensure we avoid any reallocation on subsequent blobs
-	compressed_blob_bls.reserve(blobs2read.size());
+	compressed_blob_bls->reserve(blobs2read.size());
       }
-      compressed_blob_bls.push_back(bufferlist());
-      bufferlist& bl = compressed_blob_bls.back();
-      r = bptr->get_blob().map(
+      compressed_blob_bls->push_back(bufferlist());
+      bufferlist& bl = compressed_blob_bls->back();
+      int r = bptr->get_blob().map(
 	0, bptr->get_blob().get_ondisk_length(),
 	[&](uint64_t offset, uint64_t length) {
 	  int r;
 	  // use aio if there are more regions to read than those in this blob
 	  if (num_regions > r2r.size()) {
-	    r = bdev->aio_read(offset, length, &bl, &ioc);
+	    r = _bdev_aio_read(offset, length, &bl, ioc);
 	  } else {
-	    r = bdev->read(offset, length, &bl, &ioc, false);
+	    r = _bdev_read(offset, length, &bl, ioc);
 	  }
 	  if (r < 0)
             return r;
@@ -8529,15 +10353,15 @@ int BlueStore::_do_read(
 		 << dendl;
 
 	// read it
-	r = bptr->get_blob().map(
+	int r = bptr->get_blob().map(
 	  req.r_off, req.r_len,
 	  [&](uint64_t offset, uint64_t length) {
 	    int r;
 	    // use aio if there is more than one region to read
 	    if (num_regions > 1) {
-	      r = bdev->aio_read(offset, length, &req.bl, &ioc);
+	      r = _bdev_aio_read(offset, length, &req.bl, ioc);
 	    } else {
-	      r = bdev->read(offset, length, &req.bl, &ioc, false);
+	      r = _bdev_read(offset, length, &req.bl, ioc);
 	    }
 	    if (r < 0)
               return r;
@@ -8556,18 +10380,20 @@ int BlueStore::_do_read(
       }
     }
   }
-  if (ioc.has_pending_aios()) {
-    bdev->aio_submit(&ioc);
-    dout(20) << __func__ << " waiting for aio" << dendl;
-    ioc.aio_wait();
-    r = ioc.get_return_value();
-    if (r < 0) {
-      ceph_assert(r == -EIO); // no other errors allowed
-      return -EIO;
-    }
-  }
-  logger->tinc(l_bluestore_read_wait_aio_lat, mono_clock::now() - start);
+  return 0;
+}
 
+int BlueStore::_generate_read_result_bl(
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  ready_regions_t& ready_regions,
+  vector<bufferlist>& compressed_blob_bls,
+  blobs2read_t& blobs2read,
+  bool buffered,
+  bool* csum_error,
+  bufferlist& bl)
+{
   // enumerate and decompress desired blobs
   auto p = compressed_blob_bls.begin();
   blobs2read_t::iterator b2r_it = blobs2read.begin();
@@ -8581,18 +10407,11 @@ int BlueStore::_do_read(
       bufferlist& compressed_bl = *p++;
       if (_verify_csum(o, &bptr->get_blob(), 0, compressed_bl,
         	       r2r.front().regs.front().logical_offset) < 0) {
-        // Handles spurious read errors caused by a kernel bug.
-        // We sometimes get all-zero pages as a result of the read under
-        // high memory pressure. Retrying the failing read succeeds in most 
-        // cases.
-        // See also: http://tracker.ceph.com/issues/22464
-        if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
-          return -EIO;
-        }
-        return _do_read(c, o, offset, length, bl, op_flags, retry_count + 1);
+	*csum_error = true;
+	return -EIO;
       }
       bufferlist raw_bl;
-      r = _decompress(compressed_bl, &raw_bl);
+      int r = _decompress(compressed_bl, &raw_bl);
       if (r < 0)
 	return r;
       if (buffered) {
@@ -8609,15 +10428,8 @@ int BlueStore::_do_read(
       for (auto& req : r2r) {
 	if (_verify_csum(o, &bptr->get_blob(), req.r_off, req.bl,
 			 req.regs.front().logical_offset) < 0) {
-          // Handles spurious read errors caused by a kernel bug.
-          // We sometimes get all-zero pages as a result of the read under
-          // high memory pressure. Retrying the failing read succeeds in most
-          // cases.
-          // See also: http://tracker.ceph.com/issues/22464
-          if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
-            return -EIO;
-          }
-          return _do_read(c, o, offset, length, bl, op_flags, retry_count + 1);
+	  *csum_error = true;
+	  return -EIO;
 	}
 	if (buffered) {
 	  bptr->shared_blob->bc.did_read(bptr->shared_blob->get_cache(),
@@ -8636,7 +10448,7 @@ int BlueStore::_do_read(
   // generate a resulting buffer
   auto pr = ready_regions.begin();
   auto pr_end = ready_regions.end();
-  pos = 0;
+  uint64_t pos = 0;
   while (pos < length) {
     if (pr != pr_end && pr->first == pos + offset) {
       dout(30) << __func__ << " assemble 0x" << std::hex << pos
@@ -8661,6 +10473,103 @@ int BlueStore::_do_read(
   ceph_assert(bl.length() == length);
   ceph_assert(pos == length);
   ceph_assert(pr == pr_end);
+  return 0;
+}
+
+int BlueStore::_do_read(
+  Collection *c,
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  bufferlist& bl,
+  uint32_t op_flags,
+  uint64_t retry_count)
+{
+  FUNCTRACE(cct);
+  int r = 0;
+  int read_cache_policy = 0; // do not bypass clean or dirty cache
+
+  dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
+           << " size 0x" << o->onode.size << " (" << std::dec
+           << o->onode.size << ")" << dendl;
+  bl.clear();
+
+  if (offset >= o->onode.size) {
+    return r;
+  }
+
+  bool buffered = _is_buffered_read(op_flags);
+
+  if (offset + length > o->onode.size) {
+    length = o->onode.size - offset;
+  }
+
+  if (o->onode.has_inline_data()) {
+    auto& d = o->onode.inline_data;
+    if (offset < d.length()) {
+      bl.append(d, offset, std::min<uint64_t>(length, d.length() - offset));
+    }
+    if (bl.length() < length) {
+      bl.append_zero(length - bl.length());
+    }
+    return bl.length();
+  }
+
+  auto start = mono_clock::now();
+  o->extent_map.fault_range(db, offset, length);
+  logger->tinc(l_bluestore_read_onode_meta_lat, mono_clock::now() - start);
+  _dump_onode(o);
+
+  // for deep-scrub, we only read dirty cache and bypass clean cache in
+  // order to read underlying block device in case there are silent disk errors.
+  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
+    dout(20) << __func__ << " will bypass cache and do direct read" << dendl;
+    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+  }
+
+  ready_regions_t ready_regions;
+  blobs2read_t blobs2read;
+  unsigned num_regions = _read_cache(o, offset, length, read_cache_policy,
+				     ready_regions, blobs2read);
+
+  // read raw blob data.  use aio if we have >1 blobs to read.
+  start = mono_clock::now(); // for the sake of simplicity
+                             // measure the whole block below.
+                             // The error isn't that much...
+  vector<bufferlist> compressed_blob_bls;
+  IOContext ioc(cct, NULL, true); // allow EIO
+  r = _prepare_read_ioc(blobs2read, num_regions, &compressed_blob_bls, &ioc);
+  if (r < 0)
+    return r;
+  if (ioc.has_pending_aios()) {
+    bdev->aio_submit(&ioc);
+    dout(20) << __func__ << " waiting for aio" << dendl;
+    ioc.aio_wait();
+    r = ioc.get_return_value();
+    if (r < 0) {
+      ceph_assert(r == -EIO); // no other errors allowed
+      return -EIO;
+    }
+  }
+  logger->tinc(l_bluestore_read_wait_aio_lat, mono_clock::now() - start);
+
+  bool csum_error = false;
+  r = _generate_read_result_bl(o, offset, length, ready_regions,
+			       compressed_blob_bls, blobs2read,
+			       buffered, &csum_error, bl);
+  if (csum_error) {
+    // Handles spurious read errors caused by a kernel bug.
+    // We sometimes get all-zero pages as a result of the read under
+    // high memory pressure. Retrying the failing read succeeds in most
+    // cases.
+    // See also: http://tracker.ceph.com/issues/22464
+    if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
+      return -EIO;
+    }
+    return _do_read(c, o, offset, length, bl, op_flags, retry_count + 1);
+  }
+  if (r < 0)
+    return r;
   r = bl.length();
   if (retry_count) {
     logger->inc(l_bluestore_reads_with_retries);
@@ -8783,6 +10692,15 @@ int BlueStore::_fiemap(
       length = o->onode.size - offset;
     }
 
+    if (o->onode.has_inline_data()) {
+      // nothing is mapped on disk; report the stored bytes as data
+      uint64_t l = o->onode.inline_data.length();
+      if (offset < l) {
+	destset.insert(offset, std::min<uint64_t>(length, l - offset));
+      }
+      goto out;
+    }
+
     o->extent_map.fault_range(db, offset, length);
     eend = o->extent_map.extent_map.end();
     ep = o->extent_map.seek_lextent(offset);
@@ -9361,8 +11279,10 @@ uint64_t BlueStore::_get_ondisk_reserved() const {
 
 void BlueStore::_prepare_ondisk_format_super(KeyValueDB::Transaction& t)
 {
+  int32_t compat_ondisk_format = fast_tier_size ?
+    fast_tier_compat_ondisk_format : min_compat_ondisk_format;
   dout(10) << __func__ << " ondisk_format " << ondisk_format
-	   << " min_compat_ondisk_format " << min_compat_ondisk_format
+	   << " min_compat_ondisk_format " << compat_ondisk_format
 	   << dendl;
   ceph_assert(ondisk_format == latest_ondisk_format);
   {
@@ -9372,7 +11292,7 @@ void BlueStore::_prepare_ondisk_format_super(KeyValueDB::Transaction& t)
   }
   {
     bufferlist bl;
-    encode(min_compat_ondisk_format, bl);
+    encode(compat_ondisk_format, bl);
     t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
   }
 }
@@ -9508,6 +11428,7 @@ int BlueStore::_upgrade_super()
     ceph_assert(ondisk_format > 0);
     ceph_assert(ondisk_format < latest_ondisk_format);
 
+    KeyValueDB::Transaction t = db->get_transaction();
     if (ondisk_format == 1) {
       // changes:
       // - super: added ondisk_format
@@ -9515,7 +11436,6 @@ int BlueStore::_upgrade_super()
       // - super: added min_compat_ondisk_format
       // - super: added min_alloc_size
       // - super: removed min_min_alloc_size
-      KeyValueDB::Transaction t = db->get_transaction();
       {
 	bufferlist bl;
 	db->get(PREFIX_SUPER, "min_min_alloc_size", &bl);
@@ -9532,10 +11452,15 @@ int BlueStore::_upgrade_super()
 	t->rmkey(PREFIX_SUPER, "min_min_alloc_size");
       }
       ondisk_format = 2;
-      _prepare_ondisk_format_super(t);
-      int r = db->submit_transaction_sync(t);
-      ceph_assert(r == 0);
     }
+    if (ondisk_format == 2) {
+      // changes:
+      // - super: min_compat_ondisk_format is 3 if there is a fast tier
+      ondisk_format = 3;
+    }
+    _prepare_ondisk_format_super(t);
+    int r = db->submit_transaction_sync(t);
+    ceph_assert(r == 0);
   }
   // done
   dout(1) << __func__ << " done" << dendl;
@@ -9850,6 +11775,24 @@ void BlueStore::_txc_finalize_kv(TransContext *txc, KeyValueDB::Transaction t)
     }
   }
 
+  // the fast tier keeps a freelist of its own
+  interval_set<uint64_t> fast_allocated, fast_released;
+  if (fast_fm) {
+    interval_set<uint64_t> main_allocated, main_released;
+    _split_fast_tier(*pallocated, &main_allocated, &fast_allocated);
+    _split_fast_tier(*preleased, &main_released, &fast_released);
+    tmp_allocated.swap(main_allocated);
+    tmp_released.swap(main_released);
+    pallocated = &tmp_allocated;
+    preleased = &tmp_released;
+  }
+  for (auto p = fast_allocated.begin(); p != fast_allocated.end(); ++p) {
+    fast_fm->allocate(p.get_start(), p.get_len(), t);
+  }
+  for (auto p = fast_released.begin(); p != fast_released.end(); ++p) {
+    fast_fm->release(p.get_start(), p.get_len(), t);
+  }
+
   // update freelist with non-overlap sets
   for (interval_set<uint64_t>::iterator p = pallocated->begin();
        p != pallocated->end();
@@ -9982,6 +11925,16 @@ void BlueStore::_txc_release_alloc(TransContext *txc)
   // it's expected we're called with lazy_release_lock already taken!
   if (likely(!cct->_conf->bluestore_debug_no_reuse_blocks)) {
     int r = 0;
+    if (fast_alloc) {
+      // bluefs decides about discards on block.db, so the fast tier
+      // extents go straight back to their allocator
+      interval_set<uint64_t> main_released, fast_released;
+      _split_fast_tier(txc->released, &main_released, &fast_released);
+      if (!fast_released.empty()) {
+	fast_alloc->release(fast_released);
+	txc->released.swap(main_released);
+      }
+    }
     if (cct->_conf->bdev_enable_discard && cct->_conf->bdev_async_discard) {
       r = bdev->queue_discard(txc->released);
       if (r == 0) {
@@ -10263,6 +12216,11 @@ void BlueStore::_kv_sync_thread()
       	}
       }
 
+      if (fast_bdev) {
+	// writes to the fast tier are synchronous and don't show up in
+	// num_aios; this is a no-op if there weren't any
+	fast_bdev->flush();
+      }
       if (force_flush) {
 	dout(20) << __func__ << " num_aios=" << aios
 		 << " force_flush=" << (int)force_flush
@@ -10589,7 +12547,7 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 	if (!g_conf()->bluestore_debug_omit_block_device_write) {
 	  logger->inc(l_bluestore_deferred_write_ops);
 	  logger->inc(l_bluestore_deferred_write_bytes, bl.length());
-	  int r = bdev->aio_write(start, bl, &b->ioc, false);
+	  int r = _bdev_aio_write(start, bl, &b->ioc, false);
 	  ceph_assert(r == 0);
 	}
       }
@@ -10611,7 +12569,13 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     ++i;
   }
 
-  bdev->aio_submit(&b->ioc);
+  if (b->ioc.has_pending_aios()) {
+    bdev->aio_submit(&b->ioc);
+  } else {
+    // all of it went to the fast tier (or nowhere), which is written
+    // synchronously, so there's no aio completion to wait for
+    _deferred_aio_finish(osr);
+  }
 }
 
 struct C_DeferredTrySubmit : public Context {
@@ -10752,6 +12716,9 @@ int BlueStore::queue_transactions(
     txc->bytes += (*p).get_num_bytes();
     _txc_add_transaction(txc, &(*p));
   }
+  if (txc->ch->exists) {
+    _tier_demote_queued(txc, txc->ch);
+  }
   _txc_calc_cost(txc);
 
   _txc_write_nodes(txc, txc->t);
@@ -11221,6 +13188,10 @@ void BlueStore::_dump_onode(const OnodeRef& o)
 		  << ", " << o->extent_map.spanning_blob_map.size()
 		  << " spanning blobs"
 		  << dendl;
+  if (o->onode.has_inline_data()) {
+    dout(LogLevelV) << __func__ << "  inline data len 0x" << std::hex
+		    << o->onode.inline_data.length() << std::dec << dendl;
+  }
   for (auto p = o->onode.attrs.begin();
        p != o->onode.attrs.end();
        ++p) {
@@ -11315,7 +13286,9 @@ void BlueStore::_pad_zeros(
     ceph_assert(back_pad == 0);
     back_pad = chunk_size - back_copy;
     ceph_assert(back_copy <= length);
-    bufferptr tail(chunk_size);
+    // page aligned like the front pad, so that the device need not
+    // rebuild it before an O_DIRECT write
+    bufferptr tail = buffer::create_small_page_aligned(chunk_size);
     bl->copy(length - back_copy, back_copy, tail.c_str());
     tail.zero(back_copy, back_pad, false);
     bufferlist old;
@@ -11451,7 +13424,7 @@ void BlueStore::_do_write_small(
 	      b->get_blob().map_bl(
 		b_off, bl,
 		[&](uint64_t offset, bufferlist& t) {
-		  bdev->aio_write(offset, t,
+		  _bdev_aio_write(offset, t,
 				  &txc->ioc, wctx->buffered);
 		});
 	    }
@@ -11889,9 +13862,31 @@ int BlueStore::_do_alloc_write(
   PExtentVector prealloc;
   prealloc.reserve(2 * wctx->writes.size());;
   int64_t prealloc_left = 0;
-  prealloc_left = alloc->allocate(
-    need, min_alloc_size, need,
-    0, &prealloc);
+  bool fast = false;
+  if (!wctx->demote && _tier_should_promote(o, need)) {
+    prealloc_left = fast_alloc->allocate(
+      need, min_alloc_size, need,
+      0, &prealloc);
+    if (prealloc_left == (int64_t)need) {
+      for (auto& e : prealloc) {
+	e.offset += FAST_TIER_BASE;
+      }
+      fast = true;
+      logger->inc(l_bluestore_tier_fast_alloc_bytes, need);
+      _tier_add_resident(coll->cid, o.get());
+    } else {
+      if (prealloc.size()) {
+	fast_alloc->release(prealloc);
+	prealloc.clear();
+      }
+      logger->inc(l_bluestore_tier_fast_full);
+    }
+  }
+  if (!fast) {
+    prealloc_left = alloc->allocate(
+      need, min_alloc_size, need,
+      0, &prealloc);
+  }
   if (prealloc_left < (int64_t)need) {
     derr << __func__ << " failed to allocate 0x" << std::hex << need
          << " allocated 0x " << prealloc_left
@@ -12024,7 +14019,7 @@ int BlueStore::_do_alloc_write(
 	b->get_blob().map_bl(
 	  b_off, *l,
 	  [&](uint64_t offset, bufferlist& t) {
-	    bdev->aio_write(offset, t, &txc->ioc, false);
+	    _bdev_aio_write(offset, t, &txc->ioc, false);
 	  });
       }
     }
@@ -12304,6 +14299,72 @@ int BlueStore::_do_gc(
   return 0;
 }
 
+bool BlueStore::_can_inline_data(OnodeRef& o, uint64_t end)
+{
+  if (end > inline_data_max) {
+    return false;
+  }
+  if (o->onode.has_inline_data()) {
+    return true;
+  }
+  // only empty objects start out inline; once an object has blobs it
+  // keeps them, and a hint that it will grow large keeps it off too.
+  return o->onode.size == 0 &&
+    o->onode.extent_map_shards.empty() &&
+    o->extent_map.extent_map.empty() &&
+    o->onode.expected_object_size <= inline_data_max;
+}
+
+void BlueStore::_do_write_inline(
+  OnodeRef& o,
+  uint64_t offset,
+  uint64_t length,
+  bufferlist& bl)
+{
+  bufferptr& d = o->onode.inline_data;
+  uint64_t end = offset + length;
+  dout(20) << __func__ << " " << o->oid
+	   << " 0x" << std::hex << offset << "~" << length
+	   << " inline 0x" << d.length() << std::dec << dendl;
+
+  // rebuild rather than modify in place: the old buffer may still be
+  // referenced by a reader or by an onode encoding in flight
+  bufferptr n = buffer::create(std::max<uint64_t>(end, d.length()));
+  n.zero(false);
+  if (d.length()) {
+    n.copy_in(0, d.length(), d.c_str(), false);
+  }
+  bl.copy(0, length, n.c_str() + offset);
+  n.reassign_to_mempool(mempool::mempool_bluestore_cache_other);
+  d.swap(n);
+  o->onode.set_flag(bluestore_onode_t::FLAG_INLINE_DATA);
+  if (end > o->onode.size) {
+    o->onode.size = end;
+  }
+  logger->inc(l_bluestore_write_inline);
+  logger->inc(l_bluestore_write_inline_bytes, length);
+}
+
+int BlueStore::_inline_data_spill(
+  TransContext *txc,
+  CollectionRef& c,
+  OnodeRef& o)
+{
+  bufferlist bl;
+  bl.append(o->onode.inline_data);
+  o->onode.inline_data = bufferptr();
+  o->onode.clear_flag(bluestore_onode_t::FLAG_INLINE_DATA);
+  dout(20) << __func__ << " " << o->oid
+	   << " 0x" << std::hex << bl.length() << std::dec
+	   << " bytes to blobs" << dendl;
+  logger->inc(l_bluestore_inline_spill);
+  if (bl.length() == 0) {
+    return 0;
+  }
+  // size > 0 now and the flag is gone, so this won't come back inline
+  return _do_write(txc, c, o, 0, bl.length(), bl, 0);
+}
+
 int BlueStore::_do_write(
   TransContext *txc,
   CollectionRef& c,
@@ -12331,6 +14392,17 @@ int BlueStore::_do_write(
 
   uint64_t end = offset + length;
 
+  if (_can_inline_data(o, end)) {
+    _do_write_inline(o, offset, length, bl);
+    return 0;
+  }
+  if (o->onode.has_inline_data()) {
+    r = _inline_data_spill(txc, c, o);
+    if (r < 0) {
+      return r;
+    }
+  }
+
   GarbageCollector gc(c->store->cct);
   int64_t benefit;
   auto dirty_start = offset;
@@ -12442,11 +14514,20 @@ int BlueStore::_do_zero(TransContext *txc,
 
   _dump_onode(o);
 
-  WriteContext wctx;
-  o->extent_map.fault_range(db, offset, length);
-  o->extent_map.punch_hole(c, offset, length, &wctx.old_extents);
-  o->extent_map.dirty_range(offset, length);
-  _wctx_finish(txc, c, o, &wctx);
+  if (o->onode.has_inline_data()) {
+    auto& d = o->onode.inline_data;
+    if (offset < d.length()) {
+      bufferlist z;
+      z.append_zero(std::min<uint64_t>(length, d.length() - offset));
+      _do_write_inline(o, offset, z.length(), z);
+    }
+  } else {
+    WriteContext wctx;
+    o->extent_map.fault_range(db, offset, length);
+    o->extent_map.punch_hole(c, offset, length, &wctx.old_extents);
+    o->extent_map.dirty_range(offset, length);
+    _wctx_finish(txc, c, o, &wctx);
+  }
 
   if (length > 0 && offset + length > o->onode.size) {
     o->onode.size = offset + length;
@@ -12473,7 +14554,16 @@ void BlueStore::_do_truncate(
   if (offset == o->onode.size)
     return;
 
-  if (offset < o->onode.size) {
+  if (o->onode.has_inline_data()) {
+    auto& d = o->onode.inline_data;
+    if (offset == 0) {
+      d = bufferptr();
+      o->onode.clear_flag(bluestore_onode_t::FLAG_INLINE_DATA);
+    } else if (offset < d.length()) {
+      // readers hold their own ptr to the raw buffer, so trimming is safe
+      d.set_length(offset);
+    }
+  } else if (offset < o->onode.size) {
     WriteContext wctx;
     uint64_t length = o->onode.size - offset;
     o->extent_map.fault_range(db, offset, length);
@@ -13010,6 +15100,15 @@ int BlueStore::_do_clone_range(
 	   << newo->oid
 	   << " 0x" << std::hex << srcoff << "~" << length << " -> "
 	   << " 0x" << dstoff << "~" << length << std::dec << dendl;
+  if (oldo->onode.has_inline_data() || newo->onode.has_inline_data()) {
+    // inline data can't be shared between onodes, copy it instead
+    bufferlist bl;
+    int r = _do_read(c.get(), oldo, srcoff, length, bl, 0);
+    if (r < 0) {
+      return r;
+    }
+    return _do_write(txc, c, newo, dstoff, bl.length(), bl, 0);
+  }
   oldo->extent_map.fault_range(db, srcoff, length);
   newo->extent_map.fault_range(db, dstoff, length);
   _dump_onode(oldo);
@@ -13484,7 +15583,9 @@ void BlueStore::generate_db_histogram(Formatter *f)
     } else if (key.first == PREFIX_DEFERRED) {
 	hist.update_hist_entry(hist.key_hist, PREFIX_DEFERRED, key_size, value_size);
 	num_deferred++;
-    } else if (key.first == PREFIX_ALLOC || key.first == PREFIX_ALLOC_BITMAP) {
+    } else if (key.first == PREFIX_ALLOC || key.first == PREFIX_ALLOC_BITMAP ||
+	       key.first == PREFIX_ALLOC_FAST ||
+	       key.first == PREFIX_ALLOC_FAST_BITMAP) {
 	hist.update_hist_entry(hist.key_hist, PREFIX_ALLOC, key_size, value_size);
 	num_alloc++;
     } else if (key.first == PREFIX_SHARED_BLOB) {
@@ -81,6 +81,11 @@ enum {
   l_bluestore_read_lat,
   l_bluestore_read_onode_meta_lat,
   l_bluestore_read_wait_aio_lat,
+  l_bluestore_read_multi_lat,
+  l_bluestore_read_multi_ops,
+  l_bluestore_digest_lat,
+  l_bluestore_digest_bytes,
+  l_bluestore_digest_csum_bytes,
   l_bluestore_compress_lat,
   l_bluestore_decompress_lat,
   l_bluestore_csum_lat,
@@ -115,6 +120,9 @@ enum {
   l_bluestore_write_small_deferred,
   l_bluestore_write_small_pre_read,
   l_bluestore_write_small_new,
+  l_bluestore_write_inline,
+  l_bluestore_write_inline_bytes,
+  l_bluestore_inline_spill,
   l_bluestore_txc,
   l_bluestore_onode_reshard,
   l_bluestore_blob_split,
@@ -123,9 +131,28 @@ enum {
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
   l_bluestore_fragmentation,
+  l_bluestore_onode_warmup_loaded,
+  l_bluestore_onode_warmup_skipped,
+  l_bluestore_onode_warmup_bytes,
+  l_bluestore_onode_warmup_pending,
+  l_bluestore_tier_fast_read_bytes,
+  l_bluestore_tier_slow_read_bytes,
+  l_bluestore_tier_fast_alloc_bytes,
+  l_bluestore_tier_fast_full,
+  l_bluestore_tier_demoted_bytes,
+  l_bluestore_tier_fast_free,
   l_bluestore_last
 };
 
+enum {
+  l_bluestore_cache_shard_first = 732700,
+  l_bluestore_cache_shard_onodes,
+  l_bluestore_cache_shard_buffer_bytes,
+  l_bluestore_cache_shard_lock_contended,
+  l_bluestore_cache_shard_lock_wait,
+  l_bluestore_cache_shard_last
+};
+
 #define META_POOL_ID ((uint64_t)-1ull)
 
 class BlueStore : public ObjectStore,
@@ -386,13 +413,17 @@ public:
     bool loaded = false;
 
     CollectionRef coll;
+    Cache *cache;               ///< cache shard holding our buffers
     union {
       uint64_t sbid_unloaded;              ///< sbid if persistent isn't loaded
       bluestore_shared_blob_t *persistent; ///< persistent part of the shared blob if any
     };
     BufferSpace bc;             ///< buffer cache
 
-    SharedBlob(Collection *_coll) : coll(_coll), sbid_unloaded(0) {
+    SharedBlob(Collection *_coll)
+      : coll(_coll),
+	cache(_coll ? _coll->pick_cache() : nullptr),
+	sbid_unloaded(0) {
       if (get_cache()) {
 	get_cache()->add_blob();
       }
@@ -427,7 +458,7 @@ public:
       return l.get_sbid() == r.get_sbid();
     }
     inline Cache* get_cache() {
-      return coll ? coll->cache : nullptr;
+      return cache;
     }
     inline SharedBlobSet* get_parent() {
       return coll ? &(coll->shared_blob_set) : nullptr;
@@ -1051,6 +1082,17 @@ public:
     ceph::mutex flush_lock = ceph::make_mutex("BlueStore::Onode::flush_lock");
     ceph::condition_variable flush_cond;   ///< wait here for uncommitted txns
 
+    // access stats for fast tier placement; racy updates are fine, these
+    // are only hints
+    std::atomic<uint32_t> tier_heat = {0};   ///< reads, halved every half life
+    std::atomic<uint32_t> tier_stamp = {0};  ///< last access, coarse seconds
+    enum {
+      TIER_UNKNOWN,   ///< not checked for fast tier data yet
+      TIER_SLOW,      ///< had no fast tier data when checked
+      TIER_RESIDENT,  ///< registered as a fast tier user
+    };
+    std::atomic<uint8_t> tier_state = {TIER_UNKNOWN};
+
     Onode(Collection *c, const ghobject_t& o,
 	  const mempool::bluestore_cache_other::string& k)
       : nref(0),
@@ -1061,6 +1103,11 @@ public:
 	extent_map(this) {
     }
 
+    /// build an onode from its encoded kv value
+    static Onode* decode(Collection *c, const ghobject_t& oid,
+			 const mempool::bluestore_cache_other::string& key,
+			 const bufferlist& v);
+
     void flush();
     void get() {
       ++nref;
@@ -1069,18 +1116,70 @@ public:
       if (--nref == 0)
 	delete this;
     }
+
+    /// current read heat, decayed to @now
+    uint32_t get_tier_heat(uint32_t now, uint32_t half_life) const {
+      uint32_t stamp = tier_stamp;
+      uint32_t halvings = now > stamp ? (now - stamp) / half_life : 0;
+      return halvings < 32 ? tier_heat >> halvings : 0;
+    }
+    /// note an access; reads (@inc > 0) heat the object up
+    void note_tier_access(uint32_t now, uint32_t half_life, uint32_t inc) {
+      uint32_t h = get_tier_heat(now, half_life);
+      tier_heat = h + inc < h ? h : h + inc;
+      tier_stamp = now;
+    }
   };
   typedef boost::intrusive_ptr<Onode> OnodeRef;
 
+  /// decides which allocations land on the fast tier and when they leave
+  class TierPolicy {
+  public:
+    virtual ~TierPolicy() {}
+    /// place a new @need byte allocation for @o on the fast tier?
+    virtual bool should_promote(const Onode& o, uint64_t need,
+				uint64_t fast_free, uint64_t fast_total) = 0;
+    /// move @o's data off the fast tier?
+    virtual bool should_demote(const Onode& o,
+			       uint64_t fast_free, uint64_t fast_total) = 0;
+  };
+
 
   /// a cache (shard) of onodes and buffers
   struct Cache {
     CephContext* cct;
     PerfCounters *logger;
 
+    PerfCounters *shard_logger = nullptr;  ///< per-shard stats, if any
+
+    /// recursive mutex which keeps track of how often (and for how long)
+    /// callers had to wait for it
+    struct shard_lock_t {
+      ceph::recursive_mutex m = {
+	ceph::make_recursive_mutex("BlueStore::Cache::lock") };
+      std::atomic<uint64_t> nr_contended = {0};
+      std::atomic<uint64_t> wait_ns = {0};
+
+      void lock() {
+	if (m.try_lock()) {
+	  return;
+	}
+	auto start = mono_clock::now();
+	m.lock();
+	++nr_contended;
+	wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+	  mono_clock::now() - start).count();
+      }
+      bool try_lock() {
+	return m.try_lock();
+      }
+      void unlock() {
+	m.unlock();
+      }
+    };
+
     /// protect lru and other structures
-    ceph::recursive_mutex lock = {
-      ceph::make_recursive_mutex("BlueStore::Cache::lock") };
+    shard_lock_t lock;
 
     std::atomic<uint64_t> num_extents = {0};
     std::atomic<uint64_t> num_blobs = {0};
@@ -1088,7 +1187,10 @@ public:
     static Cache *create(CephContext* cct, string type, PerfCounters *logger);
 
     Cache(CephContext* cct) : cct(cct), logger(nullptr) {}
-    virtual ~Cache() {}
+    virtual ~Cache();
+
+    void init_shard_logger(unsigned id);
+    void update_shard_logger(uint64_t onodes, uint64_t buffer_bytes);
 
     virtual void _add_onode(OnodeRef& o, int level) = 0;
     virtual void _rm_onode(OnodeRef& o) = 0;
@@ -1103,6 +1205,9 @@ public:
     virtual uint64_t _get_num_onodes() = 0;
     virtual uint64_t _get_buffer_bytes() = 0;
 
+    /// append up to max onodes, most recently used first
+    virtual void _get_hot_onodes(size_t max, vector<Onode*> *ls) = 0;
+
     void add_extent() {
       ++num_extents;
     }
@@ -1177,6 +1282,13 @@ public:
       onode_lru.erase(q);
     }
     void _touch_onode(OnodeRef& o) override;
+    void _get_hot_onodes(size_t max, vector<Onode*> *ls) override {
+      for (auto p = onode_lru.begin();
+	   p != onode_lru.end() && max > 0;
+	   ++p, --max) {
+	ls->push_back(&*p);
+      }
+    }
 
     uint64_t _get_buffer_bytes() override {
       return buffer_size;
@@ -1282,6 +1394,13 @@ public:
       onode_lru.erase(q);
     }
     void _touch_onode(OnodeRef& o) override;
+    void _get_hot_onodes(size_t max, vector<Onode*> *ls) override {
+      for (auto p = onode_lru.begin();
+	   p != onode_lru.end() && max > 0;
+	   ++p, --max) {
+	ls->push_back(&*p);
+      }
+    }
 
     uint64_t _get_buffer_bytes() override {
       return buffer_bytes;
@@ -1329,23 +1448,41 @@ public:
 
   struct OnodeSpace {
   private:
-    Cache *cache;
+    typedef mempool::bluestore_cache_other::unordered_map<
+      ghobject_t,OnodeRef> onode_map_t;
+
+    /// lock domains.  onodes hashing to slot i sit on caches[i]'s lru,
+    /// and onode_maps[i] is protected by caches[i]->lock.
+    vector<Cache*> caches;
 
-    /// forward lookups
-    mempool::bluestore_cache_other::unordered_map<ghobject_t,OnodeRef> onode_map;
+    /// forward lookups, one map per slot
+    vector<onode_map_t> onode_maps;
 
     friend class Collection; // for split_cache()
 
+    size_t _get_slot(const ghobject_t& oid) const {
+      if (caches.size() == 1) {
+	return 0;
+      }
+      // the low bits of the hash pick the pg, so use the high bits
+      return oid.hobj.get_bitwise_key_u32() % caches.size();
+    }
+
   public:
-    OnodeSpace(Cache *c) : cache(c) {}
+    OnodeSpace(const vector<Cache*>& c)
+      : caches(c),
+	onode_maps(c.size()) {
+      ceph_assert(!caches.empty());
+    }
     ~OnodeSpace() {
       clear();
     }
 
     OnodeRef add(const ghobject_t& oid, OnodeRef o);
     OnodeRef lookup(const ghobject_t& o);
+    /// caller must hold the lock of the slot's cache
     void remove(const ghobject_t& oid) {
-      onode_map.erase(oid);
+      onode_maps[_get_slot(oid)].erase(oid);
     }
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
@@ -1366,7 +1503,9 @@ public:
   struct Collection : public CollectionImpl {
     BlueStore *store;
     OpSequencerRef osr;
-    Cache *cache;       ///< our cache shard
+    Cache *cache;       ///< our primary cache shard
+    vector<Cache*> caches;  ///< shards our onodes/buffers are spread over
+    std::atomic<unsigned> next_cache = {0};
     bluestore_cnode_t cnode;
     RWLock lock;
 
@@ -1383,6 +1522,8 @@ public:
     ContextQueue *commit_queue;
 
     OnodeRef get_onode(const ghobject_t& oid, bool create);
+    /// look up several onodes, fetching the uncached ones in one kv get
+    void get_onodes(const vector<ghobject_t>& oids, vector<OnodeRef> *onodes);
 
     // the terminology is confusing here, sorry!
     //
@@ -1400,6 +1541,11 @@ public:
     void make_blob_shared(uint64_t sbid, BlobRef b);
     uint64_t make_blob_unshared(SharedBlob *sb);
 
+    /// pick a cache shard for a new SharedBlob's buffers
+    Cache *pick_cache() {
+      return caches[next_cache++ % caches.size()];
+    }
+
     BlobRef new_blob() {
       BlobRef b = new Blob();
       b->shared_blob = new SharedBlob(this);
@@ -1423,7 +1569,9 @@ public:
     void flush() override;
     void flush_all_but_last();
 
-    Collection(BlueStore *ns, Cache *ca, coll_t c);
+    Collection(BlueStore *ns, const vector<Cache*>& ca, coll_t c);
+    Collection(BlueStore *ns, Cache *ca, coll_t c)
+      : Collection(ns, vector<Cache*>{ca}, c) {}
   };
 
   class OmapIteratorImpl : public ObjectMap::ObjectMapIteratorImpl {
@@ -1851,6 +1999,47 @@ public:
       return NULL;
     }
   };
+  struct OnodeWarmupThread : public Thread {
+    BlueStore *store;
+    explicit OnodeWarmupThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_onode_warmup_thread();
+      return NULL;
+    }
+  };
+
+  struct TierThread : public Thread {
+    BlueStore *store;
+    explicit TierThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_tier_thread();
+      return NULL;
+    }
+  };
+
+  /// an object to prefetch into the cache after a restart
+  struct onode_warmup_item_t {
+    coll_t cid;
+    ghobject_t oid;
+    interval_set<uint64_t> cached;  ///< logical ranges with clean buffers
+
+    void encode(bufferlist& bl) const {
+      using ceph::encode;
+      ENCODE_START(1, 1, bl);
+      encode(cid, bl);
+      encode(oid, bl);
+      encode(cached, bl);
+      ENCODE_FINISH(bl);
+    }
+    void decode(bufferlist::const_iterator& p) {
+      using ceph::decode;
+      DECODE_START(1, p);
+      decode(cid, p);
+      decode(oid, p);
+      decode(cached, p);
+      DECODE_FINISH(p);
+    }
+  };
 
   struct DBHistogram {
     struct value_dist {
@@ -1889,6 +2078,17 @@ private:
   std::string freelist_type;
   FreelistManager *fm = nullptr;
   Allocator *alloc = nullptr;
+
+  // optional fast tier for object data, carved out of the end of block.db.
+  // its blocks are addressed as FAST_TIER_BASE + offset into the tier, so
+  // pextents tell which device they live on.
+  BlockDevice *fast_bdev = nullptr;     ///< block.db, shared with bluefs
+  FreelistManager *fast_fm = nullptr;
+  Allocator *fast_alloc = nullptr;      ///< in offsets relative to the tier
+  uint64_t fast_tier_offset = 0;        ///< start of the tier on block.db
+  uint64_t fast_tier_size = 0;          ///< 0 if there is no fast tier
+  std::unique_ptr<TierPolicy> tier_policy;
+
   uuid_d fsid;
   int path_fd = -1;  ///< open handle to $path
   int fsid_fd = -1;  ///< open handle (locked) to $path/fsid
@@ -1900,6 +2100,9 @@ private:
 
   vector<Cache*> cache_shards;
 
+  /// cache shards a collection's onodes and buffers are spread over
+  vector<Cache*> _get_collection_caches(const coll_t& cid);
+
   /// protect zombie_osr_set
   ceph::mutex zombie_osr_lock = ceph::make_mutex("BlueStore::zombie_osr_lock");
   std::map<coll_t,OpSequencerRef> zombie_osr_set; ///< set of OpSequencers for deleted collections
@@ -1981,6 +2184,7 @@ private:
   std::atomic<uint64_t> comp_max_blob_size = {0};
 
   std::atomic<uint64_t> max_blob_size = {0};  ///< maximum blob size
+  std::atomic<uint64_t> inline_data_max = {0}; ///< max object data kept in onode
 
   uint64_t kv_ios = 0;
   uint64_t kv_throttle_costs = 0;
@@ -2149,6 +2353,23 @@ private:
         PriorityCache::Priority pri);
   } mempool_thread;
 
+  OnodeWarmupThread onode_warmup_thread;
+  ceph::mutex onode_warmup_lock =
+    ceph::make_mutex("BlueStore::onode_warmup_lock");
+  ceph::condition_variable onode_warmup_cond;
+  bool onode_warmup_stop = false;
+
+  TierThread tier_thread;
+  ceph::mutex tier_lock = ceph::make_mutex("BlueStore::tier_lock");
+  ceph::condition_variable tier_cond;
+  bool tier_stop = false;
+  /// objects which (may) have data on the fast tier
+  map<coll_t, set<ghobject_t>> tier_residents;
+  /// objects picked for demotion, drained by writes to their collection
+  map<coll_t, set<ghobject_t>> tier_demote_queue;
+  std::atomic<bool> tier_demote_pending = {false};
+  std::atomic<uint32_t> tier_heat_half_life = {1};
+
   // --------------------------------------------------------
   // private methods
 
@@ -2277,6 +2498,50 @@ private:
   void _kv_sync_thread();
   void _kv_finalize_thread();
 
+  // onode cache warm-up across restarts
+  int _write_onode_warmup();
+  int _write_onode_warmup_file(bufferlist& bl);
+  int _read_onode_warmup(vector<onode_warmup_item_t> *items);
+  void _onode_warmup_start();
+  void _onode_warmup_stop();
+  void _onode_warmup_thread();
+
+  static constexpr uint64_t FAST_TIER_BASE = 1ull << 60;
+  bool _is_fast_tier(uint64_t offset) const {
+    return offset >= FAST_TIER_BASE;
+  }
+  /// device holding @offset; translates @offset to the device's space
+  BlockDevice *_get_bdev(uint64_t *offset) const {
+    if (_is_fast_tier(*offset)) {
+      *offset = *offset - FAST_TIER_BASE + fast_tier_offset;
+      return fast_bdev;
+    }
+    return bdev;
+  }
+  int _bdev_read(uint64_t off, uint64_t len, bufferlist *pbl, IOContext *ioc);
+  int _bdev_aio_read(uint64_t off, uint64_t len, bufferlist *pbl,
+		     IOContext *ioc);
+  int _bdev_aio_write(uint64_t off, bufferlist& bl, IOContext *ioc,
+		      bool buffered);
+  int _bdev_write(uint64_t off, bufferlist& bl, bool buffered);
+  int _read_fast_tier_meta();
+  bool _has_fast_tier();
+  int _open_fast_tier();
+  void _close_fast_tier();
+  /// split @s into main device and fast tier (relative) extents
+  void _split_fast_tier(const interval_set<uint64_t>& s,
+			interval_set<uint64_t> *main,
+			interval_set<uint64_t> *fast);
+  void _tier_note_read(Collection *c, Onode *o);
+  void _tier_add_resident(const coll_t& cid, Onode *o);
+  bool _tier_should_promote(OnodeRef& o, uint64_t need);
+  void _tier_start();
+  void _tier_stop();
+  void _tier_thread();
+  void _tier_demote_queued(TransContext *txc, CollectionRef& c);
+  int _tier_demote(TransContext *txc, CollectionRef& c, OnodeRef& o,
+		   uint64_t *budget);
+
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, OnodeRef o);
   void _deferred_queue(TransContext *txc);
 public:
@@ -2298,6 +2563,7 @@ private:
     const PExtentVector& extents,
     bool compressed,
     mempool_dynamic_bitset &used_blocks,
+    mempool_dynamic_bitset &fast_used_blocks,
     uint64_t granularity,
     BlueStoreRepairer* repairer,
     store_statfs_t& expected_statfs);
@@ -2310,6 +2576,22 @@ private:
     int& errors,
     BlueStoreRepairer* repairer);
 
+  /// state shared by the threads walking the object keyspace
+  struct FSCK_ObjectCtx;
+  void _fsck_check_objects(FSCK_ObjectCtx& ctx);
+  void _fsck_check_objects_range(
+    FSCK_ObjectCtx& ctx,
+    const string& start,
+    const string& end);
+  void _fsck_check_object(
+    FSCK_ObjectCtx& ctx,
+    Collection *c,
+    OnodeRef o,
+    mempool::bluestore_fsck::list<string>& expecting_shards,
+    store_statfs_t& onode_statfs);
+  void _fsck_check_shared_blobs(FSCK_ObjectCtx& ctx);
+  void _fsck_check_stray_omap(FSCK_ObjectCtx& ctx, bool pgmeta);
+
   void _buffer_cache_write(
     TransContext *txc,
     BlobRef b,
@@ -2343,9 +2625,12 @@ private:
 
   // -- ondisk version ---
 public:
-  const int32_t latest_ondisk_format = 2;        ///< our version
+  const int32_t latest_ondisk_format = 3;        ///< our version
   const int32_t min_readable_ondisk_format = 1;  ///< what we can read
   const int32_t min_compat_ondisk_format = 2;    ///< who can read us
+  /// who can read us if we have a fast tier, whose FAST_TIER_BASE extents
+  /// an older release would take for block device offsets
+  const int32_t fast_tier_compat_ondisk_format = 3;
 
 private:
   int32_t ondisk_format = 0;  ///< value detected on mount
@@ -2372,6 +2657,13 @@ public:
 
   bool is_rotational() override;
   bool is_journal_rotational() override;
+  double get_queue_utilization() override {
+    // bytes between submit and commit, against what we let in
+    int64_t max = throttle_bytes.get_max();
+    if (max <= 0)
+      return 0;
+    return std::min(1.0, (double)throttle_bytes.get_current() / max);
+  }
 
   string get_default_device_class() override {
     string device_class;
@@ -2421,6 +2713,14 @@ public:
     return _fsck(deep, true);
   }
   int _fsck(bool deep, bool repair);
+  int fsck_online() override;
+
+  /// replace the fast tier placement policy; only before mount
+  void set_tier_policy(std::unique_ptr<TierPolicy> p) {
+    ceph_assert(!mounted);
+    ceph_assert(p);
+    tier_policy = std::move(p);
+  }
 
   void set_cache_shards(unsigned num) override;
   void dump_cache_stats(Formatter *f) override {
@@ -2504,6 +2804,98 @@ public:
     bufferlist& bl,
     uint32_t op_flags = 0,
     uint64_t retry_count = 0);
+  int read_multi(
+    CollectionHandle &c,
+    vector<read_multi_op_t>& ops,
+    uint32_t op_flags = 0) override;
+  int digest(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    uint32_t *digest,
+    uint32_t op_flags = 0) override;
+  int _do_digest(
+    Collection *c,
+    OnodeRef o,
+    uint64_t offset,
+    size_t len,
+    uint32_t *digest,
+    uint32_t op_flags = 0,
+    uint64_t retry_count = 0);
+
+private:
+  // intermediate data structures used while reading
+  struct region_t {
+    uint64_t logical_offset;
+    uint64_t blob_xoffset;   //region offset within the blob
+    uint64_t length;
+
+    // used later in read process
+    uint64_t front = 0;
+
+    region_t(uint64_t offset, uint64_t b_offs, uint64_t len, uint64_t front = 0)
+      : logical_offset(offset),
+      blob_xoffset(b_offs),
+      length(len),
+      front(front){}
+    region_t(const region_t& from)
+      : logical_offset(from.logical_offset),
+      blob_xoffset(from.blob_xoffset),
+      length(from.length),
+      front(from.front){}
+
+    friend ostream& operator<<(ostream& out, const region_t& r) {
+      return out << "0x" << std::hex << r.logical_offset << ":"
+	<< r.blob_xoffset << "~" << r.length << std::dec;
+    }
+  };
+
+  // merged blob read request
+  struct read_req_t {
+    uint64_t r_off = 0;
+    uint64_t r_len = 0;
+    bufferlist bl;
+    std::list<region_t> regs; // original read regions
+
+    read_req_t(uint64_t off, uint64_t len) : r_off(off), r_len(len) {}
+
+    friend ostream& operator<<(ostream& out, const read_req_t& r) {
+      out << "{<0x" << std::hex << r.r_off << ", 0x" << r.r_len << "> : [";
+      for (const auto& reg : r.regs)
+	out << reg;
+      return out << "]}" << std::dec;
+    }
+  };
+
+  typedef list<read_req_t> regions2read_t;
+  typedef map<BlueStore::BlobRef, regions2read_t> blobs2read_t;
+
+  // the phases of _do_read, split so that read_multi can share one
+  // IOContext between several objects
+  unsigned _read_cache(
+    OnodeRef o,
+    uint64_t offset,
+    size_t length,
+    int read_cache_policy,
+    ready_regions_t& ready_regions,
+    blobs2read_t& blobs2read);
+  int _prepare_read_ioc(
+    blobs2read_t& blobs2read,
+    unsigned num_regions,
+    vector<bufferlist>* compressed_blob_bls,
+    IOContext* ioc);
+  int _generate_read_result_bl(
+    OnodeRef o,
+    uint64_t offset,
+    size_t length,
+    ready_regions_t& ready_regions,
+    vector<bufferlist>& compressed_blob_bls,
+    blobs2read_t& blobs2read,
+    bool buffered,
+    bool* csum_error,
+    bufferlist& bl);
+  bool _is_buffered_read(uint32_t op_flags);
 
 private:
   int _fiemap(CollectionHandle &c_, const ghobject_t& oid,
@@ -2636,6 +3028,10 @@ public:
   void inject_leaked(uint64_t len);
   void inject_false_free(coll_t cid, ghobject_t oid);
   void inject_statfs(const string& key, const store_statfs_t& new_statfs);
+  /// replace the onode warm-up record with @c bl, read on the next mount
+  void inject_onode_warmup_record(bufferlist& bl);
+  /// wait for the onode warm-up started by mount() to run its course
+  void wait_for_onode_warmup();
   void inject_misreference(coll_t cid1, ghobject_t oid1,
 			   coll_t cid2, ghobject_t oid2,
 			   uint64_t offset);
@@ -2727,6 +3123,7 @@ private:
   struct WriteContext {
     bool buffered = false;          ///< buffered write
     bool compress = false;          ///< compressed write
+    bool demote = false;            ///< keep allocations off the fast tier
     uint64_t target_blob_size = 0;  ///< target (max) blob size
     unsigned csum_order = 0;        ///< target checksum chunk order
 
@@ -2775,6 +3172,7 @@ private:
     void fork(const WriteContext& other) {
       buffered = other.buffered;
       compress = other.compress;
+      demote = other.demote;
       target_blob_size = other.target_blob_size;
       csum_order = other.csum_order;
     }
@@ -2860,6 +3258,13 @@ private:
 		uint64_t offset, uint64_t length,
 		bufferlist& bl,
 		uint32_t fadvise_flags);
+  bool _can_inline_data(OnodeRef& o, uint64_t end);
+  void _do_write_inline(OnodeRef& o,
+			uint64_t offset, uint64_t length,
+			bufferlist& bl);
+  int _inline_data_spill(TransContext *txc,
+			 CollectionRef& c,
+			 OnodeRef& o);
   void _do_write_data(TransContext *txc,
                       CollectionRef& c,
                       OnodeRef o,
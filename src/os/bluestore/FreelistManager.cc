@@ -13,13 +13,17 @@ FreelistManager *FreelistManager::create(
   // put the freelistmanagers in different prefixes because the merge
   // op is per prefix, has to done pre-db-open, and we don't know the
   // freelist type until after we open the db.
-  ceph_assert(prefix == "B");
-  if (type == "bitmap")
+  ceph_assert(prefix == "B" || prefix == "F");
+  if (type == "bitmap") {
+    if (prefix == "F")
+      return new BitmapFreelistManager(cct, "F", "f");
     return new BitmapFreelistManager(cct, "B", "b");
+  }
   return NULL;
 }
 
 void FreelistManager::setup_merge_operators(KeyValueDB *db)
 {
   BitmapFreelistManager::setup_merge_operator(db, "b");
+  BitmapFreelistManager::setup_merge_operator(db, "f");
 }
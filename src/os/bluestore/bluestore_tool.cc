@@ -224,6 +224,7 @@ int main(int argc, char **argv)
   string action;
   string log_file;
   string key, value;
+  string sharding;
   int log_level = 30;
   bool fsck_deep = false;
   po::options_description po_options("Options");
@@ -239,10 +240,11 @@ int main(int argc, char **argv)
     ("deep", po::value<bool>(&fsck_deep), "deep fsck (read all data)")
     ("key,k", po::value<string>(&key), "label metadata key name")
     ("value,v", po::value<string>(&value), "label metadata value")
+    ("sharding", po::value<string>(&sharding), "new column family layout for reshard, as in bluestore_rocksdb_cfs")
     ;
   po::options_description po_positional("Positional options");
   po_positional.add_options()
-    ("command", po::value<string>(&action), "fsck, repair, bluefs-export, bluefs-bdev-sizes, bluefs-bdev-expand, bluefs-bdev-new-db, bluefs-bdev-new-wal, bluefs-bdev-migrate, show-label, set-label-key, rm-label-key, prime-osd-dir, bluefs-log-dump")
+    ("command", po::value<string>(&action), "fsck, repair, bluefs-export, bluefs-bdev-sizes, bluefs-bdev-expand, bluefs-bdev-new-db, bluefs-bdev-new-wal, bluefs-bdev-migrate, show-label, set-label-key, rm-label-key, prime-osd-dir, bluefs-log-dump, reshard")
     ;
   po::options_description po_all("All options");
   po_all.add(po_options).add(po_positional);
@@ -358,6 +360,17 @@ int main(int argc, char **argv)
     }
   }
 
+  if (action == "reshard") {
+    if (path.empty()) {
+      cerr << "must specify bluestore path" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (sharding.empty()) {
+      cerr << "must specify new layout with --sharding" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
   vector<const char*> args;
   if (log_file.size()) {
     args.push_back("--log-file");
@@ -787,6 +800,21 @@ int main(int argc, char **argv)
       }
       return r;
     }
+  } else if (action == "reshard") {
+    validate_path(cct.get(), path, false);
+    BlueStore bluestore(cct.get(), path);
+    KeyValueDB *db;
+    int r = bluestore.start_kv_only(&db);
+    if (r < 0) {
+      cerr << "error opening kv store: " << cpp_strerror(r) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    r = db->reshard(sharding, cout);
+    bluestore.umount();
+    if (r < 0) {
+      cerr << "reshard failed: " << cpp_strerror(r) << std::endl;
+      exit(EXIT_FAILURE);
+    }
   } else {
     cerr << "unrecognized action " << action << std::endl;
     return 1;
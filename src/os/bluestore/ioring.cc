@@ -0,0 +1,283 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ioring.h"
+#include "include/compat.h"
+
+#if defined(HAVE_LIBURING)
+
+#include <liburing.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+
+struct ioring_data {
+  struct io_uring io_uring;
+  ceph::mutex sq_lock = ceph::make_mutex("ioring_data::sq_lock");
+  ceph::mutex cq_lock = ceph::make_mutex("ioring_data::cq_lock");
+  int epoll_fd = -1;
+  std::map<int, int> fixed_fds_map;  ///< real fd -> registered fd index
+};
+
+static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
+			  struct aio_t **paio)
+{
+  struct io_uring *ring = &d->io_uring;
+  struct io_uring_cqe *cqe;
+
+  unsigned nr = 0;
+  unsigned head;
+  io_uring_for_each_cqe(ring, head, cqe) {
+    struct aio_t *io = (struct aio_t *)(uintptr_t) io_uring_cqe_get_data(cqe);
+    io->rval = cqe->res;
+
+    paio[nr++] = io;
+
+    if (nr == max)
+      break;
+  }
+  io_uring_cq_advance(ring, nr);
+
+  return nr;
+}
+
+static int find_fixed_fd(struct ioring_data *d, int real_fd)
+{
+  auto it = d->fixed_fds_map.find(real_fd);
+  if (it == d->fixed_fds_map.end())
+    return -1;
+
+  return it->second;
+}
+
+static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
+		     struct aio_t *io)
+{
+  int fixed_fd = find_fixed_fd(d, io->fd);
+  int fd = fixed_fd >= 0 ? fixed_fd : io->fd;
+
+  // aio_t is always prepared for libaio on linux; reuse its opcode
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
+    io_uring_prep_writev(sqe, fd, &io->iov[0], io->iov.size(), io->offset);
+  else if (io->iocb.aio_lio_opcode == IO_CMD_PREAD)
+    io_uring_prep_readv(sqe, fd, &io->iov[0], io->iov.size(), io->offset);
+  else
+    ceph_abort_msg("unexpected aio opcode");
+
+  io_uring_sqe_set_data(sqe, io);
+  if (fixed_fd >= 0)
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+  : d(std::make_unique<ioring_data>()),
+    iodepth(iodepth_),
+    hipri(hipri_),
+    sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  unsigned flags = 0;
+
+  if (hipri)
+    flags |= IORING_SETUP_IOPOLL;
+  if (sq_thread)
+    flags |= IORING_SETUP_SQPOLL;
+
+  int ret = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (ret < 0)
+    return ret;
+
+  ret = io_uring_register_files(&d->io_uring, &fds[0], fds.size());
+  if (ret < 0)
+    goto close_ring_fd;
+
+  for (unsigned i = 0; i < fds.size(); ++i) {
+    d->fixed_fds_map[fds[i]] = i;
+  }
+
+  if (!hipri) {
+    // with IORING_SETUP_IOPOLL completions are never signaled on the
+    // ring fd, so there is nothing to wait for
+    d->epoll_fd = epoll_create1(0);
+    if (d->epoll_fd < 0) {
+      ret = -errno;
+      goto close_ring_fd;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ret = epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, d->io_uring.ring_fd, &ev);
+    if (ret < 0) {
+      ret = -errno;
+      goto close_epoll_fd;
+    }
+  }
+
+  return 0;
+
+close_epoll_fd:
+  VOID_TEMP_FAILURE_RETRY(::close(d->epoll_fd));
+  d->epoll_fd = -1;
+close_ring_fd:
+  d->fixed_fds_map.clear();
+  io_uring_queue_exit(&d->io_uring);
+
+  return ret;
+}
+
+void ioring_queue_t::shutdown()
+{
+  d->fixed_fds_map.clear();
+  if (d->epoll_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(d->epoll_fd));
+    d->epoll_fd = -1;
+  }
+  io_uring_queue_exit(&d->io_uring);
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  (void)aios_size;
+
+  // same backoff schedule as aio_queue_t::submit_batch
+  int attempts = 16;
+  int delay = 125;
+  int done = 0;
+  unsigned queued = 0;
+
+  std::lock_guard l(d->sq_lock);
+  while (beg != end || queued) {
+    for (; beg != end; ++beg) {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(&d->io_uring);
+      if (!sqe)
+	break;
+      aio_t *io = &*beg;
+      io->priv = priv;
+      init_sqe(d.get(), sqe, io);
+      ++queued;
+    }
+
+    int r = io_uring_submit(&d->io_uring);
+    if (r < 0 && r != -EAGAIN && r != -EBUSY) {
+      return r;
+    }
+    if (r > 0) {
+      done += r;
+      queued -= std::min<unsigned>(queued, r);
+      attempts = 16;
+      delay = 125;
+    } else {
+      // sq or cq is full; wait for the completion thread to catch up
+      if (attempts-- <= 0) {
+	return r < 0 ? r : -EAGAIN;
+      }
+      usleep(delay);
+      delay *= 2;
+      (*retries)++;
+    }
+  }
+  return done;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  auto reap = [&] {
+    std::lock_guard l(d->cq_lock);
+    return ioring_get_cqe(d.get(), max, paio);
+  };
+
+  int events = reap();
+  if (events) {
+    return events;
+  }
+
+  if (hipri) {
+    // IOPOLL: drive completion polling from here until something shows
+    // up or we hit the timeout
+    auto deadline = ceph::mono_clock::now() +
+      std::chrono::milliseconds(timeout_ms);
+    do {
+      int r = syscall(__NR_io_uring_enter, d->io_uring.ring_fd, 0, 0,
+		      IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (r < 0 && errno != EINTR) {
+	return -errno;
+      }
+      events = reap();
+    } while (!events && ceph::mono_clock::now() < deadline);
+    return events;
+  }
+
+  struct epoll_event ev;
+  int ret = TEMP_FAILURE_RETRY(epoll_wait(d->epoll_fd, &ev, 1, timeout_ms));
+  if (ret < 0) {
+    return -errno;
+  }
+  if (ret > 0) {
+    events = reap();
+  }
+  return events;
+}
+
+bool ioring_queue_t::supported()
+{
+  struct io_uring ring;
+  if (io_uring_queue_init(1, &ring, 0) < 0) {
+    return false;
+  }
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+#else // #if defined(HAVE_LIBURING)
+
+struct ioring_data {};
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+{
+  ceph_abort_msg("built without liburing support");
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  ceph_abort_msg("built without liburing support");
+}
+
+void ioring_queue_t::shutdown()
+{
+  ceph_abort_msg("built without liburing support");
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  ceph_abort_msg("built without liburing support");
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  ceph_abort_msg("built without liburing support");
+}
+
+bool ioring_queue_t::supported()
+{
+  return false;
+}
+
+#endif // #if defined(HAVE_LIBURING)
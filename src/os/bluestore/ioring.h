@@ -0,0 +1,43 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include "acconfig.h"
+
+#include "include/types.h"
+#include "ceph_aio.h"
+
+struct ioring_data;
+
+/**
+ * io_queue_t implementation on top of the Linux io_uring API.
+ *
+ * The fds handed to init() are registered with the ring so that each
+ * submission skips the per-io fget/fput.  Optionally the ring can be
+ * set up for completion polling (hipri) and/or with a kernel thread
+ * polling the submission queue (sq_thread), in which case most
+ * submissions do not need a syscall at all.
+ *
+ * Completions are reported through the same aio_t::rval contract as
+ * aio_queue_t, so callers don't need to know which queue is in use.
+ */
+struct ioring_queue_t final : public io_queue_t {
+  std::unique_ptr<ioring_data> d;
+  unsigned iodepth = 0;
+  bool hipri = false;
+  bool sq_thread = false;
+
+  /// true if we were built with liburing and the kernel supports io_uring
+  static bool supported();
+
+  ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_);
+  ~ioring_queue_t() final;
+
+  int init(std::vector<int> &fds) final;
+  void shutdown() final;
+
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) final;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) final;
+};
@@ -983,22 +983,47 @@ void ECBackend::handle_sub_read(
 {
   trace.event("handle sub read");
   shard_id_t shard = get_parent()->whoami_shard().shard;
+  auto reads_complete_chunks = [&op, this](const hobject_t& hoid) {
+    const auto& subchunks = op.subchunks.find(hoid)->second;
+    return (subchunks.size() == 1 &&
+	    subchunks.front().second == ec_impl->get_sub_chunk_count());
+  };
+  // the complete chunks are read with one read_multi() for each set of op
+  // flags, so the store can look up the objects and issue their io at once
+  using extent_t = boost::tuple<uint64_t, uint64_t, uint32_t>;
+  map<uint32_t, vector<ObjectStore::read_multi_op_t>> batches;
+  map<const extent_t*, pair<uint32_t, size_t>> batched;
+  for (auto& [hoid, extents] : op.to_read) {
+    if (!reads_complete_chunks(hoid)) {
+      continue;
+    }
+    for (auto& extent : extents) {
+      auto& batch = batches[extent.get<2>()];
+      batched[&extent] = make_pair(extent.get<2>(), batch.size());
+      batch.emplace_back(ghobject_t(hoid, ghobject_t::NO_GEN, shard),
+			 extent.get<0>(), extent.get<1>());
+    }
+  }
+  for (auto& [flags, batch] : batches) {
+    int r = store->read_multi(ch, batch, flags); // Allow EIO return
+    if (r < 0) {
+      for (auto& read : batch) {
+	read.r = r;
+      }
+    }
+  }
   for(auto i = op.to_read.begin();
       i != op.to_read.end();
       ++i) {
     int r = 0;
     for (auto j = i->second.begin(); j != i->second.end(); ++j) {
       bufferlist bl;
-      if ((op.subchunks.find(i->first)->second.size() == 1) && 
-          (op.subchunks.find(i->first)->second.front().second == 
-                                            ec_impl->get_sub_chunk_count())) {
+      if (reads_complete_chunks(i->first)) {
         dout(25) << __func__ << " case1: reading the complete chunk/shard." << dendl;
-        r = store->read(
-	  ch,
-	  ghobject_t(i->first, ghobject_t::NO_GEN, shard),
-	  j->get<0>(),
-	  j->get<1>(),
-	  bl, j->get<2>()); // Allow EIO return
+	auto [flags, n] = batched[&*j];
+	auto& read = batches[flags][n];
+	r = read.r;
+	bl.claim_append(read.bl);
       } else {
         dout(25) << __func__ << " case2: going to do fragmented read." << dendl;
         int subchunk_size =
@@ -1173,12 +1198,15 @@ void ECBackend::handle_sub_read_reply(
       boost::tuple<
 	uint64_t, uint64_t, map<pg_shard_t, bufferlist> > >::iterator riter =
       rop.complete[i->first].returned.begin();
+    bool chunk_offsets = rop.to_read.find(i->first)->second.chunk_offsets;
     for (list<pair<uint64_t, bufferlist> >::iterator j = i->second.begin();
 	 j != i->second.end();
 	 ++j, ++req_iter, ++riter) {
       ceph_assert(req_iter != rop.to_read.find(i->first)->second.to_read.end());
       ceph_assert(riter != rop.complete[i->first].returned.end());
       pair<uint64_t, uint64_t> adjusted =
+	chunk_offsets ?
+	make_pair(req_iter->get<0>(), req_iter->get<1>()) :
 	sinfo.aligned_offset_len_to_chunk(
 	  make_pair(req_iter->get<0>(), req_iter->get<1>()));
       ceph_assert(adjusted.first == j->first);
@@ -1417,6 +1445,7 @@ void ECBackend::on_change()
   waiting_reads.clear();
   waiting_state.clear();
   waiting_commit.clear();
+  parity_delta_in_flight.clear();
   for (auto &&op: tid_to_op_map) {
     cache.release_write_pin(op.second.pin);
   }
@@ -1720,6 +1749,8 @@ void ECBackend::do_read_op(ReadOp &op)
 	 j != i->second.to_read.end();
 	 ++j) {
       pair<uint64_t, uint64_t> chunk_off_len =
+	i->second.chunk_offsets ?
+	make_pair(j->get<0>(), j->get<1>()) :
 	sinfo.aligned_offset_len_to_chunk(make_pair(j->get<0>(), j->get<1>()));
       for (auto k = i->second.need.begin();
 	   k != i->second.need.end();
@@ -1838,8 +1869,20 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
       }
       return ref;
     },
+    [&](const hobject_t &i,
+	const PGTransaction::ObjectOperation &o,
+	uint64_t size,
+	ECTransaction::ParityDelta *pd) {
+      return get_parity_delta(i, o, size, pd);
+    },
     get_parent()->get_dpp());
 
+  for (auto &&i : op->plan.parity_delta) {
+    parity_delta_in_flight[i.first].insert(
+      sinfo.logical_to_prev_stripe_offset(i.second.offset),
+      sinfo.get_stripe_width());
+  }
+
   dout(10) << __func__ << ": " << *op << dendl;
 
   waiting_state.push_back(*op);
@@ -1861,6 +1904,13 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
+  if (op->requires_rmw() && blocked_by_parity_delta(*op)) {
+    dout(20) << __func__ << ": blocking " << *op
+	     << " because it reads a stripe with a parity delta in flight"
+	     << dendl;
+    return false;
+  }
+
   if (!pipeline_state.caching_enabled()) {
     op->using_cache = false;
   } else if (op->invalidates_cache()) {
@@ -1917,6 +1967,10 @@ bool ECBackend::try_state_to_reads()
       });
   }
 
+  if (!op->plan.parity_delta.empty()) {
+    start_parity_delta_reads(op);
+  }
+
   return true;
 }
 
@@ -1968,6 +2022,7 @@ bool ECBackend::try_reads_to_commit()
       get_parent()->get_info().pgid.pgid,
       sinfo,
       op->remote_read_result,
+      op->parity_delta_read,
       op->log_entries,
       &written,
       &trans,
@@ -2005,6 +2060,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->parity_delta_read.clear();
 
   ObjectStore::Transaction empty;
   bool should_write_local = false;
@@ -2114,6 +2170,16 @@ bool ECBackend::try_finish_rmw()
   if (op->using_cache) {
     cache.release_write_pin(op->pin);
   }
+  for (auto &&i : op->plan.parity_delta) {
+    auto p = parity_delta_in_flight.find(i.first);
+    ceph_assert(p != parity_delta_in_flight.end());
+    p->second.erase(
+      sinfo.logical_to_prev_stripe_offset(i.second.offset),
+      sinfo.get_stripe_width());
+    if (p->second.empty()) {
+      parity_delta_in_flight.erase(p);
+    }
+  }
   tid_to_op_map.erase(op->tid);
 
   if (waiting_reads.empty() &&
@@ -2133,6 +2199,233 @@ void ECBackend::check_ops()
 	 try_finish_rmw());
 }
 
+bool ECBackend::get_parity_delta(
+  const hobject_t &hoid,
+  const PGTransaction::ObjectOperation &op,
+  uint64_t size,
+  ECTransaction::ParityDelta *pd)
+{
+  if (!(ec_impl->get_supported_optimizations() &
+	ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION) ||
+      !ec_impl->get_chunk_mapping().empty() ||
+      ec_impl->get_sub_chunk_count() != 1 ||
+      !get_parent()->get_pool().allows_ecoverwrites() ||
+      !cct->_conf.get_val<bool>("osd_ec_parity_delta_writes")) {
+    return false;
+  }
+  if (!ECTransaction::get_parity_delta(
+	sinfo, ec_impl->get_coding_chunk_count(), size, op, pd)) {
+    return false;
+  }
+
+  // every shard must be up to date: we read from the acting shards and
+  // only write the range we have read
+  set<int> have;
+  for (auto &&i : get_parent()->get_acting_shards()) {
+    have.insert(i.shard);
+  }
+  if (have.size() != ec_impl->get_chunk_count()) {
+    return false;
+  }
+  for (auto &&i : get_parent()->get_acting_recovery_backfill_shards()) {
+    auto m = get_parent()->maybe_get_shard_missing(i);
+    if (!m || (*m).is_missing(hoid) ||
+	!get_parent()->should_send_op(i, hoid)) {
+      return false;
+    }
+  }
+
+  // and nothing ahead of us may write to the stripe
+  uint64_t stripe = sinfo.logical_to_prev_stripe_offset(pd->offset);
+  for (auto *l : {&waiting_state, &waiting_reads, &waiting_commit}) {
+    for (auto &&o : *l) {
+      auto w = o.plan.will_write.find(hoid);
+      if (w != o.plan.will_write.end() &&
+	  w->second.intersects(stripe, sinfo.get_stripe_width())) {
+	dout(20) << __func__ << ": " << hoid << " stripe " << stripe
+		 << " is being written by " << o << dendl;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ECBackend::blocked_by_parity_delta(const Op &op) const
+{
+  for (auto &&i : op.plan.to_read) {
+    auto p = parity_delta_in_flight.find(i.first);
+    if (p == parity_delta_in_flight.end()) {
+      continue;
+    }
+    for (auto &&e : i.second) {
+      if (p->second.intersects(e.first, e.second)) {
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ECBackend::start_parity_delta_reads(Op *op)
+{
+  map<hobject_t, set<int>> want_to_read;
+  map<hobject_t, read_request_t> for_read_op;
+  for (auto &&i : op->plan.parity_delta) {
+    const hobject_t &hoid = i.first;
+    const ECTransaction::ParityDelta &pd = i.second;
+    set<int> want;
+    want.insert(pd.shard);
+    for (unsigned j = ec_impl->get_data_chunk_count();
+	 j < ec_impl->get_chunk_count();
+	 ++j) {
+      want.insert(j);
+    }
+    map<pg_shard_t, vector<pair<int, int>>> need;
+    for (auto &&j : get_parent()->get_acting_shards()) {
+      if (want.count(j.shard)) {
+	need[j].push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+      }
+    }
+    ceph_assert(need.size() == want.size());
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+    to_read.push_back(boost::make_tuple(pd.chunk_offset, pd.length, 0));
+    for_read_op.insert(
+      make_pair(
+	hoid,
+	read_request_t(
+	  to_read,
+	  need,
+	  false,
+	  make_gen_lambda_context<
+	    pair<RecoveryMessages*, read_result_t&>&>(
+	      [this, op, hoid](pair<RecoveryMessages*, read_result_t&> &in) {
+		handle_parity_delta_read(op, hoid, in.second);
+	      }).release(),
+	  true)));
+    want_to_read.insert(make_pair(hoid, std::move(want)));
+  }
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    want_to_read,
+    for_read_op,
+    op->client_op,
+    false, false);
+}
+
+void ECBackend::handle_parity_delta_read(
+  Op *op,
+  const hobject_t &hoid,
+  read_result_t &res)
+{
+  const ECTransaction::ParityDelta &pd = op->plan.parity_delta.at(hoid);
+  map<int, bufferlist> chunks;
+  if (res.r == 0) {
+    ceph_assert(res.returned.size() == 1);
+    for (auto &&i : res.returned.front().get<2>()) {
+      if (i.first.shard == pd.shard ||
+	  i.first.shard >= (int)ec_impl->get_data_chunk_count()) {
+	chunks[i.first.shard].claim(i.second);
+      }
+    }
+  }
+  if (chunks.size() != ec_impl->get_coding_chunk_count() + 1) {
+    dout(10) << __func__ << ": " << hoid << " " << pd << " got "
+	     << chunks.size() << " shards, r=" << res.r
+	     << ", reading the stripe" << dendl;
+    parity_delta_read_stripe(op, hoid);
+    return;
+  }
+  dout(20) << __func__ << ": " << hoid << " " << pd << dendl;
+  op->parity_delta_read[hoid].swap(chunks);
+  check_ops();
+}
+
+void ECBackend::parity_delta_read_stripe(Op *op, const hobject_t &hoid)
+{
+  // Some shard could not serve the range.  Reconstruct the stripe from
+  // whatever is readable and re-encode it: the old data and coding are
+  // what they would have been, and the write still only touches the
+  // range.
+  const ECTransaction::ParityDelta &pd = op->plan.parity_delta.at(hoid);
+  uint64_t stripe = sinfo.logical_to_prev_stripe_offset(pd.offset);
+  map<hobject_t,extent_set> to_read;
+  to_read[hoid].insert(stripe, sinfo.get_stripe_width());
+  objects_read_async_no_cache(
+    to_read,
+    [this, op, hoid, stripe](map<hobject_t,pair<int, extent_map> > &&results) {
+      const ECTransaction::ParityDelta &pd = op->plan.parity_delta.at(hoid);
+      auto &got = results[hoid];
+      auto range = got.second.get_containing_range(
+	stripe, sinfo.get_stripe_width());
+      if (got.first < 0 || range.first == range.second) {
+	derr << __func__ << ": " << hoid << " unable to read stripe "
+	     << stripe << " for " << pd << ", r=" << got.first
+	     << ", there is no way to recover from such an error in this"
+	     << " context" << dendl;
+	ceph_abort();
+      }
+      bufferlist bl;
+      bl.substr_of(
+	range.first.get_val(),
+	stripe - range.first.get_off(),
+	sinfo.get_stripe_width());
+      set<int> want;
+      for (unsigned i = 0; i < ec_impl->get_chunk_count(); ++i) {
+	want.insert(i);
+      }
+      map<int, bufferlist> encoded;
+      int r = ECUtil::encode(sinfo, ec_impl, bl, want, &encoded);
+      ceph_assert(r == 0);
+      uint64_t off = pd.chunk_offset -
+	sinfo.logical_to_prev_chunk_offset(pd.offset);
+      auto &chunks = op->parity_delta_read[hoid];
+      chunks[pd.shard].substr_of(encoded[pd.shard], off, pd.length);
+      for (unsigned i = ec_impl->get_data_chunk_count();
+	   i < ec_impl->get_chunk_count();
+	   ++i) {
+	chunks[i].substr_of(encoded[i], off, pd.length);
+      }
+      check_ops();
+    });
+}
+
+bool ECBackend::get_direct_read_shard(
+  const hobject_t &hoid,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+  pg_shard_t *shard)
+{
+  if (extents.empty() ||
+      !ec_impl->get_chunk_mapping().empty() ||
+      ec_impl->get_sub_chunk_count() != 1 ||
+      !cct->_conf.get_val<bool>("osd_ec_direct_reads")) {
+    return false;
+  }
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  int chunk = -1;
+  for (auto &&e : extents) {
+    uint64_t off = e.get<0>() - sinfo.logical_to_prev_stripe_offset(e.get<0>());
+    int c = off / chunk_size;
+    if (e.get<1>() == 0 ||
+	off % chunk_size + e.get<1>() > chunk_size ||
+	(chunk >= 0 && c != chunk)) {
+      return false;
+    }
+    chunk = c;
+  }
+  for (auto &&i : get_parent()->get_acting_shards()) {
+    if (i.shard != chunk) {
+      continue;
+    }
+    if (get_parent()->get_shard_missing(i).is_missing(hoid)) {
+      return false;
+    }
+    *shard = i;
+    return true;
+  }
+  return false;
+}
+
 int ECBackend::objects_read_sync(
   const hobject_t &hoid,
   uint64_t off,
@@ -2155,6 +2448,7 @@ void ECBackend::objects_read_async(
 
   uint32_t flags = 0;
   extent_set es;
+  std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > extents;
   for (list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
 	 pair<bufferlist*, Context*> > >::const_iterator i =
 	 to_read.begin();
@@ -2166,6 +2460,7 @@ void ECBackend::objects_read_async(
 
     es.union_insert(tmp.first, tmp.second);
     flags |= i->first.get<2>();
+    extents.push_back(i->first);
   }
 
   if (!es.empty()) {
@@ -2251,15 +2546,21 @@ void ECBackend::objects_read_async(
       to_read.clear();
     }
   };
+  auto func = make_gen_lambda_context<
+    map<hobject_t,pair<int, extent_map> > &&, cb>(
+      cb(this,
+	 hoid,
+	 to_read,
+	 on_complete));
+  pg_shard_t shard;
+  if (!fast_read && get_direct_read_shard(hoid, extents, &shard)) {
+    objects_read_direct(hoid, shard, extents, reads[hoid], std::move(func));
+    return;
+  }
   objects_read_and_reconstruct(
     reads,
     fast_read,
-    make_gen_lambda_context<
-      map<hobject_t,pair<int, extent_map> > &&, cb>(
-	cb(this,
-	   hoid,
-	   to_read,
-	   on_complete)));
+    std::move(func));
 }
 
 struct CallClientContexts :
@@ -2375,10 +2676,128 @@ void ECBackend::objects_read_and_reconstruct(
 }
 
 
+void ECBackend::objects_read_direct(
+  const hobject_t &hoid,
+  pg_shard_t shard,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &stripes,
+  GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func)
+{
+  dout(20) << __func__ << ": " << hoid << " " << extents << " from "
+	   << shard << dendl;
+  in_progress_client_reads.emplace_back(1, std::move(func));
+  ClientAsyncReadStatus *status = &(in_progress_client_reads.back());
+
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+  for (auto &&e : extents) {
+    uint64_t off = e.get<0>();
+    to_read.push_back(
+      boost::make_tuple(
+	sinfo.logical_to_prev_chunk_offset(off) +
+	(off - sinfo.logical_to_prev_stripe_offset(off)) %
+	sinfo.get_chunk_size(),
+	e.get<1>(),
+	e.get<2>()));
+  }
+  map<pg_shard_t, vector<pair<int, int>>> need;
+  need[shard].push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+  map<hobject_t, set<int>> want_to_read;
+  want_to_read[hoid].insert(shard.shard);
+  map<hobject_t, read_request_t> for_read_op;
+  for_read_op.insert(
+    make_pair(
+      hoid,
+      read_request_t(
+	to_read,
+	need,
+	false,
+	make_gen_lambda_context<
+	  pair<RecoveryMessages*, read_result_t&>&>(
+	    [this, hoid, shard, extents, stripes, status](
+	      pair<RecoveryMessages*, read_result_t&> &in) {
+	      handle_direct_read(hoid, shard, extents, stripes, status,
+				 in.second);
+	    }).release(),
+	true)));
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    want_to_read,
+    for_read_op,
+    OpRequestRef(),
+    false, false);
+}
+
+void ECBackend::handle_direct_read(
+  const hobject_t &hoid,
+  pg_shard_t shard,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &stripes,
+  ClientAsyncReadStatus *status,
+  read_result_t &res)
+{
+  extent_map result;
+  bool complete = res.r == 0 && res.returned.size() == extents.size();
+  auto e = extents.begin();
+  for (auto r = res.returned.begin();
+       complete && r != res.returned.end();
+       ++r, ++e) {
+    auto bl = r->get<2>().find(shard);
+    if (bl == r->get<2>().end() || bl->second.length() != e->get<1>()) {
+      complete = false;
+      break;
+    }
+    result.insert(e->get<0>(), e->get<1>(), std::move(bl->second));
+  }
+  if (complete) {
+    status->complete_object(hoid, 0, std::move(result));
+    kick_reads();
+    return;
+  }
+
+  dout(10) << __func__ << ": " << hoid << " " << shard << " r=" << res.r
+	   << " errors " << res.errors << ", reading " << stripes << dendl;
+  map<pg_shard_t, vector<pair<int, int>>> shards;
+  set<int> want_to_read;
+  get_want_to_read_shards(&want_to_read);
+  int r = get_min_avail_to_read_shards(
+    hoid,
+    want_to_read,
+    false,
+    false,
+    &shards);
+  if (r < 0) {
+    status->complete_object(hoid, r, extent_map());
+    kick_reads();
+    return;
+  }
+  map<hobject_t, read_request_t> for_read_op;
+  for_read_op.insert(
+    make_pair(
+      hoid,
+      read_request_t(
+	stripes,
+	shards,
+	false,
+	new CallClientContexts(hoid, this, status, stripes))));
+  map<hobject_t, set<int>> obj_want_to_read;
+  obj_want_to_read.insert(make_pair(hoid, want_to_read));
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    obj_want_to_read,
+    for_read_op,
+    OpRequestRef(),
+    false, false);
+}
+
 int ECBackend::send_all_remaining_reads(
   const hobject_t &hoid,
   ReadOp &rop)
 {
+  if (rop.to_read.find(hoid)->second.chunk_offsets) {
+    // raw shard ranges can't be rebuilt from other shards
+    dout(10) << __func__ << " " << hoid << " not retrying chunk read" << dendl;
+    return -EIO;
+  }
   set<int> already_read;
   const set<pg_shard_t>& ots = rop.obj_to_source[hoid];
   for (set<pg_shard_t>::iterator i = ots.begin(); i != ots.end(); ++i)
@@ -2394,6 +2813,7 @@ int ECBackend::send_all_remaining_reads(
     rop.to_read.find(hoid)->second.to_read;
   GenContext<pair<RecoveryMessages *, read_result_t& > &> *c =
     rop.to_read.find(hoid)->second.cb;
+  bool chunk_offsets = rop.to_read.find(hoid)->second.chunk_offsets;
 
   // (Note cuixf) If we need to read attrs and we read failed, try to read again.
   bool want_attrs =
@@ -2410,7 +2830,8 @@ int ECBackend::send_all_remaining_reads(
 	offsets,
 	shards,
 	want_attrs,
-	c)));
+	c,
+	chunk_offsets)));
   do_read_op(rop);
   return 0;
 }
@@ -2473,34 +2894,22 @@ int ECBackend::be_deep_scrub(
     pos.data_hash = bufferhash(-1);
   }
 
-  uint64_t stride = cct->_conf->osd_deep_scrub_stride;
-  if (stride % sinfo.get_chunk_size())
-    stride += sinfo.get_chunk_size() - (stride % sinfo.get_chunk_size());
-
-  bufferlist bl;
-  r = store->read(
-    ch,
-    ghobject_t(
-      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-    pos.data_pos,
-    stride, bl,
-    fadvise_flags);
+  uint64_t stride;
+  r = be_deep_scrub_data(poid, pos, sinfo.get_chunk_size(), fadvise_flags,
+			 &stride);
   if (r < 0) {
     dout(20) << __func__ << "  " << poid << " got "
 	     << r << " on read, read_error" << dendl;
     o.read_error = true;
     return 0;
   }
-  if (bl.length() % sinfo.get_chunk_size()) {
+  if (r % sinfo.get_chunk_size()) {
     dout(20) << __func__ << "  " << poid << " got "
 	     << r << " on read, not chunk size " << sinfo.get_chunk_size() << " aligned"
 	     << dendl;
     o.read_error = true;
     return 0;
   }
-  if (r > 0) {
-    pos.data_hash << bl;
-  }
   pos.data_pos += r;
   if (r == (int)stride) {
     return -EINPROGRESS;
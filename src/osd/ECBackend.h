@@ -353,14 +353,19 @@ public:
     const list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
     const map<pg_shard_t, vector<pair<int, int>>> need;
     const bool want_attrs;
+    /// to_read holds offsets within the shards rather than stripe
+    /// aligned logical extents; such reads are not decoded, so a
+    /// shard error is left to the callback to deal with
+    const bool chunk_offsets;
     GenContext<pair<RecoveryMessages *, read_result_t& > &> *cb;
     read_request_t(
       const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
       const map<pg_shard_t, vector<pair<int, int>>> &need,
       bool want_attrs,
-      GenContext<pair<RecoveryMessages *, read_result_t& > &> *cb)
+      GenContext<pair<RecoveryMessages *, read_result_t& > &> *cb,
+      bool chunk_offsets = false)
       : to_read(to_read), need(need), want_attrs(want_attrs),
-	cb(cb) {}
+	chunk_offsets(chunk_offsets), cb(cb) {}
   };
   friend ostream &operator<<(ostream &lhs, const read_request_t &rhs);
 
@@ -484,8 +489,10 @@ public:
     map<hobject_t,extent_set> pending_read; // subset already being read
     map<hobject_t,extent_set> remote_read;  // subset we must read
     map<hobject_t,extent_map> remote_read_result;
+    map<hobject_t,map<int, bufferlist> > parity_delta_read; // shard -> range
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return (!remote_read.empty() && remote_read_result.empty()) ||
+	parity_delta_read.size() < plan.parity_delta.size();
     }
 
     /// In progress write state.
@@ -569,6 +576,54 @@ public:
   bool try_finish_rmw();
   void check_ops();
 
+  /**
+   * Parity delta writes read the old range from the data and coding
+   * shards rather than through the extent cache, so they must not
+   * overlap a stripe with a write ahead of them, and rmw reads of a
+   * stripe must wait for a parity delta write to it to commit.
+   */
+  map<hobject_t,extent_set> parity_delta_in_flight; // stripes
+  bool get_parity_delta(
+    const hobject_t &hoid,
+    const PGTransaction::ObjectOperation &op,
+    uint64_t size,
+    ECTransaction::ParityDelta *pd);
+  bool blocked_by_parity_delta(const Op &op) const;
+  void start_parity_delta_reads(Op *op);
+  void handle_parity_delta_read(
+    Op *op,
+    const hobject_t &hoid,
+    read_result_t &res);
+  void parity_delta_read_stripe(Op *op, const hobject_t &hoid);
+
+  /**
+   * Direct reads
+   *
+   * A client read whose extents all fall within the same data chunk of
+   * their stripes needs nothing but that chunk.  If the shard holding it
+   * is acting and has the object, we read the ranges from that shard
+   * alone and skip the decode.  Should the shard fail the read, we fall
+   * back to reading and decoding the stripes (extents rounded out to
+   * stripe bounds, as objects_read_and_reconstruct expects).
+   */
+  bool get_direct_read_shard(
+    const hobject_t &hoid,
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+    pg_shard_t *shard);
+  void objects_read_direct(
+    const hobject_t &hoid,
+    pg_shard_t shard,
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &stripes,
+    GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func);
+  void handle_direct_read(
+    const hobject_t &hoid,
+    pg_shard_t shard,
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &extents,
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &stripes,
+    ClientAsyncReadStatus *status,
+    read_result_t &res);
+
   ErasureCodeInterfaceRef ec_impl;
 
 
@@ -81,6 +81,140 @@ void encode_and_write(
   }
 }
 
+void delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const ECTransaction::ParityDelta &pd,
+  const map<int, bufferlist> &old_chunks,
+  uint64_t offset,
+  bufferlist bl,
+  uint32_t flags,
+  extent_map &written,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  ceph_assert(offset >= pd.offset);
+  ceph_assert(offset + bl.length() <= pd.offset + pd.length);
+
+  auto old_iter = old_chunks.find(pd.shard);
+  ceph_assert(old_iter != old_chunks.end());
+  bufferlist old_data = old_iter->second;
+  ceph_assert(old_data.length() == pd.length);
+
+  // the new content of the range: the update laid over the old data
+  bufferlist new_data;
+  uint64_t head = offset - pd.offset;
+  uint64_t tail = pd.length - head - bl.length();
+  if (head) {
+    new_data.substr_of(old_data, 0, head);
+  }
+  new_data.claim_append(bl);
+  if (tail) {
+    bufferlist t;
+    t.substr_of(old_data, pd.length - tail, tail);
+    new_data.claim_append(t);
+  }
+
+  map<int, bufferlist> parity;
+  for (unsigned i = ecimpl->get_data_chunk_count();
+       i < ecimpl->get_chunk_count();
+       ++i) {
+    auto p = old_chunks.find(i);
+    ceph_assert(p != old_chunks.end());
+    ceph_assert(p->second.length() == pd.length);
+    parity[i] = p->second;
+  }
+  int r = ECUtil::apply_parity_delta(
+    ecimpl, pd.shard, old_data, new_data, &parity);
+  ceph_assert(r == 0);
+
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid << " " << pd << dendl;
+  written.insert(pd.offset, pd.length, new_data);
+
+  for (auto &&i : *transactions) {
+    if (!ECTransaction::parity_delta_writes_shard(
+	  ecimpl->get_data_chunk_count(), pd, i.first)) {
+      continue;
+    }
+    bufferlist enc_bl = i.first == pd.shard ? new_data : parity[i.first];
+    i.second.write(
+      coll_t(spg_t(pgid, i.first)),
+      ghobject_t(oid, ghobject_t::NO_GEN, i.first),
+      pd.chunk_offset,
+      enc_bl.length(),
+      enc_bl,
+      flags);
+  }
+}
+
+ostream &ECTransaction::operator<<(ostream &lhs, const ParityDelta &rhs)
+{
+  return lhs << "parity_delta(shard " << rhs.shard
+	     << " " << rhs.offset << "~" << rhs.length
+	     << " chunk " << rhs.chunk_offset << ")";
+}
+
+bool ECTransaction::parity_delta_writes_shard(
+  unsigned data_chunks,
+  const ParityDelta &pd,
+  int shard) {
+  return shard == pd.shard || shard >= (int)data_chunks;
+}
+
+bool ECTransaction::get_parity_delta(
+  const ECUtil::stripe_info_t &sinfo,
+  unsigned coding_chunks,
+  uint64_t size,
+  const PGTransaction::ObjectOperation &op,
+  ParityDelta *pd) {
+  if (!op.is_none() || op.truncate) {
+    return false;
+  }
+  unsigned extents = 0;
+  uint64_t off = 0, end = 0;
+  for (auto &&extent: op.buffer_updates) {
+    using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+    if (++extents > 1 ||
+	boost::get<BufferUpdate::CloneRange>(&(extent.get_val()))) {
+      return false;
+    }
+    off = extent.get_off();
+    end = off + extent.get_len();
+  }
+  if (!extents || end > size) {
+    return false;
+  }
+
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t stripe = sinfo.logical_to_prev_stripe_offset(off);
+  const uint64_t shard = (off - stripe) / chunk_size;
+  const uint64_t chunk_start = stripe + shard * chunk_size;
+  if (end > chunk_start + chunk_size) {
+    return false;
+  }
+
+  // widen to whole pages of the chunk so the shards see aligned writes
+  const uint64_t align = std::min<uint64_t>(CEPH_PAGE_SIZE, chunk_size);
+  uint64_t rel_off = (off - chunk_start) / align * align;
+  uint64_t rel_end = std::min(
+    (end - chunk_start + align - 1) / align * align, chunk_size);
+  uint64_t len = rel_end - rel_off;
+
+  // we read and write the range on the data shard and on every coding
+  // shard; a full rmw reads the stripe from every data shard
+  const uint64_t data_chunks = sinfo.get_stripe_width() / chunk_size;
+  if ((1 + coding_chunks) * len >= data_chunks * chunk_size) {
+    return false;
+  }
+
+  pd->shard = shard;
+  pd->offset = chunk_start + rel_off;
+  pd->length = len;
+  pd->chunk_offset = sinfo.logical_to_prev_chunk_offset(off) + rel_off;
+  return true;
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -100,6 +234,7 @@ void ECTransaction::generate_transactions(
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int, bufferlist> > &parity_delta_reads,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -384,6 +519,90 @@ void ECTransaction::generate_transactions(
 	}
       }
 
+      auto pditer = plan.parity_delta.find(oid);
+      if (pditer != plan.parity_delta.end()) {
+	const auto &pd = pditer->second;
+	auto rditer = parity_delta_reads.find(oid);
+	ceph_assert(rditer != parity_delta_reads.end());
+	ceph_assert(op.buffer_updates.begin() != op.buffer_updates.end());
+	auto &&extent = *(op.buffer_updates.begin());
+
+	using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+	bufferlist bl;
+	uint32_t fadvise_flags = 0;
+	match(
+	  extent.get_val(),
+	  [&](const BufferUpdate::Write &op) {
+	    bl = op.buffer;
+	    fadvise_flags |= op.fadvise_flags;
+	  },
+	  [&](const BufferUpdate::Zero &) {
+	    bl.append_zero(extent.get_len());
+	  },
+	  [&](const BufferUpdate::CloneRange &) {
+	    ceph_assert(
+	      0 ==
+	      "CloneRange is not allowed, do_op should have returned ENOTSUPP");
+	  });
+
+	if (entry) {
+	  ldpp_dout(dpp, 20) << __func__ << ": overwriting "
+			     << pd.chunk_offset << "~" << pd.length
+			     << dendl;
+	  // only stash the shards we write, and record which ones they are
+	  // so that rollback and trim leave the others alone
+	  set<shard_id_t> stashed;
+	  for (auto &&st : *transactions) {
+	    if (!ECTransaction::parity_delta_writes_shard(
+		  ecimpl->get_data_chunk_count(), pd, st.first)) {
+	      continue;
+	    }
+	    stashed.insert(st.first);
+	    st.second.touch(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, entry->version.version, st.first));
+	    st.second.clone_range(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	      ghobject_t(oid, entry->version.version, st.first),
+	      pd.chunk_offset,
+	      pd.length,
+	      pd.chunk_offset);
+	  }
+	  entry->mod_desc.rollback_extents(
+	    entry->version.version,
+	    {make_pair(pd.chunk_offset, pd.length)},
+	    stashed);
+	  hinfo->set_total_chunk_size_clear_hash(
+	    hinfo->get_total_chunk_size());
+	}
+
+	delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  pd,
+	  rditer->second,
+	  extent.get_off(),
+	  bl,
+	  fadvise_flags,
+	  written,
+	  transactions,
+	  dpp);
+
+	bufferlist hbuf;
+	encode(*hinfo, hbuf);
+	for (auto &&i : *transactions) {
+	  i.second.setattr(
+	    coll_t(spg_t(pgid, i.first)),
+	    ghobject_t(oid, ghobject_t::NO_GEN, i.first),
+	    ECUtil::get_hinfo_key(),
+	    hbuf);
+	}
+	return;
+      }
+
       extent_map to_write;
       auto pextiter = partial_extents.find(oid);
       if (pextiter != partial_extents.end()) {
@@ -23,11 +23,26 @@
 #include "ExtentCache.h"
 
 namespace ECTransaction {
+  /**
+   * An overwrite confined to a single data chunk of a stripe.  Rather
+   * than reading and re-encoding the whole stripe, we read the range
+   * from the data shard and from the coding shards, and update the
+   * coding chunks from the delta between the old and the new data.
+   */
+  struct ParityDelta {
+    int shard = -1;            ///< data shard holding the range
+    uint64_t offset = 0;       ///< logical offset of the range
+    uint64_t length = 0;       ///< length of the range
+    uint64_t chunk_offset = 0; ///< offset of the range within the shard
+  };
+  ostream &operator<<(ostream &lhs, const ParityDelta &rhs);
+
   struct WritePlan {
     PGTransactionUPtr t;
     bool invalidates_cache = false; // Yes, both are possible
     map<hobject_t,extent_set> to_read;
     map<hobject_t,extent_set> will_write; // superset of to_read
+    map<hobject_t,ParityDelta> parity_delta; // disjoint from to_read
 
     map<hobject_t,ECUtil::HashInfoRef> hash_infos;
   };
@@ -36,11 +51,42 @@ namespace ECTransaction {
     uint64_t prev_size,
     const PGTransaction::ObjectOperation &op);
 
-  template <typename F>
+  /**
+   * Check whether op is a small overwrite of a single data chunk that
+   * is cheaper to apply as a parity delta than as a full stripe
+   * read-modify-write, and if so fill in pd.
+   *
+   * @param sinfo [in] stripe layout
+   * @param coding_chunks [in] number of coding chunks per stripe
+   * @param size [in] projected logical size of the object
+   * @param op [in] operation on the object
+   * @param pd [out] range to update
+   * @return true if op can use a parity delta
+   */
+  bool get_parity_delta(
+    const ECUtil::stripe_info_t &sinfo,
+    unsigned coding_chunks,
+    uint64_t size,
+    const PGTransaction::ObjectOperation &op,
+    ParityDelta *pd);
+
+  /// true if a parity delta write of pd modifies shard
+  bool parity_delta_writes_shard(
+    unsigned data_chunks,
+    const ParityDelta &pd,
+    int shard);
+
+  /**
+   * get_parity_delta(oid, op, projected_size, &pd) decides whether an
+   * object is updated with a parity delta; such objects go into
+   * WritePlan::parity_delta rather than to_read.
+   */
+  template <typename F, typename G>
   WritePlan get_write_plan(
     const ECUtil::stripe_info_t &sinfo,
     PGTransactionUPtr &&t,
     F &&get_hinfo,
+    G &&get_parity_delta,
     DoutPrefixProvider *dpp) {
     WritePlan plan;
     t->safe_create_traverse(
@@ -67,6 +113,15 @@ namespace ECTransaction {
 	}
 
 	auto &will_write = plan.will_write[i.first];
+	ParityDelta pd;
+	if (get_parity_delta(i.first, i.second, projected_size, &pd)) {
+	  ldpp_dout(dpp, 20) << __func__ << ": " << i.first
+			     << " parity delta " << pd << dendl;
+	  will_write.union_insert(pd.offset, pd.length);
+	  plan.parity_delta[i.first] = pd;
+	  return;
+	}
+
 	if (i.second.truncate &&
 	    i.second.truncate->first < projected_size) {
 	  if (!(sinfo.logical_offset_is_stripe_aligned(
@@ -188,6 +243,7 @@ namespace ECTransaction {
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
     const map<hobject_t,extent_map> &partial_extents,
+    const map<hobject_t,map<int, bufferlist> > &parity_delta_reads,
     vector<pg_log_entry_t> &entries,
     map<hobject_t,extent_map> *written,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -158,6 +158,42 @@ int ECUtil::encode(
   return 0;
 }
 
+int ECUtil::apply_parity_delta(
+  ErasureCodeInterfaceRef &ec_impl,
+  int shard,
+  bufferlist &old_data,
+  bufferlist &new_data,
+  map<int, bufferlist> *parity) {
+  const unsigned len = old_data.length();
+  ceph_assert(new_data.length() == len);
+  ceph_assert(parity);
+
+  bufferptr delta;
+  ec_impl->encode_delta(
+    bufferptr(old_data.c_str(), len),
+    bufferptr(new_data.c_str(), len),
+    &delta);
+
+  map<int, bufferptr> in;
+  in[shard] = delta;
+  map<int, bufferptr> out;
+  for (auto &&i : *parity) {
+    ceph_assert(i.second.length() == len);
+    bufferptr p(buffer::create_page_aligned(len));
+    i.second.copy(0, len, p.c_str());
+    out[i.first] = std::move(p);
+  }
+  int r = ec_impl->apply_delta(in, out);
+  if (r < 0)
+    return r;
+  for (auto &&i : out) {
+    bufferlist &bl = (*parity)[i.first];
+    bl.clear();
+    bl.push_back(std::move(i.second));
+  }
+  return 0;
+}
+
 void ECUtil::HashInfo::append(uint64_t old_size,
 			      map<int, bufferlist> &to_append) {
   ceph_assert(old_size == total_chunk_size);
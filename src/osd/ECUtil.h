@@ -98,6 +98,25 @@ int encode(
   const std::set<int> &want,
   std::map<int, bufferlist> *out);
 
+/**
+ * Update a range of the coding chunks for an overwrite of the same
+ * range of a single data chunk, using the plugin's parity delta
+ * support rather than re-encoding the stripe.
+ *
+ * @param ec_impl [in] plugin with FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION
+ * @param shard [in] data chunk being overwritten
+ * @param old_data [in] the range of the data chunk as stored
+ * @param new_data [in] the range of the data chunk as it will be written
+ * @param parity [in,out] coding chunk -> the range, updated in place
+ * @return 0 on success or a negative errno from the plugin
+ */
+int apply_parity_delta(
+  ErasureCodeInterfaceRef &ec_impl,
+  int shard,
+  bufferlist &old_data,
+  bufferlist &new_data,
+  std::map<int, bufferlist> *parity);
+
 class HashInfo {
   uint64_t total_chunk_size = 0;
   std::vector<uint32_t> cumulative_shard_hashes;
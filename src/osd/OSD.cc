@@ -262,6 +262,7 @@ OSDService::OSDService(OSD *osd) :
   recovery_ops_active(0),
   recovery_ops_reserved(0),
   recovery_paused(false),
+  recovery_throttle(RecoveryThrottle::limits_from_conf(cct)),
   map_cache_lock("OSDService::map_cache_lock"),
   map_cache(cct, cct->_conf->osd_map_cache_size),
   map_bl_cache(cct->_conf->osd_map_cache_size),
@@ -2677,6 +2678,22 @@ will start to track new ops received afterwards.";
     f->open_object_section("compact_result");
     f->dump_float("elapsed_time", duration);
     f->close_section();
+  } else if (admin_command == "fsck_online") {
+    dout(1) << "triggering online fsck" << dendl;
+    auto start = ceph::coarse_mono_clock::now();
+    int r = store->fsck_online();
+    auto end = ceph::coarse_mono_clock::now();
+    double duration = std::chrono::duration<double>(end-start).count();
+    dout(1) << "finished online fsck in " << duration << " seconds: "
+	    << (r < 0 ? cpp_strerror(r) : stringify(r) + " errors") << dendl;
+    f->open_object_section("fsck_result");
+    if (r < 0) {
+      f->dump_string("error", cpp_strerror(r));
+    } else {
+      f->dump_int("errors", r);
+    }
+    f->dump_float("elapsed_time", duration);
+    f->close_section();
   } else if (admin_command == "get_mapped_pools") {
     f->open_array_section("mapped_pools");
     set<int64_t> poollist = get_mapped_pools();
@@ -2810,6 +2827,8 @@ int OSD::get_num_op_threads()
 
 float OSD::get_osd_recovery_sleep()
 {
+  if (cct->_conf.get_val<bool>("osd_recovery_adaptive"))
+    return service.recovery_throttle.get_sleep();
   if (cct->_conf->osd_recovery_sleep)
     return cct->_conf->osd_recovery_sleep;
   if (!store_is_rotational && !journal_is_rotational)
@@ -3345,6 +3364,12 @@ void OSD::final_init()
                                      " WARNING: Compaction probably slows your requests");
   ceph_assert(r == 0);
 
+  r = admin_socket->register_command("fsck_online", "fsck_online",
+				     asok_hook,
+				     "Check object store metadata consistency"
+				     " against a snapshot while serving io.");
+  ceph_assert(r == 0);
+
   r = admin_socket->register_command("get_mapped_pools", "get_mapped_pools",
                                      asok_hook,
                                      "dump pools whose PG(s) are mapped to this OSD.");
@@ -3587,6 +3612,10 @@ void OSD::create_logger()
     "Latency of IO before calling queue(before really queue into ShardedOpWq)"); // client io before queue op_wq latency
   osd_plb.add_time_avg(l_osd_op_before_dequeue_op_lat, "op_before_dequeue_op_lat",
     "Latency of IO before calling dequeue_op(already dequeued and get PG lock)"); // client io before dequeue_op latency
+  osd_plb.add_u64_avg(
+    l_osd_op_copy_bytes, "op_copy_bytes",
+    "Bytes memcpy'd rebuilding buffers while processing a client operation",
+    NULL, PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
 
   osd_plb.add_u64_counter(
     l_osd_sop, "subop", "Suboperations");
@@ -3609,6 +3638,10 @@ void OSD::create_logger()
     l_osd_sop_push_inb, "subop_push_in_bytes", "Suboperations pushed size", NULL, 0, unit_t(UNIT_BYTES));
   osd_plb.add_time_avg(
     l_osd_sop_push_lat, "subop_push_latency", "Suboperations push latency");
+  osd_plb.add_u64_avg(
+    l_osd_sop_copy_bytes, "subop_copy_bytes",
+    "Bytes memcpy'd rebuilding buffers while applying a replicated write",
+    NULL, PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
 
   osd_plb.add_u64_counter(l_osd_pull, "pull", "Pull requests sent");
   osd_plb.add_u64_counter(l_osd_push, "push", "Push messages sent");
@@ -3740,6 +3773,19 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64(
+    l_osd_recovery_adaptive_active, "recovery_adaptive_active",
+    "Concurrent recovery ops allowed by the adaptive throttle");
+  osd_plb.add_time(
+    l_osd_recovery_adaptive_sleep, "recovery_adaptive_sleep",
+    "Recovery sleep chosen by the adaptive throttle");
+  osd_plb.add_u64(
+    l_osd_recovery_adaptive_backfills, "recovery_adaptive_backfills",
+    "Backfill reservations allowed by the adaptive throttle");
+  osd_plb.add_time(
+    l_osd_recovery_adaptive_client_p99, "recovery_adaptive_client_p99",
+    "Client op p99 latency seen by the adaptive throttle");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -5404,6 +5450,7 @@ void OSD::tick_without_osd_lock()
       sched_scrub();
     }
     service.promote_throttle_recalibrate();
+    service.update_recovery_throttle();
     resume_creating_pg();
     bool need_send_beacon = false;
     const auto now = ceph::coarse_mono_clock::now();
@@ -7965,7 +8012,17 @@ void OSD::handle_osd_map(MOSDMap *m)
       t.write(coll_t::meta(), oid, 0, bl.length(), bl);
 
       OSDMap *o = new OSDMap;
-      if (e > 1) {
+      OSDMapRef prev;
+      if (auto q = added_maps.find(e - 1); q != added_maps.end()) {
+	prev = q->second;
+      } else if (osdmap && osdmap->get_epoch() == e - 1) {
+	prev = osdmap;
+      }
+      if (prev) {
+	// share whatever the incremental leaves alone with the previous
+	// epoch instead of decoding a private copy of everything
+	o->shared_copy_from(*prev);
+      } else if (e > 1) {
 	bufferlist obl;
         bool got = get_map_bl(e - 1, obl);
 	if (!got) {
@@ -9504,7 +9561,7 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
     return false;
   }
 
-  uint64_t max = cct->_conf->osd_recovery_max_active;
+  uint64_t max = get_recovery_max_active();
   if (max <= recovery_ops_active + recovery_ops_reserved) {
     dout(15) << __func__ << " active " << recovery_ops_active
 	     << " + reserved " << recovery_ops_reserved
@@ -9518,6 +9575,38 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
   return true;
 }
 
+uint64_t OSDService::get_recovery_max_active()
+{
+  if (cct->_conf.get_val<bool>("osd_recovery_adaptive"))
+    return recovery_throttle.get_max_active();
+  return cct->_conf->osd_recovery_max_active;
+}
+
+void OSDService::update_recovery_throttle()
+{
+  if (!cct->_conf.get_val<bool>("osd_recovery_adaptive"))
+    return;
+  bool changed = recovery_throttle.update(store->get_queue_utilization());
+  if (changed) {
+    dout(10) << __func__ << " " << recovery_throttle << dendl;
+  } else {
+    dout(20) << __func__ << " " << recovery_throttle << dendl;
+  }
+  utime_t t;
+  logger->set(l_osd_recovery_adaptive_active,
+	      recovery_throttle.get_max_active());
+  t.set_from_double(recovery_throttle.get_sleep());
+  logger->tset(l_osd_recovery_adaptive_sleep, t);
+  logger->set(l_osd_recovery_adaptive_backfills,
+	      recovery_throttle.get_max_backfills());
+  t.set_from_double(recovery_throttle.get_last_p99());
+  logger->tset(l_osd_recovery_adaptive_client_p99, t);
+  if (changed) {
+    local_reserver.set_max(recovery_throttle.get_max_backfills());
+    remote_reserver.set_max(recovery_throttle.get_max_backfills());
+  }
+}
+
 void OSD::do_recovery(
   PG *pg, epoch_t queued, uint64_t reserved_pushes,
   ThreadPool::TPHandle &handle)
@@ -9597,7 +9686,7 @@ void OSDService::start_recovery_op(PG *pg, const hobject_t& soid)
   std::lock_guard l(recovery_lock);
   dout(10) << "start_recovery_op " << *pg << " " << soid
 	   << " (" << recovery_ops_active << "/"
-	   << cct->_conf->osd_recovery_max_active << " rops)"
+	   << get_recovery_max_active() << " rops)"
 	   << dendl;
   recovery_ops_active++;
 
@@ -9613,7 +9702,7 @@ void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
   std::lock_guard l(recovery_lock);
   dout(10) << "finish_recovery_op " << *pg << " " << soid
 	   << " dequeue=" << dequeue
-	   << " (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active << " rops)"
+	   << " (" << recovery_ops_active << "/" << get_recovery_max_active() << " rops)"
 	   << dendl;
 
   // adjust count
@@ -9740,7 +9829,21 @@ void OSD::dequeue_op(
   op->mark_reached_pg();
   op->osd_trace.event("dequeue_op");
 
+  // the object store queues the transaction (and submits aligned data to
+  // the device) from this thread, so this covers the whole write path up
+  // to the disk except for deferred writes
+  uint64_t copied = buffer::get_thread_memcopy_count();
   pg->do_request(op, handle);
+  copied = buffer::get_thread_memcopy_count() - copied;
+  switch (op->get_req()->get_type()) {
+  case CEPH_MSG_OSD_OP:
+    logger->inc(l_osd_op_copy_bytes, copied);
+    break;
+  case MSG_OSD_REPOP:
+  case MSG_OSD_EC_WRITE:
+    logger->inc(l_osd_sop_copy_bytes, copied);
+    break;
+  }
 
   // finish
   dout(10) << "dequeue_op " << op << " finish" << dendl;
@@ -9810,6 +9913,11 @@ const char** OSD::get_tracked_conf_keys() const
 {
   static const char* KEYS[] = {
     "osd_max_backfills",
+    "osd_recovery_adaptive",
+    "osd_recovery_adaptive_target_p99",
+    "osd_recovery_adaptive_max_queue_util",
+    "osd_recovery_adaptive_max_active",
+    "osd_recovery_adaptive_max_sleep",
     "osd_min_recovery_priority",
     "osd_max_trimming_pgs",
     "osd_op_complaint_time",
@@ -9838,6 +9946,7 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_client_message_cap",
     "osd_heartbeat_min_size",
     "osd_heartbeat_interval",
+    "osd_op_batch_max",
     NULL
   };
   return KEYS;
@@ -9847,9 +9956,24 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
 			     const std::set <std::string> &changed)
 {
   Mutex::Locker l(osd_lock);
-  if (changed.count("osd_max_backfills")) {
-    service.local_reserver.set_max(cct->_conf->osd_max_backfills);
-    service.remote_reserver.set_max(cct->_conf->osd_max_backfills);
+  if (changed.count("osd_max_backfills") ||
+      changed.count("osd_recovery_adaptive") ||
+      changed.count("osd_recovery_adaptive_target_p99") ||
+      changed.count("osd_recovery_adaptive_max_queue_util") ||
+      changed.count("osd_recovery_adaptive_max_active") ||
+      changed.count("osd_recovery_adaptive_max_sleep")) {
+    service.recovery_throttle.set_limits(
+      RecoveryThrottle::limits_from_conf(cct));
+    unsigned backfills = cct->_conf->osd_max_backfills;
+    if (cct->_conf.get_val<bool>("osd_recovery_adaptive")) {
+      backfills = service.recovery_throttle.get_max_backfills();
+    }
+    service.local_reserver.set_max(backfills);
+    service.remote_reserver.set_max(backfills);
+  }
+  if (changed.count("osd_op_batch_max")) {
+    op_shardedwq.set_batch_max(
+      cct->_conf.get_val<uint64_t>("osd_op_batch_max"));
   }
   if (changed.count("osd_min_recovery_priority")) {
     service.local_reserver.set_min_priority(cct->_conf->osd_min_recovery_priority);
@@ -10644,6 +10768,24 @@ void OSD::ShardedOpWQ::_add_slot_waiter(
 #undef dout_prefix
 #define dout_prefix *_dout << "osd." << osd->whoami << " op_wq(" << shard_index << ") "
 
+/// the op of a queue item that may run in a batch with others for its pg
+static boost::optional<OpRequestRef> batchable_op(
+  const OpQueueItem& qi, const PGRef& pg, unsigned max_batch)
+{
+  if (max_batch <= 1 || pg->get_pool().info.is_erasure()) {
+    return boost::none;
+  }
+  auto op = qi.maybe_get_op();
+  if (op) {
+    switch ((*op)->get_req()->get_type()) {
+    case CEPH_MSG_OSD_OP:
+    case MSG_OSD_REPOP:
+      return op;
+    }
+  }
+  return boost::none;
+}
+
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 {
   uint32_t shard_index = thread_index % osd->num_shards;
@@ -10915,7 +11057,40 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   delete f;
   *_dout << dendl;
 
-  qi.run(osd, sdata, pg, tp_handle);
+  const unsigned max_batch = batch_max;
+  if (auto op = batchable_op(qi, pg, max_batch); op) {
+    // keep the pg lock for the ops of this pg that other workers already
+    // took from pqueue, and which wait in to_process for the lock we hold.
+    // they are next in line for this pg anyway, so we run them in order,
+    // and queue their transactions together.  pqueue itself is not
+    // touched, so its scheduling is unchanged; the workers that queued
+    // them find to_process empty once they get the lock.
+    pg->start_txn_batch();
+    for (unsigned n = 1; ; ++n) {
+      osd->dequeue_op(pg, *op, tp_handle);
+      if (n >= max_batch) {
+	break;
+      }
+      std::lock_guard l{sdata->shard_lock};
+      auto q = sdata->pg_slots.find(token);
+      if (osd->is_stopping() ||
+	  q == sdata->pg_slots.end() ||
+	  q->second->pg != pg ||
+	  q->second->to_process.empty() ||
+	  !(op = batchable_op(q->second->to_process.front(), pg, max_batch))) {
+	dout(20) << __func__ << " " << token << " batch of " << n << dendl;
+	break;
+      }
+      dout(20) << __func__ << " " << q->second->to_process.front()
+	       << " batched after " << n << dendl;
+      q->second->to_process.pop_front();
+      tp_handle.reset_tp_timeout();
+    }
+    pg->end_txn_batch(&tp_handle);
+    pg->unlock();
+  } else {
+    qi.run(osd, sdata, pg, tp_handle);
+  }
 
   {
 #ifdef WITH_LTTNG
@@ -43,6 +43,7 @@
 #include "Session.h"
 
 #include "osd/OpQueueItem.h"
+#include "osd/RecoveryThrottle.h"
 
 #include <atomic>
 #include <map>
@@ -105,6 +106,7 @@ enum {
 
   l_osd_op_before_queue_op_lat,
   l_osd_op_before_dequeue_op_lat,
+  l_osd_op_copy_bytes,
 
   l_osd_sop,
   l_osd_sop_inb,
@@ -117,6 +119,7 @@ enum {
   l_osd_sop_push,
   l_osd_sop_push_inb,
   l_osd_sop_push_lat,
+  l_osd_sop_copy_bytes,
 
   l_osd_pull,
   l_osd_push,
@@ -185,6 +188,11 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_recovery_adaptive_active,
+  l_osd_recovery_adaptive_sleep,
+  l_osd_recovery_adaptive_backfills,
+  l_osd_recovery_adaptive_client_p99,
+
   l_osd_last,
 };
 
@@ -773,10 +781,15 @@ private:
   map<spg_t, set<hobject_t> > recovery_oids;
 #endif
   bool _recover_now(uint64_t *available_pushes);
+  uint64_t get_recovery_max_active();
   void _maybe_queue_recovery();
   void _queue_for_recovery(
     pair<epoch_t, PGRef> p, uint64_t reserved_pushes);
 public:
+  /// paces recovery when osd_recovery_adaptive is set
+  RecoveryThrottle recovery_throttle;
+  void update_recovery_throttle();
+
   void start_recovery_op(PG *pg, const hobject_t& soid);
   void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue);
   bool is_recovery_active();
@@ -1735,13 +1748,21 @@ protected:
   {
     OSD *osd;
 
+    /// max ops for one pg run under a single pg lock hold (osd_op_batch_max)
+    std::atomic<unsigned> batch_max;
+
   public:
     ShardedOpWQ(OSD *o,
 		time_t ti,
 		time_t si,
 		ShardedThreadPool* tp)
       : ShardedThreadPool::ShardedWQ<OpQueueItem>(ti, si, tp),
-        osd(o) {
+        osd(o),
+        batch_max(o->cct->_conf.get_val<uint64_t>("osd_op_batch_max")) {
+    }
+
+    void set_batch_max(unsigned n) {
+      batch_max = std::max(n, 1u);
     }
 
     void _add_slot_waiter(
@@ -1265,13 +1265,14 @@ void OSDMap::set_max_osd(int m)
   }
   osd_info.resize(m);
   osd_xinfo.resize(m);
-  osd_addrs->client_addrs.resize(m);
-  osd_addrs->cluster_addrs.resize(m);
-  osd_addrs->hb_back_addrs.resize(m);
-  osd_addrs->hb_front_addrs.resize(m);
-  osd_uuid->resize(m);
+  auto& addrs = unshare(osd_addrs);
+  addrs.client_addrs.resize(m);
+  addrs.cluster_addrs.resize(m);
+  addrs.hb_back_addrs.resize(m);
+  addrs.hb_front_addrs.resize(m);
+  unshare(osd_uuid).resize(m);
   if (osd_primary_affinity)
-    osd_primary_affinity->resize(m, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
+    unshare(osd_primary_affinity).resize(m, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
 
   calc_num_osds();
 }
@@ -1597,30 +1598,37 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
 
   int diff = 0;
 
+  // sections apply_incremental left alone are already shared
+
   // do addrs match?
   if (o->max_osd != n->max_osd)
     diff++;
-  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
-    if ( n->osd_addrs->client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
-	*n->osd_addrs->client_addrs[i] == *o->osd_addrs->client_addrs[i])
-      n->osd_addrs->client_addrs[i] = o->osd_addrs->client_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
-	*n->osd_addrs->cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
-      n->osd_addrs->cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
-	*n->osd_addrs->hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
-      n->osd_addrs->hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
-	*n->osd_addrs->hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
-      n->osd_addrs->hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
-    else
-      diff++;
+  if (n->osd_addrs != o->osd_addrs) {
+    // the entries are replaced in place, and o need not be the map n was
+    // built from, so n's section may still be shared with a published map
+    auto& addrs = unshare(n->osd_addrs);
+    for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+      if ( addrs.client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
+	  *addrs.client_addrs[i] == *o->osd_addrs->client_addrs[i])
+	addrs.client_addrs[i] = o->osd_addrs->client_addrs[i];
+      else
+	diff++;
+      if ( addrs.cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
+	  *addrs.cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
+	addrs.cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
+      else
+	diff++;
+      if ( addrs.hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
+	  *addrs.hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
+	addrs.hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
+      else
+	diff++;
+      if ( addrs.hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
+	  *addrs.hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
+	addrs.hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
+      else
+	diff++;
+    }
   }
   if (diff == 0) {
     // zoinks, no differences at all!
@@ -1628,25 +1636,29 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   }
 
   // does crush match?
-  bufferlist oc, nc;
-  encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (o->crush != n->crush) {
+    bufferlist oc, nc;
+    encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (*o->pg_temp == *n->pg_temp)
+  if (o->pg_temp != n->pg_temp && *o->pg_temp == *n->pg_temp)
     n->pg_temp = o->pg_temp;
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (o->primary_temp != n->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
 
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (o->osd_uuid != n->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
 }
@@ -1989,14 +2001,15 @@ int OSDMap::apply_incremental(const Incremental &inc)
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
-      (*osd_uuid)[osd] = uuid_d();
+      unshare(osd_uuid)[osd] = uuid_d();
       osd_info[osd] = osd_info_t();
       osd_xinfo[osd] = osd_xinfo_t();
       set_primary_affinity(osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
-      osd_addrs->client_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->cluster_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_front_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_back_addrs[osd].reset(new entity_addrvec_t());
+      auto& addrs = unshare(osd_addrs);
+      addrs.client_addrs[osd].reset(new entity_addrvec_t());
+      addrs.cluster_addrs[osd].reset(new entity_addrvec_t());
+      addrs.hb_front_addrs[osd].reset(new entity_addrvec_t());
+      addrs.hb_back_addrs[osd].reset(new entity_addrvec_t());
       osd_state[osd] = 0;
     } else {
       osd_state[osd] ^= s;
@@ -2005,18 +2018,19 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
-    osd_addrs->client_addrs[client.first].reset(
+    auto& addrs = unshare(osd_addrs);
+    addrs.client_addrs[client.first].reset(
       new entity_addrvec_t(client.second));
-    osd_addrs->hb_back_addrs[client.first].reset(
+    addrs.hb_back_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_back_up.find(client.first)->second));
-    osd_addrs->hb_front_addrs[client.first].reset(
+    addrs.hb_front_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_front_up.find(client.first)->second));
 
     osd_info[client.first].up_from = epoch;
   }
 
   for (const auto &cluster : inc.new_up_cluster)
-    osd_addrs->cluster_addrs[cluster.first].reset(
+    unshare(osd_addrs).cluster_addrs[cluster.first].reset(
       new entity_addrvec_t(cluster.second));
 
   // info
@@ -2037,25 +2051,29 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   // uuid
   for (const auto &uuid : inc.new_uuid)
-    (*osd_uuid)[uuid.first] = uuid.second;
+    unshare(osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
-  for (const auto &pg : inc.new_pg_temp) {
-    if (pg.second.empty())
-      pg_temp->erase(pg.first);
-    else
-      pg_temp->set(pg.first, pg.second);
-  }
   if (!inc.new_pg_temp.empty()) {
+    auto& temp = unshare(pg_temp);
+    for (const auto &pg : inc.new_pg_temp) {
+      if (pg.second.empty())
+	temp.erase(pg.first);
+      else
+	temp.set(pg.first, pg.second);
+    }
     // make sure pg_temp is efficiently stored
-    pg_temp->rebuild();
+    temp.rebuild();
   }
 
-  for (const auto &pg : inc.new_primary_temp) {
-    if (pg.second == -1)
-      primary_temp->erase(pg.first);
-    else
-      (*primary_temp)[pg.first] = pg.second;
+  if (!inc.new_primary_temp.empty()) {
+    auto& temp = unshare(primary_temp);
+    for (const auto &pg : inc.new_primary_temp) {
+      if (pg.second == -1)
+	temp.erase(pg.first);
+      else
+	temp[pg.first] = pg.second;
+    }
   }
 
   for (auto& p : inc.new_pg_upmap) {
@@ -2484,6 +2502,56 @@ void OSDMap::_pg_to_up_acting_osds(
     *acting_primary = _acting_primary;
 }
 
+void OSDMap::pg_range_to_up_acting_osds(
+  int64_t poolid, unsigned ps_begin, unsigned ps_end,
+  vector<vector<int>> *up, vector<int> *up_primary,
+  vector<vector<int>> *acting, vector<int> *acting_primary,
+  vector<vector<int>> *raw) const
+{
+  const pg_pool_t *pool = get_pg_pool(poolid);
+  ceph_assert(pool);
+  ceph_assert(ps_begin <= ps_end);
+  unsigned n = ps_end - ps_begin;
+  up->resize(n);
+  up_primary->resize(n);
+  acting->resize(n);
+  acting_primary->resize(n);
+
+  // same as _pg_to_raw_osds(), only for the whole range at once
+  vector<int> pps(n);
+  for (unsigned i = 0; i < n; ++i) {
+    pps[i] = pool->raw_pg_to_pps(pg_t(ps_begin + i, poolid));
+  }
+  vector<vector<int>> raws;
+  unsigned size = pool->get_size();
+  int ruleno = crush->find_rule(pool->get_crush_rule(), pool->get_type(), size);
+  if (ruleno >= 0) {
+    crush->do_rule_batch(ruleno, pps, raws, size, osd_weight, poolid);
+  } else {
+    raws.resize(n);
+  }
+  if (raw) {
+    *raw = raws;
+  }
+
+  for (unsigned i = 0; i < n; ++i) {
+    pg_t pg(ps_begin + i, poolid);
+    vector<int>& osds = raws[i];
+    _remove_nonexistent_osds(*pool, osds);
+    _apply_upmap(*pool, pg, &osds);
+    _raw_to_up_osds(*pool, osds, &(*up)[i]);
+    (*up_primary)[i] = _pick_primary((*up)[i]);
+    _apply_primary_affinity(pps[i], *pool, &(*up)[i], &(*up_primary)[i]);
+    _get_temp_osds(*pool, pg, &(*acting)[i], &(*acting_primary)[i]);
+    if ((*acting)[i].empty()) {
+      (*acting)[i] = (*up)[i];
+      if ((*acting_primary)[i] == -1) {
+	(*acting_primary)[i] = (*up_primary)[i];
+      }
+    }
+  }
+}
+
 int OSDMap::calc_pg_rank(int osd, const vector<int>& acting, int nrep)
 {
   if (!nrep)
@@ -2853,11 +2921,23 @@ void OSDMap::decode(bufferlist& bl)
   decode(p);
 }
 
+void OSDMap::reset_shared_sections()
+{
+  // we may be decoding over a map built with shared_copy_from()
+  osd_addrs = std::make_shared<addrs_s>();
+  pg_temp = std::make_shared<PGTempMap>();
+  primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
+  osd_uuid = std::make_shared<mempool::osdmap::vector<uuid_d>>();
+  osd_primary_affinity.reset();
+  crush = std::make_shared<CrushWrapper>();
+}
+
 void OSDMap::decode_classic(bufferlist::const_iterator& p)
 {
   using ceph::decode;
   __u32 n, t;
   __u16 v;
+  reset_shared_sections();
   decode(v, p);
 
   // base
@@ -2994,6 +3074,7 @@ void OSDMap::decode(bufferlist::const_iterator& bl)
     decode_classic(bl);
     return;
   }
+  reset_shared_sections();
   /**
    * Since we made it past that hurdle, we can use our normal paths.
    */
@@ -599,6 +599,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -620,6 +621,23 @@ private:
 private:
   OSDMap(const OSDMap& other) = default;
   OSDMap& operator=(const OSDMap& other) = default;
+
+  /**
+   * The shared_ptr'd sections (crush, osd_addrs, pg_temp, primary_temp,
+   * osd_uuid, osd_primary_affinity) may be shared with the maps of other
+   * epochs.  Whatever changes one in place must take its own copy first;
+   * use_count() == 1 means nobody else can be looking, as a map is only
+   * shared once it has been built.
+   */
+  template<typename T>
+  static T& unshare(std::shared_ptr<T>& p) {
+    if (p.use_count() > 1) {
+      p.reset(new T(*p));
+    }
+    return *p;
+  }
+  /// fresh sections for decode to fill in
+  void reset_shared_sections();
 public:
 
   /// return feature mask subset that is relevant to OSDMap encoding
@@ -629,6 +647,18 @@ public:
 
   uint64_t get_encoding_features() const;
 
+  /**
+   * copy o, sharing all its shared_ptr'd sections
+   *
+   * This is cheap and what we want to build the next epoch with
+   * apply_incremental(), which copies a section only when the
+   * incremental changes it.  Unlike deepish_copy_from(), the sections
+   * must not be modified directly.
+   */
+  void shared_copy_from(const OSDMap& o) {
+    *this = o;
+  }
+
   void deepish_copy_from(const OSDMap& o) {
     *this = o;
     primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>(*o.primary_temp));
@@ -758,7 +788,7 @@ public:
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
-    (*osd_primary_affinity)[o] = w;
+    unshare(osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
     ceph_assert(o < max_osd);
@@ -1181,6 +1211,20 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * map pgs [ps_begin, ps_end) of a pool as pg_to_up_acting_osds() does,
+   * running CRUSH for all of them in one batch. Element i of each output
+   * is for pg ps_begin + i. The pool must exist. If given, raw gets what
+   * CRUSH itself returned, before nonexistent osds are dropped and the
+   * upmaps applied.
+   */
+  void pg_range_to_up_acting_osds(int64_t pool, unsigned ps_begin,
+				  unsigned ps_end,
+				  vector<vector<int>> *up,
+				  vector<int> *up_primary,
+				  vector<vector<int>> *acting,
+				  vector<int> *acting_primary,
+				  vector<vector<int>> *raw = nullptr) const;
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
@@ -1435,8 +1479,8 @@ public:
   int validate_crush_rules(CrushWrapper *crush, ostream *ss) const;
 
   void clear_temp() {
-    pg_temp->clear();
-    primary_temp->clear();
+    pg_temp = std::make_shared<PGTempMap>();
+    primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
   }
 
 private:
@@ -57,6 +57,147 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+bool OSDMapMapping::update(const OSDMap& osdmap,
+			   const OSDMap::Incremental& inc)
+{
+  if (_update_incremental(osdmap, inc)) {
+    return true;
+  }
+  update(osdmap);
+  return false;
+}
+
+std::unique_ptr<OSDMapMapping::MappingJob> OSDMapMapping::start_update(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  ParallelPGMapper& mapper,
+  unsigned pgs_per_item)
+{
+  utime_t start = ceph_clock_now();
+  if (_update_incremental(osdmap, inc)) {
+    return std::unique_ptr<MappingJob>(new MappingJob(this, &osdmap, start));
+  }
+  return start_update(osdmap, mapper, pgs_per_item);
+}
+
+bool OSDMapMapping::_update_incremental(const OSDMap& osdmap,
+					const OSDMap::Incremental& inc)
+{
+  if (epoch == 0 ||
+      epoch + 1 != inc.epoch ||
+      inc.epoch != osdmap.get_epoch()) {
+    return false;
+  }
+  // anything that may move pgs around in CRUSH, or change the primary
+  // of any pg, means starting over
+  if (inc.fullmap.length() ||
+      inc.crush.length() ||
+      inc.new_max_osd >= 0 ||
+      !inc.new_weight.empty() ||
+      !inc.new_primary_affinity.empty()) {
+    return false;
+  }
+
+  // pools that are new or changed in any way are recomputed in full
+  set<int64_t> dirty_pools;
+  for (auto& p : inc.new_pools) {
+    dirty_pools.insert(p.first);
+  }
+
+  // pgs whose temps or upmaps changed
+  set<pg_t> dirty_pgs;
+  for (auto& p : inc.new_pg_temp) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& pg : inc.old_pg_upmap) {
+    dirty_pgs.insert(pg);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& pg : inc.old_pg_upmap_items) {
+    dirty_pgs.insert(pg);
+  }
+
+  // osds that went up, down, or in or out of existence.  these only
+  // matter to pgs that CRUSH, a temp or an upmap put on them.
+  set<int> dirty_osds;
+  for (auto& p : inc.new_state) {
+    if (!p.second || (p.second & (CEPH_OSD_UP | CEPH_OSD_EXISTS))) {
+      dirty_osds.insert(p.first);
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    dirty_osds.insert(p.first);
+  }
+  if (!dirty_osds.empty()) {
+    for (auto& p : pools) {
+      if (dirty_pools.count(p.first)) {
+	continue;
+      }
+      for (unsigned ps = 0; ps < p.second.pg_num; ++ps) {
+	for (auto osd : dirty_osds) {
+	  if (p.second.has_osd(ps, osd)) {
+	    dirty_pgs.insert(pg_t(ps, p.first));
+	    break;
+	  }
+	}
+      }
+    }
+    for (const auto& p : *osdmap.pg_temp) {
+      for (auto osd : p.second) {
+	if (dirty_osds.count(osd)) {
+	  dirty_pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+    for (auto& p : osdmap.pg_upmap) {
+      for (auto osd : p.second) {
+	if (dirty_osds.count(osd)) {
+	  dirty_pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+    for (auto& p : osdmap.pg_upmap_items) {
+      for (auto& q : p.second) {
+	if (dirty_osds.count(q.first) || dirty_osds.count(q.second)) {
+	  dirty_pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+  }
+
+  // resizes (and so dirties) the pools whose pg_num or size changed, and
+  // drops deleted ones
+  _init_mappings(osdmap);
+  for (auto pool : dirty_pools) {
+    auto p = osdmap.get_pools().find(pool);
+    if (p != osdmap.get_pools().end()) {
+      _update_range(osdmap, pool, 0, p->second.get_pg_num());
+    }
+  }
+  for (auto pgid : dirty_pgs) {
+    if (dirty_pools.count(pgid.pool())) {
+      continue;
+    }
+    auto p = pools.find(pgid.pool());
+    if (p != pools.end() && pgid.ps() < p->second.pg_num) {
+      _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+    }
+  }
+  _finish(osdmap);
+  return true;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -112,14 +253,15 @@ void OSDMapMapping::_update_range(
   ceph_assert(i != pools.end());
   ceph_assert(pg_begin <= pg_end);
   ceph_assert(pg_end <= i->second.pg_num);
+  vector<vector<int>> up, acting, raw;
+  vector<int> up_primary, acting_primary;
+  osdmap.pg_range_to_up_acting_osds(
+    pool, pg_begin, pg_end,
+    &up, &up_primary, &acting, &acting_primary, &raw);
   for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    vector<int> up, acting;
-    int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
-      pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
+    unsigned j = ps - pg_begin;
+    i->second.set(ps, up[j], up_primary[j], acting[j], acting_primary[j],
+		  raw[j]);
   }
 }
 
@@ -11,8 +11,7 @@
 #include "osd/osd_types.h"
 #include "common/WorkQueue.h"
 #include "common/Cond.h"
-
-class OSDMap;
+#include "osd/OSDMap.h"
 
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
@@ -187,7 +186,9 @@ private:
 	1 + // num acting
 	1 + // num up
 	size + // acting
-	size;  // up
+	size + // up
+	1 + // num raw
+	size;  // raw, as CRUSH returned it
     }
 
     PoolMapping(int s, int p, bool e)
@@ -227,7 +228,8 @@ private:
 	     const std::vector<int>& up,
 	     int up_primary,
 	     const std::vector<int>& acting,
-	     int acting_primary) {
+	     int acting_primary,
+	     const std::vector<int>& raw) {
       int32_t *row = &table[row_size() * ps];
       row[0] = acting_primary;
       row[1] = up_primary;
@@ -242,6 +244,32 @@ private:
       for (int i = 0; i < row[3]; ++i) {
 	row[4 + size + i] = up[i];
       }
+      int32_t *r = row + 4 + 2 * size;
+      r[0] = std::min<int32_t>(raw.size(), size);
+      for (int i = 0; i < r[0]; ++i) {
+	r[1 + i] = raw[i];
+      }
+    }
+    /// does osd appear in the up, acting or raw set of ps?
+    bool has_osd(size_t ps, int osd) const {
+      const int32_t *row = &table[row_size() * ps];
+      for (int i = 0; i < row[2]; ++i) {
+	if (row[4 + i] == osd) {
+	  return true;
+	}
+      }
+      for (int i = 0; i < row[3]; ++i) {
+	if (row[4 + size + i] == osd) {
+	  return true;
+	}
+      }
+      const int32_t *r = row + 4 + 2 * size;
+      for (int i = 0; i < r[0]; ++i) {
+	if (r[1 + i] == osd) {
+	  return true;
+	}
+      }
+      return false;
     }
   };
 
@@ -261,12 +289,17 @@ private:
   void _build_rmap(const OSDMap& osdmap);
 
   void _start(const OSDMap& osdmap) {
+    // we are no mapping of any epoch until _finish
+    epoch = 0;
     _init_mappings(osdmap);
   }
   void _finish(const OSDMap& osdmap);
 
   void _dump();
 
+  bool _update_incremental(const OSDMap& osdmap,
+			   const OSDMap::Incremental& inc);
+
   friend class ParallelPGMapper;
 
   struct MappingJob : public ParallelPGMapper::Job {
@@ -275,6 +308,12 @@ private:
       : Job(osdmap), mapping(m) {
       mapping->_start(*osdmap);
     }
+    /// a job that is already done, the mapping being up to date
+    MappingJob(OSDMapMapping *m, const OSDMap *osdmap, utime_t started)
+      : Job(osdmap), mapping(m) {
+      start = started;
+      finish = ceph_clock_now();
+    }
     void process(int64_t pool, unsigned ps_begin, unsigned ps_end) override {
       mapping->_update_range(*osdmap, pool, ps_begin, ps_end);
     }
@@ -324,6 +363,15 @@ public:
 
   void update(const OSDMap& map);
   void update(const OSDMap& map, pg_t pgid);
+  /**
+   * update a mapping of the epoch before map, inc being what took the
+   * OSDMap from there to map.  Only the pools and pgs that inc can have
+   * remapped are recomputed; a new crush map, osd weights or primary
+   * affinities, or a mapping of any other epoch, make it start over.
+   *
+   * @return true if we got away with updating just a part
+   */
+  bool update(const OSDMap& map, const OSDMap::Incremental& inc);
 
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
@@ -333,6 +381,16 @@ public:
     mapper.queue(job.get(), pgs_per_item);
     return job;
   }
+  /**
+   * like update(map, inc) when that can get away with a partial update,
+   * which is done in place and the job returned is already done;
+   * otherwise start_update(map, mapper, pgs_per_item)
+   */
+  std::unique_ptr<MappingJob> start_update(
+    const OSDMap& map,
+    const OSDMap::Incremental& inc,
+    ParallelPGMapper& mapper,
+    unsigned pgs_per_item);
 
   epoch_t get_epoch() const {
     return epoch;
@@ -388,6 +388,40 @@ void PG::lock(bool no_lockdep) const
   dout(30) << "lock" << dendl;
 }
 
+void PG::end_txn_batch(ThreadPool::TPHandle *handle)
+{
+  ceph_assert(is_locked());
+  batching_txns = false;
+  if (txn_batch.empty()) {
+    return;
+  }
+  dout(20) << __func__ << " " << txn_batch.size() << " transactions of "
+	   << txn_batch_ops.size() << " ops" << dendl;
+  if (txn_batch_ops.size() == 1 || !osd->store->allows_journal()) {
+    // a store only tracks the op it is handed in its journal, so without
+    // one the batch goes in one call, and each op notes when it was queued
+    for (auto& [op, first] : txn_batch_ops) {
+      if (op) {
+	op->mark_event("txn_batch_queued");
+      }
+    }
+    osd->store->queue_transactions(ch, txn_batch,
+				   txn_batch_ops.front().first, handle);
+  } else {
+    // one call for each op, so every op is tracked through the journal
+    for (auto p = txn_batch_ops.begin(); p != txn_batch_ops.end(); ++p) {
+      auto first = txn_batch.begin() + p->second;
+      auto last = (std::next(p) == txn_batch_ops.end() ?
+		   txn_batch.end() : txn_batch.begin() + std::next(p)->second);
+      vector<ObjectStore::Transaction> tls{std::make_move_iterator(first),
+					   std::make_move_iterator(last)};
+      osd->store->queue_transactions(ch, tls, p->first, handle);
+    }
+  }
+  txn_batch.clear();
+  txn_batch_ops.clear();
+}
+
 std::ostream& PG::gen_prefix(std::ostream& out) const
 {
   OSDMapRef mapref = osdmap_ref;
@@ -4016,9 +4050,11 @@ void PG::log_weirdness()
 			 << pg_log.get_log().log.rbegin()->version << "]";
   }
   
-  if (pg_log.get_log().caller_ops.size() > pg_log.get_log().log.size()) {
+  auto caller_ops = pg_log.get_log().reqid_index.size(
+    pglog_reqid_index_t::ENTRY);
+  if (caller_ops > pg_log.get_log().log.size()) {
     osd->clog->error() << info.pgid
-		      << " caller_ops.size " << pg_log.get_log().caller_ops.size()
+		      << " caller_ops.size " << caller_ops
 		       << " > log size " << pg_log.get_log().log.size();
   }
 }
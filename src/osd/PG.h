@@ -299,6 +299,17 @@ public:
     return _lock.is_locked();
   }
 
+  /**
+   * hold back the transactions queued through queue_transaction(s) until
+   * end_txn_batch(), which submits them to the store in one call.  The
+   * pg lock must be held for the whole batch.
+   */
+  void start_txn_batch() {
+    ceph_assert(is_locked());
+    batching_txns = true;
+  }
+  void end_txn_batch(ThreadPool::TPHandle *handle);
+
   const spg_t& get_pgid() const {
     return pg_id;
   }
@@ -548,6 +559,19 @@ protected:
 
   std::atomic<unsigned int> ref{0};
 
+  // transactions held back by start_txn_batch()
+  bool batching_txns = false;
+  vector<ObjectStore::Transaction> txn_batch;
+  /// the ops that queued into txn_batch, and the index of their first one
+  vector<pair<OpRequestRef, size_t>> txn_batch_ops;
+
+  void add_to_txn_batch(ObjectStore::Transaction&& t, OpRequestRef op) {
+    if (txn_batch_ops.empty() || txn_batch_ops.back().first != op) {
+      txn_batch_ops.emplace_back(op, txn_batch.size());
+    }
+    txn_batch.push_back(std::move(t));
+  }
+
 #ifdef PG_DEBUG_REFS
   Mutex _ref_id_lock = {"PG::_ref_id_lock"};
   map<uint64_t, string> _live_ids;
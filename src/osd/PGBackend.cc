@@ -18,6 +18,7 @@
 
 #include "common/errno.h"
 #include "common/scrub_types.h"
+#include "include/intarith.h"
 #include "ReplicatedBackend.h"
 #include "ScrubStore.h"
 #include "ECBackend.h"
@@ -229,7 +230,13 @@ void PGBackend::rollback(
     }
     void rollback_extents(
       version_t gen,
-      const vector<pair<uint64_t, uint64_t> > &extents) override {
+      const vector<pair<uint64_t, uint64_t> > &extents,
+      const set<shard_id_t> &shards) override {
+      if (!shards.empty() &&
+	  !shards.count(pg->get_parent()->whoami_shard().shard)) {
+	// this shard was left alone and has nothing stashed
+	return;
+      }
       ObjectStore::Transaction temp;
       pg->rollback_extents(gen, extents, hoid, &temp);
       temp.append(t);
@@ -261,7 +268,12 @@ struct Trimmer : public ObjectModDesc::Visitor {
   // try_rmobject defaults to rmobject
   void rollback_extents(
     version_t gen,
-    const vector<pair<uint64_t, uint64_t> > &extents) override {
+    const vector<pair<uint64_t, uint64_t> > &extents,
+    const set<shard_id_t> &shards) override {
+    if (!shards.empty() &&
+	!shards.count(pg->get_parent()->whoami_shard().shard)) {
+      return;
+    }
     pg->trim_rollback_object(
       soid,
       gen,
@@ -617,6 +629,36 @@ int PGBackend::be_scan_list(
   return 0;
 }
 
+int PGBackend::be_deep_scrub_data(
+  const hobject_t &poid,
+  ScrubMapBuilder &pos,
+  uint64_t align,
+  uint32_t fadvise_flags,
+  uint64_t *stride)
+{
+  ghobject_t oid(poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
+  uint32_t digest = pos.data_hash.digest();
+  int r = -EOPNOTSUPP;
+  if (cct->_conf.get_val<bool>("osd_deep_scrub_store_digest")) {
+    // the data stays in the store, so we can afford larger steps
+    *stride = round_up_to(
+      cct->_conf.get_val<Option::size_t>("osd_deep_scrub_digest_stride"), align);
+    r = store->digest(ch, oid, pos.data_pos, *stride, &digest, fadvise_flags);
+  }
+  if (r == -EOPNOTSUPP) {
+    *stride = round_up_to(cct->_conf->osd_deep_scrub_stride, align);
+    bufferlist bl;
+    r = store->read(ch, oid, pos.data_pos, *stride, bl, fadvise_flags);
+    if (r > 0) {
+      digest = bl.crc32c(digest);
+    }
+  }
+  if (r >= 0) {
+    pos.data_hash = bufferhash(digest);
+  }
+  return r;
+}
+
 bool PGBackend::be_compare_scrub_objects(
   pg_shard_t auth_shard,
   const ScrubMap::object &auth,
@@ -607,6 +607,13 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      ScrubMap &map,
      ScrubMapBuilder &pos,
      ScrubMap::object &o) = 0;
+   /// fold the next *stride bytes of oid's data into pos.data_hash
+   int be_deep_scrub_data(
+     const hobject_t &oid,
+     ScrubMapBuilder &pos,
+     uint64_t align,
+     uint32_t fadvise_flags,
+     uint64_t *stride);
    void be_large_omap_check(
      const map<pg_shard_t,ScrubMap*> &maps,
      const set<hobject_t> &master_set,
@@ -29,6 +29,44 @@ static ostream& _prefix(std::ostream *_dout, const PGLog *pglog)
   return pglog->gen_prefix(*_dout);
 }
 
+namespace {
+
+/**
+ * Encodes log entries and dups for the omap into one shared buffer; each
+ * key's value is a slice of it.  Encoding each into its own bufferlist
+ * costs an allocation per key and, for dups, pins a whole append buffer
+ * for a value of a few dozen bytes until the transaction is done.
+ */
+class dense_log_encoder_t {
+  bufferlist bl;
+  map<string,bufferlist> *km;
+public:
+  explicit dense_log_encoder_t(map<string,bufferlist> *km) : km(km) {}
+
+  /// same bytes as pg_log_entry_t::encode_with_checksum
+  void add(const pg_log_entry_t &e) {
+    unsigned start = bl.length();
+    auto len_filler = bl.append_hole(sizeof(ceph_le32));
+    unsigned payload_start = bl.length();
+    e.encode(bl);
+    bufferlist payload;
+    payload.substr_of(bl, payload_start, bl.length() - payload_start);
+    ceph_le32 len;
+    len = payload.length();
+    len_filler.copy_in(sizeof(len), (char *)&len);
+    encode(payload.crc32c(0), bl);
+    (*km)[e.get_key_name()].substr_of(bl, start, bl.length() - start);
+  }
+
+  void add(const pg_log_dup_t &d) {
+    unsigned start = bl.length();
+    encode(d, bl);
+    (*km)[d.get_key_name()].substr_of(bl, start, bl.length() - start);
+  }
+};
+
+} // anonymous namespace
+
 //////////////////// PGLog::IndexedLog ////////////////////
 
 void PGLog::IndexedLog::split_out_child(
@@ -148,8 +186,8 @@ ostream& PGLog::IndexedLog::print(ostream& out) const
     ceph_assert(!p->reqid_is_indexed() || logged_req(p->reqid));
   }
 
-  for (list<pg_log_dup_t>::const_iterator p = dups.begin();
-       p != dups.end();
+  for (auto p = dups.cbegin();
+       p != dups.cend();
        ++p) {
     out << *p << std::endl;
   }
@@ -515,19 +553,22 @@ bool PGLog::merge_log_dups(const pg_log_t& olog) {
 
 	auto log_tail_version = log.dups.back().version;
 
-	auto insert_cursor = log.dups.end();
+	// find the oldest of olog's newer dups
+	auto i = olog.dups.cend();
+	while (i != olog.dups.cbegin()) {
+	  auto prev = i;
+	  --prev;
+	  if (prev->version <= log_tail_version) break;
+	  i = prev;
+	}
 	eversion_t last_shared = eversion_t::max();
-	for (auto i = olog.dups.crbegin(); i != olog.dups.crend(); ++i) {
-	  if (i->version <= log_tail_version) break;
-	  log.dups.insert(insert_cursor, *i);
+	if (i != olog.dups.cend()) {
 	  last_shared = i->version;
-
-	  auto prev = insert_cursor;
-	  --prev;
+	}
+	for (; i != olog.dups.cend(); ++i) {
+	  log.dups.push_back(*i);
 	  // be sure to pass reference of copy in log.dups
-	  log.index(*prev);
-
-	  --insert_cursor; // make sure we insert in reverse order
+	  log.index(log.dups.back());
 	}
 	mark_dirty_from_dups(last_shared);
       }
@@ -538,16 +579,23 @@ bool PGLog::merge_log_dups(const pg_log_t& olog) {
 	  olog.dups.front().version << dendl;
 	changed = true;
 
+	// find the newest of olog's older dups, and prepend back from it
+	auto log_head_version = log.dups.front().version;
+	auto i = olog.dups.cbegin();
+	while (i != olog.dups.cend() && i->version < log_head_version) {
+	  ++i;
+	}
 	eversion_t last;
-	auto insert_cursor = log.dups.begin();
-	for (auto i = olog.dups.cbegin(); i != olog.dups.cend(); ++i) {
-	  if (i->version >= insert_cursor->version) break;
-	  log.dups.insert(insert_cursor, *i);
-	  last = i->version;
-	  auto prev = insert_cursor;
+	if (i != olog.dups.cbegin()) {
+	  auto prev = i;
 	  --prev;
+	  last = prev->version;
+	}
+	while (i != olog.dups.cbegin()) {
+	  --i;
+	  log.dups.push_front(*i);
 	  // be sure to pass address of copy in log.dups
-	  log.index(*prev);
+	  log.index(log.dups.front());
 	}
 	mark_dirty_to_dups(last);
       }
@@ -714,12 +762,11 @@ void PGLog::_write_log_and_missing_wo_missing(
     clear_after(log_keys_debug, dirty_from.get_key_name());
   }
 
+  dense_log_encoder_t enc(km);
   for (list<pg_log_entry_t>::iterator p = log.log.begin();
        p != log.log.end() && p->version <= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()].claim(bl);
+    enc.add(*p);
   }
 
   for (list<pg_log_entry_t>::reverse_iterator p = log.log.rbegin();
@@ -727,9 +774,7 @@ void PGLog::_write_log_and_missing_wo_missing(
 	 (p->version >= dirty_from || p->version >= writeout_from) &&
 	 p->version >= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()].claim(bl);
+    enc.add(*p);
   }
 
   if (log_keys_debug) {
@@ -764,19 +809,15 @@ void PGLog::_write_log_and_missing_wo_missing(
   for (const auto& entry : log.dups) {
     if (entry.version > dirty_to_dups)
       break;
-    bufferlist bl;
-    encode(entry, bl);
-    (*km)[entry.get_key_name()].claim(bl);
+    enc.add(entry);
   }
 
-  for (list<pg_log_dup_t>::reverse_iterator p = log.dups.rbegin();
+  for (auto p = log.dups.rbegin();
        p != log.dups.rend() &&
 	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
 	 p->version >= dirty_to_dups;
        ++p) {
-    bufferlist bl;
-    encode(*p, bl);
-    (*km)[p->get_key_name()].claim(bl);
+    enc.add(*p);
   }
 
   if (dirty_divergent_priors) {
@@ -843,12 +884,11 @@ void PGLog::_write_log_and_missing(
     clear_after(log_keys_debug, dirty_from.get_key_name());
   }
 
+  dense_log_encoder_t enc(km);
   for (list<pg_log_entry_t>::iterator p = log.log.begin();
        p != log.log.end() && p->version <= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()].claim(bl);
+    enc.add(*p);
   }
 
   for (list<pg_log_entry_t>::reverse_iterator p = log.log.rbegin();
@@ -856,9 +896,7 @@ void PGLog::_write_log_and_missing(
 	 (p->version >= dirty_from || p->version >= writeout_from) &&
 	 p->version >= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()].claim(bl);
+    enc.add(*p);
   }
 
   if (log_keys_debug) {
@@ -893,19 +931,15 @@ void PGLog::_write_log_and_missing(
   for (const auto& entry : log.dups) {
     if (entry.version > dirty_to_dups)
       break;
-    bufferlist bl;
-    encode(entry, bl);
-    (*km)[entry.get_key_name()].claim(bl);
+    enc.add(entry);
   }
 
-  for (list<pg_log_dup_t>::reverse_iterator p = log.dups.rbegin();
+  for (auto p = log.dups.rbegin();
        p != log.dups.rend() &&
 	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
 	 p->version >= dirty_to_dups;
        ++p) {
-    bufferlist bl;
-    encode(*p, bl);
-    (*km)[p->get_key_name()].claim(bl);
+    enc.add(*p);
   }
 
   if (clear_divergent_priors) {
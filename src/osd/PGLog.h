@@ -19,6 +19,7 @@
 // re-include our assert to clobber boost's
 #include "include/ceph_assert.h"
 #include "osd_types.h"
+#include "PGLogIndex.h"
 #include "os/ObjectStore.h"
 #include <list>
 
@@ -67,9 +68,8 @@ public:
    */
   struct IndexedLog : public pg_log_t {
     mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
-    mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    /// caller ops, extra caller ops and dups; ptrs into log and dups
+    mutable pglog_reqid_index_t reqid_index;
 
     // recovery pointers
     list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -239,11 +239,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      if (!caller_ops.count(r)) {
+      if (!reqid_index.find_entry(r)) {
         if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
           index_extra_caller_ops();
         }
-        return extra_caller_ops.count(r);
+        return reqid_index.find_extra(r);
       }
       return true;
     }
@@ -257,15 +257,14 @@ public:
       ceph_assert(version);
       ceph_assert(user_version);
       ceph_assert(return_code);
-      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>::const_iterator p;
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
+      const pg_log_entry_t *p = reqid_index.find_entry(r);
+      if (p) {
+	*version = p->version;
+	*user_version = p->user_version;
+	*return_code = p->return_code;
 	return true;
       }
 
@@ -274,19 +273,19 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
-      if (p != extra_caller_ops.end()) {
+      p = reqid_index.find_extra(r);
+      if (p) {
 	uint32_t idx = 0;
-	for (auto i = p->second->extra_reqids.begin();
-	     i != p->second->extra_reqids.end();
+	for (auto i = p->extra_reqids.begin();
+	     i != p->extra_reqids.end();
 	     ++idx, ++i) {
 	  if (i->first == r) {
-	    *version = p->second->version;
+	    *version = p->version;
 	    *user_version = i->second;
-	    *return_code = p->second->return_code;
+	    *return_code = p->return_code;
 	    if (*return_code >= 0) {
-	      auto it = p->second->extra_reqid_return_codes.find(idx);
-	      if (it != p->second->extra_reqid_return_codes.end()) {
+	      auto it = p->extra_reqid_return_codes.find(idx);
+	      if (it != p->extra_reqid_return_codes.end()) {
 		*return_code = it->second;
 	      }
 	    }
@@ -299,11 +298,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_DUPS)) {
         index_dups();
       }
-      auto q = dup_index.find(r);
-      if (q != dup_index.end()) {
-	*version = q->second->version;
-	*user_version = q->second->user_version;
-	*return_code = q->second->return_code;
+      const pg_log_dup_t *q = reqid_index.find_dup(r);
+      if (q) {
+	*version = q->version;
+	*user_version = q->user_version;
+	*return_code = q->return_code;
 	return true;
       }
 
@@ -353,14 +352,17 @@ public:
 
       if (to_index & PGLOG_INDEXED_OBJECTS)
 	objects.clear();
+      unsigned reqid_kinds = 0;
       if (to_index & PGLOG_INDEXED_CALLER_OPS)
-	caller_ops.clear();
+	reqid_kinds |= pglog_reqid_index_t::mask_of(pglog_reqid_index_t::ENTRY);
       if (to_index & PGLOG_INDEXED_EXTRA_CALLER_OPS)
-	extra_caller_ops.clear();
+	reqid_kinds |= pglog_reqid_index_t::mask_of(pglog_reqid_index_t::EXTRA);
+      if (to_index & PGLOG_INDEXED_DUPS)
+	reqid_kinds |= pglog_reqid_index_t::mask_of(pglog_reqid_index_t::DUP);
+      reqid_index.clear(reqid_kinds);
       if (to_index & PGLOG_INDEXED_DUPS) {
-	dup_index.clear();
 	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
+	  reqid_index.set_dup(i);
 	}
       }
 
@@ -381,7 +383,7 @@ public:
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      reqid_index.set_entry(*i);
 	    }
 	  }
 
@@ -389,8 +391,7 @@ public:
 	    for (auto j = i->extra_reqids.begin();
 		 j != i->extra_reqids.end();
 		 ++j) {
-	      extra_caller_ops.insert(
-		make_pair(j->first, const_cast<pg_log_entry_t*>(&(*i))));
+	      reqid_index.insert_extra(j->first, *i);
 	    }
 	  }
 	}
@@ -424,23 +425,21 @@ public:
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  reqid_index.set_entry(e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
         for (auto j = e.extra_reqids.begin();
 	     j != e.extra_reqids.end();
 	     ++j) {
-	  extra_caller_ops.insert(make_pair(j->first, &e));
+	  reqid_index.insert_extra(j->first, e);
         }
       }
     }
 
     void unindex() {
       objects.clear();
-      caller_ops.clear();
-      extra_caller_ops.clear();
-      dup_index.clear();
+      reqid_index.clear();
       indexed_data = 0;
     }
 
@@ -453,41 +452,28 @@ public:
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
-	  auto it = caller_ops.find(e.reqid);
 	  // divergent merge_log indexes new before unindexing old
-          if (it != caller_ops.end() && it->second == &e)
-            caller_ops.erase(it);
+	  reqid_index.erase_entry(e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
         for (auto j = e.extra_reqids.begin();
              j != e.extra_reqids.end();
              ++j) {
-          for (ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*>::iterator k =
-		 extra_caller_ops.find(j->first);
-               k != extra_caller_ops.end() && k->first == j->first;
-               ++k) {
-            if (k->second == &e) {
-              extra_caller_ops.erase(k);
-              break;
-            }
-          }
+	  reqid_index.erase_extra(j->first, e);
         }
       }
     }
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	reqid_index.set_dup(e);
       }
     }
 
     void unindex(const pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	auto i = dup_index.find(e.reqid);
-	if (i != dup_index.end()) {
-	  dup_index.erase(i);
-	}
+	reqid_index.erase_dup(e);
       }
     }
 
@@ -517,7 +503,7 @@ public:
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  reqid_index.set_entry(log.back());
         }
       }
 
@@ -525,7 +511,7 @@ public:
         for (auto j = e.extra_reqids.begin();
 	     j != e.extra_reqids.end();
 	     ++j) {
-	  extra_caller_ops.insert(make_pair(j->first, &(log.back())));
+	  reqid_index.insert_extra(j->first, log.back());
         }
       }
 
@@ -0,0 +1,252 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include "include/ceph_assert.h"
+#include "include/mempool.h"
+#include "osd_types.h"
+
+/**
+ * pglog_reqid_index_t
+ *
+ * Index of the pg log's log entries (by reqid and by their extra_reqids)
+ * and dups (by reqid).  It is a single open addressing table with linear
+ * probing.  A slot holds the hash of the reqid, the kind of record and a
+ * pointer to it; the reqid itself is read back from the record, so a
+ * record costs one 16 byte slot instead of an unordered_map node holding
+ * a copy of the key.  The table lives in the osd_pglog mempool.
+ *
+ * The same reqid may be indexed under several kinds (an op that was
+ * trimmed into a dup and retried, say), so every lookup is by kind.
+ * ENTRY and DUP keep one record per reqid, the latest set wins; EXTRA
+ * keeps them all.  Erasure shifts the rest of the run back, so there
+ * are no tombstones.
+ *
+ * Records must be erased before they are freed: a probe dereferences the
+ * records of any slot whose hash matches.
+ */
+class pglog_reqid_index_t {
+public:
+  enum kind_t : uint8_t {
+    NONE = 0,
+    ENTRY = 1,  ///< pg_log_entry_t, by its reqid
+    EXTRA = 2,  ///< pg_log_entry_t, by one of its extra_reqids
+    DUP = 3,    ///< pg_log_dup_t, by its reqid
+  };
+  static constexpr unsigned mask_of(kind_t k) {
+    return 1u << k;
+  }
+
+  const pg_log_entry_t *find_entry(const osd_reqid_t &r) const {
+    return static_cast<const pg_log_entry_t*>(_find(ENTRY, r));
+  }
+  /// warning: returns *an* entry carrying r, not necessarily the latest
+  const pg_log_entry_t *find_extra(const osd_reqid_t &r) const {
+    return static_cast<const pg_log_entry_t*>(_find(EXTRA, r));
+  }
+  const pg_log_dup_t *find_dup(const osd_reqid_t &r) const {
+    return static_cast<const pg_log_dup_t*>(_find(DUP, r));
+  }
+
+  void set_entry(const pg_log_entry_t &e) {
+    _set(ENTRY, e.reqid, &e);
+  }
+  /// erase e, if it is still the entry indexed for its reqid
+  void erase_entry(const pg_log_entry_t &e) {
+    _erase(ENTRY, e.reqid, &e);
+  }
+  void insert_extra(const osd_reqid_t &r, const pg_log_entry_t &e) {
+    _insert(EXTRA, hash_of(r), &e);
+  }
+  void erase_extra(const osd_reqid_t &r, const pg_log_entry_t &e) {
+    _erase(EXTRA, r, &e);
+  }
+  void set_dup(const pg_log_dup_t &d) {
+    _set(DUP, d.reqid, &d);
+  }
+  /// erase whichever dup is indexed for d's reqid
+  void erase_dup(const pg_log_dup_t &d) {
+    _erase(DUP, d.reqid, nullptr);
+  }
+
+  size_t size(kind_t k) const {
+    return counts[k];
+  }
+  size_t size() const {
+    return counts[ENTRY] + counts[EXTRA] + counts[DUP];
+  }
+  size_t capacity() const {
+    return slots.size();
+  }
+
+  void clear() {
+    slots.clear();
+    slots.shrink_to_fit();
+    for (auto &c : counts) {
+      c = 0;
+    }
+  }
+  /// drop every record of the kinds in mask (@see mask_of)
+  void clear(unsigned mask) {
+    if (!size()) {
+      return;
+    }
+    mempool::osd_pglog::vector<slot_t> old;
+    old.swap(slots);
+    for (auto k : {ENTRY, EXTRA, DUP}) {
+      if (mask & mask_of(k)) {
+	counts[k] = 0;
+      }
+    }
+    if (size()) {
+      slots.resize(capacity_for(size()));
+      for (auto &s : old) {
+	if (s.kind != NONE && !(mask & mask_of(s.kind))) {
+	  _place(s);
+	}
+      }
+    }
+  }
+
+private:
+  struct slot_t {
+    uint32_t hash = 0;
+    kind_t kind = NONE;
+    const void *p = nullptr;
+  };
+  static_assert(sizeof(slot_t) == 16, "pglog_reqid_index_t slot grew");
+
+  mempool::osd_pglog::vector<slot_t> slots;  ///< power of two, or empty
+  size_t counts[4] = {0, 0, 0, 0};
+
+  static constexpr size_t npos = ~(size_t)0;
+  static constexpr size_t MIN_CAPACITY = 16;
+
+  static uint32_t hash_of(const osd_reqid_t &r) {
+    // std::hash<osd_reqid_t> just xors the fields; consecutive tids
+    // from one client would make long runs
+    uint64_t h = r.name.num() * 0x9e3779b97f4a7c15ull;
+    h ^= r.tid + ((uint64_t)r.inc << 40) + ((uint64_t)r.name.type() << 56);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+  /// keep the load factor at or below 3/4
+  static size_t capacity_for(size_t n) {
+    size_t cap = MIN_CAPACITY;
+    while (cap * 3 < n * 4) {
+      cap *= 2;
+    }
+    return cap;
+  }
+
+  static bool key_matches(const slot_t &s, const osd_reqid_t &r) {
+    switch (s.kind) {
+    case ENTRY:
+      return static_cast<const pg_log_entry_t*>(s.p)->reqid == r;
+    case EXTRA:
+      for (auto &i : static_cast<const pg_log_entry_t*>(s.p)->extra_reqids) {
+	if (i.first == r) {
+	  return true;
+	}
+      }
+      return false;
+    case DUP:
+      return static_cast<const pg_log_dup_t*>(s.p)->reqid == r;
+    default:
+      return false;
+    }
+  }
+
+  /// slot holding (k, r), and p if given, or npos
+  size_t _find_slot(kind_t k, const osd_reqid_t &r, uint32_t h,
+		    const void *p) const {
+    if (slots.empty()) {
+      return npos;
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask; slots[i].kind != NONE; i = (i + 1) & mask) {
+      const slot_t &s = slots[i];
+      if (s.kind == k && s.hash == h && (!p || s.p == p) &&
+	  key_matches(s, r)) {
+	return i;
+      }
+    }
+    return npos;
+  }
+  const void *_find(kind_t k, const osd_reqid_t &r) const {
+    size_t i = _find_slot(k, r, hash_of(r), nullptr);
+    return i == npos ? nullptr : slots[i].p;
+  }
+
+  void _place(const slot_t &s) {
+    size_t mask = slots.size() - 1;
+    size_t i = s.hash & mask;
+    while (slots[i].kind != NONE) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = s;
+  }
+  void _insert(kind_t k, uint32_t h, const void *p) {
+    if ((size() + 1) * 4 > slots.size() * 3) {
+      mempool::osd_pglog::vector<slot_t> old(capacity_for(size() + 1));
+      old.swap(slots);
+      for (auto &s : old) {
+	if (s.kind != NONE) {
+	  _place(s);
+	}
+      }
+    }
+    slot_t s;
+    s.hash = h;
+    s.kind = k;
+    s.p = p;
+    _place(s);
+    ++counts[k];
+  }
+  void _set(kind_t k, const osd_reqid_t &r, const void *p) {
+    uint32_t h = hash_of(r);
+    size_t i = _find_slot(k, r, h, nullptr);
+    if (i != npos) {
+      slots[i].p = p;
+    } else {
+      _insert(k, h, p);
+    }
+  }
+  void _erase(kind_t k, const osd_reqid_t &r, const void *p) {
+    size_t i = _find_slot(k, r, hash_of(r), p);
+    if (i == npos) {
+      return;
+    }
+    --counts[k];
+    // backward shift: pull later members of the run into the hole unless
+    // that would move them before their home slot
+    size_t mask = slots.size() - 1;
+    size_t j = i;
+    while (true) {
+      j = (j + 1) & mask;
+      if (slots[j].kind == NONE) {
+	break;
+      }
+      size_t home = slots[j].hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+	slots[i] = slots[j];
+	i = j;
+      }
+    }
+    slots[i] = slot_t();
+  }
+};
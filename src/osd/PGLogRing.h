@@ -0,0 +1,362 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+#include "include/ceph_assert.h"
+#include "include/encoding.h"
+#include "include/mempool.h"
+
+/**
+ * pglog_ring_t
+ *
+ * Double ended queue for the pg log, laid out as a ring of fixed size
+ * blocks of BLOCK elements.  Elements sit back to back in their block
+ * with no per-element node, so trimming walks memory in order instead
+ * of chasing list pointers.  Only the ends can be pushed or popped,
+ * and doing so never moves the elements already in the ring: their
+ * addresses stay valid until they are popped, as the pg log indexes
+ * rely on.  The blocks and the ring of block pointers are allocated
+ * from the osd_pglog mempool.
+ */
+template <typename T, unsigned BLOCK = 64>
+class pglog_ring_t {
+  static_assert(BLOCK && !(BLOCK & (BLOCK - 1)),
+		"pglog_ring_t block size must be a power of two");
+
+  template <bool CONST>
+  class iterator_t {
+    using ring_t = std::conditional_t<CONST, const pglog_ring_t, pglog_ring_t>;
+    ring_t *r = nullptr;
+    size_t i = 0;
+
+    template <bool> friend class iterator_t;
+
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<CONST, const T*, T*>;
+    using reference = std::conditional_t<CONST, const T&, T&>;
+
+    iterator_t() = default;
+    iterator_t(ring_t *r, size_t i) : r(r), i(i) {}
+    template <bool C = CONST, typename = std::enable_if_t<C>>
+    iterator_t(const iterator_t<false> &o) : r(o.r), i(o.i) {}
+
+    reference operator*() const {
+      return (*r)[i];
+    }
+    pointer operator->() const {
+      return &(*r)[i];
+    }
+    iterator_t &operator++() {
+      ++i;
+      return *this;
+    }
+    iterator_t operator++(int) {
+      iterator_t t = *this;
+      ++i;
+      return t;
+    }
+    iterator_t &operator--() {
+      --i;
+      return *this;
+    }
+    iterator_t operator--(int) {
+      iterator_t t = *this;
+      --i;
+      return t;
+    }
+    bool operator==(const iterator_t &o) const {
+      return r == o.r && i == o.i;
+    }
+    bool operator!=(const iterator_t &o) const {
+      return !(*this == o);
+    }
+  };
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = iterator_t<false>;
+  using const_iterator = iterator_t<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  pglog_ring_t() = default;
+  pglog_ring_t(const pglog_ring_t &o) {
+    for (auto &i : o) {
+      push_back(i);
+    }
+  }
+  pglog_ring_t(pglog_ring_t &&o) noexcept {
+    swap(o);
+  }
+  ~pglog_ring_t() {
+    clear();
+  }
+  pglog_ring_t &operator=(const pglog_ring_t &o) {
+    if (this != &o) {
+      pglog_ring_t t(o);
+      swap(t);
+    }
+    return *this;
+  }
+  pglog_ring_t &operator=(pglog_ring_t &&o) noexcept {
+    if (this != &o) {
+      clear();
+      swap(o);
+    }
+    return *this;
+  }
+
+  void swap(pglog_ring_t &o) noexcept {
+    blocks.swap(o.blocks);
+    std::swap(first, o.first);
+    std::swap(nblocks, o.nblocks);
+    std::swap(head, o.head);
+    std::swap(count, o.count);
+  }
+
+  size_t size() const {
+    return count;
+  }
+  bool empty() const {
+    return count == 0;
+  }
+  /// bytes held in blocks, used or not
+  size_t allocated_bytes() const {
+    return nblocks * BLOCK * sizeof(T) + blocks.capacity() * sizeof(T*);
+  }
+
+  T &operator[](size_t i) {
+    size_t pos = head + i;
+    return block(pos / BLOCK)[pos % BLOCK];
+  }
+  const T &operator[](size_t i) const {
+    size_t pos = head + i;
+    return block(pos / BLOCK)[pos % BLOCK];
+  }
+  T &front() {
+    ceph_assert(count);
+    return (*this)[0];
+  }
+  const T &front() const {
+    ceph_assert(count);
+    return (*this)[0];
+  }
+  T &back() {
+    ceph_assert(count);
+    return (*this)[count - 1];
+  }
+  const T &back() const {
+    ceph_assert(count);
+    return (*this)[count - 1];
+  }
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+  iterator end() {
+    return iterator(this, count);
+  }
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, count);
+  }
+  const_iterator cbegin() const {
+    return begin();
+  }
+  const_iterator cend() const {
+    return end();
+  }
+  reverse_iterator rbegin() {
+    return reverse_iterator(end());
+  }
+  reverse_iterator rend() {
+    return reverse_iterator(begin());
+  }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+  const_reverse_iterator crbegin() const {
+    return rbegin();
+  }
+  const_reverse_iterator crend() const {
+    return rend();
+  }
+
+  template <typename... Args>
+  T &emplace_back(Args&&... args) {
+    if (head + count == nblocks * BLOCK) {
+      _add_block_back();
+    }
+    T *p = &(*this)[count];
+    new (p) T(std::forward<Args>(args)...);
+    ++count;
+    return *p;
+  }
+  void push_back(const T &v) {
+    emplace_back(v);
+  }
+  void push_back(T &&v) {
+    emplace_back(std::move(v));
+  }
+
+  template <typename... Args>
+  T &emplace_front(Args&&... args) {
+    if (head == 0) {
+      _add_block_front();
+    }
+    T *p = &block(0)[head - 1];
+    new (p) T(std::forward<Args>(args)...);
+    --head;
+    ++count;
+    return *p;
+  }
+  void push_front(const T &v) {
+    emplace_front(v);
+  }
+  void push_front(T &&v) {
+    emplace_front(std::move(v));
+  }
+
+  void pop_front() {
+    ceph_assert(count);
+    front().~T();
+    ++head;
+    --count;
+    if (count == 0) {
+      _release();
+    } else if (head == BLOCK) {
+      _free_block(first);
+      first = (first + 1) & (blocks.size() - 1);
+      --nblocks;
+      head = 0;
+    }
+  }
+  void pop_back() {
+    ceph_assert(count);
+    back().~T();
+    --count;
+    if (count == 0) {
+      _release();
+    } else if (head + count <= (nblocks - 1) * BLOCK) {
+      _free_block((first + nblocks - 1) & (blocks.size() - 1));
+      --nblocks;
+    }
+  }
+
+  void clear() {
+    for (size_t i = 0; i < count; ++i) {
+      (*this)[i].~T();
+    }
+    count = 0;
+    _release();
+    blocks.clear();
+    blocks.shrink_to_fit();
+    first = 0;
+  }
+
+  bool operator==(const pglog_ring_t &o) const {
+    return count == o.count && std::equal(begin(), end(), o.begin());
+  }
+  bool operator!=(const pglog_ring_t &o) const {
+    return !(*this == o);
+  }
+
+private:
+  using block_allocator_t = mempool::osd_pglog::pool_allocator<T>;
+
+  mempool::osd_pglog::vector<T*> blocks;  ///< ring of blocks, power of two
+  size_t first = 0;    ///< slot in blocks of the block holding the front
+  size_t nblocks = 0;  ///< blocks in use, starting at first
+  size_t head = 0;     ///< offset of the front element in its block
+  size_t count = 0;
+
+  T *block(size_t n) const {
+    return blocks[(first + n) & (blocks.size() - 1)];
+  }
+
+  void _free_block(size_t slot) {
+    block_allocator_t().deallocate(blocks[slot], BLOCK);
+    blocks[slot] = nullptr;
+  }
+  /// free every block once the ring is empty
+  void _release() {
+    for (size_t n = 0; n < nblocks; ++n) {
+      _free_block((first + n) & (blocks.size() - 1));
+    }
+    nblocks = 0;
+    head = 0;
+  }
+  /// make room in blocks for one more block
+  void _grow() {
+    if (nblocks < blocks.size()) {
+      return;
+    }
+    mempool::osd_pglog::vector<T*> n(blocks.empty() ? 4 : blocks.size() * 2);
+    for (size_t i = 0; i < nblocks; ++i) {
+      n[i] = block(i);
+    }
+    blocks.swap(n);
+    first = 0;
+  }
+  void _add_block_back() {
+    _grow();
+    blocks[(first + nblocks) & (blocks.size() - 1)] =
+      block_allocator_t().allocate(BLOCK);
+    ++nblocks;
+  }
+  void _add_block_front() {
+    _grow();
+    first = (first - 1) & (blocks.size() - 1);
+    blocks[first] = block_allocator_t().allocate(BLOCK);
+    ++nblocks;
+    head = BLOCK;
+  }
+};
+
+template <typename T, unsigned BLOCK>
+inline void encode(const pglog_ring_t<T, BLOCK> &r, ceph::bufferlist &bl)
+{
+  using ceph::encode;
+  encode((__u32)r.size(), bl);
+  for (auto &i : r) {
+    encode(i, bl);
+  }
+}
+
+template <typename T, unsigned BLOCK>
+inline void decode(pglog_ring_t<T, BLOCK> &r,
+		   ceph::bufferlist::const_iterator &p)
+{
+  using ceph::decode;
+  __u32 n;
+  decode(n, p);
+  r.clear();
+  while (n--) {
+    decode(r.emplace_back(), p);
+  }
+}
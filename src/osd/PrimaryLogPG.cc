@@ -4155,6 +4155,7 @@ void PrimaryLogPG::log_op_stats(const OpRequest& op,
   osd->logger->inc(l_osd_op_inb, inb);
   osd->logger->tinc(l_osd_op_lat, latency);
   osd->logger->tinc(l_osd_op_process_lat, process_latency);
+  osd->recovery_throttle.add_client_op(latency);
 
   if (op.may_read() && op.may_write()) {
     osd->logger->inc(l_osd_op_rw);
@@ -10785,8 +10786,7 @@ void PrimaryLogPG::submit_log_entries(
       };
       t.register_on_commit(
 	new OnComplete{this, rep_tid, get_osdmap_epoch()});
-      int r = osd->store->queue_transaction(ch, std::move(t), NULL);
-      ceph_assert(r == 0);
+      queue_transaction(std::move(t), OpRequestRef());
       op_applied(info.last_update);
     });
 
@@ -318,10 +318,20 @@ public:
   }
   void queue_transaction(ObjectStore::Transaction&& t,
 			 OpRequestRef op) override {
+    if (batching_txns) {
+      add_to_txn_batch(std::move(t), op);
+      return;
+    }
     osd->store->queue_transaction(ch, std::move(t), op);
   }
   void queue_transactions(vector<ObjectStore::Transaction>& tls,
 			  OpRequestRef op) override {
+    if (batching_txns) {
+      for (auto& t : tls) {
+	add_to_txn_batch(std::move(t), op);
+      }
+      return;
+    }
     osd->store->queue_transactions(ch, tls, op, NULL);
   }
   epoch_t get_interval_start_epoch() const override {
@@ -0,0 +1,144 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "RecoveryThrottle.h"
+#include "common/ceph_context.h"
+#include "common/config.h"
+
+RecoveryThrottle::limits_t RecoveryThrottle::limits_from_conf(CephContext *cct)
+{
+  limits_t l;
+  l.target_p99 = cct->_conf.get_val<double>("osd_recovery_adaptive_target_p99");
+  l.max_queue_util =
+    cct->_conf.get_val<double>("osd_recovery_adaptive_max_queue_util");
+  l.max_active = cct->_conf.get_val<uint64_t>("osd_recovery_adaptive_max_active");
+  l.max_sleep = cct->_conf.get_val<double>("osd_recovery_adaptive_max_sleep");
+  l.max_backfills = cct->_conf->osd_max_backfills;
+  return l;
+}
+
+RecoveryThrottle::RecoveryThrottle(const limits_t& l)
+  : limits(l)
+{
+  for (auto& b : buckets) {
+    b = 0;
+  }
+  _clamp();
+}
+
+void RecoveryThrottle::set_limits(const limits_t& l)
+{
+  std::lock_guard locker(lock);
+  limits = l;
+  _clamp();
+}
+
+void RecoveryThrottle::_clamp()
+{
+  limits.max_active = std::max<uint64_t>(limits.max_active, 1);
+  limits.max_backfills = std::max(limits.max_backfills, 1u);
+  limits.min_sleep = std::min(limits.min_sleep, limits.max_sleep);
+  max_active = std::min<uint64_t>(max_active, limits.max_active);
+  sleep = std::min<double>(sleep, limits.max_sleep);
+  max_backfills = std::min<unsigned>(max_backfills, limits.max_backfills);
+}
+
+unsigned RecoveryThrottle::bucket_of(double latency)
+{
+  double us = latency * 1000000.0;
+  if (!(us > 1.0)) {
+    return 0;
+  }
+  unsigned b = std::log2(us) * 4;
+  return std::min(b, NUM_BUCKETS - 1);
+}
+
+double RecoveryThrottle::bucket_upper(unsigned b)
+{
+  return std::exp2((b + 1) / 4.0) / 1000000.0;
+}
+
+bool RecoveryThrottle::update(double queue_util)
+{
+  std::lock_guard locker(lock);
+  uint64_t counts[NUM_BUCKETS];
+  uint64_t total = 0;
+  for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+    counts[i] = buckets[i].exchange(0);
+    total += counts[i];
+  }
+  double p99 = 0;
+  if (total >= limits.min_samples) {
+    // the bucket holding the 99th percentile; report its upper bound so
+    // that we err on the side of backing off
+    uint64_t rank = std::ceil(total * 0.99);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+	p99 = bucket_upper(i);
+	break;
+      }
+    }
+  }
+  last_p99 = p99;
+  last_samples = total;
+
+  uint64_t active = max_active;
+  double s = sleep;
+  bool over = p99 > limits.target_p99 || queue_util > limits.max_queue_util;
+  bool headroom = !over &&
+    p99 < limits.target_p99 * limits.headroom &&
+    queue_util < limits.max_queue_util * limits.headroom;
+  if (over) {
+    if (active > 1) {
+      active = std::max<uint64_t>(active / 2, 1);
+    } else {
+      s = std::min(std::max(s * 2, limits.min_sleep), limits.max_sleep);
+    }
+  } else if (headroom) {
+    if (s > 0) {
+      s /= 2;
+      if (s < limits.min_sleep) {
+	s = 0;
+      }
+    } else if (active < limits.max_active) {
+      ++active;
+    }
+  }
+  // backfill reservations follow the share of recovery ops we allow
+  unsigned backfills = 1;
+  if (s == 0) {
+    backfills = std::ceil((double)limits.max_backfills * active /
+			  limits.max_active);
+    backfills = std::min(std::max(backfills, 1u), limits.max_backfills);
+  }
+
+  bool changed = active != max_active || s != sleep ||
+    backfills != max_backfills;
+  max_active = active;
+  sleep = s;
+  max_backfills = backfills;
+  return changed;
+}
+
+std::ostream& operator<<(std::ostream& out, const RecoveryThrottle& t)
+{
+  return out << "recovery_throttle(active " << t.get_max_active()
+	     << " sleep " << t.get_sleep()
+	     << " backfills " << t.get_max_backfills()
+	     << " p99 " << t.get_last_p99()
+	     << " samples " << t.get_last_samples() << ")";
+}
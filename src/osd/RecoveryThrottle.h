@@ -0,0 +1,105 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <ostream>
+
+#include "common/ceph_mutex.h"
+
+class CephContext;
+
+/**
+ * RecoveryThrottle
+ *
+ * Feedback controller for recovery and backfill pacing.  Client op
+ * latencies are collected into a log-scale histogram; once per interval
+ * update() compares their p99, and the object store's queue utilization,
+ * against a target and adjusts how many recovery ops may run at once,
+ * the sleep between them and the number of backfill reservations.
+ *
+ * It probes upward slowly (drop the sleep, then add one op at a time)
+ * while there is headroom and backs off quickly (halve the ops, then
+ * double the sleep) when the target is missed.
+ */
+class RecoveryThrottle {
+public:
+  struct limits_t {
+    double target_p99 = 0.1;     ///< client op p99 to hold, in seconds
+    double headroom = 0.8;       ///< probe upward below target * headroom
+    double max_queue_util = 0.8; ///< back off when the store is this busy
+    uint64_t min_samples = 10;   ///< fewer client ops than this is idle
+    uint64_t max_active = 16;    ///< ceiling for concurrent recovery ops
+    double max_sleep = 0.5;      ///< ceiling for the per-op sleep, seconds
+    double min_sleep = 0.001;    ///< smallest non-zero per-op sleep
+    unsigned max_backfills = 1;  ///< ceiling for backfill reservations
+  };
+
+  static limits_t limits_from_conf(CephContext *cct);
+
+  explicit RecoveryThrottle(const limits_t& l);
+
+  void set_limits(const limits_t& l);
+
+  /// record the latency (seconds) of a completed client op
+  void add_client_op(double latency) {
+    buckets[bucket_of(latency)]++;
+  }
+
+  /**
+   * close the current sample interval and adjust the rates
+   *
+   * @param queue_util object store queue utilization, 0..1
+   * @returns true if any rate changed
+   */
+  bool update(double queue_util);
+
+  uint64_t get_max_active() const {
+    return max_active;
+  }
+  double get_sleep() const {
+    return sleep;
+  }
+  unsigned get_max_backfills() const {
+    return max_backfills;
+  }
+  /// client op p99 seen in the last interval, or 0 if it was idle
+  double get_last_p99() const {
+    return last_p99;
+  }
+  uint64_t get_last_samples() const {
+    return last_samples;
+  }
+
+  // 4 buckets per power of two, starting at 1us
+  static constexpr unsigned NUM_BUCKETS = 128;
+  static unsigned bucket_of(double latency);
+  /// upper bound of a bucket, in seconds
+  static double bucket_upper(unsigned b);
+
+  friend std::ostream& operator<<(std::ostream& out,
+				  const RecoveryThrottle& t);
+
+private:
+  ceph::mutex lock = ceph::make_mutex("RecoveryThrottle::lock");
+  limits_t limits;
+  std::atomic<uint64_t> buckets[NUM_BUCKETS];
+
+  std::atomic<uint64_t> max_active{1};
+  std::atomic<double> sleep{0};
+  std::atomic<unsigned> max_backfills{1};
+  std::atomic<double> last_p99{0};
+  std::atomic<uint64_t> last_samples{0};
+
+  void _clamp();
+};
@@ -4063,9 +4063,13 @@ void ObjectModDesc::visit(Visitor *visitor) const
       case ROLLBACK_EXTENTS: {
 	vector<pair<uint64_t, uint64_t> > extents;
 	version_t gen;
+	set<shard_id_t> shards;
 	decode(gen, bp);
 	decode(extents, bp);
-	visitor->rollback_extents(gen,extents);
+	if (struct_v >= 3) {
+	  decode(shards, bp);
+	}
+	visitor->rollback_extents(gen, extents, shards);
 	break;
       }
       default:
@@ -4124,11 +4128,13 @@ struct DumpVisitor : public ObjectModDesc::Visitor {
   }
   void rollback_extents(
     version_t gen,
-    const vector<pair<uint64_t, uint64_t> > &extents) override {
+    const vector<pair<uint64_t, uint64_t> > &extents,
+    const set<shard_id_t> &shards) override {
     f->open_object_section("op");
     f->dump_string("code", "ROLLBACK_EXTENTS");
     f->dump_unsigned("gen", gen);
     f->dump_stream("snaps") << extents;
+    f->dump_stream("shards") << shards;
     f->close_section();
   }
 };
@@ -4166,6 +4172,11 @@ void ObjectModDesc::generate_test_instances(list<ObjectModDesc*>& o)
   o.back()->setattrs(attrs);
   o.back()->mark_unrollbackable();
   o.back()->append(1000);
+  o.push_back(new ObjectModDesc());
+  o.back()->rollback_extents(1002, {make_pair(4096, 4096)});
+  o.push_back(new ObjectModDesc());
+  o.back()->rollback_extents(1003, {make_pair(0, 8192)},
+			     {shard_id_t(1), shard_id_t(4), shard_id_t(5)});
 }
 
 void ObjectModDesc::encode(bufferlist &_bl) const
@@ -41,6 +41,7 @@
 #include "common/hobject.h"
 #include "common/snap_types.h"
 #include "HitSet.h"
+#include "PGLogRing.h"
 #include "Watch.h"
 #include "include/cmp.h"
 #include "librados/ListObjectImpl.h"
@@ -3491,9 +3492,11 @@ public:
     }
     virtual void create() {}
     virtual void update_snaps(const set<snapid_t> &old_snaps) {}
+    /// @param shards the shards that stashed @c gen, empty if all of them did
     virtual void rollback_extents(
       version_t gen,
-      const vector<pair<uint64_t, uint64_t> > &extents) {}
+      const vector<pair<uint64_t, uint64_t> > &extents,
+      const set<shard_id_t> &shards) {}
     virtual ~Visitor() {}
   };
   void visit(Visitor *visitor) const;
@@ -3591,16 +3594,23 @@ public:
     encode(old_snaps, bl);
     ENCODE_FINISH(bl);
   }
+  /**
+   * @param shards the shards that stash @c gen, if only some of them do
+   *               (an EC parity delta write leaves the data shards it does
+   *               not touch alone); empty if every shard does
+   */
   void rollback_extents(
-    version_t gen, const vector<pair<uint64_t, uint64_t> > &extents) {
+    version_t gen, const vector<pair<uint64_t, uint64_t> > &extents,
+    const set<shard_id_t> &shards = {}) {
     ceph_assert(can_local_rollback);
     ceph_assert(!rollback_info_completed);
     if (max_required_version < 2)
       max_required_version = 2;
-    ENCODE_START(2, 2, bl);
+    ENCODE_START(3, 2, bl);
     append_id(ROLLBACK_EXTENTS);
     encode(gen, bl);
     encode(extents, bl);
+    encode(shards, bl);
     ENCODE_FINISH(bl);
   }
 
@@ -3843,7 +3853,7 @@ public:
   mempool::osd_pglog::list<pg_log_entry_t> log;
 
   // entries just for dup op detection ordered oldest to newest
-  mempool::osd_pglog::list<pg_log_dup_t> dups;
+  pglog_ring_t<pg_log_dup_t> dups;
 
   pg_log_t() = default;
   pg_log_t(const eversion_t &last_update,
@@ -3851,7 +3861,7 @@ public:
 	   const eversion_t &can_rollback_to,
 	   const eversion_t &rollback_info_trimmed_to,
 	   mempool::osd_pglog::list<pg_log_entry_t> &&entries,
-	   mempool::osd_pglog::list<pg_log_dup_t> &&dup_entries)
+	   pglog_ring_t<pg_log_dup_t> &&dup_entries)
     : head(last_update), tail(log_tail), can_rollback_to(can_rollback_to),
       rollback_info_trimmed_to(rollback_info_trimmed_to),
       log(std::move(entries)), dups(std::move(dup_entries)) {}
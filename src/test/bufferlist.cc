@@ -22,6 +22,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <thread>
 
 #include "include/buffer.h"
 #include "include/buffer_raw.h"
@@ -1719,6 +1720,35 @@ TEST(BufferList, rebuild) {
   }
 }
 
+TEST(BufferList, thread_memcopy_count) {
+  uint64_t before = buffer::get_thread_memcopy_count();
+  bufferlist bl;
+  bl.append(buffer::create_page_aligned(CEPH_PAGE_SIZE));
+  bl.append(buffer::create_page_aligned(CEPH_PAGE_SIZE));
+  // already aligned: nothing to copy
+  EXPECT_FALSE(bl.rebuild_aligned(CEPH_PAGE_SIZE));
+  EXPECT_EQ(before, buffer::get_thread_memcopy_count());
+  bl.c_str();
+  EXPECT_EQ(before + 2 * CEPH_PAGE_SIZE, buffer::get_thread_memcopy_count());
+  bl.append("x", 1);
+  bl.rebuild();
+  EXPECT_EQ(before + 4 * CEPH_PAGE_SIZE + 1,
+	    buffer::get_thread_memcopy_count());
+  // counted per thread
+  uint64_t other = 0;
+  std::thread th([&other] {
+    bufferlist b;
+    b.append("a", 1);
+    b.append(buffer::create(1));
+    b.rebuild();
+    other = buffer::get_thread_memcopy_count();
+  });
+  th.join();
+  EXPECT_EQ(2u, other);
+  EXPECT_EQ(before + 4 * CEPH_PAGE_SIZE + 1,
+	    buffer::get_thread_memcopy_count());
+}
+
 TEST(BufferList, rebuild_page_aligned) {
   {
     bufferlist bl;
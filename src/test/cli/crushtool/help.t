@@ -98,6 +98,8 @@
         [--simulate]       simulate placements using a random
                            number generator in place of the CRUSH
                            algorithm
+        [--verify-batch]   check the batched CRUSH mappings against
+                           mapping each input on its own
      --show-utilization    show OSD usage
      --show-utilization-all
                            include zero weight items
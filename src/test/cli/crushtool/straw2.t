@@ -1,4 +1,6 @@
   $ crushtool -c $TESTDIR/straw2.txt -o straw2
+  $ crushtool -i straw2 --test --verify-batch --min-x 0 --max-x 9999 --num-rep 3
+  WARNING: no output selected; use --output-csv or --show-X
   $ crushtool -d straw2 -o straw2.txt.new
   $ diff -b $TESTDIR/straw2.txt straw2.txt.new
   $ rm straw2 straw2.txt.new
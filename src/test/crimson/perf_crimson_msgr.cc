@@ -3,7 +3,9 @@
 
 #include <map>
 #include <random>
+#include <vector>
 #include <boost/program_options.hpp>
+#include <boost/range/irange.hpp>
 
 #include <seastar/core/app-template.hh>
 #include <seastar/core/do_with.hh>
@@ -46,6 +48,8 @@ static seastar::future<> run(unsigned rounds,
                              double keepalive_ratio,
                              int bs,
                              int depth,
+                             unsigned conns,
+                             int server_shard,
                              std::string addr,
                              perf_mode_t mode)
 {
@@ -73,8 +77,9 @@ static seastar::future<> run(unsigned rounds,
       seastar::future<> init(const entity_name_t& name,
                              const std::string& lname,
                              const uint64_t nonce,
-                             const entity_addr_t& addr) {
-        auto&& fut = ceph::net::Messenger::create(name, lname, nonce, 1);
+                             const entity_addr_t& addr,
+                             int shard) {
+        auto&& fut = ceph::net::Messenger::create(name, lname, nonce, shard);
         return fut.then([this, addr](ceph::net::Messenger *messenger) {
             return container().invoke_on_all([messenger](auto& server) {
                 server.msgr = messenger->get_local_shard();
@@ -105,7 +110,7 @@ static seastar::future<> run(unsigned rounds,
 
       unsigned rounds;
       std::bernoulli_distribution keepalive_dist;
-      ceph::net::Messenger *msgr = nullptr;
+      std::vector<ceph::net::Messenger*> msgrs;
       std::map<ceph::net::Connection*, seastar::promise<>> pending_conns;
       std::map<ceph::net::ConnectionRef, PingSessionRef> sessions;
       int msg_len;
@@ -166,25 +171,50 @@ static seastar::future<> run(unsigned rounds,
 
       seastar::future<> init(const entity_name_t& name,
                              const std::string& lname,
-                             const uint64_t nonce) {
-        return ceph::net::Messenger::create(name, lname, nonce, 2)
-          .then([this](ceph::net::Messenger *messenger) {
-            return container().invoke_on_all([messenger](auto& client) {
-                client.msgr = messenger->get_local_shard();
-                client.msgr->set_crc_header();
-              }).then([this, messenger] {
-                return messenger->start(this);
+                             const uint64_t nonce,
+                             unsigned conns) {
+        // a messenger per connection, each with its own nonce and core, like
+        // the processes of a client host
+        return seastar::do_for_each(boost::irange(0u, conns),
+                                    [this, name, lname, nonce] (unsigned i) {
+            return ceph::net::Messenger::create(name, lname, nonce + i,
+                                                (2 + i) % seastar::smp::count)
+              .then([this](ceph::net::Messenger *messenger) {
+                return container().invoke_on_all([messenger](auto& client) {
+                    client.msgrs.push_back(messenger->get_local_shard());
+                    client.msgrs.back()->set_crc_header();
+                  }).then([this, messenger] {
+                    return messenger->start(this);
+                  });
               });
           });
       }
 
       seastar::future<> shutdown() {
-        ceph_assert(msgr);
-        return msgr->shutdown();
+        ceph_assert(!msgrs.empty());
+        return seastar::parallel_for_each(msgrs, [] (auto msgr) {
+            return msgr->shutdown();
+          });
       }
 
       seastar::future<> dispatch_messages(const entity_addr_t& peer_addr, bool foreign_dispatch=true) {
         mono_time start_time = mono_clock::now();
+        return seastar::parallel_for_each(msgrs,
+            [this, peer_addr, foreign_dispatch] (auto msgr) {
+              return dispatch_messages(msgr, peer_addr, foreign_dispatch);
+            }).then([this, start_time] {
+              std::chrono::duration<double> dur = mono_clock::now() - start_time;
+              auto total = rounds * msgrs.size();
+              logger().info("{} connections: {} messages in {}s, {} msgs/s",
+                            msgrs.size(), total, dur.count(), total / dur.count());
+            });
+      }
+
+     private:
+      seastar::future<> dispatch_messages(ceph::net::Messenger *msgr,
+                                          const entity_addr_t& peer_addr,
+                                          bool foreign_dispatch) {
+        mono_time start_time = mono_clock::now();
         return msgr->connect(peer_addr, entity_name_t::TYPE_OSD)
           .then([this, foreign_dispatch, start_time](auto conn) {
             return seastar::futurize_apply([this, conn, foreign_dispatch] {
@@ -208,7 +238,6 @@ static seastar::future<> run(unsigned rounds,
           });
       }
 
-     private:
       seastar::future<> send_msg(ceph::net::Connection* conn) {
         return depth.wait(1).then([this, conn] {
           const static pg_t pgid;
@@ -272,15 +301,17 @@ static seastar::future<> run(unsigned rounds,
   return seastar::when_all_succeed(
       ceph::net::create_sharded<test_state::Server>(),
       ceph::net::create_sharded<test_state::Client>(rounds, keepalive_ratio, bs, depth))
-    .then([rounds, keepalive_ratio, addr, mode](test_state::Server *server,
-                                                test_state::Client *client) {
+    .then([rounds, keepalive_ratio, conns, server_shard, addr, mode](test_state::Server *server,
+                                                                     test_state::Client *client) {
       entity_addr_t target_addr;
       target_addr.parse(addr.c_str(), nullptr);
       target_addr.set_type(entity_addr_t::TYPE_LEGACY);
+      // client processes on one host tell themselves apart by nonce
+      const uint32_t client_nonce = rd() & 0xffff0000;
       if (mode == perf_mode_t::both) {
           return seastar::when_all_succeed(
-              server->init(entity_name_t::OSD(0), "server", 0, target_addr),
-              client->init(entity_name_t::OSD(1), "client", 0))
+              server->init(entity_name_t::OSD(0), "server", 0, target_addr, server_shard),
+              client->init(entity_name_t::OSD(1), "client", client_nonce, conns))
           // dispatch pingpoing
             .then([client, target_addr] {
               return client->dispatch_messages(target_addr, false);
@@ -293,7 +324,7 @@ static seastar::future<> run(unsigned rounds,
               return server->shutdown();
             });
       } else if (mode == perf_mode_t::client) {
-          return client->init(entity_name_t::OSD(1), "client", 0)
+          return client->init(entity_name_t::OSD(1), "client", client_nonce, conns)
           // dispatch pingpoing
             .then([client, target_addr] {
               return client->dispatch_messages(target_addr, false);
@@ -303,7 +334,7 @@ static seastar::future<> run(unsigned rounds,
               return client->shutdown();
             });
       } else { // mode == perf_mode_t::server
-          return server->init(entity_name_t::OSD(0), "server", 0, target_addr)
+          return server->init(entity_name_t::OSD(0), "server", 0, target_addr, server_shard)
           // dispatch pingpoing
             .then([server] {
               return server->msgr->wait();
@@ -333,20 +364,29 @@ int main(int argc, char** argv)
     ("bs", bpo::value<int>()->default_value(4096),
      "block size")
     ("depth", bpo::value<int>()->default_value(512),
-     "io depth");
+     "io depth")
+    ("conns", bpo::value<unsigned>()->default_value(1),
+     "client connections, each from its own messenger and core")
+    ("server-shard", bpo::value<int>()->default_value(1),
+     "core for all server connections, -1: by client ip, -2: balanced by client ip, port and nonce");
   return app.run(argc, argv, [&app] {
       auto&& config = app.configuration();
       auto rounds = config["rounds"].as<unsigned>();
       auto keepalive_ratio = config["keepalive-ratio"].as<double>();
       auto bs = config["bs"].as<int>();
       auto depth = config["depth"].as<int>();
+      auto conns = config["conns"].as<unsigned>();
+      auto server_shard = config["server-shard"].as<int>();
       auto addr = config["addr"].as<std::string>();
       auto mode = config["mode"].as<int>();
-      logger().info("\nsettings:\n  addr={}\n  mode={}\n  rounds={}\n  keepalive-ratio={}\n  bs={}\n  depth={}",
-                    addr, mode, rounds, keepalive_ratio, bs, depth);
+      logger().info("\nsettings:\n  addr={}\n  mode={}\n  rounds={}\n  keepalive-ratio={}\n  bs={}\n  depth={}\n  conns={}\n  server-shard={}",
+                    addr, mode, rounds, keepalive_ratio, bs, depth, conns, server_shard);
       ceph_assert(mode >= 0 && mode <= 2);
+      ceph_assert(conns > 0);
+      ceph_assert(server_shard >= ceph::net::Messenger::SHARD_BALANCED &&
+                  server_shard < static_cast<int>(seastar::smp::count));
       auto _mode = static_cast<perf_mode_t>(mode);
-      return run(rounds, keepalive_ratio, bs, depth, addr, _mode)
+      return run(rounds, keepalive_ratio, bs, depth, conns, server_shard, addr, _mode)
         .then([] {
           std::cout << "successful" << std::endl;
         }).handle_exception([] (auto eptr) {
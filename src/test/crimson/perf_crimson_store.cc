@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Write and read back an object with a FuturizedStore, with the workload of
+// ceph_objectstore_bench, so the numbers of alienstore can be put next to
+// the ones of the classic store driven by ceph_objectstore_bench on the same
+// device and config file.
+
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/range/irange.hpp>
+
+#include <seastar/core/app-template.hh>
+#include <seastar/core/do_with.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/semaphore.hh>
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "crimson/common/config_proxy.h"
+#include "crimson/common/log.h"
+#include "crimson/common/perf_counters_collection.h"
+#include "crimson/os/futurized_store.h"
+#include "crimson/os/Transaction.h"
+
+namespace bpo = boost::program_options;
+
+namespace {
+
+seastar::logger& logger() {
+  return ceph::get_logger(ceph_subsys_filestore);
+}
+
+using ceph::common::local_conf;
+using ceph::os::FuturizedStore;
+using ceph::os::Transaction;
+
+struct bench_t {
+  std::unique_ptr<FuturizedStore> store;
+  FuturizedStore::CollectionRef ch;
+  const coll_t cid{spg_t{}};
+  const ghobject_t oid{hobject_t{sobject_t{"osbench", CEPH_NOSNAP}}};
+  uint64_t size;
+  uint64_t block_size;
+  unsigned repeats;
+  seastar::semaphore depth;
+  bufferlist data;
+
+  bench_t(uint64_t size, uint64_t block_size, unsigned repeats, unsigned depth)
+    : size{size}, block_size{block_size}, repeats{repeats}, depth{depth}
+  {
+    data.append(buffer::create(block_size));
+  }
+
+  seastar::future<> setup(const std::string& type) {
+    store = FuturizedStore::create(type,
+                                   local_conf().get_val<std::string>("osd_data"),
+                                   local_conf().get_config_values());
+    uuid_d fsid;
+    fsid.generate_random();
+    return store->start().then([this, fsid] {
+      return store->mkfs(fsid);
+    }).then([this] {
+      return store->mount();
+    }).then([this] {
+      ch = store->create_new_collection(cid);
+      Transaction t;
+      t.create_collection(cid, 0);
+      return store->do_transaction(ch, std::move(t));
+    });
+  }
+
+  template<typename Func>
+  seastar::future<> run(const char* what, Func&& func) {
+    auto start = mono_clock::now();
+    return seastar::do_for_each(boost::irange(0u, repeats),
+                                [this, func=std::move(func)] (unsigned) {
+      return seastar::parallel_for_each(
+        boost::irange<uint64_t>(0, size / block_size),
+        [this, func] (uint64_t i) {
+          return seastar::with_semaphore(depth, 1, [this, func, i] {
+            return func(i * block_size);
+          });
+        });
+    }).then([this, what, start] {
+      std::chrono::duration<double> dur = mono_clock::now() - start;
+      const uint64_t total = size * repeats;
+      logger().info("{} {} in {}s, at a rate of {}/s and {} iops",
+                    what, total, dur.count(),
+                    total / dur.count(), total / block_size / dur.count());
+    });
+  }
+
+  seastar::future<> write() {
+    return run("wrote", [this] (uint64_t offset) {
+      Transaction t;
+      t.write(cid, oid, offset, block_size, data);
+      return store->do_transaction(ch, std::move(t));
+    });
+  }
+
+  seastar::future<> read() {
+    return run("read", [this] (uint64_t offset) {
+      return store->read(ch, oid, offset, block_size).then([](bufferlist&&) {});
+    });
+  }
+
+  seastar::future<> teardown() {
+    ch.reset();
+    return store->umount().then([this] {
+      return store->stop();
+    });
+  }
+};
+
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<const char*> args{argv + 1, argv + argc};
+  std::string cluster;
+  std::string conf_file_list;
+  auto init_params = ceph_argparse_early_args(args,
+                                              CEPH_ENTITY_TYPE_OSD,
+                                              &cluster,
+                                              &conf_file_list);
+  seastar::app_template app;
+  app.add_options()
+    ("store", bpo::value<std::string>()->default_value("alienstore"),
+     "cyanstore or alienstore, whose backend is osd_objectstore")
+    ("size", bpo::value<uint64_t>()->default_value(1 << 20),
+     "total size in bytes")
+    ("block-size", bpo::value<uint64_t>()->default_value(4096),
+     "block size in bytes for each write and read")
+    ("repeats", bpo::value<unsigned>()->default_value(1),
+     "number of times to repeat the write and the read cycles")
+    ("depth", bpo::value<unsigned>()->default_value(16),
+     "number of writes or reads in flight");
+
+  args.insert(begin(args), argv[0]);
+  return app.run(args.size(), const_cast<char**>(args.data()), [&] {
+    auto&& config = app.configuration();
+    auto type = config["store"].as<std::string>();
+    auto size = config["size"].as<uint64_t>();
+    auto block_size = config["block-size"].as<uint64_t>();
+    auto repeats = config["repeats"].as<unsigned>();
+    auto depth = config["depth"].as<unsigned>();
+    ceph_assert(block_size > 0 && size >= block_size && depth > 0);
+    using ceph::common::sharded_conf;
+    using ceph::common::sharded_perf_coll;
+    return sharded_conf().start(init_params.name, cluster).then([] {
+      return sharded_perf_coll().start();
+    }).then([&conf_file_list] {
+      return local_conf().parse_config_files(conf_file_list);
+    }).then([=] {
+      logger().info("\nsettings:\n  store={}\n  data={}\n  size={}\n  block-size={}\n  repeats={}\n  depth={}",
+                    type, local_conf().get_val<std::string>("osd_data"),
+                    size, block_size, repeats, depth);
+      return seastar::do_with(
+        std::make_unique<bench_t>(size, block_size, repeats, depth),
+        [type] (auto& bench) {
+          return bench->setup(type).then([&bench] {
+            return bench->write();
+          }).then([&bench] {
+            return bench->read();
+          }).finally([&bench] {
+            return bench->teardown();
+          });
+        });
+    }).finally([] {
+      return sharded_perf_coll().stop().then([] {
+        return sharded_conf().stop();
+      });
+    });
+  });
+}
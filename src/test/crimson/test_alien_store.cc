@@ -0,0 +1,132 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <cstdlib>
+#include <iostream>
+#include <seastar/core/app-template.hh>
+#include <seastar/core/do_with.hh>
+
+#include "crimson/common/config_proxy.h"
+#include "crimson/common/perf_counters_collection.h"
+#include "crimson/os/futurized_store.h"
+#include "crimson/os/Transaction.h"
+
+using ceph::common::local_conf;
+using ceph::common::sharded_conf;
+using ceph::common::sharded_perf_coll;
+using ceph::os::FuturizedStore;
+using ceph::os::Transaction;
+
+namespace {
+
+struct store_test_t {
+  std::unique_ptr<FuturizedStore> store;
+  FuturizedStore::CollectionRef ch;
+  const coll_t cid{spg_t{pg_t{0, 1}}};
+  const ghobject_t oid{hobject_t{sobject_t{"alien", CEPH_NOSNAP}}};
+
+  explicit store_test_t(const std::string& path)
+    : store{FuturizedStore::create("alienstore", path,
+                                   local_conf().get_config_values())}
+  {}
+
+  seastar::future<> setup() {
+    uuid_d fsid;
+    fsid.generate_random();
+    return store->start().then([this, fsid] {
+      return store->mkfs(fsid);
+    }).then([this] {
+      return store->mount();
+    }).then([this] {
+      ch = store->create_new_collection(cid);
+      Transaction t;
+      t.create_collection(cid, 0);
+      return store->do_transaction(ch, std::move(t));
+    });
+  }
+
+  // write an object and set an omap key with a transaction built by
+  // crimson, then read them back from the classic store
+  seastar::future<> test_write_read() {
+    bufferlist data;
+    for (unsigned i = 0; i < 3; i++) {
+      // a few segments, so the encoded transaction is not contiguous
+      data.append(std::string(4096, 'a' + i));
+    }
+    Transaction t;
+    t.write(cid, oid, 0, data.length(), data);
+    std::map<std::string, bufferlist> omap;
+    omap["key"].append("value");
+    t.omap_setkeys(cid, oid, omap);
+    return store->do_transaction(ch, std::move(t)).then([this] {
+      return store->read(ch, oid, 4096, 8192);
+    }).then([data] (bufferlist&& bl) {
+      bufferlist expected;
+      expected.substr_of(data, 4096, 8192);
+      if (!bl.contents_equal(expected)) {
+        throw std::runtime_error("read does not match the write");
+      }
+    }).then([this] {
+      return store->omap_get_values(ch, oid, {"key"});
+    }).then([] (FuturizedStore::omap_values_t&& values) {
+      if (values.size() != 1 ||
+          values.begin()->first != "key" ||
+          values.begin()->second.to_str() != "value") {
+        throw std::runtime_error("omap_get_values does not match the write");
+      }
+    });
+  }
+
+  seastar::future<> teardown() {
+    ch.reset();
+    return store->umount().then([this] {
+      return store->stop();
+    });
+  }
+};
+
+}
+
+int main(int argc, char** argv)
+{
+  char path_template[] = "/tmp/test_alien_store.XXXXXX";
+  if (!::mkdtemp(path_template)) {
+    std::cerr << "unable to create the store directory" << std::endl;
+    return 1;
+  }
+  const std::string path{path_template};
+  seastar::app_template app;
+  int status = app.run(argc, argv, [&path] {
+    return sharded_conf().start(EntityName{}, string_view{"ceph"}).then([] {
+      return sharded_perf_coll().start();
+    }).then([] {
+      return local_conf().set_val("osd_objectstore", "memstore");
+    }).then([&path] {
+      return seastar::do_with(std::make_unique<store_test_t>(path),
+                              [] (auto& test) {
+        return test->setup().then([&test] {
+          return test->test_write_read();
+        }).finally([&test] {
+          return test->teardown();
+        });
+      });
+    }).handle_exception([] (auto e) {
+      std::cerr << "Error: " << e << std::endl;
+      seastar::engine().exit(1);
+    }).finally([] {
+      return sharded_perf_coll().stop().then([] {
+        return sharded_conf().stop();
+      });
+    });
+  });
+  std::system(("rm -rf " + path).c_str());
+  return status;
+}
+
+/*
+ * Local Variables:
+ * compile-command: "make -j4 \
+ * -C ../../../build \
+ * unittest_seastar_alien_store"
+ * End:
+ */
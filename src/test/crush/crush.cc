@@ -637,3 +637,65 @@ TEST(CRUSH, straw2_reweight) {
     cout << "     vs " << estddev << std::endl;
   }
 }
+
+TEST(CRUSH, hash32_3_vec) {
+  __u32 b[103], out[103];
+  for (__u32 r = 0; r < 16; ++r) {
+    for (unsigned i = 0; i < 103; ++i) {
+      b[i] = i * 2654435761u + r;
+    }
+    // every length past the straw2 batch, so that each tail left by the
+    // sse2 lanes is covered
+    for (unsigned n = 0; n <= 103; ++n) {
+      crush_hash32_3_vec(CRUSH_HASH_RJENKINS1, r * 77, b, r, out, n);
+      for (unsigned i = 0; i < n; ++i) {
+	ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, r * 77, b[i], r),
+		  out[i]);
+      }
+    }
+  }
+}
+
+TEST(CRUSH, straw2_batch) {
+  // a straw2 map big enough for the buckets to take several hash batches
+  std::unique_ptr<CrushWrapper> c(new CrushWrapper);
+  c->create();
+  c->set_type_name(2, "root");
+  c->set_type_name(1, "host");
+  c->set_type_name(0, "osd");
+  int rootno;
+  c->add_bucket(0, CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+		2, 0, NULL, NULL, &rootno);
+  c->set_item_name(rootno, "default");
+  map<string,string> loc;
+  loc["root"] = "default";
+  int osd = 0;
+  for (int h = 0; h < 40; ++h) {
+    loc["host"] = string("host-") + stringify(h);
+    for (int o = 0; o < 3 + (h * 7) % 70; ++o, ++osd) {
+      c->insert_item(g_ceph_context, osd, 1.0 + (osd % 4),
+		     string("osd.") + stringify(osd), loc);
+    }
+  }
+  int ruleno = c->add_simple_rule("data", "default", "host", "",
+				  "firstn", pg_pool_t::TYPE_REPLICATED);
+  ASSERT_GE(ruleno, 0);
+  c->finalize();
+
+  vector<__u32> weight(osd, 0x10000);
+  for (int i = 0; i < osd; i += 17) {
+    weight[i] = i % 2 ? 0 : 0x8000;
+  }
+  vector<int> xs;
+  for (int x = 0; x < 10000; ++x) {
+    xs.push_back(x * 7919);
+  }
+  vector<vector<int>> batch;
+  c->do_rule_batch(ruleno, xs, batch, 3, weight, 0);
+  ASSERT_EQ(xs.size(), batch.size());
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    vector<int> single;
+    c->do_rule(ruleno, xs[i], single, 3, weight, 0);
+    ASSERT_EQ(single, batch[i]);
+  }
+}
@@ -129,6 +129,55 @@ TYPED_TEST(ErasureCodeTest, encode_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, apply_delta)
+{
+  TypeParam jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  // only reed_sol_van and reed_sol_r6_op support parity deltas
+  if (!(jerasure.get_supported_optimizations() &
+	ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION))
+    return;
+  ASSERT_EQ(0, jerasure.init(profile, &cerr));
+
+  const unsigned chunk_size = 4096;
+  bufferlist old_in;
+  for (unsigned i = 0; i < 4 * chunk_size; i++)
+    old_in.append((char)(i * 13 + i / 251));
+  // overwrite 512 bytes of the third data chunk
+  const unsigned off = 2 * chunk_size + 1024, len = 512;
+  bufferlist new_in;
+  new_in.substr_of(old_in, 0, off);
+  for (unsigned i = 0; i < len; i++)
+    new_in.append((char)(0x5a ^ i));
+  bufferlist tail;
+  tail.substr_of(old_in, off + len, old_in.length() - off - len);
+  new_in.append(tail);
+
+  set<int> want = { 0, 1, 2, 3, 4, 5 };
+  map<int, bufferlist> old_encoded, new_encoded;
+  ASSERT_EQ(0, jerasure.encode(want, old_in, &old_encoded));
+  ASSERT_EQ(0, jerasure.encode(want, new_in, &new_encoded));
+  ASSERT_EQ(chunk_size, old_encoded[0].length());
+
+  bufferptr delta;
+  jerasure.encode_delta(bufferptr(old_encoded[2].c_str(), chunk_size),
+			bufferptr(new_encoded[2].c_str(), chunk_size),
+			&delta);
+  map<int, bufferptr> in;
+  in[2] = delta;
+  map<int, bufferptr> out;
+  out[4] = bufferptr(old_encoded[4].c_str(), chunk_size);
+  out[5] = bufferptr(old_encoded[5].c_str(), chunk_size);
+  ASSERT_EQ(0, jerasure.apply_delta(in, out));
+
+  // the coding chunks match a full re-encode of the new data
+  EXPECT_EQ(0, memcmp(out[4].c_str(), new_encoded[4].c_str(), chunk_size));
+  EXPECT_EQ(0, memcmp(out[5].c_str(), new_encoded[5].c_str(), chunk_size));
+}
+
 TYPED_TEST(ErasureCodeTest, minimum_to_decode)
 {
   TypeParam jerasure;
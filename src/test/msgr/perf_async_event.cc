@@ -0,0 +1,182 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Cross-thread submit rate of AsyncMessenger's EventCenter: producer
+ * threads hand events to the centers' owner threads, the way OSD op
+ * threads hand replies to the messenger workers.
+ */
+
+#include <stdlib.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "common/Cycles.h"
+#include "common/Thread.h"
+#include "global/global_init.h"
+#include "msg/async/Event.h"
+
+using namespace std;
+
+class Center : public Thread {
+  std::atomic<bool> done = { false };
+
+ public:
+  std::atomic<bool> ready = { false };
+  EventCenter center;
+  std::atomic<uint64_t> events = { 0 };  ///< written by the owner only
+  uint64_t loops = 0;                    ///< process_events calls with work
+
+  Center(CephContext *cct, int idx) : center(cct) {
+    center.init(1000, idx, "posix");
+  }
+  void stop() {
+    done = true;
+    center.wakeup();
+  }
+  void *entry() override {
+    center.set_owner();
+    ready = true;
+    while (!done) {
+      if (center.process_events(1000000) > 0) {
+	++loops;
+      }
+    }
+    return 0;
+  }
+};
+
+class CountEvent : public EventCallback {
+  std::atomic<uint64_t> *events;
+
+ public:
+  explicit CountEvent(std::atomic<uint64_t> *e) : events(e) {}
+  void do_request(uint64_t id) override {
+    events->store(events->load(std::memory_order_relaxed) + 1,
+		  std::memory_order_relaxed);
+  }
+};
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [producers] [centers] [events] [mode]" << std::endl;
+  cerr << "       [producers]: threads dispatching events" << std::endl;
+  cerr << "       [centers]: event centers (owner threads) they spread over" << std::endl;
+  cerr << "       [events]: events dispatched by each producer" << std::endl;
+  cerr << "       [mode]: 'external' for dispatch_event_external() or" << std::endl;
+  cerr << "               'submit' for submit_to(..., nowait)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  if (args.size() < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  int num_producers = atoi(args[0]);
+  int num_centers = atoi(args[1]);
+  uint64_t num_events = atoll(args[2]);
+  string mode = args[3];
+  if (num_producers < 1 || num_centers < 1 ||
+      num_centers > EventCenter::MAX_EVENTCENTER ||
+      (mode != "external" && mode != "submit")) {
+    usage(argv[0]);
+    return 1;
+  }
+  cerr << "       producers " << num_producers << std::endl;
+  cerr << "       centers " << num_centers << std::endl;
+  cerr << "       events per producer " << num_events << std::endl;
+  cerr << "       mode " << mode << std::endl;
+
+  vector<unique_ptr<Center>> centers;
+  for (int i = 0; i < num_centers; ++i) {
+    centers.emplace_back(new Center(g_ceph_context, i));
+    centers.back()->create("perf_center");
+  }
+  // let every center register itself for submit_to()
+  for (auto& c : centers) {
+    while (!c->ready) {
+      usleep(1000);
+    }
+  }
+
+  Cycles::init();
+  uint64_t start = Cycles::rdtsc();
+  vector<std::thread> producers;
+  for (int p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&, p] {
+      // two callbacks per center, used in turn: the center skips a
+      // callback queued twice in a row, and that must not hide events
+      vector<unique_ptr<CountEvent>> cbs;
+      for (auto& c : centers) {
+	cbs.emplace_back(new CountEvent(&c->events));
+	cbs.emplace_back(new CountEvent(&c->events));
+      }
+      for (uint64_t i = 0; i < num_events; ++i) {
+	int ci = (p + i) % num_centers;
+	if (mode == "external") {
+	  centers[ci]->center.dispatch_event_external(
+	    cbs[ci * 2 + (i / num_centers) % 2].get());
+	} else {
+	  auto *events = &centers[ci]->events;
+	  centers[0]->center.submit_to(ci, [events] {
+	      events->store(events->load(std::memory_order_relaxed) + 1,
+			    std::memory_order_relaxed);
+	    }, true);
+	}
+      }
+      // the callbacks must outlive their dispatch
+      for (int ci = 0; ci < num_centers; ++ci) {
+	centers[ci]->center.submit_to(ci, [] {}, false);
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  uint64_t total = num_events * num_producers;
+  uint64_t seen;
+  do {
+    seen = 0;
+    for (auto& c : centers) {
+      seen += c->events;
+    }
+  } while (seen < total);
+  uint64_t stop = Cycles::rdtsc();
+
+  uint64_t loops = 0;
+  for (auto& c : centers) {
+    c->stop();
+    c->join();
+    loops += c->loops;
+  }
+  uint64_t us = Cycles::to_microseconds(stop - start);
+  cerr << " Total events " << total << " run time " << us << "us, "
+       << (us ? total * 1000000 / us : 0) << " events/s, "
+       << (loops ? (double)total / loops : 0) << " events per wakeup"
+       << std::endl;
+  return 0;
+}
@@ -31,6 +31,7 @@
 #include "msg/async/Event.h"
 
 #include <atomic>
+#include <thread>
 
 // We use epoll, kqueue, evport, select in descending order by performance.
 #if defined(__linux__)
@@ -332,6 +333,51 @@ TEST(EventCenterTest, DispatchTest) {
   worker2.join();
 }
 
+class SeqEvent: public EventCallback {
+  vector<unsigned> *last;
+  unsigned producer, seq;
+  std::atomic<unsigned> *done;
+
+ public:
+  SeqEvent(vector<unsigned> *l, unsigned p, unsigned s, std::atomic<unsigned> *d)
+    : last(l), producer(p), seq(s), done(d) {}
+  void do_request(uint64_t id) override {
+    // runs in the worker thread only
+    EXPECT_EQ((*last)[producer] + 1, seq);
+    (*last)[producer] = seq;
+    (*done)++;
+    delete this;
+  }
+};
+
+TEST(EventCenterTest, DispatchManyProducers) {
+  const unsigned producers = 8, events = 20000;
+  Worker worker(g_ceph_context, 3);
+  vector<unsigned> last(producers, 0);
+  std::atomic<unsigned> done = { 0 };
+  worker.create("worker_3");
+  vector<std::thread> threads;
+  for (unsigned p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (unsigned i = 1; i <= events; ++i) {
+	worker.center.dispatch_event_external(new SeqEvent(&last, p, i, &done));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // each producer's events run in the order it dispatched them
+  while (done < producers * events) {
+    usleep(1000);
+  }
+  for (unsigned p = 0; p < producers; ++p) {
+    ASSERT_EQ(events, last[p]);
+  }
+  worker.stop();
+  worker.join();
+}
+
 INSTANTIATE_TEST_CASE_P(
   AsyncMessenger,
   EventDriverTest,
@@ -1055,6 +1055,73 @@ class StressFactory {
   }
 };
 
+TEST_P(NetworkWorkerTest, ZeroCopySendTest) {
+  if (strncmp(GetParam(), "posix", 5)) {
+    return;
+  }
+  // loopback makes the kernel copy anyway, but the completions still go
+  // through the error queue and the pinned buffers must come back intact
+  g_ceph_context->_conf.set_val("ms_async_zerocopy_min_size", "65536");
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+  exec_events([this, bind_addr](Worker *worker) mutable {
+    if (worker->id != 0)
+      return;
+    EventCenter *center = &worker->center;
+    SocketOptions options;
+    ServerSocket bind_socket;
+    ASSERT_EQ(0, worker->listen(bind_addr, 0, options, &bind_socket));
+    ConnectedSocket cli_socket, srv_socket;
+    ASSERT_EQ(0, worker->connect(bind_addr, options, &cli_socket));
+    {
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+    }
+    entity_addr_t cli_addr;
+    ASSERT_EQ(0, bind_socket.accept(&srv_socket, options, &cli_addr, worker));
+
+    const size_t len = 8 << 20;
+    bufferlist bl, expected;
+    for (size_t off = 0; off < len; off += 1 << 20) {
+      bufferptr p(buffer::create_page_aligned(1 << 20));
+      for (unsigned i = 0; i < p.length(); ++i) {
+        p.c_str()[i] = (off + i) * 31;
+      }
+      bl.append(p);
+    }
+    expected = bl;
+    expected.rebuild();
+
+    C_poll cb(center);
+    center->create_file_event(srv_socket.fd(), EVENT_READABLE, &cb);
+    std::string got;
+    char buf[65536];
+    while (got.size() < len) {
+      if (bl.length()) {
+        ssize_t r = cli_socket.send(bl, false);
+        ASSERT_LE(0, r);
+      }
+      ssize_t r = srv_socket.read(buf, sizeof(buf));
+      if (r == -EAGAIN) {
+        cb.poll(10);
+        cb.reset();
+        continue;
+      }
+      ASSERT_LT(0, r);
+      got.append(buf, r);
+    }
+    ASSERT_EQ(0u, bl.length());
+    ASSERT_EQ(0, memcmp(got.data(), expected.c_str(), len));
+    center->delete_file_event(srv_socket.fd(), EVENT_READABLE);
+    srv_socket.close();
+    cli_socket.close();
+    bind_socket.abort_accept();
+  });
+  g_ceph_context->_conf.set_val("ms_async_zerocopy_min_size", "0");
+}
+
 TEST_P(NetworkWorkerTest, StressTest) {
   StressFactory factory(stack, get_addr(), 16, 16, 10000, 1024,
                         strncmp(GetParam(), "dpdk", 4) == 0);
@@ -329,10 +329,79 @@ TEST_P(AllocTest, test_alloc_bench_10_300)
   doOverwriteTest(capacity, prefill, overwrite);
 }
 
+TEST_P(AllocTest, test_alloc_bench_fragmented)
+{
+  uint64_t capacity = uint64_t(1024) * 1024 * 1024 * 1024;
+  uint64_t alloc_unit = 4096;
+  PExtentVector tmp;
+  AllocTracker at(capacity, alloc_unit);
+
+  init_alloc(capacity, alloc_unit);
+  alloc->init_add_free(0, capacity);
+
+  gen_type rng(time(NULL));
+  boost::uniform_int<> u1(0, 4); // 4K-64K
+
+  // fill 90% of the device with small extents
+  auto cap = capacity - capacity / 10;
+  for (uint64_t i = 0; i < cap; )
+  {
+    uint32_t want = alloc_unit << u1(rng);
+    tmp.clear();
+    auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+    if (r < want) {
+      break;
+    }
+    i += r;
+
+    for(auto a : tmp) {
+      bool full = !at.push(a.offset, a.length);
+      EXPECT_EQ(full, false);
+    }
+  }
+
+  // punch random holes into it
+  uint64_t released = 0;
+  while (released < capacity / 2) {
+    uint64_t o = 0;
+    uint32_t l = 0;
+    interval_set<uint64_t> release_set;
+    if (!at.pop_random(rng, &o, &l)) {
+      break;
+    }
+    release_set.insert(o, l);
+    alloc->release(release_set);
+    released += l;
+  }
+  std::cout << "Fragmentation " << alloc->get_fragmentation(alloc_unit)
+	    << " avail " << alloc->get_free() / _1m << " MB" << std::endl;
+
+  // and see how well large requests are served out of what's left
+  uint64_t want = 4 * _1m;
+  uint64_t allocated = 0;
+  uint64_t extents = 0;
+  utime_t start = ceph_clock_now();
+  while (allocated < capacity / 4) {
+    tmp.clear();
+    auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+    if (r <= 0) {
+      break;
+    }
+    allocated += r;
+    extents += tmp.size();
+  }
+  std::cout << "Executed in " << ceph_clock_now() - start << std::endl;
+  std::cout << "Allocated " << allocated / _1m << " MB in "
+	    << extents << " extents, "
+	    << (allocated ? extents * want / allocated : 0)
+	    << " extents per " << want / _1m << " MB request" << std::endl;
+  dump_mempools();
+}
+
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid"));
 
 #else
 
@@ -14,6 +14,7 @@
 #include "include/stringify.h"
 #include "include/Context.h"
 #include "os/bluestore/Allocator.h"
+#include "os/bluestore/AvlAllocator.h"
 
 #include <boost/random/uniform_int.hpp>
 typedef boost::mt11213b gen_type;
@@ -318,10 +319,56 @@ TEST_P(AllocTest, test_alloc_bug_24598)
   EXPECT_EQ(1u, tmp.size());
 }
 
+TEST_P(AllocTest, test_alloc_hybrid_spillover)
+{
+  if (string(GetParam()) != "hybrid")
+    return;
+
+  // room for two ranges only, everything else goes to the bitmap
+  g_ceph_context->_conf.set_val_or_die("bluestore_hybrid_alloc_mem_cap",
+				       stringify(2 * sizeof(range_seg_t)));
+  uint64_t capacity = 1024 * 1024;
+  uint64_t alloc_unit = 4096;
+  init_alloc(capacity, alloc_unit);
+  g_ceph_context->_conf.rm_val("bluestore_hybrid_alloc_mem_cap");
+
+  alloc->init_add_free(0, alloc_unit);
+  alloc->init_add_free(2 * alloc_unit, 2 * alloc_unit);
+  // longer than both, so the shortest one ([0, 4K)) is spilled over
+  alloc->init_add_free(6 * alloc_unit, 3 * alloc_unit);
+  EXPECT_EQ(6 * alloc_unit, alloc->get_free());
+
+  // small requests are served by the bitmap first
+  PExtentVector tmp;
+  EXPECT_EQ(static_cast<int64_t>(alloc_unit),
+	    alloc->allocate(alloc_unit, alloc_unit, 0, 0, &tmp));
+  EXPECT_EQ(1u, tmp.size());
+  EXPECT_EQ(0u, tmp[0].offset);
+
+  tmp.clear();
+  EXPECT_EQ(static_cast<int64_t>(3 * alloc_unit),
+	    alloc->allocate(3 * alloc_unit, alloc_unit, 0, 0, &tmp));
+  EXPECT_EQ(1u, tmp.size());
+  EXPECT_EQ(6 * alloc_unit, tmp[0].offset);
+  EXPECT_EQ(2 * alloc_unit, alloc->get_free());
+
+  // released extents are spilled over the same way, and removal is
+  // routed to whichever side holds the range
+  interval_set<uint64_t> release_set;
+  release_set.insert(0, alloc_unit);
+  release_set.insert(6 * alloc_unit, 3 * alloc_unit);
+  alloc->release(release_set);
+  EXPECT_EQ(6 * alloc_unit, alloc->get_free());
+  alloc->init_rm_free(0, alloc_unit);
+  EXPECT_EQ(5 * alloc_unit, alloc->get_free());
+  alloc->init_rm_free(2 * alloc_unit, 2 * alloc_unit);
+  EXPECT_EQ(3 * alloc_unit, alloc->get_free());
+}
+
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid"));
 
 #else
 
@@ -1313,6 +1313,175 @@ TEST_P(StoreTest, SimpleObjectTest) {
   }
 }
 
+TEST_P(StoreTest, ReadMultiTest) {
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const unsigned num = 16;
+  vector<ghobject_t> oids;
+  vector<bufferlist> data;
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < num; ++i) {
+      oids.emplace_back(hobject_t(sobject_t("Object " + stringify(i),
+					    CEPH_NOSNAP)));
+      data.emplace_back();
+      data.back().append(string(0x1000 * (i % 4 + 1), 'a' + i));
+      t.write(cid, oids.back(), 0, data.back().length(), data.back());
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(0, r);
+  r = store->mount();
+  ASSERT_EQ(0, r);
+  ch = store->open_collection(cid);
+  {
+    // cold onodes, whole objects, a partial read, a missing object and a
+    // read past eof, all in one batch
+    vector<ObjectStore::read_multi_op_t> ops;
+    for (unsigned i = 0; i < num; ++i) {
+      ops.emplace_back(oids[i], 0, 0);
+    }
+    ops.emplace_back(oids[3], 0x800, 0x1000);
+    ops.emplace_back(ghobject_t(hobject_t(sobject_t("missing", CEPH_NOSNAP))),
+		     0, 0x1000);
+    ops.emplace_back(oids[0], 0x2000, 0x1000);
+    r = store->read_multi(ch, ops);
+    ASSERT_EQ(r, 0);
+    for (unsigned i = 0; i < num; ++i) {
+      ASSERT_EQ((int)data[i].length(), ops[i].r);
+      ASSERT_TRUE(bl_eq(data[i], ops[i].bl));
+    }
+    bufferlist exp;
+    exp.substr_of(data[3], 0x800, 0x1000);
+    ASSERT_EQ(0x1000, ops[num].r);
+    ASSERT_TRUE(bl_eq(exp, ops[num].bl));
+    ASSERT_EQ(-ENOENT, ops[num + 1].r);
+    ASSERT_EQ(0, ops[num + 2].r);
+    ASSERT_EQ(0u, ops[num + 2].bl.length());
+
+    // same again, now with the onodes cached
+    r = store->read_multi(ch, ops);
+    ASSERT_EQ(r, 0);
+    for (unsigned i = 0; i < num; ++i) {
+      ASSERT_EQ((int)data[i].length(), ops[i].r);
+      ASSERT_TRUE(bl_eq(data[i], ops[i].bl));
+    }
+  }
+  {
+    ObjectStore::Transaction t;
+    for (auto& oid : oids) {
+      t.remove(cid, oid);
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTest, DigestTest) {
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto random_bl = [](unsigned len) {
+    bufferlist bl;
+    bufferptr bp(len);
+    for (unsigned i = 0; i < len; ++i) {
+      bp[i] = rand();
+    }
+    bl.append(bp);
+    return bl;
+  };
+  {
+    // aligned and unaligned extents, holes, and a tail past the data
+    ObjectStore::Transaction t;
+    bufferlist bl = random_bl(0x10000);
+    t.write(cid, hoid, 0, bl.length(), bl);
+    bl = random_bl(0x3000);
+    t.write(cid, hoid, 0x20000, bl.length(), bl);
+    bl = random_bl(0x123);
+    t.write(cid, hoid, 0x30101, bl.length(), bl);
+    t.truncate(cid, hoid, 0x40000);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto check = [&](uint64_t off, uint64_t len) {
+    bufferlist bl;
+    int rr = store->read(ch, hoid, off, len, bl);
+    ASSERT_GE(rr, 0);
+    uint32_t expected = bl.crc32c(-1);
+    uint32_t digest = -1;
+    rr = store->digest(ch, hoid, off, len, &digest);
+    if (rr == -EOPNOTSUPP) {
+      return;
+    }
+    ASSERT_EQ((int)bl.length(), rr);
+    ASSERT_EQ(expected, digest);
+  };
+  check(0, 0x40000);
+  check(0x1000, 0x7fff);
+  check(0x20800, 0x11000);
+  check(0x30000, 0x20000);
+  check(0x50000, 0x1000);
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(0, r);
+  r = store->mount();
+  ASSERT_EQ(0, r);
+  ch = store->open_collection(cid);
+  check(0, 0x40000);
+  check(0x1000, 0x7fff);
+  check(0x20800, 0x11000);
+  {
+    // chunked, as deep scrub does it
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, 0x40000, bl);
+    ASSERT_EQ(0x40000, r);
+    uint32_t digest = -1;
+    uint64_t pos = 0;
+    do {
+      r = store->digest(ch, hoid, pos, 0x7000, &digest);
+      if (r == -EOPNOTSUPP) {
+	digest = bl.crc32c(-1);
+	break;
+      }
+      ASSERT_GE(r, 0);
+      pos += r;
+    } while (r == 0x7000);
+    ASSERT_EQ(bl.crc32c(-1), digest);
+  }
+  {
+    uint32_t digest = -1;
+    r = store->digest(ch, ghobject_t(hobject_t(sobject_t("missing",
+							  CEPH_NOSNAP))),
+		      0, 0x1000, &digest);
+    ASSERT_TRUE(r == -ENOENT || r == -EOPNOTSUPP);
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 #if defined(WITH_BLUESTORE)
 
 TEST_P(StoreTestSpecificAUSize, BluestoreStatFSTest) {
@@ -6930,6 +7099,177 @@ TEST_P(StoreTestSpecificAUSize, SmallWriteOnShardedExtents) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, ReadMultiInlineData) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  StartDeferred(4096);
+  SetVal(g_conf(), "bluestore_inline_data_max", "1024");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t inline_oid(hobject_t(sobject_t("inline", CEPH_NOSNAP)));
+  ghobject_t big_oid(hobject_t(sobject_t("big", CEPH_NOSNAP)));
+  bufferlist inline_bl, big_bl;
+  inline_bl.append(string(300, 'i'));
+  big_bl.append(string(0x3000, 'b'));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, inline_oid, 0, inline_bl.length(), inline_bl);
+    t.write(cid, big_oid, 0, big_bl.length(), big_bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(1u, store->get_perf_counters()->get(l_bluestore_write_inline));
+
+  for (int remount = 0; remount < 2; ++remount) {
+    if (remount) {
+      ch.reset();
+      ASSERT_EQ(0, store->umount());
+      ASSERT_EQ(0, store->mount());
+      ch = store->open_collection(cid);
+    }
+    // inline and extent backed objects mixed in one batch
+    vector<ObjectStore::read_multi_op_t> ops;
+    ops.emplace_back(inline_oid, 0, 0);
+    ops.emplace_back(big_oid, 0, 0);
+    ops.emplace_back(inline_oid, 100, 1000);
+    ops.emplace_back(inline_oid, 400, 10);
+    r = store->read_multi(ch, ops);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ((int)inline_bl.length(), ops[0].r);
+    ASSERT_TRUE(bl_eq(inline_bl, ops[0].bl));
+    ASSERT_EQ((int)big_bl.length(), ops[1].r);
+    ASSERT_TRUE(bl_eq(big_bl, ops[1].bl));
+    bufferlist exp;
+    exp.substr_of(inline_bl, 100, 200);
+    ASSERT_EQ(200, ops[2].r);
+    ASSERT_TRUE(bl_eq(exp, ops[2].bl));
+    ASSERT_EQ(0, ops[3].r);
+    ASSERT_EQ(0u, ops[3].bl.length());
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, InlineData) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  StartDeferred(block_size);
+  SetVal(g_conf(), "bluestore_inline_data_max", "1024");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t("test_inline", "", CEPH_NOSNAP, 0, -1, ""));
+  ghobject_t hoid2(hobject_t("test_inline2", "", CEPH_NOSNAP, 0, -1, ""));
+  string model;
+
+  const PerfCounters* logger = store->get_perf_counters();
+
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto check = [&](const ghobject_t& oid) {
+    bufferlist bl, expected;
+    expected.append(model);
+    int r = store->read(ch, oid, 0, model.size() + 100, bl);
+    ASSERT_EQ(r, (int)model.size());
+    ASSERT_TRUE(bl_eq(expected, bl));
+  };
+  {
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(string(100, 'a'));
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    model = string(100, 'a');
+  }
+  ASSERT_EQ(logger->get(l_bluestore_write_inline), 1u);
+  check(hoid);
+  {
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(string(10, 'b'));
+    t.write(cid, hoid, 50, bl.length(), bl);
+    t.zero(cid, hoid, 20, 10);
+    t.truncate(cid, hoid, 80);
+    bl.clear();
+    bl.append(string(30, 'c'));
+    t.write(cid, hoid, 200, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    model.replace(50, 10, string(10, 'b'));
+    model.replace(20, 10, string(10, '\0'));
+    model.resize(80);
+    model.resize(200, '\0');
+    model.append(string(30, 'c'));
+  }
+  check(hoid);
+  ASSERT_EQ(logger->get(l_bluestore_inline_spill), 0u);
+
+  // inline data must survive a remount
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ch = store->open_collection(cid);
+  check(hoid);
+  {
+    ObjectStore::Transaction t;
+    t.clone(cid, hoid, hoid2);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  check(hoid2);
+  {
+    // grow past the limit, the data moves to blobs
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(string(block_size, 'd'));
+    t.write(cid, hoid, 1000, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    model.resize(1000, '\0');
+    model.append(string(block_size, 'd'));
+  }
+  ASSERT_EQ(logger->get(l_bluestore_inline_spill), 1u);
+  check(hoid);
+  {
+    map<uint64_t, uint64_t> m;
+    r = store->fiemap(ch, hoid2, 0, 1000, m);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(m.size(), 1u);
+    ASSERT_EQ(m[0], 230u);
+  }
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ch = store->open_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, ExcessiveFragmentation) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -7362,6 +7702,7 @@ TEST_P(StoreTestSpecificAUSize, BluestoreRepairTest) {
     r = queue_transaction(store, ch, std::move(t));
     ASSERT_EQ(r, 0);
   }
+  ASSERT_EQ(bstore->fsck_online(), 0);
 
   bstore->umount();
   //////////// leaked pextent fix ////////////
@@ -7423,6 +7764,8 @@ TEST_P(StoreTestSpecificAUSize, BluestoreRepairTest) {
   bstore->inject_misreference(cid, hoid, cid, hoid_dup, 0);
   bstore->inject_misreference(cid, hoid, cid, hoid_dup, (offs_base * repeats) / 2);
   bstore->inject_misreference(cid, hoid, cid, hoid_dup, offs_base * (repeats -1) );
+  // online fsck sees the misreferences but not the leaked extents
+  ASSERT_EQ(bstore->fsck_online(), 3);
   
   bstore->umount();
   ASSERT_EQ(bstore->fsck(false), 6);
@@ -7562,6 +7905,447 @@ TEST_P(StoreTestSpecificAUSize, BluestoreTinyDevFailure2) {
   store->mount();
 }
 
+// places every allocation that fits on the fast tier, demotes on request
+class TestTierPolicy : public BlueStore::TierPolicy {
+public:
+  std::atomic<bool> promote = {true};
+  std::atomic<bool> demote = {false};
+
+  bool should_promote(const BlueStore::Onode& o, uint64_t need,
+		      uint64_t fast_free, uint64_t fast_total) override {
+    return promote && need <= fast_free;
+  }
+  bool should_demote(const BlueStore::Onode& o,
+		     uint64_t fast_free, uint64_t fast_total) override {
+    return demote;
+  }
+};
+
+class StoreTestFastTier : public StoreTestSpecificAUSize {
+protected:
+  BlueStore *bstore = nullptr;
+  TestTierPolicy *policy = nullptr;
+
+  void StartFastTier() {
+    SetVal(g_conf(), "bluestore_block_size",
+      stringify(4ull * 1024 * 1024 * 1024).c_str());
+    SetVal(g_conf(), "bluestore_block_db_size",
+      stringify(1024 * 1024 * 1024).c_str());
+    SetVal(g_conf(), "bluestore_block_db_create", "true");
+    SetVal(g_conf(), "bluestore_fast_tier_size",
+      stringify(256 * 1024 * 1024).c_str());
+    SetVal(g_conf(), "bluestore_fast_tier_demote_interval", "0.1");
+    StartDeferred(0x1000);
+    bstore = dynamic_cast<BlueStore*>(store.get());
+    ASSERT_TRUE(bstore);
+    Remount(true);
+  }
+
+  /// remount, installing a fresh test policy if asked to
+  void Remount(bool new_policy = false) {
+    ASSERT_EQ(0, store->umount());
+    if (new_policy) {
+      std::unique_ptr<TestTierPolicy> p(new TestTierPolicy);
+      policy = p.get();
+      bstore->set_tier_policy(std::move(p));
+    }
+    ASSERT_EQ(0, store->mount());
+  }
+
+  uint64_t counter(int idx) {
+    return store->get_perf_counters()->get(idx);
+  }
+};
+
+TEST_P(StoreTestFastTier, Placement) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartFastTier();
+
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t fast_oid(hobject_t(sobject_t("fast", CEPH_NOSNAP)));
+  ghobject_t slow_oid(hobject_t(sobject_t("slow", CEPH_NOSNAP)));
+  bufferlist fast_bl, slow_bl;
+  fast_bl.append(std::string(0x10000, 'f'));
+  slow_bl.append(std::string(0x10000, 's'));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, fast_oid, 0, fast_bl.length(), fast_bl);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  ASSERT_EQ(fast_bl.length(), counter(l_bluestore_tier_fast_alloc_bytes));
+
+  policy->promote = false;
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, slow_oid, 0, slow_bl.length(), slow_bl);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  ASSERT_EQ(fast_bl.length(), counter(l_bluestore_tier_fast_alloc_bytes));
+
+  // read from the devices, not the cache
+  Remount();
+  ch = store->open_collection(cid);
+  uint64_t fast_read = counter(l_bluestore_tier_fast_read_bytes);
+  {
+    bufferlist bl;
+    ASSERT_EQ((int)fast_bl.length(),
+	      store->read(ch, fast_oid, 0, fast_bl.length(), bl));
+    ASSERT_TRUE(bl_eq(fast_bl, bl));
+    ASSERT_EQ(fast_read + fast_bl.length(),
+	      counter(l_bluestore_tier_fast_read_bytes));
+  }
+  {
+    bufferlist bl;
+    ASSERT_EQ((int)slow_bl.length(),
+	      store->read(ch, slow_oid, 0, slow_bl.length(), bl));
+    ASSERT_TRUE(bl_eq(slow_bl, bl));
+    ASSERT_EQ(fast_read + fast_bl.length(),
+	      counter(l_bluestore_tier_fast_read_bytes));
+  }
+
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->fsck(false));
+  ASSERT_EQ(0, store->fsck(true));
+  ASSERT_EQ(0, store->mount());
+}
+
+TEST_P(StoreTestFastTier, PromoteDemote) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartFastTier();
+
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t oid(hobject_t(sobject_t("obj", CEPH_NOSNAP)));
+  ghobject_t other(hobject_t(sobject_t("other", CEPH_NOSNAP)));
+  bufferlist data;
+  for (unsigned i = 0; i < 0x20000; ++i) {
+    data.append((char)(i * 31 + i / 4096));
+  }
+
+  // the first half lands on the main device, the second on the fast tier
+  policy->promote = false;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    bufferlist bl;
+    bl.substr_of(data, 0, 0x10000);
+    t.write(cid, oid, 0, bl.length(), bl);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  policy->promote = true;
+  {
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.substr_of(data, 0x10000, 0x10000);
+    t.write(cid, oid, 0x10000, bl.length(), bl);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  ASSERT_EQ(0x10000u, counter(l_bluestore_tier_fast_alloc_bytes));
+  ASSERT_EQ(0u, counter(l_bluestore_tier_demoted_bytes));
+
+  // demotion is picked by the tier thread and carried out by the next
+  // write to the collection
+  policy->promote = false;
+  policy->demote = true;
+  for (int i = 0; i < 100 && !counter(l_bluestore_tier_demoted_bytes); ++i) {
+    usleep(100000);
+    ObjectStore::Transaction t;
+    t.touch(cid, other);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  ASSERT_EQ(0x10000u, counter(l_bluestore_tier_demoted_bytes));
+
+  Remount();
+  ch = store->open_collection(cid);
+  {
+    uint64_t fast_read = counter(l_bluestore_tier_fast_read_bytes);
+    bufferlist bl;
+    ASSERT_EQ((int)data.length(),
+	      store->read(ch, oid, 0, data.length(), bl));
+    ASSERT_TRUE(bl_eq(data, bl));
+    // nothing is left on the fast tier
+    ASSERT_EQ(fast_read, counter(l_bluestore_tier_fast_read_bytes));
+  }
+
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->fsck(true));
+  ASSERT_EQ(0, store->mount());
+}
+
+TEST_P(StoreTestFastTier, ExpandDevices) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartFastTier();
+
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t oid(hobject_t(sobject_t("obj", CEPH_NOSNAP)));
+  bufferlist data;
+  data.append(std::string(0x8000, 'x'));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, oid, 0, data.length(), data);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+
+  // grow block.db; the space past the fast tier must not go to bluefs
+  string db_path = string(GetParam()) + ".test_temp_dir/block.db";
+  ASSERT_EQ(0, ::truncate(db_path.c_str(), 2ull * 1024 * 1024 * 1024));
+  std::stringstream out;
+  ASSERT_EQ(0, bstore->expand_devices(out));
+  cout << out.str() << std::endl;
+  ASSERT_NE(string::npos, out.str().find("not expanding"));
+  ASSERT_EQ(string::npos, out.str().find("size label updated"));
+
+  ASSERT_EQ(0, store->fsck(false));
+  ASSERT_EQ(0, store->mount());
+  ch = store->open_collection(cid);
+  {
+    bufferlist bl;
+    ASSERT_EQ((int)data.length(),
+	      store->read(ch, oid, 0, data.length(), bl));
+    ASSERT_TRUE(bl_eq(data, bl));
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(
+  ObjectStore,
+  StoreTestFastTier,
+  ::testing::Values(
+    "bluestore"));
+
+class StoreTestOnodeWarmup : public StoreTestSpecificAUSize {
+protected:
+  BlueStore *bstore = nullptr;
+
+  void StartWarmup() {
+    StartDeferred(0x1000);
+    bstore = dynamic_cast<BlueStore*>(store.get());
+    ASSERT_TRUE(bstore);
+  }
+
+  /// remount and wait for the warm-up to finish
+  void Remount() {
+    ASSERT_EQ(0, store->umount());
+    ASSERT_EQ(0, store->mount());
+    bstore->wait_for_onode_warmup();
+  }
+
+  /// with the warm-up off, umount leaves the record alone and mount
+  /// does not read it
+  void SetWarmup(bool on) {
+    SetVal(g_conf(), "bluestore_onode_warmup", on ? "true" : "false");
+    g_conf().apply_changes(nullptr);
+  }
+
+  uint64_t counter(int idx) {
+    return store->get_perf_counters()->get(idx);
+  }
+
+  static ghobject_t make_oid(int i) {
+    return ghobject_t(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+  }
+
+  void WriteObjects(ObjectStore::CollectionHandle& ch, const coll_t& cid,
+		    int n, uint64_t len, bool create) {
+    bufferlist bl;
+    bl.append(std::string(len, 'w'));
+    ObjectStore::Transaction t;
+    if (create) {
+      t.create_collection(cid, 0);
+    }
+    for (int i = 0; i < n; ++i) {
+      t.write(cid, make_oid(i), 0, bl.length(), bl);
+    }
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+};
+
+TEST_P(StoreTestOnodeWarmup, Cycle) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartWarmup();
+
+  const int n = 20;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  WriteObjects(ch, cid, n, 0x1000, true);
+  ch.reset();
+
+  uint64_t loaded = counter(l_bluestore_onode_warmup_loaded);
+  uint64_t skipped = counter(l_bluestore_onode_warmup_skipped);
+  Remount();
+  ASSERT_EQ(loaded + n, counter(l_bluestore_onode_warmup_loaded));
+  ASSERT_EQ(skipped, counter(l_bluestore_onode_warmup_skipped));
+  ASSERT_EQ(0u, counter(l_bluestore_onode_warmup_pending));
+
+  // every onode is found in the cache
+  ch = store->open_collection(cid);
+  uint64_t misses = counter(l_bluestore_onode_misses);
+  uint64_t hits = counter(l_bluestore_onode_hits);
+  for (int i = 0; i < n; ++i) {
+    struct stat st;
+    ASSERT_EQ(0, store->stat(ch, make_oid(i), &st));
+    ASSERT_EQ(0x1000, st.st_size);
+  }
+  ASSERT_EQ(misses, counter(l_bluestore_onode_misses));
+  ASSERT_EQ(hits + n, counter(l_bluestore_onode_hits));
+}
+
+TEST_P(StoreTestOnodeWarmup, Limits) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartWarmup();
+
+  const int n = 20;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  WriteObjects(ch, cid, n, 0x10000, true);
+  ch.reset();
+
+  // everything is recorded, but only max_onodes are loaded
+  uint64_t loaded = counter(l_bluestore_onode_warmup_loaded);
+  ASSERT_EQ(0, store->umount());
+  SetVal(g_conf(), "bluestore_onode_warmup_max_onodes", "5");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, store->mount());
+  bstore->wait_for_onode_warmup();
+  ASSERT_EQ(loaded + 5, counter(l_bluestore_onode_warmup_loaded));
+
+  // no more than max_onodes are recorded either
+  loaded = counter(l_bluestore_onode_warmup_loaded);
+  ASSERT_EQ(0, store->umount());
+  SetVal(g_conf(), "bluestore_onode_warmup_max_onodes", "100000");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, store->mount());
+  bstore->wait_for_onode_warmup();
+  ASSERT_GE(loaded + 5, counter(l_bluestore_onode_warmup_loaded));
+  ASSERT_LT(loaded, counter(l_bluestore_onode_warmup_loaded));
+
+  // buffers are read back up to max_bytes
+  ch = store->open_collection(cid);
+  for (int i = 0; i < n; ++i) {
+    bufferlist bl;
+    ASSERT_EQ(0x10000, store->read(ch, make_oid(i), 0, 0x10000, bl));
+  }
+  ch.reset();
+  SetVal(g_conf(), "bluestore_onode_warmup_buffers", "true");
+  SetVal(g_conf(), "bluestore_onode_warmup_max_bytes", "196608");
+  g_conf().apply_changes(nullptr);
+  uint64_t bytes = counter(l_bluestore_onode_warmup_bytes);
+  Remount();
+  ASSERT_LT(bytes, counter(l_bluestore_onode_warmup_bytes));
+  ASSERT_GE(bytes + 0x30000, counter(l_bluestore_onode_warmup_bytes));
+}
+
+TEST_P(StoreTestOnodeWarmup, BadRecord) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartWarmup();
+
+  const int n = 4;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  WriteObjects(ch, cid, n, 0x1000, true);
+  ch.reset();
+
+  vector<bufferlist> records(3);
+  // records[0] is empty
+  {
+    // the header promises items that are not there
+    ENCODE_START(1, 1, records[1]);
+    encode((uint32_t)1000000, records[1]);
+    ENCODE_FINISH(records[1]);
+  }
+  for (unsigned i = 0; i < 64; ++i) {
+    records[2].append((char)(i * 97 + 13));
+  }
+
+  for (auto& bl : records) {
+    bstore->inject_onode_warmup_record(bl);
+    SetWarmup(false);
+    ASSERT_EQ(0, store->umount());
+    SetWarmup(true);
+    uint64_t loaded = counter(l_bluestore_onode_warmup_loaded);
+    uint64_t skipped = counter(l_bluestore_onode_warmup_skipped);
+    ASSERT_EQ(0, store->mount());
+    bstore->wait_for_onode_warmup();
+    // the record is ignored, the store mounts just the same
+    ASSERT_EQ(loaded, counter(l_bluestore_onode_warmup_loaded));
+    ASSERT_EQ(skipped, counter(l_bluestore_onode_warmup_skipped));
+    ch = store->open_collection(cid);
+    for (int i = 0; i < n; ++i) {
+      bufferlist r;
+      ASSERT_EQ(0x1000, store->read(ch, make_oid(i), 0, 0x1000, r));
+    }
+    ch.reset();
+  }
+}
+
+TEST_P(StoreTestOnodeWarmup, CollectionChanged) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  StartWarmup();
+
+  const int n = 8;
+  coll_t removed(spg_t(pg_t(1, 1), shard_id_t::NO_SHARD));
+  coll_t recreated(spg_t(pg_t(2, 1), shard_id_t::NO_SHARD));
+  {
+    auto ch = store->create_new_collection(removed);
+    WriteObjects(ch, removed, n, 0x1000, true);
+  }
+  {
+    auto ch = store->create_new_collection(recreated);
+    WriteObjects(ch, recreated, n, 0x1000, true);
+  }
+  // record both collections, then change them behind the record's back
+  ASSERT_EQ(0, store->umount());
+  SetWarmup(false);
+  ASSERT_EQ(0, store->mount());
+  for (auto& cid : { removed, recreated }) {
+    auto ch = store->open_collection(cid);
+    ObjectStore::Transaction t;
+    for (int i = 0; i < n; ++i) {
+      t.remove(cid, make_oid(i));
+    }
+    t.remove_collection(cid);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  {
+    auto ch = store->create_new_collection(recreated);
+    WriteObjects(ch, recreated, 1, 0x1000, true);
+  }
+  ASSERT_EQ(0, store->umount());
+  SetWarmup(true);
+
+  // only the one object left from the record is loaded
+  uint64_t loaded = counter(l_bluestore_onode_warmup_loaded);
+  uint64_t skipped = counter(l_bluestore_onode_warmup_skipped);
+  ASSERT_EQ(0, store->mount());
+  bstore->wait_for_onode_warmup();
+  ASSERT_EQ(loaded + 1, counter(l_bluestore_onode_warmup_loaded));
+  ASSERT_EQ(skipped + 2 * n - 1, counter(l_bluestore_onode_warmup_skipped));
+
+  auto ch = store->open_collection(recreated);
+  bufferlist bl;
+  ASSERT_EQ(0x1000, store->read(ch, make_oid(0), 0, 0x1000, bl));
+}
+
+INSTANTIATE_TEST_CASE_P(
+  ObjectStore,
+  StoreTestOnodeWarmup,
+  ::testing::Values(
+    "bluestore"));
+
 TEST_P(StoreTest, SpuriousReadErrorTest) {
   if (string(GetParam()) != "bluestore")
     return;
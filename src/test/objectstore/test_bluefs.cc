@@ -568,6 +568,155 @@ TEST(BlueFS, test_replay) {
   rm_temp_bdev(fn);
 }
 
+void append_and_fsync(BlueFS &fs, const string& dir, int n, unsigned ops)
+{
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write(dir, "wal." + to_string(n), &h, false));
+    ASSERT_NE(nullptr, h);
+    auto sg = make_scope_guard([&fs, h] { fs.close_writer(h); });
+    std::unique_ptr<char[]> buf = gen_buffer(ALLOC_SIZE);
+    for (unsigned i = 0; i < ops; ++i) {
+      h->append(buf.get(), ALLOC_SIZE);
+      ASSERT_EQ(0, fs.fsync(h));
+    }
+}
+
+// not a pass/fail test: reports append+fsync throughput as the number
+// of concurrent writers grows, WAL style (one file per writer).
+TEST(BlueFS, test_fsync_scaling) {
+  uint64_t size = 1048576 * 512;
+  string fn = get_temp_bdev(size);
+  g_ceph_context->_conf.set_val(
+    "bluefs_alloc_size",
+    "65536");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+  const unsigned ops_per_thread = 512;
+  for (int num_threads : {1, 2, 4, 8}) {
+    string dir = "scaling." + to_string(num_threads);
+    ASSERT_EQ(0, fs.mkdir(dir));
+    std::vector<std::thread> threads;
+    utime_t start = ceph_clock_now();
+    for (int i = 0; i < num_threads; i++) {
+      threads.push_back(std::thread(append_and_fsync, std::ref(fs),
+				    std::cref(dir), i, ops_per_thread));
+    }
+    join_all(threads);
+    utime_t elapsed = ceph_clock_now() - start;
+    uint64_t ops = num_threads * ops_per_thread;
+    std::cout << "writers " << num_threads
+	      << " fsyncs " << ops
+	      << " elapsed " << elapsed
+	      << " fsyncs/sec " << (double)ops / (double)elapsed
+	      << " MB/sec " << (double)(ops * ALLOC_SIZE) / (double)elapsed / 1048576
+	      << std::endl;
+  }
+  fs.umount();
+  rm_temp_bdev(fn);
+}
+
+// the byte at offset @pos of the file written by writer @n
+char fsync_replay_byte(int n, uint64_t pos)
+{
+  return (char)(n * 131 + pos * 7 + pos / 4093);
+}
+
+void append_and_fsync_pattern(BlueFS &fs, const string& dir, int n,
+			      unsigned ops, uint64_t *written)
+{
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write(dir, "wal." + to_string(n), &h, false));
+    ASSERT_NE(nullptr, h);
+    auto sg = make_scope_guard([&fs, h] { fs.close_writer(h); });
+    uint64_t pos = 0;
+    for (unsigned i = 0; i < ops; ++i) {
+      // odd sizes, so that appends keep straddling block boundaries
+      unsigned len = 1000 + (i * 977 + n * 331) % 7000;
+      std::string data;
+      for (unsigned j = 0; j < len; ++j) {
+	data.push_back(fsync_replay_byte(n, pos + j));
+      }
+      h->append(data.data(), data.size());
+      pos += len;
+      ASSERT_EQ(0, fs.fsync(h));
+    }
+    *written = pos;
+}
+
+TEST(BlueFS, test_concurrent_fsync_replay) {
+  uint64_t size = 1048576 * 256;
+  string fn = get_temp_bdev(size);
+  g_ceph_context->_conf.set_val(
+    "bluefs_alloc_size",
+    "65536");
+  g_ceph_context->_conf.set_val(
+    "bluefs_compact_log_sync",
+    "false");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+  const int num_threads = 8;
+  const unsigned ops_per_thread = 300;
+  const string dir = "dir";
+  std::vector<uint64_t> written(num_threads);
+  ASSERT_EQ(0, fs.mkdir(dir));
+  {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.push_back(std::thread(append_and_fsync_pattern, std::ref(fs),
+				    std::cref(dir), i, ops_per_thread,
+				    &written[i]));
+    }
+    // compact the log while the fsyncs are going on
+    std::atomic<bool> done{false};
+    std::thread compactor([&fs, &done] {
+	while (!done) {
+	  fs.compact_log();
+	  usleep(10000);
+	}
+      });
+    join_all(threads);
+    done = true;
+    compactor.join();
+  }
+  fs.umount();
+
+  // everything that was fsynced must survive the log replay
+  ASSERT_EQ(0, fs.mount());
+  for (int n = 0; n < num_threads; n++) {
+    string file = "wal." + to_string(n);
+    uint64_t file_size = 0;
+    utime_t mtime;
+    ASSERT_EQ(0, fs.stat(dir, file, &file_size, &mtime));
+    ASSERT_NE(0u, written[n]);
+    ASSERT_EQ(written[n], file_size);
+
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read(dir, file, &h));
+    bufferlist bl;
+    ASSERT_EQ((int)file_size, fs.read(h, &h->buf, 0, file_size, &bl, NULL));
+    delete h;
+    ASSERT_EQ(file_size, bl.length());
+    auto p = bl.cbegin();
+    for (uint64_t pos = 0; pos < file_size; ++pos, ++p) {
+      ASSERT_EQ(fsync_replay_byte(n, pos), *p) << file << " at " << pos;
+    }
+  }
+  fs.umount();
+  rm_temp_bdev(fn);
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -1179,6 +1179,47 @@ TEST(ExtentMap, compress_extent_map)
   ASSERT_EQ(6u, em.extent_map.size());
 }
 
+TEST(OnodeSpace, spread_over_shards)
+{
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::LRUCache c0(g_ceph_context), c1(g_ceph_context),
+    c2(g_ceph_context), c3(g_ceph_context);
+  vector<BlueStore::Cache*> caches = { &c0, &c1, &c2, &c3 };
+  BlueStore::CollectionRef coll(
+    new BlueStore::Collection(&store, caches, coll_t()));
+
+  // objects in one pg share the low hash bits; only the high bits differ
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t(object_t("obj" + stringify(i)), "",
+				CEPH_NOSNAP, (i << 26) | 0x7, 1, ""));
+  };
+  for (unsigned i = 0; i < 64; ++i) {
+    ghobject_t oid = make_oid(i);
+    BlueStore::OnodeRef o(new BlueStore::Onode(coll.get(), oid, ""));
+    ASSERT_EQ(o, coll->onode_map.add(oid, o));
+  }
+  for (auto c : caches) {
+    ASSERT_EQ(16u, c->_get_num_onodes());
+  }
+
+  // rename across slots leaves a placeholder behind and moves the onode
+  // to the new slot's shard
+  BlueStore::OnodeRef oldo;
+  ghobject_t from = make_oid(0);
+  ghobject_t to = make_oid(32);
+  to.hobj.oid.name = "renamed";
+  coll->onode_map.rename(oldo, from, to, "renamed");
+  ASSERT_TRUE(oldo);
+  ASSERT_EQ(16u, c0._get_num_onodes());
+  ASSERT_EQ(17u, c1._get_num_onodes());
+
+  coll->onode_map.clear();
+  ASSERT_TRUE(coll->onode_map.empty());
+  for (auto c : caches) {
+    ASSERT_EQ(0u, c->_get_num_onodes());
+  }
+}
+
 TEST(GarbageCollector, BasicTest)
 {
   BlueStore::LRUCache cache(g_ceph_context);
@@ -417,6 +417,100 @@ TEST_P(KVTest, RocksDBIteratorTest) {
   fini();
 }
 
+TEST_P(KVTest, RocksDBShardedCF) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  ASSERT_EQ(0, KeyValueDB::parse_column_families("cf1(4) cf2", &cfs, &cerr));
+  ASSERT_EQ(2u, cfs.size());
+  ASSERT_EQ(4u, cfs[0].shard_cnt);
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  cout << "creating a prefix sharded over four column families" << std::endl;
+  ASSERT_EQ(0, db->create_and_open(cout, cfs));
+  const int num = 100;
+  auto make_key = [](int i) {
+    char k[16];
+    snprintf(k, sizeof(k), "key%03d", i);
+    return string(k);
+  };
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (int i = 0; i < num; ++i) {
+      bufferlist bl;
+      bl.append(make_key(i));
+      t->set("cf1", make_key(i), bl);
+      t->set("prefix", make_key(i), bl);
+    }
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  auto verify = [&](const string& prefix) {
+    KeyValueDB::Iterator iter = db->get_iterator(prefix);
+    iter->seek_to_first();
+    for (int i = 0; i < num; ++i) {
+      ASSERT_EQ(1, iter->valid());
+      ASSERT_EQ(make_key(i), iter->key());
+      ASSERT_EQ(make_key(i), _bl_to_str(iter->value()));
+      iter->next();
+    }
+    ASSERT_EQ(0, iter->valid());
+    iter->seek_to_last();
+    for (int i = num - 1; i >= 0; --i) {
+      ASSERT_EQ(1, iter->valid());
+      ASSERT_EQ(make_key(i), iter->key());
+      iter->prev();
+    }
+    ASSERT_EQ(0, iter->valid());
+    // change direction in the middle
+    iter->lower_bound(make_key(50));
+    ASSERT_EQ(make_key(50), iter->key());
+    iter->prev();
+    ASSERT_EQ(make_key(49), iter->key());
+    iter->next();
+    ASSERT_EQ(make_key(50), iter->key());
+    iter->upper_bound(make_key(50));
+    ASSERT_EQ(make_key(51), iter->key());
+    for (int i = 0; i < num; ++i) {
+      bufferlist bl;
+      ASSERT_EQ(0, db->get(prefix, make_key(i), &bl));
+      ASSERT_EQ(make_key(i), _bl_to_str(bl));
+    }
+  };
+  verify("cf1");
+  verify("prefix");
+  fini();
+
+  init();
+  cout << "reopen with a different configured layout" << std::endl;
+  std::vector<KeyValueDB::ColumnFamily> other;
+  other.push_back(KeyValueDB::ColumnFamily("cf1", ""));
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->open(cout, other));
+  verify("cf1");
+  verify("prefix");
+  cout << "reshard" << std::endl;
+  ASSERT_EQ(-EINVAL, db->reshard("cf1(0)", cout));
+  ASSERT_EQ(0, db->reshard("cf1(2,0-6) prefix(3)", cout));
+  verify("cf1");
+  verify("prefix");
+  fini();
+
+  init();
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->open(cout, other));
+  verify("cf1");
+  verify("prefix");
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->rmkeys_by_prefix("prefix");
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+    KeyValueDB::Iterator iter = db->get_iterator("prefix");
+    iter->seek_to_first();
+    ASSERT_EQ(0, iter->valid());
+  }
+  fini();
+}
+
 TEST_P(KVTest, RocksDBCFMerge) {
   if(string(GetParam()) != "rocksdb")
     return;
@@ -175,6 +175,36 @@ TEST(Transaction, GetNumBytes)
   ASSERT_TRUE(a.get_encoded_bytes() == a.get_encoded_bytes_test());
 }
 
+TEST(Transaction, DataAlignment)
+{
+  ObjectStore::Transaction t;
+  coll_t cid;
+  ghobject_t oid(hobject_t(object_t("obj"), "", CEPH_NOSNAP, 0, 0, ""));
+  ASSERT_EQ(0, t.get_data_alignment());
+
+  const uint64_t off = 3 * CEPH_PAGE_SIZE + 512;
+  bufferlist small, big;
+  small.append(string(100, 'a'));
+  big.append(string(2 * CEPH_PAGE_SIZE, 'b'));
+  t.touch(cid, oid);
+  t.write(cid, oid, 0, small.length(), small);
+  t.write(cid, oid, off, big.length(), big);
+
+  bufferlist bl;
+  encode(t, bl);
+  unsigned data_off = t.get_data_offset();
+  ASSERT_LE(data_off + big.length(), bl.length());
+  bufferlist data;
+  data.substr_of(bl, data_off, big.length());
+  ASSERT_TRUE(data.contents_equal(big));
+
+  // received at this page offset, the big write lands on the same page
+  // offset as its destination in the object
+  unsigned align = t.get_data_alignment();
+  ASSERT_LT(align, CEPH_PAGE_SIZE);
+  ASSERT_EQ(off & ~CEPH_PAGE_MASK, (align + data_off) & ~CEPH_PAGE_MASK);
+}
+
 void bench_num_bytes(bool legacy)
 {
   const int max = 2500000;
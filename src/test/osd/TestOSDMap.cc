@@ -1100,3 +1100,324 @@ TEST(PGTempMap, basic)
   ASSERT_EQ(998u, m.size());
 }
 
+
+TEST_F(OSDMapTest, SharedSections) {
+  set_up_map();
+  bufferlist before;
+  osdmap.encode(before, CEPH_FEATURES_SUPPORTED_DEFAULT);
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  inc.new_state[0] = CEPH_OSD_UP;
+  inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>({1, 2, 3});
+
+  OSDMap shared;
+  shared.shared_copy_from(osdmap);
+  ASSERT_EQ(0, shared.apply_incremental(inc));
+
+  // what the incremental left alone is still shared...
+  ASSERT_EQ(osdmap.crush, shared.crush);
+  ASSERT_EQ(&osdmap.get_uuid(1), &shared.get_uuid(1));
+  ASSERT_EQ(&osdmap.get_addrs(1), &shared.get_addrs(1));
+  // ...and the previous epoch did not see the change
+  ASSERT_TRUE(osdmap.is_up(0));
+  ASSERT_FALSE(shared.is_up(0));
+  ASSERT_EQ(0u, osdmap.get_num_pg_temp());
+  ASSERT_EQ(1u, shared.get_num_pg_temp());
+  bufferlist after;
+  osdmap.encode(after, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  ASSERT_TRUE(before.contents_equal(after));
+
+  // the same as decoding the previous epoch and applying to that
+  OSDMap decoded;
+  decoded.decode(before);
+  ASSERT_EQ(0, decoded.apply_incremental(inc));
+  bufferlist sbl, dbl;
+  shared.encode(sbl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  decoded.encode(dbl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  ASSERT_TRUE(sbl.contents_equal(dbl));
+
+  // a section is copied before it is changed
+  uuid_d u;
+  u.generate_random();
+  OSDMap::Incremental inc2(shared.get_epoch() + 1);
+  inc2.fsid = shared.get_fsid();
+  inc2.new_uuid[1] = u;
+  OSDMap next;
+  next.shared_copy_from(shared);
+  ASSERT_EQ(0, next.apply_incremental(inc2));
+  ASSERT_NE(&shared.get_uuid(1), &next.get_uuid(1));
+  ASSERT_EQ(u, next.get_uuid(1));
+  ASSERT_EQ(osdmap.get_uuid(1), shared.get_uuid(1));
+
+  // decoding over a shared copy leaves the original alone
+  next.decode(before);
+  ASSERT_FALSE(shared.is_up(0));
+  ASSERT_EQ(1u, shared.get_num_pg_temp());
+}
+
+TEST_F(OSDMapTest, DedupUnsharesAddrs) {
+  set_up_map();
+  bufferlist bl;
+  osdmap.encode(bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+
+  // next shares its addrs with osdmap, which has been published already
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  inc.new_state[0] = CEPH_OSD_UP;
+  OSDMap next;
+  next.shared_copy_from(osdmap);
+  ASSERT_EQ(0, next.apply_incremental(inc));
+  ASSERT_EQ(&osdmap.get_addrs(1), &next.get_addrs(1));
+
+  // dedup next against a map it was not copied from
+  OSDMap other;
+  other.decode(bl);
+  ASSERT_NE(&osdmap.get_addrs(1), &other.get_addrs(1));
+  const entity_addrvec_t *published = &osdmap.get_addrs(1);
+  OSDMap::dedup(&other, &next);
+  ASSERT_EQ(published, &osdmap.get_addrs(1));
+  ASSERT_EQ(&other.get_addrs(1), &next.get_addrs(1));
+  ASSERT_EQ(osdmap.get_addrs(1), next.get_addrs(1));
+}
+
+TEST_F(OSDMapTest, IncrementalMapping) {
+  set_up_map();
+  mapping.update(osdmap);
+
+  // apply inc to the map and the mapping and check the mapping against
+  // one computed from scratch
+  auto apply = [&](OSDMap::Incremental& inc, bool partial) {
+    inc.fsid = osdmap.get_fsid();
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+    ASSERT_EQ(partial, mapping.update(osdmap, inc));
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+    OSDMapMapping full;
+    full.update(osdmap);
+    ASSERT_EQ(full.get_num_pgs(), mapping.get_num_pgs());
+    for (auto& p : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	full.get(pgid, &up, &up_primary, &acting, &acting_primary);
+	mapping.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+    for (unsigned osd = 0; osd < get_num_osds(); ++osd) {
+      ASSERT_EQ(full.get_osd_acting_pgs(osd), mapping.get_osd_acting_pgs(osd));
+    }
+  };
+
+  pg_t rep_pg(3, my_rep_pool), ec_pg(5, my_ec_pool);
+  vector<int> up;
+  int primary;
+  osdmap.pg_to_raw_up(rep_pg, &up, &primary);
+  ASSERT_EQ(3u, up.size());
+  int spare = -1;
+  for (unsigned osd = 0; osd < get_num_osds(); ++osd) {
+    if (std::find(up.begin(), up.end(), (int)osd) == up.end()) {
+      spare = osd;
+    }
+  }
+
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[rep_pg] = mempool::osdmap::vector<int>({up[2], up[1]});
+    apply(inc, true);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    vector<int> acting;
+    osdmap.pg_to_acting_osds(ec_pg, acting);
+    inc.new_primary_temp[ec_pg] = acting[1];
+    apply(inc, true);
+  }
+  {
+    // down, and back up
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[up[1]] = CEPH_OSD_UP;
+    apply(inc, true);
+    ASSERT_TRUE(osdmap.is_down(up[1]));
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    entity_addrvec_t a;
+    a.v.push_back(entity_addr_t());
+    inc2.new_up_client[up[1]] = a;
+    inc2.new_up_cluster[up[1]] = a;
+    inc2.new_hb_back_up[up[1]] = a;
+    inc2.new_hb_front_up[up[1]] = a;
+    apply(inc2, true);
+    ASSERT_TRUE(osdmap.is_up(up[1]));
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_upmap_items[rep_pg] =
+      mempool::osdmap::vector<pair<int32_t,int32_t>>({{up[0], spare}});
+    apply(inc, true);
+    // and the upmap target going down
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_state[spare] = CEPH_OSD_UP;
+    apply(inc2, true);
+  }
+  {
+    // a pool change recomputes that pool
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    pg_pool_t *p = inc.get_new_pool(my_rep_pool,
+				    osdmap.get_pg_pool(my_rep_pool));
+    p->size = 2;
+    apply(inc, true);
+  }
+  {
+    // but an osd weight change is a full update
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[up[0]] = CEPH_OSD_OUT;
+    apply(inc, false);
+  }
+  {
+    // as is a mapping of any other epoch
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[rep_pg] = mempool::osdmap::vector<int>();
+    inc.fsid = osdmap.get_fsid();
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_pg_temp[ec_pg] = mempool::osdmap::vector<int>({0, 1, 2});
+    apply(inc2, false);
+  }
+}
+
+namespace {
+
+/// a large cluster and a storm of incrementals for it, the way an osd
+/// that was away for a while sees them
+struct MapStorm {
+  static constexpr int num_osds = 2000;
+  static constexpr int num_epochs = 200;
+  static constexpr int flap = 20;  ///< osds going down per epoch
+
+  OSDMap base;
+  vector<OSDMap::Incremental> incs;
+
+  MapStorm() {
+    uuid_d fsid;
+    fsid.generate_random();
+    base.build_simple_with_pool(g_ceph_context, 0, fsid, num_osds, 2, 2);
+    OSDMap::Incremental up(base.get_epoch() + 1);
+    up.fsid = base.get_fsid();
+    for (int i = 0; i < num_osds; ++i) {
+      mark_up(up, i);
+      up.new_state[i] = CEPH_OSD_EXISTS | CEPH_OSD_NEW;
+      up.new_weight[i] = CEPH_OSD_IN;
+      uuid_d u;
+      u.generate_random();
+      up.new_uuid[i] = u;
+    }
+    base.apply_incremental(up);
+
+    int64_t pool = base.get_pools().begin()->first;
+    unsigned pg_num = base.get_pg_num(pool);
+    epoch_t e = base.get_epoch();
+    set<int> down;
+    for (int i = 0; i < num_epochs; ++i) {
+      OSDMap::Incremental inc(++e);
+      inc.fsid = base.get_fsid();
+      if (i % 10 == 9) {
+	// the flapping osds come back
+	for (auto osd : down) {
+	  mark_up(inc, osd);
+	}
+	down.clear();
+      } else if (i % 2) {
+	for (int j = 0; j < flap; ++j) {
+	  int osd = (i * 97 + j * 31) % num_osds;
+	  if (down.insert(osd).second) {
+	    inc.new_state[osd] = CEPH_OSD_UP;
+	  }
+	}
+      } else {
+	for (int j = 0; j < 50; ++j) {
+	  pg_t pgid(((unsigned)i * 131 + j * 17) % pg_num, pool);
+	  inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>(
+	    {j % num_osds, (j + 1) % num_osds, (j + 2) % num_osds});
+	}
+      }
+      incs.push_back(inc);
+    }
+  }
+
+  static void mark_up(OSDMap::Incremental& inc, int osd) {
+    entity_addrvec_t a;
+    a.v.push_back(entity_addr_t());
+    a.v[0].nonce = osd;
+    inc.new_up_client[osd] = a;
+    inc.new_up_cluster[osd] = a;
+    inc.new_hb_back_up[osd] = a;
+    inc.new_hb_front_up[osd] = a;
+  }
+
+  struct result_t {
+    double seconds = 0;
+    size_t bytes = 0;
+    set<CrushWrapper*> crushes;
+    bufferlist last;
+  };
+
+  /**
+   * build every epoch the way OSD::handle_osd_map does, from the decoded
+   * previous full map or from a shared copy of it, and keep them all
+   * around like the map cache would
+   */
+  result_t run(bool share) {
+    result_t r;
+    size_t start = mempool::osdmap::allocated_bytes();
+    vector<std::shared_ptr<OSDMap>> maps;
+    bufferlist prev_bl;
+    base.encode(prev_bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    auto prev = std::make_shared<OSDMap>();
+    prev->decode(prev_bl);
+    maps.push_back(prev);
+    utime_t t0 = ceph_clock_now();
+    for (auto& inc : incs) {
+      auto o = std::make_shared<OSDMap>();
+      if (share) {
+	o->shared_copy_from(*prev);
+      } else {
+	o->decode(prev_bl);
+      }
+      ceph_assert(o->apply_incremental(inc) == 0);
+      prev_bl.clear();
+      o->encode(prev_bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+      OSDMap::dedup(prev.get(), o.get());
+      maps.push_back(o);
+      prev = o;
+    }
+    r.seconds = ceph_clock_now() - t0;
+    r.bytes = mempool::osdmap::allocated_bytes() - start;
+    for (auto& m : maps) {
+      r.crushes.insert(m->crush.get());
+    }
+    r.last = prev_bl;
+    return r;
+  }
+};
+
+} // anonymous namespace
+
+TEST(OSDMapStorm, SharedVsDecoded)
+{
+  MapStorm storm;
+  auto decoded = storm.run(false);
+  auto shared = storm.run(true);
+  std::cout << MapStorm::num_epochs << " epochs of " << MapStorm::num_osds
+	    << " osds: decode+apply " << decoded.seconds << "s "
+	    << decoded.bytes << " bytes, share+apply " << shared.seconds
+	    << "s " << shared.bytes << " bytes" << std::endl;
+  ASSERT_TRUE(decoded.last.contents_equal(shared.last));
+  // no epoch changed crush, so all of them use the one we started with
+  ASSERT_EQ(1u, shared.crushes.size());
+  ASSERT_LT(shared.bytes, decoded.bytes);
+}
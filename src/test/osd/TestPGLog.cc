@@ -2451,9 +2451,10 @@ public:
   }
 
   void check_index() {
-    EXPECT_EQ(log.dups.size(), log.dup_index.size());
+    EXPECT_EQ(log.dups.size(),
+	      log.reqid_index.size(pglog_reqid_index_t::DUP));
     for (auto& i : log.dups) {
-      EXPECT_EQ(1u, log.dup_index.count(i.reqid));
+      EXPECT_TRUE(log.reqid_index.find_dup(i.reqid));
     }
   }
 
@@ -2835,7 +2836,7 @@ TEST_F(PGLogTrimTest, TestTrimAll)
 {
   SetUp(1, 2, 20);
   PGLog::IndexedLog log;
-  EXPECT_EQ(0u, log.dup_index.size()); // Sanity check
+  EXPECT_EQ(0u, log.reqid_index.size(pglog_reqid_index_t::DUP)); // Sanity check
   log.head = mk_evt(24, 0);
   log.skip_can_rollback_to_to_head();
   log.head = mk_evt(9, 0);
@@ -2858,7 +2859,8 @@ TEST_F(PGLogTrimTest, TestTrimAll)
   EXPECT_EQ(6u, trimmed.size());
   EXPECT_EQ(5u, log.dups.size());
   EXPECT_EQ(0u, trimmed_dups.size());
-  EXPECT_EQ(0u, log.dup_index.size()); // dup_index entry should be trimmed
+  // dup index entry should be trimmed
+  EXPECT_EQ(0u, log.reqid_index.size(pglog_reqid_index_t::DUP));
 }
 
 
@@ -2986,6 +2988,236 @@ TEST(pg_log_dup_t, get_key_name) {
   EXPECT_EQ("dup_0000001234.00000000000000005678", a_key_name);
 }
 
+TEST(pglog_reqid_index_t, basic) {
+  pglog_reqid_index_t idx;
+  osd_reqid_t a(entity_name_t::CLIENT(777), 8, 1);
+  osd_reqid_t b(entity_name_t::CLIENT(777), 8, 2);
+  EXPECT_FALSE(idx.find_entry(a));
+  EXPECT_EQ(0u, idx.capacity());
+
+  pg_log_entry_t e1, e2;
+  e1.reqid = a;
+  e2.reqid = a;
+  e2.extra_reqids.push_back(make_pair(b, 5));
+  pg_log_dup_t d(eversion_t(1, 1), 1, a, 0);
+
+  idx.set_entry(e1);
+  idx.set_dup(d);
+  idx.insert_extra(b, e2);
+  EXPECT_EQ(&e1, idx.find_entry(a));
+  EXPECT_EQ(&d, idx.find_dup(a));
+  EXPECT_EQ(&e2, idx.find_extra(b));
+  EXPECT_FALSE(idx.find_extra(a));
+  EXPECT_FALSE(idx.find_dup(b));
+
+  // the latest entry for a reqid wins; erasing the older one is a no-op
+  idx.set_entry(e2);
+  EXPECT_EQ(1u, idx.size(pglog_reqid_index_t::ENTRY));
+  EXPECT_EQ(&e2, idx.find_entry(a));
+  idx.erase_entry(e1);
+  EXPECT_EQ(&e2, idx.find_entry(a));
+  idx.erase_entry(e2);
+  EXPECT_FALSE(idx.find_entry(a));
+  EXPECT_EQ(&d, idx.find_dup(a));
+
+  idx.clear(pglog_reqid_index_t::mask_of(pglog_reqid_index_t::DUP));
+  EXPECT_FALSE(idx.find_dup(a));
+  EXPECT_EQ(&e2, idx.find_extra(b));
+  idx.erase_extra(b, e2);
+  EXPECT_EQ(0u, idx.size());
+}
+
+TEST(pglog_reqid_index_t, churn) {
+  // a log that keeps being appended to and trimmed, like a busy pg's
+  constexpr unsigned n = 3000;
+  mempool::osd_pglog::list<pg_log_entry_t> log;
+  mempool::osd_pglog::list<pg_log_dup_t> dups;
+  pglog_reqid_index_t idx;
+  for (unsigned i = 0; i < 10 * n; ++i) {
+    pg_log_entry_t e;
+    e.reqid = osd_reqid_t(entity_name_t::CLIENT(i % 7), 0, i);
+    e.version = eversion_t(1, i + 1);
+    if (i % 5 == 0) {
+      e.extra_reqids.push_back(
+	make_pair(osd_reqid_t(entity_name_t::CLIENT(100), 0, i), i));
+    }
+    log.push_back(e);
+    idx.set_entry(log.back());
+    for (auto &j : log.back().extra_reqids) {
+      idx.insert_extra(j.first, log.back());
+    }
+    if (log.size() > n) {
+      auto &old = log.front();
+      idx.erase_entry(old);
+      for (auto &j : old.extra_reqids) {
+	idx.erase_extra(j.first, old);
+      }
+      dups.push_back(pg_log_dup_t(old));
+      idx.set_dup(dups.back());
+      log.pop_front();
+    }
+    if (dups.size() > n) {
+      idx.erase_dup(dups.front());
+      dups.pop_front();
+    }
+  }
+  EXPECT_EQ(n, idx.size(pglog_reqid_index_t::ENTRY));
+  EXPECT_EQ(n, idx.size(pglog_reqid_index_t::DUP));
+  for (auto &e : log) {
+    ASSERT_EQ(&e, idx.find_entry(e.reqid));
+    for (auto &j : e.extra_reqids) {
+      ASSERT_EQ(&e, idx.find_extra(j.first));
+    }
+  }
+  for (auto &d : dups) {
+    ASSERT_EQ(&d, idx.find_dup(d.reqid));
+    ASSERT_FALSE(idx.find_entry(d.reqid));
+  }
+  EXPECT_FALSE(idx.find_entry(osd_reqid_t(entity_name_t::CLIENT(1), 0, 0)));
+  EXPECT_LE(idx.size() * 4, idx.capacity() * 3);
+}
+
+TEST(pglog_reqid_index_t, mempool) {
+  // the index is accounted to the osd_pglog pool, at 16 bytes a slot
+  constexpr unsigned n = 3000;
+  PGLog::IndexedLog log;
+  for (unsigned i = 0; i < n; ++i) {
+    pg_log_entry_t e;
+    e.op = pg_log_entry_t::MODIFY;
+    e.soid = PGLogTestBase::mk_obj(i);
+    e.reqid = osd_reqid_t(entity_name_t::CLIENT(777), 8, i);
+    e.version = eversion_t(1, n + i + 1);
+    log.log.push_back(e);
+    log.dups.push_back(
+      pg_log_dup_t(eversion_t(1, i + 1), i,
+		   osd_reqid_t(entity_name_t::CLIENT(778), 8, i), 0));
+  }
+  log.head = eversion_t(1, 2 * n);
+  size_t before = mempool::osd_pglog::allocated_bytes();
+  log.index();
+  size_t used = mempool::osd_pglog::allocated_bytes() - before;
+  std::cout << "reqid index: " << log.reqid_index.size() << " records, "
+	    << used << " bytes, "
+	    << (double)used / log.reqid_index.size() << " bytes/record"
+	    << std::endl;
+  EXPECT_EQ(2 * n, log.reqid_index.size());
+  EXPECT_EQ(log.reqid_index.capacity() * 16, used);
+  // an unordered_map node alone (reqid, pointer, next, hash) is 64 bytes
+  EXPECT_LT(used, 2 * n * 48);
+  log.unindex();
+  EXPECT_EQ(before, mempool::osd_pglog::allocated_bytes());
+}
+
+TEST(pglog_ring_t, ends) {
+  pglog_ring_t<unsigned, 4> r;
+  std::deque<unsigned> ref;
+  std::vector<const unsigned*> addrs;
+  EXPECT_TRUE(r.empty());
+  // grow at both ends across several blocks and a resize of the ring
+  for (unsigned i = 0; i < 50; ++i) {
+    r.push_back(1000 + i);
+    ref.push_back(1000 + i);
+    r.push_front(1000 - i - 1);
+    ref.push_front(1000 - i - 1);
+  }
+  ASSERT_EQ(ref.size(), r.size());
+  ASSERT_TRUE(std::equal(ref.begin(), ref.end(), r.begin()));
+  ASSERT_TRUE(std::equal(ref.rbegin(), ref.rend(), r.rbegin()));
+  for (auto &i : r) {
+    addrs.push_back(&i);
+  }
+
+  // popping and pushing at the ends leaves the others where they are
+  for (unsigned i = 0; i < 30; ++i) {
+    r.pop_front();
+    ref.pop_front();
+    r.pop_back();
+    ref.pop_back();
+  }
+  for (unsigned i = 0; i < 20; ++i) {
+    r.push_back(i);
+    ref.push_back(i);
+  }
+  for (unsigned i = 0; i < 40; ++i) {
+    ASSERT_EQ(addrs[30 + i], &r[i]);
+  }
+  ASSERT_TRUE(std::equal(ref.begin(), ref.end(), r.begin()));
+
+  auto copy = r;
+  EXPECT_EQ(r, copy);
+  copy.pop_back();
+  EXPECT_NE(r, copy);
+  auto moved = std::move(copy);
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(r.size() - 1, moved.size());
+
+  while (!r.empty()) {
+    ASSERT_EQ(ref.front(), r.front());
+    r.pop_front();
+    ref.pop_front();
+  }
+  r.push_front(7);
+  EXPECT_EQ(7u, r.back());
+}
+
+TEST(pglog_ring_t, encode) {
+  pglog_ring_t<pg_log_dup_t> r;
+  mempool::osd_pglog::list<pg_log_dup_t> l;
+  for (unsigned i = 0; i < 200; ++i) {
+    pg_log_dup_t d(eversion_t(1, i + 1), i,
+		   osd_reqid_t(entity_name_t::CLIENT(777), 8, i), -(int)i);
+    r.push_back(d);
+    l.push_back(d);
+  }
+  // same bytes as the list the dups used to be kept in
+  bufferlist rbl, lbl;
+  encode(r, rbl);
+  encode(l, lbl);
+  ASSERT_TRUE(rbl.contents_equal(lbl));
+
+  pglog_ring_t<pg_log_dup_t> out;
+  out.push_back(pg_log_dup_t());
+  auto p = rbl.cbegin();
+  decode(out, p);
+  EXPECT_EQ(r, out);
+}
+
+TEST(pglog_ring_t, mempool) {
+  // the dups are accounted to the osd_pglog pool, without a list node
+  // apiece
+  constexpr unsigned n = 3000;
+  size_t before = mempool::osd_pglog::allocated_bytes();
+  size_t used_list, used_ring;
+  {
+    mempool::osd_pglog::list<pg_log_dup_t> l;
+    for (unsigned i = 0; i < n; ++i) {
+      l.push_back(pg_log_dup_t());
+    }
+    used_list = mempool::osd_pglog::allocated_bytes() - before;
+  }
+  {
+    pglog_ring_t<pg_log_dup_t> r;
+    for (unsigned i = 0; i < n; ++i) {
+      r.push_back(pg_log_dup_t());
+    }
+    used_ring = mempool::osd_pglog::allocated_bytes() - before;
+    EXPECT_EQ(r.allocated_bytes(), used_ring);
+    // trimming from the front hands whole blocks back
+    for (unsigned i = 0; i < n - 1; ++i) {
+      r.pop_front();
+    }
+    EXPECT_EQ(r.allocated_bytes(),
+	      mempool::osd_pglog::allocated_bytes() - before);
+    EXPECT_LT(r.allocated_bytes() * 10, used_ring);
+  }
+  std::cout << n << " dups: list " << used_list << " bytes, ring "
+	    << used_ring << " bytes" << std::endl;
+  EXPECT_LE(used_ring, n * sizeof(pg_log_dup_t) +
+	    64 * sizeof(pg_log_dup_t) + 64 * sizeof(void*));
+  EXPECT_LT(used_ring, used_list);
+  EXPECT_EQ(before, mempool::osd_pglog::allocated_bytes());
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
@@ -0,0 +1,205 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "osd/RecoveryThrottle.h"
+
+namespace {
+
+/*
+ * A toy OSD: client ops see a base latency that grows with the recovery
+ * load, recovery load being the number of recovery ops in flight scaled
+ * down by the time they spend sleeping.  Latencies are log-normal around
+ * that mean.
+ */
+struct SimOSD {
+  std::mt19937 rng{42};
+  double base = 0.005;     ///< client op latency without recovery, seconds
+  double per_op = 0.5;     ///< latency growth per unit of recovery load
+  double svc = 0.02;       ///< time a recovery op keeps the device busy
+  double sigma = 0.4;      ///< log-normal spread of client latencies
+  unsigned client_ops = 500; ///< client ops per tick
+
+  double recovery_load(const RecoveryThrottle& t) const {
+    return t.get_max_active() * svc / (svc + t.get_sleep());
+  }
+
+  /// feed one tick of client ops; returns their true p99
+  double tick(RecoveryThrottle& t) {
+    std::normal_distribution<double> n(0, sigma);
+    double mean = base * (1 + per_op * recovery_load(t));
+    std::vector<double> lat(client_ops);
+    for (auto& l : lat) {
+      l = mean * std::exp(n(rng));
+      t.add_client_op(l);
+    }
+    if (lat.empty()) {
+      return 0;
+    }
+    std::sort(lat.begin(), lat.end());
+    return lat[std::min<size_t>(lat.size() - 1, lat.size() * 0.99)];
+  }
+};
+
+RecoveryThrottle::limits_t test_limits()
+{
+  RecoveryThrottle::limits_t l;
+  l.target_p99 = 0.05;
+  l.max_active = 16;
+  l.max_sleep = 0.5;
+  l.max_backfills = 4;
+  return l;
+}
+
+} // anonymous namespace
+
+TEST(RecoveryThrottle, Buckets)
+{
+  EXPECT_EQ(0u, RecoveryThrottle::bucket_of(0));
+  EXPECT_EQ(0u, RecoveryThrottle::bucket_of(-1));
+  EXPECT_EQ(RecoveryThrottle::NUM_BUCKETS - 1,
+	    RecoveryThrottle::bucket_of(1e9));
+  unsigned last = 0;
+  for (double l = 1e-6; l < 100; l *= 1.1) {
+    unsigned b = RecoveryThrottle::bucket_of(l);
+    EXPECT_GE(b, last);
+    EXPECT_LE(l, RecoveryThrottle::bucket_upper(b) * 1.0001);
+    // buckets are a quarter power of two wide
+    EXPECT_LE(RecoveryThrottle::bucket_upper(b), l * 1.19);
+    last = b;
+  }
+}
+
+TEST(RecoveryThrottle, Percentile)
+{
+  RecoveryThrottle t(test_limits());
+  for (int i = 0; i < 990; ++i) {
+    t.add_client_op(0.001);
+  }
+  for (int i = 0; i < 10; ++i) {
+    t.add_client_op(1.0);
+  }
+  t.update(0);
+  EXPECT_EQ(1000u, t.get_last_samples());
+  EXPECT_GE(t.get_last_p99(), 0.001);
+  EXPECT_LT(t.get_last_p99(), 0.0012);
+
+  // the histogram starts over each interval
+  t.update(0);
+  EXPECT_EQ(0u, t.get_last_samples());
+  EXPECT_EQ(0, t.get_last_p99());
+}
+
+TEST(RecoveryThrottle, IdleRampsUp)
+{
+  auto l = test_limits();
+  RecoveryThrottle t(l);
+  EXPECT_EQ(1u, t.get_max_active());
+  for (int i = 0; i < 100; ++i) {
+    t.update(0);
+  }
+  EXPECT_EQ(l.max_active, t.get_max_active());
+  EXPECT_EQ(0, t.get_sleep());
+  EXPECT_EQ(l.max_backfills, t.get_max_backfills());
+}
+
+TEST(RecoveryThrottle, BusyStoreBacksOff)
+{
+  auto l = test_limits();
+  RecoveryThrottle t(l);
+  for (int i = 0; i < 100; ++i) {
+    t.update(0);
+  }
+  ASSERT_EQ(l.max_active, t.get_max_active());
+  // halving: down to a single op within log2(max_active) intervals
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(t.update(0.95));
+  }
+  EXPECT_EQ(1u, t.get_max_active());
+  EXPECT_EQ(1u, t.get_max_backfills());
+  for (int i = 0; i < 20; ++i) {
+    t.update(0.95);
+  }
+  EXPECT_EQ(l.max_sleep, t.get_sleep());
+  EXPECT_FALSE(t.update(0.95));
+  // and recovers once the store drains
+  for (int i = 0; i < 100; ++i) {
+    t.update(0);
+  }
+  EXPECT_EQ(0, t.get_sleep());
+  EXPECT_EQ(l.max_active, t.get_max_active());
+}
+
+TEST(RecoveryThrottle, SimHoldsTarget)
+{
+  auto l = test_limits();
+  RecoveryThrottle t(l);
+  SimOSD sim;
+  // with no recovery the client p99 is ~13ms; each recovery op in flight
+  // adds about half of the base latency, so the target of 50ms leaves
+  // room for a handful of them
+  unsigned over = 0, ticks = 0;
+  double active_sum = 0;
+  for (int i = 0; i < 400; ++i) {
+    double p99 = sim.tick(t);
+    t.update(0);
+    if (i >= 100) {
+      ++ticks;
+      active_sum += sim.recovery_load(t);
+      if (p99 > l.target_p99 * 1.25) {
+	++over;
+      }
+    }
+  }
+  double avg_load = active_sum / ticks;
+  std::cout << "avg recovery load " << avg_load << ", " << over << "/"
+	    << ticks << " ticks over target" << std::endl;
+  // recovery makes real progress...
+  EXPECT_GT(avg_load, 1.5);
+  // ...without pushing clients past the target for long
+  EXPECT_LT(over, ticks / 5);
+}
+
+TEST(RecoveryThrottle, SimReactsToLoadChange)
+{
+  auto l = test_limits();
+  RecoveryThrottle t(l);
+  SimOSD sim;
+  for (int i = 0; i < 200; ++i) {
+    sim.tick(t);
+    t.update(0);
+  }
+  double before = sim.recovery_load(t);
+  // the client workload gets heavier: much less room for recovery
+  sim.base = 0.015;
+  for (int i = 0; i < 20; ++i) {
+    sim.tick(t);
+    t.update(0);
+  }
+  double after = sim.recovery_load(t);
+  std::cout << "recovery load " << before << " -> " << after << std::endl;
+  EXPECT_LT(after, before);
+  unsigned over = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (sim.tick(t) > l.target_p99 * 1.25) {
+      ++over;
+    }
+    t.update(0);
+  }
+  EXPECT_LT(over, 20u);
+
+  // and takes the room back when the clients go away
+  sim.client_ops = 0;
+  for (int i = 0; i < 100; ++i) {
+    sim.tick(t);
+    t.update(0);
+  }
+  EXPECT_EQ(l.max_active, t.get_max_active());
+  EXPECT_EQ(0, t.get_sleep());
+}
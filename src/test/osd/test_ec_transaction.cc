@@ -15,6 +15,7 @@
 #include <gtest/gtest.h>
 #include "osd/PGTransaction.h"
 #include "osd/ECTransaction.h"
+#include "erasure-code/ErasureCode.h"
 
 #include "test/unit.cc"
 
@@ -45,6 +46,12 @@ TEST(ectransaction, two_writes_separated)
       ECUtil::HashInfoRef ref(new ECUtil::HashInfo(1));
       return ref;
     },
+    [&](const hobject_t &i,
+	const PGTransaction::ObjectOperation &o,
+	uint64_t size,
+	ECTransaction::ParityDelta *pd) {
+      return false;
+    },
     &dpp);
   generic_derr << "to_read " << plan.to_read << dendl;
   generic_derr << "will_write " << plan.will_write << dendl;
@@ -74,6 +81,12 @@ TEST(ectransaction, two_writes_nearby)
       ECUtil::HashInfoRef ref(new ECUtil::HashInfo(1));
       return ref;
     },
+    [&](const hobject_t &i,
+	const PGTransaction::ObjectOperation &o,
+	uint64_t size,
+	ECTransaction::ParityDelta *pd) {
+      return false;
+    },
     &dpp);
   generic_derr << "to_read " << plan.to_read << dendl;
   generic_derr << "will_write " << plan.will_write << dendl;
@@ -115,6 +128,12 @@ TEST(ectransaction, many_writes)
       ECUtil::HashInfoRef ref(new ECUtil::HashInfo(1));
       return ref;
     },
+    [&](const hobject_t &i,
+	const PGTransaction::ObjectOperation &o,
+	uint64_t size,
+	ECTransaction::ParityDelta *pd) {
+      return false;
+    },
     &dpp);
   generic_derr << "to_read " << plan.to_read << dendl;
   generic_derr << "will_write " << plan.will_write << dendl;
@@ -122,3 +141,231 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+// k data chunks and a single xor parity chunk
+class ErasureCodeXor : public ErasureCode {
+  unsigned k;
+public:
+  explicit ErasureCodeXor(unsigned k) : k(k) {}
+
+  unsigned int get_chunk_count() const override {
+    return k + 1;
+  }
+  unsigned int get_data_chunk_count() const override {
+    return k;
+  }
+  unsigned int get_chunk_size(unsigned int object_size) const override {
+    return (object_size + k - 1) / k;
+  }
+  int encode_chunks(const set<int> &want_to_encode,
+		    map<int, bufferlist> *encoded) override {
+    char *parity = (*encoded)[k].c_str();
+    unsigned len = (*encoded)[k].length();
+    memset(parity, 0, len);
+    for (unsigned i = 0; i < k; ++i) {
+      const char *data = (*encoded)[i].c_str();
+      for (unsigned j = 0; j < len; ++j) {
+	parity[j] ^= data[j];
+      }
+    }
+    return 0;
+  }
+  uint64_t get_supported_optimizations() const override {
+    return FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION;
+  }
+  int apply_delta(const map<int, bufferptr> &in,
+		  map<int, bufferptr> &out) override {
+    for (auto &&d : in) {
+      for (auto &&c : out) {
+	for (unsigned j = 0; j < c.second.length(); ++j) {
+	  c.second.c_str()[j] ^= d.second.c_str()[j];
+	}
+      }
+    }
+    return 0;
+  }
+};
+
+static bool parity_delta_for_write(
+  const ECUtil::stripe_info_t &sinfo,
+  unsigned coding_chunks,
+  uint64_t size,
+  uint64_t off,
+  uint64_t len,
+  ECTransaction::ParityDelta *pd)
+{
+  hobject_t h;
+  PGTransaction t;
+  bufferlist bl;
+  bl.append_zero(len);
+  t.write(h, off, len, bl, 0);
+  return ECTransaction::get_parity_delta(
+    sinfo, coding_chunks, size, t.op_map[h], pd);
+}
+
+TEST(ectransaction, parity_delta_range)
+{
+  // k=4, m=2, 16k chunks
+  ECUtil::stripe_info_t sinfo(4, 4 * 16384);
+  const uint64_t size = 4 * sinfo.get_stripe_width();
+  ECTransaction::ParityDelta pd;
+
+  // a small write in the second chunk of the third stripe is widened to
+  // the page around it
+  uint64_t stripe = 2 * sinfo.get_stripe_width();
+  ASSERT_TRUE(parity_delta_for_write(
+    sinfo, 2, size, stripe + 16384 + 5000, 100, &pd));
+  ASSERT_EQ(1, pd.shard);
+  ASSERT_EQ(stripe + 16384 + 4096, pd.offset);
+  ASSERT_EQ(4096u, pd.length);
+  ASSERT_EQ(2 * 16384u + 4096, pd.chunk_offset);
+
+  // across a page boundary
+  ASSERT_TRUE(parity_delta_for_write(
+    sinfo, 2, size, stripe + 4000, 200, &pd));
+  ASSERT_EQ(0, pd.shard);
+  ASSERT_EQ(stripe, pd.offset);
+  ASSERT_EQ(8192u, pd.length);
+  ASSERT_EQ(2 * 16384u, pd.chunk_offset);
+
+  // spans two data chunks
+  ASSERT_FALSE(parity_delta_for_write(
+    sinfo, 2, size, stripe + 16384 - 100, 200, &pd));
+  // extends the object
+  ASSERT_FALSE(parity_delta_for_write(
+    sinfo, 2, size, size - 100, 200, &pd));
+  // (1 + m) * 16k would be read, as much as the full stripe
+  ASSERT_FALSE(parity_delta_for_write(
+    sinfo, 3, size, stripe, 16384, &pd));
+}
+
+TEST(ectransaction, parity_delta_plan)
+{
+  hobject_t h;
+  PGTransactionUPtr t(new PGTransaction);
+  bufferlist a;
+  a.append_zero(512);
+  t->write(h, 8192 + 512, a.length(), a, 0);
+
+  ECUtil::stripe_info_t sinfo(4, 4 * 4096);
+  auto plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      ECUtil::HashInfoRef ref(new ECUtil::HashInfo(6));
+      ref->set_projected_total_logical_size(
+	sinfo, 4 * sinfo.get_stripe_width());
+      return ref;
+    },
+    [&](const hobject_t &i,
+	const PGTransaction::ObjectOperation &o,
+	uint64_t size,
+	ECTransaction::ParityDelta *pd) {
+      return ECTransaction::get_parity_delta(sinfo, 2, size, o, pd);
+    },
+    &dpp);
+
+  ASSERT_EQ(0u, plan.to_read.size());
+  ASSERT_EQ(1u, plan.parity_delta.size());
+  const ECTransaction::ParityDelta &pd = plan.parity_delta[h];
+  ASSERT_EQ(2, pd.shard);
+  ASSERT_EQ(8192u, pd.offset);
+  ASSERT_EQ(4096u, pd.length);
+  ASSERT_EQ(4096u, plan.will_write[h].size());
+  ASSERT_TRUE(plan.will_write[h].contains(8192, 4096));
+
+  for (int shard = 0; shard < 6; ++shard) {
+    ASSERT_EQ(shard == 2 || shard >= 4,
+	      ECTransaction::parity_delta_writes_shard(4, pd, shard));
+  }
+}
+
+TEST(ectransaction, parity_delta_rollback_shards)
+{
+  struct visitor_t : public ObjectModDesc::Visitor {
+    vector<set<shard_id_t>> seen;
+    void rollback_extents(
+      version_t gen,
+      const vector<pair<uint64_t, uint64_t> > &extents,
+      const set<shard_id_t> &shards) override {
+      seen.push_back(shards);
+    }
+  };
+
+  // a parity delta write records the shards it stashed, a full stripe
+  // write stashes every shard and records none
+  const set<shard_id_t> stashed = {shard_id_t(2), shard_id_t(4),
+				   shard_id_t(5)};
+  ObjectModDesc delta;
+  delta.rollback_extents(10, {make_pair(8192, 4096)}, stashed);
+  ObjectModDesc full;
+  full.rollback_extents(11, {make_pair(0, 16384)});
+
+  for (auto *desc : {&delta, &full}) {
+    bufferlist bl;
+    encode(*desc, bl);
+    ObjectModDesc decoded;
+    auto p = bl.cbegin();
+    decode(decoded, p);
+    visitor_t vis;
+    decoded.visit(&vis);
+    ASSERT_EQ(1u, vis.seen.size());
+    ASSERT_EQ(desc == &delta ? stashed : set<shard_id_t>(), vis.seen[0]);
+  }
+}
+
+TEST(ectransaction, parity_delta_matches_encode)
+{
+  const unsigned k = 4;
+  const uint64_t chunk_size = 4096;
+  ECUtil::stripe_info_t sinfo(k, k * chunk_size);
+  ErasureCodeInterfaceRef ec_impl(new ErasureCodeXor(k));
+  set<int> want;
+  for (unsigned i = 0; i <= k; ++i) {
+    want.insert(i);
+  }
+
+  // two stripes of data, then overwrite 300 bytes in chunk 3 of the
+  // second stripe
+  bufferlist old_bl;
+  for (unsigned i = 0; i < 2 * sinfo.get_stripe_width(); ++i) {
+    old_bl.append((char)(i * 7 + i / 4096));
+  }
+  const uint64_t size = old_bl.length();
+  const uint64_t off = sinfo.get_stripe_width() + 3 * chunk_size + 1000;
+  const uint64_t len = 300;
+  bufferlist update;
+  for (unsigned i = 0; i < len; ++i) {
+    update.append((char)(0xa5 ^ i));
+  }
+  bufferlist new_bl;
+  new_bl.substr_of(old_bl, 0, off);
+  new_bl.append(update);
+  bufferlist tail;
+  tail.substr_of(old_bl, off + len, size - off - len);
+  new_bl.append(tail);
+
+  map<int, bufferlist> old_enc, new_enc;
+  ASSERT_EQ(0, ECUtil::encode(sinfo, ec_impl, old_bl, want, &old_enc));
+  ASSERT_EQ(0, ECUtil::encode(sinfo, ec_impl, new_bl, want, &new_enc));
+
+  ECTransaction::ParityDelta pd;
+  ASSERT_TRUE(parity_delta_for_write(sinfo, 1, size, off, len, &pd));
+  ASSERT_EQ(3, pd.shard);
+
+  bufferlist old_data, new_data;
+  old_data.substr_of(old_enc[pd.shard], pd.chunk_offset, pd.length);
+  new_data.substr_of(new_enc[pd.shard], pd.chunk_offset, pd.length);
+  map<int, bufferlist> parity;
+  parity[k].substr_of(old_enc[k], pd.chunk_offset, pd.length);
+  ASSERT_EQ(0, ECUtil::apply_parity_delta(
+	      ec_impl, pd.shard, old_data, new_data, &parity));
+
+  bufferlist expected;
+  expected.substr_of(new_enc[k], pd.chunk_offset, pd.length);
+  ASSERT_TRUE(expected.contents_equal(parity[k]));
+  // the old parity is left alone
+  bufferlist old_parity;
+  old_parity.substr_of(old_enc[k], pd.chunk_offset, pd.length);
+  ASSERT_FALSE(expected.contents_equal(old_parity));
+}
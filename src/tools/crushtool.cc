@@ -206,6 +206,8 @@ void usage()
   cout << "      [--simulate]       simulate placements using a random\n";
   cout << "                         number generator in place of the CRUSH\n";
   cout << "                         algorithm\n";
+  cout << "      [--verify-batch]   check the batched CRUSH mappings against\n";
+  cout << "                         mapping each input on its own\n";
   cout << "   --show-utilization    show OSD usage\n";
   cout << "   --show-utilization-all\n";
   cout << "                         include zero weight items\n";
@@ -528,6 +530,8 @@ int main(int argc, const char **argv)
     } else if (ceph_argparse_witharg(args, i, &full_location, err, "--show-location", (char*)NULL)) {
     } else if (ceph_argparse_flag(args, i, "-s", "--simulate", (char*)NULL)) {
       tester.set_random_placement();
+    } else if (ceph_argparse_flag(args, i, "--verify-batch", (char*)NULL)) {
+      tester.set_verify_batch(true);
     } else if (ceph_argparse_flag(args, i, "--enable-unsafe-tunables", (char*)NULL)) {
       unsafe_tunables = true;
     } else if (ceph_argparse_witharg(args, i, &choose_local_tries, err,